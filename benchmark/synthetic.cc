@@ -0,0 +1,370 @@
+#include "colmap/estimators/bundle_adjustment.h"
+#include "colmap/estimators/pose.h"
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/scene/database.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/sfm/incremental_mapper.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <benchmark/benchmark.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace colmap;
+
+// Records the peak resident memory of the process in megabytes. Note that the
+// peak is monotonic over the lifetime of the process, so run a benchmark in
+// isolation (--benchmark_filter) to attribute the peak to it.
+static void SetPeakResidentMemoryCounter(benchmark::State& state) {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    // Reported in bytes on macOS.
+    const double peak_rss_bytes = static_cast<double>(usage.ru_maxrss);
+#else
+    // Reported in kilobytes on Linux.
+    const double peak_rss_bytes = 1024.0 * usage.ru_maxrss;
+#endif
+    state.counters["peak_rss_mb"] = peak_rss_bytes / (1024.0 * 1024.0);
+  }
+#endif
+}
+
+// Scene sizes as {num_images, num_points3D, point2D_stddev}.
+static void SceneArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"num_images", "num_points3D", "point2D_stddev"});
+  for (const int num_images : {10, 50}) {
+    for (const int num_points3D : {100, 1000}) {
+      for (const int point2D_stddev : {0, 1}) {
+        benchmark->Args({num_images, num_points3D, point2D_stddev});
+      }
+    }
+  }
+}
+
+// Two-view sizes as {num_points3D, point2D_stddev}.
+static void TwoViewArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"num_points3D", "point2D_stddev"});
+  for (const int num_points3D : {100, 1000, 10000}) {
+    for (const int point2D_stddev : {0, 1}) {
+      benchmark->Args({num_points3D, point2D_stddev});
+    }
+  }
+}
+
+static SyntheticDatasetOptions CreateSyntheticDatasetOptions(
+    const int num_images,
+    const int num_points3D,
+    const double point2D_stddev) {
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = num_images;
+  options.num_points3D = num_points3D;
+  options.point2D_stddev = point2D_stddev;
+  return options;
+}
+
+static BundleAdjustmentConfig CreateBundleAdjustmentConfig(
+    const Reconstruction& reconstruction, const size_t num_images) {
+  BundleAdjustmentConfig config;
+  const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+  for (size_t i = 0; i < std::min(num_images, reg_image_ids.size()); ++i) {
+    config.AddImage(reg_image_ids[i]);
+  }
+  // As in the incremental mapper's local bundle adjustment, refine the points
+  // of the selected images, such that their observations in the remaining
+  // images are added to the problem with constant poses and intrinsics.
+  if (num_images < reg_image_ids.size()) {
+    for (const image_t image_id : config.Images()) {
+      for (const Point2D& point2D :
+           reconstruction.Image(image_id).Points2D()) {
+        if (point2D.HasPoint3D()) {
+          config.AddVariablePoint(point2D.point3D_id);
+        }
+      }
+    }
+  }
+  // Fix the gauge ambiguity as in the incremental mapper.
+  config.SetConstantCamPose(reg_image_ids[0]);
+  config.SetConstantCamPositions(reg_image_ids[1], {0});
+  return config;
+}
+
+static void BM_DatabaseCacheCreate(benchmark::State& state) {
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        state.range(0), state.range(1), state.range(2)),
+                    &reconstruction,
+                    &database);
+
+  for (auto _ : state) {
+    std::shared_ptr<DatabaseCache> database_cache =
+        DatabaseCache::Create(database,
+                              /*min_num_matches=*/0,
+                              /*ignore_watermarks=*/false,
+                              /*image_names=*/{});
+    benchmark::DoNotOptimize(database_cache);
+  }
+
+  state.SetItemsProcessed(state.iterations() * database.NumInlierMatches());
+  SetPeakResidentMemoryCounter(state);
+}
+BENCHMARK(BM_DatabaseCacheCreate)->Apply(SceneArgs);
+
+// Registers all images and triangulates their observations, starting from
+// the best initial image pair.
+static void BM_IncrementalMapperRegisterAndTriangulate(
+    benchmark::State& state) {
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction gt_reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        state.range(0), state.range(1), state.range(2)),
+                    &gt_reconstruction,
+                    &database);
+  std::shared_ptr<const DatabaseCache> database_cache =
+      DatabaseCache::Create(database,
+                            /*min_num_matches=*/0,
+                            /*ignore_watermarks=*/false,
+                            /*image_names=*/{});
+
+  const IncrementalMapper::Options mapper_options;
+  const IncrementalTriangulator::Options tri_options;
+
+  size_t num_reg_images = 0;
+  for (auto _ : state) {
+    auto reconstruction = std::make_shared<Reconstruction>();
+    IncrementalMapper mapper(database_cache);
+    mapper.BeginReconstruction(reconstruction);
+
+    TwoViewGeometry two_view_geometry;
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    if (!mapper.FindInitialImagePair(
+            mapper_options, two_view_geometry, image_id1, image_id2)) {
+      state.SkipWithError("Failed to find initial image pair");
+      break;
+    }
+    mapper.RegisterInitialImagePair(
+        mapper_options, two_view_geometry, image_id1, image_id2);
+    mapper.TriangulateImage(tri_options, image_id1);
+    mapper.TriangulateImage(tri_options, image_id2);
+
+    bool reg_next_success = true;
+    while (reg_next_success) {
+      reg_next_success = false;
+      for (const image_t next_image_id :
+           mapper.FindNextImages(mapper_options)) {
+        if (mapper.RegisterNextImage(mapper_options, next_image_id)) {
+          mapper.TriangulateImage(tri_options, next_image_id);
+          reg_next_success = true;
+          break;
+        }
+      }
+    }
+
+    num_reg_images += reconstruction->NumRegImages();
+    mapper.EndReconstruction(/*discard=*/false);
+  }
+
+  state.SetItemsProcessed(num_reg_images);
+  SetPeakResidentMemoryCounter(state);
+}
+BENCHMARK(BM_IncrementalMapperRegisterAndTriangulate)
+    ->Apply(SceneArgs)
+    ->Unit(benchmark::kMillisecond);
+
+static void RunBundleAdjustment(benchmark::State& state, size_t num_images) {
+  Reconstruction gt_reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        state.range(0), state.range(1), state.range(2)),
+                    &gt_reconstruction);
+  const BundleAdjustmentConfig config =
+      CreateBundleAdjustmentConfig(gt_reconstruction, num_images);
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+
+  size_t num_residuals = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Reconstruction reconstruction = gt_reconstruction;
+    state.ResumeTiming();
+
+    BundleAdjuster bundle_adjuster(options, config);
+    if (!bundle_adjuster.Solve(&reconstruction)) {
+      state.SkipWithError("Bundle adjustment failed");
+      break;
+    }
+    num_residuals += bundle_adjuster.Summary().num_residuals_reduced;
+  }
+
+  state.SetItemsProcessed(num_residuals);
+  SetPeakResidentMemoryCounter(state);
+}
+
+// Local bundle adjustment over as many images as the incremental mapper's
+// default local_ba_num_images. The points observed by these images are
+// refined, while the poses of their remaining observers are kept constant.
+static void BM_BundleAdjustmentLocal(benchmark::State& state) {
+  RunBundleAdjustment(state, IncrementalMapper::Options().local_ba_num_images);
+}
+BENCHMARK(BM_BundleAdjustmentLocal)
+    ->Apply(SceneArgs)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_BundleAdjustmentGlobal(benchmark::State& state) {
+  RunBundleAdjustment(state, std::numeric_limits<size_t>::max());
+}
+BENCHMARK(BM_BundleAdjustmentGlobal)
+    ->Apply(SceneArgs)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_EstimateTwoViewGeometry(benchmark::State& state) {
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        /*num_images=*/2, state.range(0), state.range(1)),
+                    &reconstruction,
+                    &database);
+
+  const Image& image1 = reconstruction.Image(1);
+  const Image& image2 = reconstruction.Image(2);
+  std::vector<Eigen::Vector2d> points1;
+  for (const Point2D& point2D : image1.Points2D()) {
+    points1.push_back(point2D.xy);
+  }
+  std::vector<Eigen::Vector2d> points2;
+  for (const Point2D& point2D : image2.Points2D()) {
+    points2.push_back(point2D.xy);
+  }
+  const FeatureMatches matches =
+      database.ReadTwoViewGeometry(1, 2).inlier_matches;
+
+  const TwoViewGeometryOptions options;
+  for (auto _ : state) {
+    const TwoViewGeometry two_view_geometry =
+        EstimateTwoViewGeometry(reconstruction.Camera(image1.CameraId()),
+                                points1,
+                                reconstruction.Camera(image2.CameraId()),
+                                points2,
+                                matches,
+                                options);
+    benchmark::DoNotOptimize(two_view_geometry);
+  }
+
+  state.SetItemsProcessed(state.iterations() * matches.size());
+  SetPeakResidentMemoryCounter(state);
+}
+BENCHMARK(BM_EstimateTwoViewGeometry)
+    ->Apply(TwoViewArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_EstimateAbsolutePose(benchmark::State& state) {
+  Reconstruction reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        /*num_images=*/2, state.range(0), state.range(1)),
+                    &reconstruction);
+
+  const Image& image = reconstruction.Image(1);
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  for (const Point2D& point2D : image.Points2D()) {
+    if (point2D.HasPoint3D()) {
+      points2D.push_back(point2D.xy);
+      points3D.push_back(reconstruction.Point3D(point2D.point3D_id).xyz);
+    }
+  }
+
+  const AbsolutePoseEstimationOptions options;
+  for (auto _ : state) {
+    Camera camera = reconstruction.Camera(image.CameraId());
+    Rigid3d cam_from_world;
+    size_t num_inliers;
+    std::vector<char> inlier_mask;
+    const bool success = EstimateAbsolutePose(options,
+                                              points2D,
+                                              points3D,
+                                              &cam_from_world,
+                                              &camera,
+                                              &num_inliers,
+                                              &inlier_mask);
+    benchmark::DoNotOptimize(success);
+  }
+
+  state.SetItemsProcessed(state.iterations() * points2D.size());
+  SetPeakResidentMemoryCounter(state);
+}
+BENCHMARK(BM_EstimateAbsolutePose)
+    ->Apply(TwoViewArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+static std::string CreateReconstructionDir() {
+  const boost::filesystem::path path =
+      boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path("colmap_benchmark_%%%%-%%%%-%%%%");
+  CreateDirIfNotExists(path.string());
+  return path.string();
+}
+
+static size_t GetReconstructionSize(const std::string& path) {
+  return GetFileSize(JoinPaths(path, "cameras.bin")) +
+         GetFileSize(JoinPaths(path, "images.bin")) +
+         GetFileSize(JoinPaths(path, "points3D.bin"));
+}
+
+static void BM_ReconstructionWriteBinary(benchmark::State& state) {
+  Reconstruction reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        state.range(0), state.range(1), state.range(2)),
+                    &reconstruction);
+  const std::string path = CreateReconstructionDir();
+
+  for (auto _ : state) {
+    reconstruction.WriteBinary(path);
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          reconstruction.ComputeNumObservations());
+  state.SetBytesProcessed(state.iterations() * GetReconstructionSize(path));
+  SetPeakResidentMemoryCounter(state);
+  boost::filesystem::remove_all(path);
+}
+BENCHMARK(BM_ReconstructionWriteBinary)
+    ->Apply(SceneArgs)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ReconstructionReadBinary(benchmark::State& state) {
+  Reconstruction gt_reconstruction;
+  SynthesizeDataset(CreateSyntheticDatasetOptions(
+                        state.range(0), state.range(1), state.range(2)),
+                    &gt_reconstruction);
+  const std::string path = CreateReconstructionDir();
+  gt_reconstruction.WriteBinary(path);
+
+  for (auto _ : state) {
+    Reconstruction reconstruction;
+    reconstruction.ReadBinary(path);
+    benchmark::DoNotOptimize(reconstruction);
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          gt_reconstruction.ComputeNumObservations());
+  state.SetBytesProcessed(state.iterations() * GetReconstructionSize(path));
+  SetPeakResidentMemoryCounter(state);
+  boost::filesystem::remove_all(path);
+}
+BENCHMARK(BM_ReconstructionReadBinary)
+    ->Apply(SceneArgs)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
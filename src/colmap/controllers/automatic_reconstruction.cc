@@ -39,6 +39,7 @@
 #include "colmap/mvs/patch_match.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/trace.h"
 
 namespace colmap {
 
@@ -84,6 +85,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
   option_manager_.sift_matching->num_threads = options_.num_threads;
   option_manager_.mapper->num_threads = options_.num_threads;
   option_manager_.poisson_meshing->num_threads = options_.num_threads;
+  option_manager_.patch_match_stereo->num_threads = options_.num_threads;
 
   ImageReaderOptions& reader_options = *option_manager_.image_reader;
   reader_options.database_path = *option_manager_.database_path;
@@ -100,6 +102,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 
   option_manager_.sift_extraction->use_gpu = options_.use_gpu;
   option_manager_.sift_matching->use_gpu = options_.use_gpu;
+  option_manager_.patch_match_stereo->use_gpu = options_.use_gpu;
 
   option_manager_.sift_extraction->gpu_index = options_.gpu_index;
   option_manager_.sift_matching->gpu_index = options_.gpu_index;
@@ -175,6 +178,7 @@ void AutomaticReconstructionController::Run() {
 }
 
 void AutomaticReconstructionController::RunFeatureExtraction() {
+  COLMAP_TRACE_SCOPE("automatic_reconstruction/feature_extraction");
   THROW_CHECK_NOTNULL(feature_extractor_);
   active_thread_ = feature_extractor_.get();
   feature_extractor_->Start();
@@ -184,6 +188,7 @@ void AutomaticReconstructionController::RunFeatureExtraction() {
 }
 
 void AutomaticReconstructionController::RunFeatureMatching() {
+  COLMAP_TRACE_SCOPE("automatic_reconstruction/feature_matching");
   Thread* matcher = nullptr;
   if (options_.data_type == DataType::VIDEO) {
     matcher = sequential_matcher_.get();
@@ -209,6 +214,7 @@ void AutomaticReconstructionController::RunFeatureMatching() {
 }
 
 void AutomaticReconstructionController::RunSparseMapper() {
+  COLMAP_TRACE_SCOPE("automatic_reconstruction/sparse_mapper");
   const auto sparse_path = JoinPaths(options_.workspace_path, "sparse");
   if (ExistsDir(sparse_path)) {
     auto dir_list = GetDirList(sparse_path);
@@ -236,6 +242,7 @@ void AutomaticReconstructionController::RunSparseMapper() {
 }
 
 void AutomaticReconstructionController::RunDenseMapper() {
+  COLMAP_TRACE_SCOPE("automatic_reconstruction/dense_mapper");
   CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
 
   for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
@@ -280,7 +287,6 @@ void AutomaticReconstructionController::RunDenseMapper() {
 
     // Patch match stereo.
 
-#if defined(COLMAP_CUDA_ENABLED)
     {
       mvs::PatchMatchController patch_match_controller(
           *option_manager_.patch_match_stereo, dense_path, "COLMAP", "");
@@ -288,10 +294,6 @@ void AutomaticReconstructionController::RunDenseMapper() {
           [&]() { return IsStopped(); });
       patch_match_controller.Run();
     }
-#else   // COLMAP_CUDA_ENABLED
-    LOG(WARNING) << "Skipping patch match stereo because CUDA is not available";
-    return;
-#endif  // COLMAP_CUDA_ENABLED
 
     if (IsStopped()) {
       return;
@@ -31,11 +31,15 @@
 
 #include "colmap/feature/sift.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/util/cuda.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
 #include "colmap/util/timer.h"
+#include "colmap/util/trace.h"
 
+#include <atomic>
+#include <map>
 #include <numeric>
 
 namespace colmap {
@@ -82,7 +86,40 @@ void MaskKeypoints(const Bitmap& mask,
   descriptors->conservativeResize(out_index, descriptors->cols());
 }
 
+// Number of processed images and accumulated processing time of one stage of
+// the extraction pipeline, shared by all threads of the stage.
+struct StageCounter {
+  StageCounter(std::string name, int num_threads)
+      : name(std::move(name)), num_threads(num_threads) {}
+
+  void Add(const Timer& timer) {
+    num_images += 1;
+    busy_micro_seconds += static_cast<int64_t>(timer.ElapsedMicroSeconds());
+  }
+
+  void Print(const double elapsed_seconds) const {
+    const double busy_seconds = busy_micro_seconds * 1e-6;
+    LOG(INFO) << StringPrintf(
+        "  %-10s %d images, %.2f images/s, %.1fms/image, %d threads, "
+        "%.0f%% busy",
+        (name + ":").c_str(),
+        static_cast<int>(num_images),
+        num_images / std::max(elapsed_seconds, 1e-9),
+        1e3 * busy_seconds / std::max<size_t>(num_images, 1),
+        num_threads,
+        100 * busy_seconds / std::max(num_threads * elapsed_seconds, 1e-9));
+  }
+
+  const std::string name;
+  const int num_threads;
+  std::atomic<size_t> num_images{0};
+  std::atomic<int64_t> busy_micro_seconds{0};
+};
+
 struct ImageData {
+  // Index of the image in the order of the image reader.
+  size_t index = 0;
+
   ImageReader::Status status = ImageReader::Status::FAILURE;
 
   Camera camera;
@@ -94,12 +131,64 @@ struct ImageData {
   FeatureDescriptors descriptors;
 };
 
+class ImageDecoderThread : public Thread {
+ public:
+  ImageDecoderThread(const ImageReader* image_reader,
+                     StageCounter* counter,
+                     JobQueue<ImageData>* input_queue,
+                     JobQueue<ImageData>* output_queue)
+      : image_reader_(image_reader),
+        counter_(counter),
+        input_queue_(input_queue),
+        output_queue_(output_queue) {}
+
+ private:
+  void Run() override {
+    while (true) {
+      if (IsStopped()) {
+        break;
+      }
+
+      auto input_job = input_queue_->Pop();
+      if (input_job.IsValid()) {
+        auto& image_data = input_job.Data();
+
+        if (image_data.status == ImageReader::Status::SUCCESS) {
+          COLMAP_TRACE_SCOPE("feature_extraction/decode_image");
+          Timer timer;
+          timer.Start();
+          image_data.status = image_reader_->ReadBitmap(image_data.camera,
+                                                        image_data.image,
+                                                        &image_data.bitmap,
+                                                        &image_data.mask);
+          if (image_data.status != ImageReader::Status::SUCCESS) {
+            image_data.bitmap.Deallocate();
+          }
+          counter_->Add(timer);
+        }
+
+        output_queue_->Push(std::move(image_data));
+      } else {
+        break;
+      }
+    }
+  }
+
+  const ImageReader* image_reader_;
+  StageCounter* counter_;
+
+  JobQueue<ImageData>* input_queue_;
+  JobQueue<ImageData>* output_queue_;
+};
+
 class ImageResizerThread : public Thread {
  public:
   ImageResizerThread(int max_image_size,
+                     StageCounter* counter,
                      JobQueue<ImageData>* input_queue,
                      JobQueue<ImageData>* output_queue)
       : max_image_size_(max_image_size),
+        counter_(counter),
         input_queue_(input_queue),
         output_queue_(output_queue) {}
 
@@ -115,6 +204,9 @@ class ImageResizerThread : public Thread {
         auto& image_data = input_job.Data();
 
         if (image_data.status == ImageReader::Status::SUCCESS) {
+          COLMAP_TRACE_SCOPE("feature_extraction/resize_image");
+          Timer timer;
+          timer.Start();
           if (static_cast<int>(image_data.bitmap.Width()) > max_image_size_ ||
               static_cast<int>(image_data.bitmap.Height()) > max_image_size_) {
             // Fit the down-sampled version exactly into the max dimensions.
@@ -128,6 +220,7 @@ class ImageResizerThread : public Thread {
 
             image_data.bitmap.Rescale(new_width, new_height);
           }
+          counter_->Add(timer);
         }
 
         output_queue_->Push(std::move(image_data));
@@ -138,6 +231,7 @@ class ImageResizerThread : public Thread {
   }
 
   const int max_image_size_;
+  StageCounter* counter_;
 
   JobQueue<ImageData>* input_queue_;
   JobQueue<ImageData>* output_queue_;
@@ -147,10 +241,12 @@ class SiftFeatureExtractorThread : public Thread {
  public:
   SiftFeatureExtractorThread(const SiftExtractionOptions& sift_options,
                              const std::shared_ptr<Bitmap>& camera_mask,
+                             StageCounter* counter,
                              JobQueue<ImageData>* input_queue,
                              JobQueue<ImageData>* output_queue)
       : sift_options_(sift_options),
         camera_mask_(camera_mask),
+        counter_(counter),
         input_queue_(input_queue),
         output_queue_(output_queue) {
     THROW_CHECK(sift_options_.Check());
@@ -191,6 +287,9 @@ class SiftFeatureExtractorThread : public Thread {
         auto& image_data = input_job.Data();
 
         if (image_data.status == ImageReader::Status::SUCCESS) {
+          COLMAP_TRACE_SCOPE("feature_extraction/extract_features");
+          Timer timer;
+          timer.Start();
           if (extractor->Extract(image_data.bitmap,
                                  &image_data.keypoints,
                                  &image_data.descriptors)) {
@@ -209,6 +308,7 @@ class SiftFeatureExtractorThread : public Thread {
           } else {
             image_data.status = ImageReader::Status::FAILURE;
           }
+          counter_->Add(timer);
         }
 
         image_data.bitmap.Deallocate();
@@ -222,6 +322,7 @@ class SiftFeatureExtractorThread : public Thread {
 
   const SiftExtractionOptions sift_options_;
   std::shared_ptr<Bitmap> camera_mask_;
+  StageCounter* counter_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
@@ -233,14 +334,22 @@ class FeatureWriterThread : public Thread {
  public:
   FeatureWriterThread(size_t num_images,
                       Database* database,
+                      FeatureStore* feature_store,
+                      StageCounter* counter,
                       JobQueue<ImageData>* input_queue)
       : num_images_(num_images),
         database_(database),
+        feature_store_(feature_store),
+        counter_(counter),
         input_queue_(input_queue) {}
 
  private:
   void Run() override {
-    size_t image_index = 0;
+    // The images leave the parallel stages of the pipeline in arbitrary order.
+    // Write them in their reading order, so that the output and the assigned
+    // image identifiers do not depend on the thread scheduling.
+    std::map<size_t, ImageData> pending_image_data;
+    size_t next_index = 0;
     while (true) {
       if (IsStopped()) {
         break;
@@ -249,83 +358,104 @@ class FeatureWriterThread : public Thread {
       auto input_job = input_queue_->Pop();
       if (input_job.IsValid()) {
         auto& image_data = input_job.Data();
-
-        image_index += 1;
-
-        LOG(INFO) << StringPrintf(
-            "Processed file [%d/%d]", image_index, num_images_);
-
-        LOG(INFO) << StringPrintf("  Name:            %s",
-                                  image_data.image.Name().c_str());
-
-        if (image_data.status == ImageReader::Status::IMAGE_EXISTS) {
-          LOG(INFO) << "  SKIP: Features for image already extracted.";
-        } else if (image_data.status == ImageReader::Status::BITMAP_ERROR) {
-          LOG(ERROR) << "Failed to read image file format.";
-        } else if (image_data.status ==
-                   ImageReader::Status::CAMERA_SINGLE_DIM_ERROR) {
-          LOG(ERROR) << "Single camera specified, "
-                        "but images have different dimensions.";
-        } else if (image_data.status ==
-                   ImageReader::Status::CAMERA_EXIST_DIM_ERROR) {
-          LOG(ERROR) << "Image previously processed, but current image "
-                        "has different dimensions.";
-        } else if (image_data.status ==
-                   ImageReader::Status::CAMERA_PARAM_ERROR) {
-          LOG(ERROR) << "Camera has invalid parameters.";
-        } else if (image_data.status == ImageReader::Status::FAILURE) {
-          LOG(ERROR) << "Failed to extract features.";
+        const size_t index = image_data.index;
+        pending_image_data.emplace(index, std::move(image_data));
+        while (!pending_image_data.empty() &&
+               pending_image_data.begin()->first == next_index) {
+          COLMAP_TRACE_SCOPE("feature_extraction/write_features");
+          Timer timer;
+          timer.Start();
+          Write(std::move(pending_image_data.begin()->second));
+          pending_image_data.erase(pending_image_data.begin());
+          next_index += 1;
+          counter_->Add(timer);
         }
+      } else {
+        break;
+      }
+    }
+  }
 
-        if (image_data.status != ImageReader::Status::SUCCESS) {
-          continue;
-        }
+  void Write(ImageData image_data) {
+    LOG(INFO) << StringPrintf(
+        "Processed file [%d/%d]", image_data.index + 1, num_images_);
+
+    LOG(INFO) << StringPrintf("  Name:            %s",
+                              image_data.image.Name().c_str());
+
+    if (image_data.status == ImageReader::Status::IMAGE_EXISTS) {
+      LOG(INFO) << "  SKIP: Features for image already extracted.";
+    } else if (image_data.status == ImageReader::Status::BITMAP_ERROR) {
+      LOG(ERROR) << "Failed to read image file format.";
+    } else if (image_data.status ==
+               ImageReader::Status::CAMERA_SINGLE_DIM_ERROR) {
+      LOG(ERROR) << "Single camera specified, "
+                    "but images have different dimensions.";
+    } else if (image_data.status ==
+               ImageReader::Status::CAMERA_EXIST_DIM_ERROR) {
+      LOG(ERROR) << "Image previously processed, but current image "
+                    "has different dimensions.";
+    } else if (image_data.status == ImageReader::Status::CAMERA_PARAM_ERROR) {
+      LOG(ERROR) << "Camera has invalid parameters.";
+    } else if (image_data.status == ImageReader::Status::FAILURE) {
+      LOG(ERROR) << "Failed to extract features.";
+    }
 
-        LOG(INFO) << StringPrintf("  Dimensions:      %d x %d",
-                                  image_data.camera.width,
-                                  image_data.camera.height);
-        LOG(INFO) << StringPrintf("  Camera:          #%d - %s",
-                                  image_data.camera.camera_id,
-                                  image_data.camera.ModelName().c_str());
-        LOG(INFO) << StringPrintf(
-            "  Focal Length:    %.2fpx%s",
-            image_data.camera.MeanFocalLength(),
-            image_data.camera.has_prior_focal_length ? " (Prior)" : "");
-        const Eigen::Vector3d& translation_prior =
-            image_data.image.CamFromWorldPrior().translation;
-        if (translation_prior.array().isFinite().any()) {
-          LOG(INFO) << StringPrintf(
-              "  GPS:             LAT=%.3f, LON=%.3f, ALT=%.3f",
-              translation_prior.x(),
-              translation_prior.y(),
-              translation_prior.z());
-        }
-        LOG(INFO) << StringPrintf("  Features:        %d",
-                                  image_data.keypoints.size());
+    if (image_data.status != ImageReader::Status::SUCCESS) {
+      return;
+    }
 
-        DatabaseTransaction database_transaction(database_);
+    LOG(INFO) << StringPrintf("  Dimensions:      %d x %d",
+                              image_data.camera.width,
+                              image_data.camera.height);
+    LOG(INFO) << StringPrintf("  Camera:          #%d - %s",
+                              image_data.camera.camera_id,
+                              image_data.camera.ModelName().c_str());
+    LOG(INFO) << StringPrintf(
+        "  Focal Length:    %.2fpx%s",
+        image_data.camera.MeanFocalLength(),
+        image_data.camera.has_prior_focal_length ? " (Prior)" : "");
+    const Eigen::Vector3d& translation_prior =
+        image_data.image.CamFromWorldPrior().translation;
+    if (translation_prior.array().isFinite().any()) {
+      LOG(INFO) << StringPrintf(
+          "  GPS:             LAT=%.3f, LON=%.3f, ALT=%.3f",
+          translation_prior.x(),
+          translation_prior.y(),
+          translation_prior.z());
+    }
+    LOG(INFO) << StringPrintf("  Features:        %d",
+                              image_data.keypoints.size());
+    TraceValue("feature_extraction/num_features", image_data.keypoints.size());
 
-        if (image_data.image.ImageId() == kInvalidImageId) {
-          image_data.image.SetImageId(database_->WriteImage(image_data.image));
-        }
+    DatabaseTransaction database_transaction(database_);
 
-        if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
-          database_->WriteKeypoints(image_data.image.ImageId(),
-                                    image_data.keypoints);
-        }
+    if (image_data.image.ImageId() == kInvalidImageId) {
+      image_data.image.SetImageId(database_->WriteImage(image_data.image));
+    }
 
-        if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
-          database_->WriteDescriptors(image_data.image.ImageId(),
-                                      image_data.descriptors);
-        }
-      } else {
-        break;
+    if (feature_store_ != nullptr) {
+      feature_store_->WriteKeypoints(image_data.image.ImageId(),
+                                     image_data.keypoints);
+      feature_store_->WriteDescriptors(image_data.image.ImageId(),
+                                       image_data.descriptors);
+    } else {
+      if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
+        database_->WriteKeypoints(image_data.image.ImageId(),
+                                  image_data.keypoints);
+      }
+
+      if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
+        database_->WriteDescriptors(image_data.image.ImageId(),
+                                    image_data.descriptors);
       }
     }
   }
 
   const size_t num_images_;
   Database* database_;
+  FeatureStore* feature_store_;
+  StageCounter* counter_;
   JobQueue<ImageData>* input_queue_;
 };
 
@@ -337,7 +467,11 @@ class FeatureExtractorController : public Thread {
       : reader_options_(reader_options),
         sift_options_(sift_options),
         database_(reader_options_.database_path),
-        image_reader_(reader_options_, &database_) {
+        feature_store_(reader_options_.feature_store_path.empty()
+                           ? nullptr
+                           : std::make_unique<FeatureStore>(
+                                 reader_options_.feature_store_path)),
+        image_reader_(reader_options_, &database_, feature_store_.get()) {
     THROW_CHECK(reader_options_.Check());
     THROW_CHECK(sift_options_.Check());
 
@@ -360,14 +494,29 @@ class FeatureExtractorController : public Thread {
     // avoid excess in memory usage since images and features take lots of
     // memory.
     const int kQueueSize = 1;
+    decoder_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
     resizer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
     extractor_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
     writer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
 
+    // Decoding the images is expensive, so it is done in parallel after the
+    // sequential reading of the metadata and assignment of the cameras.
+    decode_counter_ = std::make_unique<StageCounter>("Decode", num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      decoders_.emplace_back(std::make_unique<ImageDecoderThread>(
+          &image_reader_,
+          decode_counter_.get(),
+          decoder_queue_.get(),
+          sift_options_.max_image_size > 0 ? resizer_queue_.get()
+                                           : extractor_queue_.get()));
+    }
+
     if (sift_options_.max_image_size > 0) {
+      resize_counter_ = std::make_unique<StageCounter>("Resize", num_threads);
       for (int i = 0; i < num_threads; ++i) {
         resizers_.emplace_back(
             std::make_unique<ImageResizerThread>(sift_options_.max_image_size,
+                                                 resize_counter_.get(),
                                                  resizer_queue_.get(),
                                                  extractor_queue_.get()));
       }
@@ -387,12 +536,15 @@ class FeatureExtractorController : public Thread {
       }
 #endif  // COLMAP_CUDA_ENABLED
 
+      extract_counter_ = std::make_unique<StageCounter>(
+          "Extract", static_cast<int>(gpu_indices.size()));
       auto sift_gpu_options = sift_options_;
       for (const auto& gpu_index : gpu_indices) {
         sift_gpu_options.gpu_index = std::to_string(gpu_index);
         extractors_.emplace_back(
             std::make_unique<SiftFeatureExtractorThread>(sift_gpu_options,
                                                          camera_mask,
+                                                         extract_counter_.get(),
                                                          extractor_queue_.get(),
                                                          writer_queue_.get()));
       }
@@ -411,19 +563,26 @@ class FeatureExtractorController : public Thread {
                "memory for the current settings.";
       }
 
+      extract_counter_ = std::make_unique<StageCounter>("Extract", num_threads);
       auto custom_sift_options = sift_options_;
       custom_sift_options.use_gpu = false;
       for (int i = 0; i < num_threads; ++i) {
         extractors_.emplace_back(
             std::make_unique<SiftFeatureExtractorThread>(custom_sift_options,
                                                          camera_mask,
+                                                         extract_counter_.get(),
                                                          extractor_queue_.get(),
                                                          writer_queue_.get()));
       }
     }
 
-    writer_ = std::make_unique<FeatureWriterThread>(
-        image_reader_.NumImages(), &database_, writer_queue_.get());
+    metadata_counter_ = std::make_unique<StageCounter>("Metadata", 1);
+    write_counter_ = std::make_unique<StageCounter>("Write", 1);
+    writer_ = std::make_unique<FeatureWriterThread>(image_reader_.NumImages(),
+                                                    &database_,
+                                                    feature_store_.get(),
+                                                    write_counter_.get(),
+                                                    writer_queue_.get());
   }
 
  private:
@@ -432,6 +591,10 @@ class FeatureExtractorController : public Thread {
     Timer run_timer;
     run_timer.Start();
 
+    for (auto& decoder : decoders_) {
+      decoder->Start();
+    }
+
     for (auto& resizer : resizers_) {
       resizer->Start();
     }
@@ -450,28 +613,30 @@ class FeatureExtractorController : public Thread {
 
     while (image_reader_.NextIndex() < image_reader_.NumImages()) {
       if (IsStopped()) {
+        decoder_queue_->Stop();
         resizer_queue_->Stop();
         extractor_queue_->Stop();
+        decoder_queue_->Clear();
         resizer_queue_->Clear();
         extractor_queue_->Clear();
         break;
       }
 
+      Timer timer;
+      timer.Start();
       ImageData image_data;
-      image_data.status = image_reader_.Next(&image_data.camera,
-                                             &image_data.image,
-                                             &image_data.bitmap,
-                                             &image_data.mask);
+      image_data.index = image_reader_.NextIndex();
+      image_data.status =
+          image_reader_.NextMetadata(&image_data.camera, &image_data.image);
+      metadata_counter_->Add(timer);
 
-      if (image_data.status != ImageReader::Status::SUCCESS) {
-        image_data.bitmap.Deallocate();
-      }
+      THROW_CHECK(decoder_queue_->Push(std::move(image_data)));
+    }
 
-      if (sift_options_.max_image_size > 0) {
-        THROW_CHECK(resizer_queue_->Push(std::move(image_data)));
-      } else {
-        THROW_CHECK(extractor_queue_->Push(std::move(image_data)));
-      }
+    decoder_queue_->Wait();
+    decoder_queue_->Stop();
+    for (auto& decoder : decoders_) {
+      decoder->Wait();
     }
 
     resizer_queue_->Wait();
@@ -490,6 +655,18 @@ class FeatureExtractorController : public Thread {
     writer_queue_->Stop();
     writer_->Wait();
 
+    LOG(INFO) << "Stage throughput:";
+    const double elapsed_seconds = run_timer.ElapsedSeconds();
+    for (const auto* counter : {metadata_counter_.get(),
+                                decode_counter_.get(),
+                                resize_counter_.get(),
+                                extract_counter_.get(),
+                                write_counter_.get()}) {
+      if (counter != nullptr) {
+        counter->Print(elapsed_seconds);
+      }
+    }
+
     run_timer.PrintMinutes();
   }
 
@@ -497,12 +674,21 @@ class FeatureExtractorController : public Thread {
   const SiftExtractionOptions sift_options_;
 
   Database database_;
+  std::unique_ptr<FeatureStore> feature_store_;
   ImageReader image_reader_;
 
+  std::vector<std::unique_ptr<Thread>> decoders_;
   std::vector<std::unique_ptr<Thread>> resizers_;
   std::vector<std::unique_ptr<Thread>> extractors_;
   std::unique_ptr<Thread> writer_;
 
+  std::unique_ptr<StageCounter> metadata_counter_;
+  std::unique_ptr<StageCounter> decode_counter_;
+  std::unique_ptr<StageCounter> resize_counter_;
+  std::unique_ptr<StageCounter> extract_counter_;
+  std::unique_ptr<StageCounter> write_counter_;
+
+  std::unique_ptr<JobQueue<ImageData>> decoder_queue_;
   std::unique_ptr<JobQueue<ImageData>> resizer_queue_;
   std::unique_ptr<JobQueue<ImageData>> extractor_queue_;
   std::unique_ptr<JobQueue<ImageData>> writer_queue_;
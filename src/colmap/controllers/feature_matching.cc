@@ -37,7 +37,11 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <numeric>
 
 namespace colmap {
@@ -47,6 +51,16 @@ void PrintElapsedTime(const Timer& timer) {
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
 }
 
+void PrintFeatureCacheStatistics(FeatureMatcherCache* cache) {
+  const size_t num_hits = cache->NumFeatureCacheHits();
+  const size_t num_misses = cache->NumFeatureCacheMisses();
+  LOG(INFO) << StringPrintf(
+      "Feature cache: %zu reads, %.1f%% hit rate",
+      num_misses,
+      num_hits + num_misses > 0 ? 100.0 * num_hits / (num_hits + num_misses)
+                                : 0.0);
+}
+
 void IndexImagesInVisualIndex(const int num_threads,
                               const int num_checks,
                               const int max_num_features,
@@ -211,53 +225,71 @@ class ExhaustiveFeatureMatcher : public Thread {
         std::ceil(static_cast<double>(image_ids.size()) / block_size));
     const size_t num_pairs_per_block = block_size * (block_size - 1) / 2;
 
+    // Process the blocks along a Hilbert curve over the block matrix instead
+    // of row by row. Consecutive blocks then share their first or second
+    // images and the last few blocks mostly cover the same images, which
+    // remain in the cache of 5 blocks of images.
+    size_t num_curve_cells = 1;
+    while (num_curve_cells < num_blocks) {
+      num_curve_cells *= 2;
+    }
+    std::vector<std::pair<uint64_t, std::pair<size_t, size_t>>> blocks;
+    blocks.reserve(num_blocks * num_blocks);
+    for (size_t block_idx1 = 0; block_idx1 < num_blocks; ++block_idx1) {
+      for (size_t block_idx2 = 0; block_idx2 < num_blocks; ++block_idx2) {
+        blocks.emplace_back(
+            HilbertCurveIndex(num_curve_cells, block_idx1, block_idx2),
+            std::make_pair(block_idx1, block_idx2));
+      }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
     std::vector<std::pair<image_t, image_t>> image_pairs;
     image_pairs.reserve(num_pairs_per_block);
 
-    for (size_t start_idx1 = 0; start_idx1 < image_ids.size();
-         start_idx1 += block_size) {
+    for (const auto& block : blocks) {
+      const size_t start_idx1 = block.second.first * block_size;
       const size_t end_idx1 =
           std::min(image_ids.size(), start_idx1 + block_size) - 1;
-      for (size_t start_idx2 = 0; start_idx2 < image_ids.size();
-           start_idx2 += block_size) {
-        const size_t end_idx2 =
-            std::min(image_ids.size(), start_idx2 + block_size) - 1;
-
-        if (IsStopped()) {
-          run_timer.PrintMinutes();
-          return;
-        }
+      const size_t start_idx2 = block.second.second * block_size;
+      const size_t end_idx2 =
+          std::min(image_ids.size(), start_idx2 + block_size) - 1;
 
-        Timer timer;
-        timer.Start();
-
-        LOG(INFO) << StringPrintf("Matching block [%d/%d, %d/%d]",
-                                  start_idx1 / block_size + 1,
-                                  num_blocks,
-                                  start_idx2 / block_size + 1,
-                                  num_blocks)
-                  << std::flush;
-
-        image_pairs.clear();
-        for (size_t idx1 = start_idx1; idx1 <= end_idx1; ++idx1) {
-          for (size_t idx2 = start_idx2; idx2 <= end_idx2; ++idx2) {
-            const size_t block_id1 = idx1 % block_size;
-            const size_t block_id2 = idx2 % block_size;
-            if ((idx1 > idx2 && block_id1 <= block_id2) ||
-                (idx1 < idx2 &&
-                 block_id1 < block_id2)) {  // Avoid duplicate pairs
-              image_pairs.emplace_back(image_ids[idx1], image_ids[idx2]);
-            }
+      if (IsStopped()) {
+        run_timer.PrintMinutes();
+        return;
+      }
+
+      Timer timer;
+      timer.Start();
+
+      LOG(INFO) << StringPrintf("Matching block [%d/%d, %d/%d]",
+                                block.second.first + 1,
+                                num_blocks,
+                                block.second.second + 1,
+                                num_blocks)
+                << std::flush;
+
+      image_pairs.clear();
+      for (size_t idx1 = start_idx1; idx1 <= end_idx1; ++idx1) {
+        for (size_t idx2 = start_idx2; idx2 <= end_idx2; ++idx2) {
+          const size_t block_id1 = idx1 % block_size;
+          const size_t block_id2 = idx2 % block_size;
+          if ((idx1 > idx2 && block_id1 <= block_id2) ||
+              (idx1 < idx2 &&
+               block_id1 < block_id2)) {  // Avoid duplicate pairs
+            image_pairs.emplace_back(image_ids[idx1], image_ids[idx2]);
           }
         }
+      }
 
-        DatabaseTransaction database_transaction(&database_);
-        matcher_.Match(image_pairs);
+      DatabaseTransaction database_transaction(&database_);
+      matcher_.Match(image_pairs);
 
-        PrintElapsedTime(timer);
-      }
+      PrintElapsedTime(timer);
     }
 
+    PrintFeatureCacheStatistics(&cache_);
     run_timer.PrintMinutes();
   }
 
@@ -396,7 +428,7 @@ class SequentialFeatureMatcher : public Thread {
   void RunLoopDetection(const std::vector<image_t>& image_ids) {
     // Read the pre-trained vocabulary tree from disk.
     retrieval::VisualIndex<> visual_index;
-    visual_index.Read(options_.vocab_tree_path);
+    visual_index.Read(options_.vocab_tree_path, /*memory_map=*/true);
 
     // Index all images in the visual index.
     IndexImagesInVisualIndex(matching_options_.num_threads,
@@ -491,7 +523,7 @@ class VocabTreeFeatureMatcher : public Thread {
 
     // Read the pre-trained vocabulary tree from disk.
     retrieval::VisualIndex<> visual_index;
-    visual_index.Read(options_.vocab_tree_path);
+    visual_index.Read(options_.vocab_tree_path, /*memory_map=*/true);
 
     const std::vector<image_t> all_image_ids = cache_.GetImageIds();
     std::vector<image_t> image_ids;
@@ -621,16 +653,11 @@ class SpatialFeatureMatcher : public Thread {
 
     LOG(INFO) << "Indexing images..." << std::flush;
 
-    GPSTransform gps_transform;
-
-    size_t num_locations = 0;
-    Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
-        image_ids.size(), 3);
-
     std::vector<size_t> location_idxs;
     location_idxs.reserve(image_ids.size());
 
-    std::vector<Eigen::Vector3d> ells(1);
+    std::vector<Eigen::Vector3d> ells;
+    ells.reserve(image_ids.size());
 
     for (size_t i = 0; i < image_ids.size(); ++i) {
       const auto image_id = image_ids[i];
@@ -646,37 +673,50 @@ class SpatialFeatureMatcher : public Thread {
       }
 
       location_idxs.push_back(i);
-
-      if (options_.is_gps) {
-        ells[0](0) = translation_prior(0);
-        ells[0](1) = translation_prior(1);
-        ells[0](2) = options_.ignore_z ? 0 : translation_prior(2);
-
-        const auto xyzs = gps_transform.EllToXYZ(ells);
-
-        location_matrix(num_locations, 0) = static_cast<float>(xyzs[0](0));
-        location_matrix(num_locations, 1) = static_cast<float>(xyzs[0](1));
-        location_matrix(num_locations, 2) = static_cast<float>(xyzs[0](2));
-      } else {
-        location_matrix(num_locations, 0) =
-            static_cast<float>(translation_prior(0));
-        location_matrix(num_locations, 1) =
-            static_cast<float>(translation_prior(1));
-        location_matrix(num_locations, 2) =
-            static_cast<float>(options_.ignore_z ? 0 : translation_prior(2));
-      }
-
-      num_locations += 1;
+      ells.emplace_back(translation_prior(0),
+                        translation_prior(1),
+                        options_.ignore_z ? 0 : translation_prior(2));
     }
 
-    PrintElapsedTime(timer);
+    const size_t num_locations = location_idxs.size();
 
     if (num_locations == 0) {
+      PrintElapsedTime(timer);
       LOG(INFO) << "=> No images with location data.";
       run_timer.PrintMinutes();
       return;
     }
 
+    ThreadPool thread_pool(
+        GetEffectiveNumThreads(matching_options_.num_threads));
+
+    // The locations are converted and searched in parallel in chunks of
+    // consecutive locations.
+    const size_t kChunkSize = 1024;
+    auto ParallelForChunks =
+        [&thread_pool, kChunkSize, num_locations](
+            const std::function<void(size_t, size_t)>& func) {
+          thread_pool.ParallelFor(0, num_locations, kChunkSize, func);
+        };
+
+    Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
+        num_locations, 3);
+
+    GPSTransform gps_transform;
+    ParallelForChunks([this, &gps_transform, &ells, &location_matrix](
+                          const size_t begin, const size_t end) {
+      std::vector<Eigen::Vector3d> xyzs(ells.begin() + begin,
+                                        ells.begin() + end);
+      if (options_.is_gps) {
+        xyzs = gps_transform.EllToXYZ(xyzs);
+      }
+      for (size_t i = begin; i < end; ++i) {
+        location_matrix.row(i) = xyzs[i - begin].cast<float>();
+      }
+    });
+
+    PrintElapsedTime(timer);
+
     //////////////////////////////////////////////////////////////////////////////
     // Building spatial index
     //////////////////////////////////////////////////////////////////////////////
@@ -688,9 +728,11 @@ class SpatialFeatureMatcher : public Thread {
     flann::Matrix<float> locations(
         location_matrix.data(), num_locations, location_matrix.cols());
 
-    flann::LinearIndexParams index_params;
-    flann::LinearIndex<flann::L2<float>> search_index(index_params);
-    search_index.buildIndex(locations);
+    // Exact k-d tree search, which is efficient for low-dimensional data.
+    flann::KDTreeSingleIndexParams index_params;
+    flann::KDTreeSingleIndex<flann::L2<float>> search_index(locations,
+                                                            index_params);
+    search_index.buildIndex();
 
     PrintElapsedTime(timer);
 
@@ -702,27 +744,34 @@ class SpatialFeatureMatcher : public Thread {
 
     LOG(INFO) << "Searching for nearest neighbors..." << std::flush;
 
-    const int knn = std::min<int>(options_.max_num_neighbors, num_locations);
-
-    Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        index_matrix(num_locations, knn);
-    flann::Matrix<size_t> indices(index_matrix.data(), num_locations, knn);
-
-    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        distance_matrix(num_locations, knn);
-    flann::Matrix<float> distances(distance_matrix.data(), num_locations, knn);
-
-    flann::SearchParams search_params(flann::FLANN_CHECKS_AUTOTUNED);
-    if (matching_options_.num_threads == ThreadPool::kMaxNumThreads) {
-      search_params.cores = std::thread::hardware_concurrency();
-    } else {
-      search_params.cores = matching_options_.num_threads;
-    }
-    if (search_params.cores <= 0) {
-      search_params.cores = 1;
-    }
-
-    search_index.knnSearch(locations, indices, distances, knn, search_params);
+    // The radius query returns at most the nearest `max_num_neighbors`
+    // locations within the maximum distance, sorted by distance.
+    flann::SearchParams search_params;
+    search_params.max_neighbors =
+        std::min<int>(options_.max_num_neighbors, num_locations);
+    search_params.sorted = true;
+    search_params.cores = 1;
+
+    // The radius query excludes locations at exactly the maximum distance,
+    // which are included by inflating the squared radius by one ulp.
+    const float max_distance = std::nextafter(
+        static_cast<float>(options_.max_distance * options_.max_distance),
+        std::numeric_limits<float>::max());
+
+    std::vector<std::vector<size_t>> neighbor_idxs(num_locations);
+    ParallelForChunks([&search_index,
+                       &search_params,
+                       &location_matrix,
+                       max_distance,
+                       &neighbor_idxs](const size_t begin, const size_t end) {
+      const flann::Matrix<float> queries(
+          location_matrix.row(begin).data(), end - begin, 3);
+      std::vector<std::vector<size_t>> indices;
+      std::vector<std::vector<float>> distances;
+      search_index.radiusSearch(
+          queries, indices, distances, max_distance, search_params);
+      std::move(indices.begin(), indices.end(), neighbor_idxs.begin() + begin);
+    });
 
     PrintElapsedTime(timer);
 
@@ -730,11 +779,8 @@ class SpatialFeatureMatcher : public Thread {
     // Matching
     //////////////////////////////////////////////////////////////////////////////
 
-    const float max_distance =
-        static_cast<float>(options_.max_distance * options_.max_distance);
-
     std::vector<std::pair<image_t, image_t>> image_pairs;
-    image_pairs.reserve(knn);
+    image_pairs.reserve(options_.max_num_neighbors);
 
     for (size_t i = 0; i < num_locations; ++i) {
       if (IsStopped()) {
@@ -749,20 +795,15 @@ class SpatialFeatureMatcher : public Thread {
 
       image_pairs.clear();
 
-      for (int j = 0; j < knn; ++j) {
+      for (const size_t neighbor_idx : neighbor_idxs[i]) {
         // Check if query equals result.
-        if (index_matrix(i, j) == i) {
+        if (neighbor_idx == i) {
           continue;
         }
 
-        // Since the nearest neighbors are sorted by distance, we can break.
-        if (distance_matrix(i, j) > max_distance) {
-          break;
-        }
-
         const size_t idx = location_idxs[i];
         const image_t image_id = image_ids.at(idx);
-        const size_t nn_idx = location_idxs.at(index_matrix(i, j));
+        const size_t nn_idx = location_idxs.at(neighbor_idx);
         const image_t nn_image_id = image_ids.at(nn_idx);
         image_pairs.emplace_back(image_id, nn_image_id);
       }
@@ -1017,6 +1058,10 @@ class ImagePairsFeatureMatcher : public Thread {
     // Feature matching
     //////////////////////////////////////////////////////////////////////////////
 
+    // The pairs in the list may be in any order, so reorder them to reuse the
+    // cached features of images across consecutive pairs and blocks.
+    OrderImagePairsByHilbertCurve(&image_pairs);
+
     const size_t num_match_blocks =
         image_pairs.size() / options_.block_size + 1;
     std::vector<std::pair<image_t, image_t>> block_image_pairs;
@@ -1051,6 +1096,7 @@ class ImagePairsFeatureMatcher : public Thread {
       PrintElapsedTime(timer);
     }
 
+    PrintFeatureCacheStatistics(&cache_);
     run_timer.PrintMinutes();
   }
 
@@ -1103,6 +1149,14 @@ class FeaturePairsFeatureMatcher : public Thread {
     Timer run_timer;
     run_timer.Start();
 
+    // Raw matches are imported into the same backend that matching and
+    // verification read from, while two-view geometries remain in the
+    // database.
+    if (!matching_options_.feature_store_path.empty()) {
+      cache_.SetFeatureStore(
+          std::make_shared<FeatureStore>(matching_options_.feature_store_path));
+    }
+
     cache_.Setup();
 
     std::unordered_map<std::string, const Image*> image_name_to_image;
@@ -1155,7 +1209,7 @@ class FeaturePairsFeatureMatcher : public Thread {
       const Image& image2 = *image_name_to_image[image_name2];
 
       bool skip_pair = false;
-      if (database_.ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
+      if (cache_.ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
         LOG(INFO) << "SKIP: Matches for image pair already exist in database.";
         skip_pair = true;
       }
@@ -1189,7 +1243,12 @@ class FeaturePairsFeatureMatcher : public Thread {
       const Camera& camera2 = cache_.GetCamera(image2.CameraId());
 
       if (options_.verify_matches) {
-        database_.WriteMatches(image1.ImageId(), image2.ImageId(), matches);
+        // Replace stale raw matches without inlier matches, as in the
+        // FeatureMatcherController.
+        if (cache_.ExistsMatches(image1.ImageId(), image2.ImageId())) {
+          cache_.DeleteMatches(image1.ImageId(), image2.ImageId());
+        }
+        cache_.WriteMatches(image1.ImageId(), image2.ImageId(), matches);
 
         const auto keypoints1 = cache_.GetKeypoints(image1.ImageId());
         const auto keypoints2 = cache_.GetKeypoints(image2.ImageId());
@@ -1202,7 +1261,7 @@ class FeaturePairsFeatureMatcher : public Thread {
                                     matches,
                                     geometry_options_);
 
-        database_.WriteTwoViewGeometry(
+        cache_.WriteTwoViewGeometry(
             image1.ImageId(), image2.ImageId(), two_view_geometry);
       } else {
         TwoViewGeometry two_view_geometry;
@@ -1215,7 +1274,7 @@ class FeaturePairsFeatureMatcher : public Thread {
 
         two_view_geometry.inlier_matches = matches;
 
-        database_.WriteTwoViewGeometry(
+        cache_.WriteTwoViewGeometry(
             image1.ImageId(), image2.ImageId(), two_view_geometry);
       }
     }
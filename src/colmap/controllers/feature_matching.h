@@ -66,7 +66,8 @@ struct ExhaustiveMatchingOptions {
 // images[i]
 //
 // Pairs will only be matched if 1, to avoid duplicate pairs. Pairs with #
-// are on the main diagonal and denote pairs of the same image.
+// are on the main diagonal and denote pairs of the same image. The blocks are
+// processed along a Hilbert curve, such that consecutive blocks share images.
 std::unique_ptr<Thread> CreateExhaustiveFeatureMatcher(
     const ExhaustiveMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
@@ -233,6 +234,8 @@ struct ImagePairsMatchingOptions {
 //    image_name2 image_name3
 //    ...
 //
+// The pairs are matched in an order that maximizes the reuse of cached
+// features and not in the order of the file.
 std::unique_ptr<Thread> CreateImagePairsFeatureMatcher(
     const ImagePairsMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
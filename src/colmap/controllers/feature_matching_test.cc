@@ -0,0 +1,150 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/controllers/feature_matching.h"
+
+#include "colmap/scene/feature_store.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/testing.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(FeaturePairsFeatureMatcher, FeatureStore) {
+  const std::string test_dir = CreateTestDir();
+  const std::string database_path = test_dir + "/database.db";
+  const std::string feature_store_path = test_dir + "/features";
+  const std::string match_list_path = test_dir + "/matches.txt";
+
+  Database database(database_path);
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 3;
+  synthetic_dataset_options.num_points3D = 50;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction, &database);
+
+  // Write the synthesized matches to the pairs file and only keep the features
+  // in the feature store.
+  std::vector<image_pair_t> image_pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  ASSERT_FALSE(image_pair_ids.empty());
+  {
+    std::ofstream file(match_list_path);
+    for (size_t i = 0; i < image_pair_ids.size(); ++i) {
+      const auto [image_id1, image_id2] =
+          Database::PairIdToImagePair(image_pair_ids[i]);
+      file << database.ReadImage(image_id1).Name() << " "
+           << database.ReadImage(image_id2).Name() << "\n";
+      for (const auto& match : two_view_geometries[i].inlier_matches) {
+        file << match.point2D_idx1 << " " << match.point2D_idx2 << "\n";
+      }
+      file << "\n";
+    }
+  }
+  database.ClearMatches();
+  database.ClearTwoViewGeometries();
+  {
+    FeatureStore feature_store(feature_store_path);
+    ExportFeaturesToFeatureStore(database, &feature_store);
+  }
+
+  FeaturePairsMatchingOptions options;
+  options.match_list_path = match_list_path;
+  SiftMatchingOptions matching_options;
+  matching_options.feature_store_path = feature_store_path;
+  auto matcher = CreateFeaturePairsFeatureMatcher(
+      options, matching_options, TwoViewGeometryOptions(), database_path);
+  matcher->Start();
+  matcher->Wait();
+
+  // Raw matches are imported into the feature store and two-view geometries
+  // into the database.
+  EXPECT_EQ(database.NumMatches(), 0);
+  FeatureStore feature_store(feature_store_path);
+  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
+    const auto [image_id1, image_id2] =
+        Database::PairIdToImagePair(image_pair_ids[i]);
+    EXPECT_EQ(feature_store.NumMatchesForImagePair(image_id1, image_id2),
+              two_view_geometries[i].inlier_matches.size());
+    EXPECT_TRUE(database.ExistsInlierMatches(image_id1, image_id2));
+  }
+}
+
+TEST(SpatialFeatureMatcher, MaxDistance) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  // The images lie on a line, such that only the first two images are within
+  // the maximum distance, at exactly the maximum distance.
+  Database database(database_path);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 100.0, 100, 100);
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (const double x : {0.5, 1.5, 3.5}) {
+    Image image;
+    image.SetName("image" + std::to_string(image_ids.size()));
+    image.SetCameraId(camera.camera_id);
+    image.CamFromWorldPrior().translation = Eigen::Vector3d(x, 1, 0);
+    image_ids.push_back(database.WriteImage(image));
+    const int kNumFeatures = 10;
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors =
+        FeatureDescriptors::Zero(kNumFeatures, 128);
+    for (int i = 0; i < kNumFeatures; ++i) {
+      keypoints.emplace_back(10 * i, 10 * i);
+      descriptors(i, i) = 255;
+    }
+    database.WriteKeypoints(image_ids.back(), keypoints);
+    database.WriteDescriptors(image_ids.back(), descriptors);
+  }
+
+  SpatialMatchingOptions options;
+  options.is_gps = false;
+  options.max_distance = 1;
+  SiftMatchingOptions matching_options;
+  matching_options.use_gpu = false;
+  matching_options.num_threads = 1;
+  auto matcher = CreateSpatialFeatureMatcher(
+      options, matching_options, TwoViewGeometryOptions(), database_path);
+  matcher->Start();
+  matcher->Wait();
+
+  EXPECT_TRUE(database.ExistsMatches(image_ids[0], image_ids[1]));
+  EXPECT_FALSE(database.ExistsMatches(image_ids[0], image_ids[2]));
+  EXPECT_FALSE(database.ExistsMatches(image_ids[1], image_ids[2]));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -33,9 +33,12 @@
 #include "colmap/feature/utils.h"
 #include "colmap/util/cuda.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/trace.h"
 
+#include <algorithm>
 #include <fstream>
 #include <numeric>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace colmap {
@@ -62,6 +65,10 @@ void FeatureMatcherCache::Setup() {
   keypoints_cache_ =
       std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>(
           cache_size_, [this](const image_t image_id) {
+            if (feature_store_) {
+              return std::make_shared<FeatureKeypoints>(
+                  feature_store_->ReadKeypoints(image_id));
+            }
             return std::make_shared<FeatureKeypoints>(
                 database_->ReadKeypoints(image_id));
           });
@@ -69,17 +76,27 @@ void FeatureMatcherCache::Setup() {
   descriptors_cache_ =
       std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>(
           cache_size_, [this](const image_t image_id) {
+            if (feature_store_) {
+              return std::make_shared<FeatureDescriptors>(
+                  feature_store_->ReadDescriptorsView(image_id));
+            }
             return std::make_shared<FeatureDescriptors>(
                 database_->ReadDescriptors(image_id));
           });
 
   keypoints_exists_cache_ = std::make_unique<LRUCache<image_t, bool>>(
       images_cache_.size(), [this](const image_t image_id) {
+        if (feature_store_) {
+          return feature_store_->ExistsKeypoints(image_id);
+        }
         return database_->ExistsKeypoints(image_id);
       });
 
   descriptors_exists_cache_ = std::make_unique<LRUCache<image_t, bool>>(
       images_cache_.size(), [this](const image_t image_id) {
+        if (feature_store_) {
+          return feature_store_->ExistsDescriptors(image_id);
+        }
         return database_->ExistsDescriptors(image_id);
       });
 }
@@ -101,15 +118,41 @@ std::shared_ptr<FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
 std::shared_ptr<FeatureDescriptors> FeatureMatcherCache::GetDescriptors(
     const image_t image_id) {
   std::lock_guard<std::mutex> lock(database_mutex_);
+  if (!descriptors_cache_->Exists(image_id) && descriptor_index_cache_) {
+    // Reuse the descriptors that are kept alive by a cached search index
+    // instead of reading a second copy.
+    std::lock_guard<std::mutex> index_lock(descriptor_index_mutex_);
+    if (descriptor_index_cache_->Exists(image_id)) {
+      std::shared_ptr<FeatureDescriptors> descriptors =
+          descriptor_index_cache_->Get(image_id).descriptors;
+      descriptors_cache_->Set(image_id, descriptors);
+      return descriptors;
+    }
+  }
   return descriptors_cache_->Get(image_id);
 }
 
 FeatureMatches FeatureMatcherCache::GetMatches(const image_t image_id1,
                                                const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
+  if (feature_store_) {
+    return feature_store_->ReadMatches(image_id1, image_id2);
+  }
   return database_->ReadMatches(image_id1, image_id2);
 }
 
+size_t FeatureMatcherCache::NumFeatureCacheHits() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  return THROW_CHECK_NOTNULL(keypoints_cache_)->NumHits() +
+         THROW_CHECK_NOTNULL(descriptors_cache_)->NumHits();
+}
+
+size_t FeatureMatcherCache::NumFeatureCacheMisses() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  return THROW_CHECK_NOTNULL(keypoints_cache_)->NumMisses() +
+         THROW_CHECK_NOTNULL(descriptors_cache_)->NumMisses();
+}
+
 std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
   std::vector<image_t> image_ids;
   image_ids.reserve(images_cache_.size());
@@ -119,6 +162,79 @@ std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
   return image_ids;
 }
 
+void FeatureMatcherCache::SetFeatureStore(
+    std::shared_ptr<FeatureStore> feature_store) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  feature_store_ = std::move(feature_store);
+}
+
+bool FeatureMatcherCache::HasFeatureStore() const {
+  return feature_store_ != nullptr;
+}
+
+size_t FeatureMatcherCache::MaxNumKeypoints() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  if (feature_store_) {
+    return feature_store_->MaxNumKeypoints();
+  }
+  return database_->MaxNumKeypoints();
+}
+
+void FeatureMatcherCache::EnableDescriptorIndexCache(
+    const size_t max_num_bytes, const std::string& index_path) {
+  std::lock_guard<std::mutex> lock(descriptor_index_mutex_);
+  descriptor_index_path_ = index_path;
+  if (!descriptor_index_path_.empty()) {
+    CreateDirIfNotExists(descriptor_index_path_, /*recursive=*/true);
+  }
+  descriptor_index_cache_ = std::make_unique<
+      MemoryConstrainedLRUCache<image_t, DescriptorIndexEntry>>(
+      max_num_bytes, [](const image_t) { return DescriptorIndexEntry(); });
+}
+
+bool FeatureMatcherCache::HasDescriptorIndexCache() const {
+  return descriptor_index_cache_ != nullptr;
+}
+
+std::shared_ptr<const FeatureDescriptorIndex>
+FeatureMatcherCache::GetDescriptorIndex(const image_t image_id) {
+  {
+    std::lock_guard<std::mutex> lock(descriptor_index_mutex_);
+    THROW_CHECK_NOTNULL(descriptor_index_cache_);
+    if (descriptor_index_cache_->Exists(image_id)) {
+      return descriptor_index_cache_->Get(image_id).index;
+    }
+  }
+
+  // Load or build the index without holding the lock, so that other workers
+  // are not blocked. Concurrent requests for the same image may build the
+  // index twice, in which case the first inserted index is kept.
+  std::shared_ptr<FeatureDescriptors> descriptors = GetDescriptors(image_id);
+  std::shared_ptr<const FeatureDescriptorIndex> index;
+  std::string index_path;
+  if (!descriptor_index_path_.empty()) {
+    index_path =
+        JoinPaths(descriptor_index_path_, std::to_string(image_id) + ".flann");
+    index = ReadSiftCPUDescriptorIndex(index_path, descriptors);
+  }
+  if (index == nullptr) {
+    index = CreateSiftCPUDescriptorIndex(descriptors);
+    if (!index_path.empty()) {
+      WriteSiftCPUDescriptorIndex(index_path, *index);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(descriptor_index_mutex_);
+  if (descriptor_index_cache_->Exists(image_id)) {
+    return descriptor_index_cache_->Get(image_id).index;
+  }
+  DescriptorIndexEntry entry;
+  entry.descriptors = std::move(descriptors);
+  entry.index = index;
+  descriptor_index_cache_->Set(image_id, std::move(entry));
+  return index;
+}
+
 bool FeatureMatcherCache::ExistsKeypoints(const image_t image_id) {
   std::lock_guard<std::mutex> lock(database_mutex_);
   return keypoints_exists_cache_->Get(image_id);
@@ -132,6 +248,9 @@ bool FeatureMatcherCache::ExistsDescriptors(const image_t image_id) {
 bool FeatureMatcherCache::ExistsMatches(const image_t image_id1,
                                         const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
+  if (feature_store_) {
+    return feature_store_->ExistsMatches(image_id1, image_id2);
+  }
   return database_->ExistsMatches(image_id1, image_id2);
 }
 
@@ -145,6 +264,10 @@ void FeatureMatcherCache::WriteMatches(const image_t image_id1,
                                        const image_t image_id2,
                                        const FeatureMatches& matches) {
   std::lock_guard<std::mutex> lock(database_mutex_);
+  if (feature_store_) {
+    feature_store_->WriteMatches(image_id1, image_id2, matches);
+    return;
+  }
   database_->WriteMatches(image_id1, image_id2, matches);
 }
 
@@ -159,6 +282,10 @@ void FeatureMatcherCache::WriteTwoViewGeometry(
 void FeatureMatcherCache::DeleteMatches(const image_t image_id1,
                                         const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
+  if (feature_store_) {
+    feature_store_->DeleteMatches(image_id1, image_id2);
+    return;
+  }
   database_->DeleteMatches(image_id1, image_id2);
 }
 
@@ -168,6 +295,73 @@ void FeatureMatcherCache::DeleteInlierMatches(const image_t image_id1,
   database_->DeleteInlierMatches(image_id1, image_id2);
 }
 
+uint64_t HilbertCurveIndex(const uint64_t num_cells, uint64_t x, uint64_t y) {
+  THROW_CHECK_GT(num_cells, 0);
+  THROW_CHECK_EQ(num_cells & (num_cells - 1), 0);
+  THROW_CHECK_LT(x, num_cells);
+  THROW_CHECK_LT(y, num_cells);
+  uint64_t index = 0;
+  for (uint64_t s = num_cells / 2; s > 0; s /= 2) {
+    const uint64_t rx = (x & s) > 0;
+    const uint64_t ry = (y & s) > 0;
+    index += s * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant, such that the curve in it has the base orientation.
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return index;
+}
+
+void OrderImagePairsByHilbertCurve(
+    std::vector<std::pair<image_t, image_t>>* image_pairs) {
+  THROW_CHECK_NOTNULL(image_pairs);
+
+  std::vector<image_t> image_ids;
+  image_ids.reserve(2 * image_pairs->size());
+  for (const auto& image_pair : *image_pairs) {
+    image_ids.push_back(image_pair.first);
+    image_ids.push_back(image_pair.second);
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+  image_ids.erase(std::unique(image_ids.begin(), image_ids.end()),
+                  image_ids.end());
+
+  std::unordered_map<image_t, uint64_t> image_id_to_idx;
+  image_id_to_idx.reserve(image_ids.size());
+  for (size_t idx = 0; idx < image_ids.size(); ++idx) {
+    image_id_to_idx.emplace(image_ids[idx], idx);
+  }
+
+  uint64_t num_cells = 1;
+  while (num_cells < image_ids.size()) {
+    num_cells *= 2;
+  }
+
+  std::vector<std::pair<uint64_t, size_t>> curve_indices;
+  curve_indices.reserve(image_pairs->size());
+  for (size_t i = 0; i < image_pairs->size(); ++i) {
+    const uint64_t idx1 = image_id_to_idx.at((*image_pairs)[i].first);
+    const uint64_t idx2 = image_id_to_idx.at((*image_pairs)[i].second);
+    curve_indices.emplace_back(
+        HilbertCurveIndex(
+            num_cells, std::min(idx1, idx2), std::max(idx1, idx2)),
+        i);
+  }
+  std::sort(curve_indices.begin(), curve_indices.end());
+
+  std::vector<std::pair<image_t, image_t>> ordered_image_pairs;
+  ordered_image_pairs.reserve(image_pairs->size());
+  for (const auto& curve_index : curve_indices) {
+    ordered_image_pairs.push_back((*image_pairs)[curve_index.second]);
+  }
+  *image_pairs = std::move(ordered_image_pairs);
+}
+
 FeatureMatcherWorker::FeatureMatcherWorker(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
@@ -224,23 +418,50 @@ void FeatureMatcherWorker::Run() {
     if (input_job.IsValid()) {
       auto& data = input_job.Data();
 
+      if (!data.batch_image_ids2.empty()) {
+        MatchBatch(matcher.get(), &data);
+        continue;
+      }
+
       if (!cache_->ExistsDescriptors(data.image_id1) ||
           !cache_->ExistsDescriptors(data.image_id2)) {
         THROW_CHECK(output_queue_->Push(std::move(data)));
         continue;
       }
 
-      if (matching_options_.guided_matching) {
-        matcher->MatchGuided(geometry_options_,
-                             GetKeypointsPtr(0, data.image_id1),
-                             GetKeypointsPtr(1, data.image_id2),
-                             GetDescriptorsPtr(0, data.image_id1),
-                             GetDescriptorsPtr(1, data.image_id2),
-                             &data.two_view_geometry);
-      } else {
-        matcher->Match(GetDescriptorsPtr(0, data.image_id1),
-                       GetDescriptorsPtr(1, data.image_id2),
-                       &data.matches);
+      {
+        COLMAP_TRACE_SCOPE("feature_matching/match");
+
+        if (matching_options_.guided_matching) {
+          matcher->MatchGuided(geometry_options_,
+                               GetKeypointsPtr(0, data.image_id1),
+                               GetKeypointsPtr(1, data.image_id2),
+                               GetDescriptorsPtr(0, data.image_id1),
+                               GetDescriptorsPtr(1, data.image_id2),
+                               &data.two_view_geometry);
+        } else if (cache_->HasDescriptorIndexCache()) {
+          // Only pass in the indices for new descriptors, since the matcher
+          // otherwise reuses the previous ones. The index of the first image is
+          // only needed for cross checking.
+          const auto descriptors1 = GetDescriptorsPtr(0, data.image_id1);
+          const auto descriptors2 = GetDescriptorsPtr(1, data.image_id2);
+          matcher->MatchWithIndices(
+              descriptors1,
+              (descriptors1 != nullptr && matching_options_.cross_check)
+                  ? cache_->GetDescriptorIndex(data.image_id1)
+                  : nullptr,
+              descriptors2,
+              descriptors2 != nullptr
+                  ? cache_->GetDescriptorIndex(data.image_id2)
+                  : nullptr,
+              &data.matches);
+        } else {
+          matcher->Match(GetDescriptorsPtr(0, data.image_id1),
+                         GetDescriptorsPtr(1, data.image_id2),
+                         &data.matches);
+        }
+
+        TraceValue("feature_matching/num_matches", data.matches.size());
       }
 
       THROW_CHECK(output_queue_->Push(std::move(data)));
@@ -248,6 +469,67 @@ void FeatureMatcherWorker::Run() {
   }
 }
 
+void FeatureMatcherWorker::MatchBatch(FeatureMatcher* matcher,
+                                     FeatureMatcherData* data) {
+  std::vector<FeatureMatcherData> outputs(1 + data->batch_image_ids2.size());
+  for (size_t k = 0; k < outputs.size(); ++k) {
+    outputs[k].image_id1 = data->image_id1;
+    outputs[k].image_id2 =
+        k == 0 ? data->image_id2 : data->batch_image_ids2[k - 1];
+  }
+
+  // Pairs with missing descriptors are passed on without matches.
+  std::vector<size_t> output_idxs;
+  std::vector<std::shared_ptr<const FeatureDescriptors>> descriptors2;
+  std::vector<std::shared_ptr<const FeatureDescriptorIndex>> indices2;
+  std::shared_ptr<FeatureDescriptors> last_descriptors2;
+  if (cache_->ExistsDescriptors(data->image_id1)) {
+    for (size_t k = 0; k < outputs.size(); ++k) {
+      const image_t image_id2 = outputs[k].image_id2;
+      if (!cache_->ExistsDescriptors(image_id2)) {
+        continue;
+      }
+      output_idxs.push_back(k);
+      last_descriptors2 = cache_->GetDescriptors(image_id2);
+      descriptors2.push_back(last_descriptors2);
+      if (cache_->HasDescriptorIndexCache()) {
+        indices2.push_back(cache_->GetDescriptorIndex(image_id2));
+      }
+    }
+  }
+
+  if (!output_idxs.empty()) {
+    COLMAP_TRACE_SCOPE("feature_matching/match");
+
+    std::shared_ptr<FeatureDescriptors> descriptors1 =
+        cache_->GetDescriptors(data->image_id1);
+    // The index of the first image is only needed for cross checking.
+    std::shared_ptr<const FeatureDescriptorIndex> index1;
+    if (cache_->HasDescriptorIndexCache() && matching_options_.cross_check) {
+      index1 = cache_->GetDescriptorIndex(data->image_id1);
+    }
+
+    std::vector<FeatureMatches> matches;
+    matcher->MatchOneToMany(
+        descriptors1, index1, descriptors2, indices2, &matches);
+    THROW_CHECK_EQ(matches.size(), output_idxs.size());
+    for (size_t i = 0; i < output_idxs.size(); ++i) {
+      TraceValue("feature_matching/num_matches", matches[i].size());
+      outputs[output_idxs[i]].matches = std::move(matches[i]);
+    }
+
+    // The matcher now refers to the last matched pair.
+    prev_descriptors_image_ids_[0] = data->image_id1;
+    prev_descriptors_[0] = std::move(descriptors1);
+    prev_descriptors_image_ids_[1] = outputs[output_idxs.back()].image_id2;
+    prev_descriptors_[1] = std::move(last_descriptors2);
+  }
+
+  for (auto& output : outputs) {
+    THROW_CHECK(output_queue_->Push(std::move(output)));
+  }
+}
+
 std::shared_ptr<FeatureKeypoints> FeatureMatcherWorker::GetKeypointsPtr(
     const int index, const image_t image_id) {
   THROW_CHECK_GE(index, 0);
@@ -309,19 +591,32 @@ class VerifierWorker : public Thread {
           continue;
         }
 
-        const auto& camera1 =
-            cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
-        const auto& camera2 =
-            cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-        const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-        const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-        const std::vector<Eigen::Vector2d> points1 =
-            FeatureKeypointsToPointsVector(*keypoints1);
-        const std::vector<Eigen::Vector2d> points2 =
-            FeatureKeypointsToPointsVector(*keypoints2);
-
-        data.two_view_geometry = EstimateTwoViewGeometry(
-            camera1, points1, camera2, points2, data.matches, options_);
+        {
+          COLMAP_TRACE_SCOPE("feature_matching/verify");
+
+          const auto& camera1 =
+              cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
+          const auto& camera2 =
+              cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
+          const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
+          const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
+          const std::vector<Eigen::Vector2d> points1 =
+              FeatureKeypointsToPointsVector(*keypoints1);
+          const std::vector<Eigen::Vector2d> points2 =
+              FeatureKeypointsToPointsVector(*keypoints2);
+
+          if (options_.use_prosac) {
+            SortFeatureMatchesByDescriptorDistance(
+                *cache_->GetDescriptors(data.image_id1),
+                *cache_->GetDescriptors(data.image_id2),
+                &data.matches);
+          }
+
+          data.two_view_geometry = EstimateTwoViewGeometry(
+              camera1, points1, camera2, points2, data.matches, options_);
+          TraceValue("feature_matching/num_inlier_matches",
+                     data.two_view_geometry.inlier_matches.size());
+        }
 
         THROW_CHECK(output_queue_->Push(std::move(data)));
       }
@@ -471,13 +766,31 @@ FeatureMatcherController::~FeatureMatcherController() {
 }
 
 bool FeatureMatcherController::Setup() {
+  if (!matching_options_.feature_store_path.empty() &&
+      !THROW_CHECK_NOTNULL(cache_)->HasFeatureStore()) {
+    cache_->SetFeatureStore(
+        std::make_shared<FeatureStore>(matching_options_.feature_store_path));
+  }
+
   // Minimize the amount of allocated GPU memory by computing the maximum number
   // of descriptors for any image over the whole database.
   const int max_num_features =
-      THROW_CHECK_NOTNULL(database_)->MaxNumKeypoints();
+      static_cast<int>(THROW_CHECK_NOTNULL(cache_)->MaxNumKeypoints());
   matching_options_.max_num_matches =
       std::min(matching_options_.max_num_matches, max_num_features);
 
+  // Share the FLANN search indices among the CPU matchers, so that each image
+  // is only indexed once instead of once per matched pair and thread.
+  if (!matching_options_.use_gpu &&
+      !matching_options_.brute_force_cpu_matcher &&
+      matching_options_.cpu_index_cache_size > 0 &&
+      !THROW_CHECK_NOTNULL(cache_)->HasDescriptorIndexCache()) {
+    cache_->EnableDescriptorIndexCache(
+        static_cast<size_t>(matching_options_.cpu_index_cache_size) * 1024 *
+            1024,
+        matching_options_.cpu_index_cache_path);
+  }
+
   for (auto& matcher : matchers_) {
     matcher->SetMaxNumMatches(matching_options_.max_num_matches);
     matcher->Start();
@@ -526,6 +839,9 @@ void FeatureMatcherController::Match(
   std::unordered_set<image_pair_t> image_pair_ids;
   image_pair_ids.reserve(image_pairs.size());
 
+  // The pairs to be matched from scratch in input order.
+  std::vector<std::pair<image_t, image_t>> image_pairs_to_match;
+
   size_t num_outputs = 0;
   for (const auto& image_pair : image_pairs) {
     // Avoid self-matches.
@@ -571,8 +887,54 @@ void FeatureMatcherController::Match(
       cache_->DeleteMatches(image_pair.first, image_pair.second);
       THROW_CHECK(verifier_queue_.Push(std::move(data)));
     } else {
+      image_pairs_to_match.push_back(image_pair);
+    }
+  }
+
+  // Pairs with the same first image are matched together by the CPU matchers.
+  // The batches are kept small enough to keep all matchers busy.
+  size_t batch_size = 1;
+  if (!matching_options_.use_gpu && !matchers_.empty()) {
+    batch_size = std::max<size_t>(
+        1,
+        std::min<size_t>(matching_options_.cpu_batch_size,
+                         (image_pairs_to_match.size() + matchers_.size() - 1) /
+                             matchers_.size()));
+  }
+
+  if (batch_size == 1) {
+    // Without batching, keep the order of the pairs chosen by the caller,
+    // e.g., to benefit from the locality of the Hilbert curve order.
+    for (const auto& image_pair : image_pairs_to_match) {
+      FeatureMatcherData data;
+      data.image_id1 = image_pair.first;
+      data.image_id2 = image_pair.second;
       THROW_CHECK(matcher_queue_.Push(std::move(data)));
     }
+  } else {
+    // Group the pairs by their first image in the order of first appearance.
+    std::vector<image_t> image_ids1;
+    std::unordered_map<image_t, std::vector<image_t>> image_ids1_to_ids2;
+    for (const auto& image_pair : image_pairs_to_match) {
+      auto& image_ids2 = image_ids1_to_ids2[image_pair.first];
+      if (image_ids2.empty()) {
+        image_ids1.push_back(image_pair.first);
+      }
+      image_ids2.push_back(image_pair.second);
+    }
+
+    for (const image_t image_id1 : image_ids1) {
+      const auto& image_ids2 = image_ids1_to_ids2.at(image_id1);
+      for (size_t begin = 0; begin < image_ids2.size(); begin += batch_size) {
+        const size_t end = std::min(begin + batch_size, image_ids2.size());
+        FeatureMatcherData data;
+        data.image_id1 = image_id1;
+        data.image_id2 = image_ids2[begin];
+        data.batch_image_ids2.assign(image_ids2.begin() + begin + 1,
+                                     image_ids2.begin() + end);
+        THROW_CHECK(matcher_queue_.Push(std::move(data)));
+      }
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,7 @@
 #include "colmap/estimators/two_view_geometry.h"
 #include "colmap/feature/sift.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/util/cache.h"
 #include "colmap/util/opengl_utils.h"
 #include "colmap/util/threading.h"
@@ -46,6 +47,9 @@ namespace colmap {
 struct FeatureMatcherData {
   image_t image_id1 = kInvalidImageId;
   image_t image_id2 = kInvalidImageId;
+  // Further images to be matched against image_id1 in the same job by
+  // one-to-many matching. The matcher outputs separate data for every pair.
+  std::vector<image_t> batch_image_ids2;
   FeatureMatches matches;
   TwoViewGeometry two_view_geometry;
 };
@@ -64,6 +68,29 @@ class FeatureMatcherCache {
   FeatureMatches GetMatches(image_t image_id1, image_t image_id2);
   std::vector<image_t> GetImageIds() const;
 
+  // Read keypoints and descriptors from and write raw matches to the given
+  // feature store instead of the database. Must be set before matching.
+  void SetFeatureStore(std::shared_ptr<FeatureStore> feature_store);
+  bool HasFeatureStore() const;
+
+  size_t MaxNumKeypoints();
+
+  // The number of keypoints and descriptors requests that were served from the
+  // cache and that had to be read from the database or feature store.
+  size_t NumFeatureCacheHits();
+  size_t NumFeatureCacheMisses();
+
+  // Enable caching of the search indices for CPU matching, which are built
+  // per image and shared by all matching workers. The least recently used
+  // indices are evicted when their total memory exceeds max_num_bytes. If
+  // index_path is not empty, indices are also persisted in this directory and
+  // reused across matching runs.
+  void EnableDescriptorIndexCache(size_t max_num_bytes,
+                                  const std::string& index_path);
+  bool HasDescriptorIndexCache() const;
+  std::shared_ptr<const FeatureDescriptorIndex> GetDescriptorIndex(
+      image_t image_id);
+
   bool ExistsKeypoints(image_t image_id);
   bool ExistsDescriptors(image_t image_id);
 
@@ -83,6 +110,7 @@ class FeatureMatcherCache {
  private:
   const size_t cache_size_;
   const Database* database_;
+  std::shared_ptr<FeatureStore> feature_store_;
   std::mutex database_mutex_;
   std::unordered_map<camera_t, Camera> cameras_cache_;
   std::unordered_map<image_t, Image> images_cache_;
@@ -92,8 +120,39 @@ class FeatureMatcherCache {
       descriptors_cache_;
   std::unique_ptr<LRUCache<image_t, bool>> keypoints_exists_cache_;
   std::unique_ptr<LRUCache<image_t, bool>> descriptors_exists_cache_;
+
+  // The descriptors referenced by the index are kept alive by the entry, also
+  // after they were evicted from the descriptors cache, so that their memory
+  // is counted together with the memory of the index itself.
+  struct DescriptorIndexEntry {
+    std::shared_ptr<FeatureDescriptors> descriptors;
+    std::shared_ptr<const FeatureDescriptorIndex> index;
+    size_t NumBytes() const {
+      return (descriptors ? descriptors->size() : 0) +
+             (index ? index->NumBytes() : 0);
+    }
+  };
+
+  std::mutex descriptor_index_mutex_;
+  std::string descriptor_index_path_;
+  std::unique_ptr<MemoryConstrainedLRUCache<image_t, DescriptorIndexEntry>>
+      descriptor_index_cache_;
 };
 
+// Position of the cell (x, y) along the Hilbert curve that fills the
+// num_cells x num_cells grid, where num_cells must be a power of two.
+// Consecutive cells along the curve are adjacent and every aligned square
+// block of cells is traversed contiguously.
+uint64_t HilbertCurveIndex(uint64_t num_cells, uint64_t x, uint64_t y);
+
+// Order the image pairs along a Hilbert curve over the upper triangle of the
+// matrix of sorted image identifiers, such that consecutive pairs share images
+// and any contiguous range of pairs involves few distinct images. This keeps
+// the working set of the FeatureMatcherCache small independent of its size.
+// The order of the images within a pair is kept.
+void OrderImagePairsByHilbertCurve(
+    std::vector<std::pair<image_t, image_t>>* image_pairs);
+
 class FeatureMatcherWorker : public Thread {
  public:
   typedef FeatureMatcherData Input;
@@ -110,6 +169,9 @@ class FeatureMatcherWorker : public Thread {
  private:
   void Run() override;
 
+  // Match image_id1 against image_id2 and all batch_image_ids2 at once.
+  void MatchBatch(FeatureMatcher* matcher, FeatureMatcherData* data);
+
   std::shared_ptr<FeatureKeypoints> GetKeypointsPtr(int index,
                                                     image_t image_id);
   std::shared_ptr<FeatureDescriptors> GetDescriptorsPtr(int index,
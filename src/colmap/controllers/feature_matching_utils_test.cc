@@ -0,0 +1,303 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/controllers/feature_matching_utils.h"
+
+#include "colmap/feature/sift.h"
+#include "colmap/feature/utils.h"
+#include "colmap/math/random.h"
+#include "colmap/util/cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+FeatureDescriptorsFloat CreateRandomFeatureDescriptorsFloat(
+    const size_t num_features) {
+  FeatureDescriptorsFloat descriptors(num_features, 128);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = std::pow(RandomUniformReal(0.0f, 1.0f), 2);
+  }
+  return descriptors;
+}
+
+FeatureDescriptors NormalizeFeatureDescriptors(
+    FeatureDescriptorsFloat descriptors) {
+  L2NormalizeFeatureDescriptors(&descriptors);
+  return FeatureDescriptorsToUnsignedByte(descriptors);
+}
+
+TEST(FeatureMatcherCache, DescriptorIndexCache) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 2; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteDescriptors(
+        image_ids.back(),
+        NormalizeFeatureDescriptors(CreateRandomFeatureDescriptorsFloat(100)));
+  }
+
+  FeatureMatcherCache cache(/*cache_size=*/1, &database);
+  cache.Setup();
+  EXPECT_FALSE(cache.HasDescriptorIndexCache());
+  cache.EnableDescriptorIndexCache(/*max_num_bytes=*/1 << 20,
+                                   /*index_path=*/"");
+  EXPECT_TRUE(cache.HasDescriptorIndexCache());
+
+  const auto descriptors = cache.GetDescriptors(image_ids[0]);
+  const auto index = cache.GetDescriptorIndex(image_ids[0]);
+  ASSERT_NE(index, nullptr);
+  EXPECT_EQ(cache.GetDescriptorIndex(image_ids[0]), index);
+
+  // The descriptors are evicted from the descriptors cache, but the indexed
+  // descriptors are reused instead of being read again.
+  cache.GetDescriptors(image_ids[1]);
+  const size_t num_misses = cache.NumFeatureCacheMisses();
+  EXPECT_EQ(cache.GetDescriptors(image_ids[0]), descriptors);
+  EXPECT_EQ(cache.NumFeatureCacheMisses(), num_misses);
+}
+
+TEST(FeatureMatcherCache, DescriptorIndexCacheNumBytes) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 2; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteDescriptors(
+        image_ids.back(),
+        NormalizeFeatureDescriptors(CreateRandomFeatureDescriptorsFloat(100)));
+  }
+
+  const size_t index_num_bytes =
+      CreateSiftCPUDescriptorIndex(std::make_shared<FeatureDescriptors>(
+                                       database.ReadDescriptors(image_ids[0])))
+          ->NumBytes();
+  const size_t descriptors_num_bytes = 100 * 128;
+
+  // The memory of the pinned descriptors is counted, such that the limit only
+  // fits a single index with its descriptors, although it would fit the
+  // memory of both indices alone.
+  FeatureMatcherCache cache(/*cache_size=*/1, &database);
+  cache.Setup();
+  cache.EnableDescriptorIndexCache(
+      /*max_num_bytes=*/index_num_bytes + 2 * descriptors_num_bytes,
+      /*index_path=*/"");
+  const auto index = cache.GetDescriptorIndex(image_ids[0]);
+  EXPECT_EQ(cache.GetDescriptorIndex(image_ids[0]), index);
+  cache.GetDescriptorIndex(image_ids[1]);
+  EXPECT_NE(cache.GetDescriptorIndex(image_ids[0]), index);
+}
+
+// Write images whose descriptors are noisy copies of the same descriptors, so
+// that all image pairs have matches.
+std::vector<image_t> WriteImagesWithSimilarDescriptors(const int num_images,
+                                                       Database* database) {
+  SetPRNGSeed(0);
+  const int kNumFeatures = 100;
+  const FeatureDescriptorsFloat descriptors =
+      CreateRandomFeatureDescriptorsFloat(kNumFeatures);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 100.0, 100, 100);
+  camera.camera_id = database->WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database->WriteImage(image));
+    FeatureKeypoints keypoints;
+    for (int j = 0; j < kNumFeatures; ++j) {
+      keypoints.emplace_back(RandomUniformReal<float>(0, 100),
+                             RandomUniformReal<float>(0, 100));
+    }
+    database->WriteKeypoints(image_ids.back(), keypoints);
+    FeatureDescriptorsFloat noisy_descriptors = descriptors;
+    for (Eigen::Index j = 0; j < noisy_descriptors.size(); ++j) {
+      noisy_descriptors(j) += RandomUniformReal(0.0f, 0.01f);
+    }
+    database->WriteDescriptors(image_ids.back(),
+                               NormalizeFeatureDescriptors(noisy_descriptors));
+  }
+  return image_ids;
+}
+
+TEST(FeatureMatcherController, CPUBatchSize) {
+  const int kNumImages = 6;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<std::unique_ptr<Database>> databases;
+  for (const int cpu_batch_size : {1, 4}) {
+    databases.push_back(
+        std::make_unique<Database>(Database::kInMemoryDatabasePath));
+    Database& database = *databases.back();
+    const std::vector<image_t> image_ids =
+        WriteImagesWithSimilarDescriptors(kNumImages, &database);
+    image_pairs.clear();
+    for (int i = 0; i < kNumImages; ++i) {
+      for (int j = i + 1; j < kNumImages; ++j) {
+        image_pairs.emplace_back(image_ids[i], image_ids[j]);
+      }
+    }
+
+    SiftMatchingOptions matching_options;
+    matching_options.use_gpu = false;
+    matching_options.num_threads = 2;
+    matching_options.brute_force_cpu_matcher = true;
+    matching_options.cpu_batch_size = cpu_batch_size;
+    FeatureMatcherCache cache(/*cache_size=*/kNumImages, &database);
+    cache.Setup();
+    FeatureMatcherController controller(
+        matching_options, TwoViewGeometryOptions(), &database, &cache);
+    ASSERT_TRUE(controller.Setup());
+    controller.Match(image_pairs);
+  }
+
+  // Batched matching writes the same matches as matching pair by pair.
+  for (const auto& [image_id1, image_id2] : image_pairs) {
+    const FeatureMatches matches =
+        databases[0]->ReadMatches(image_id1, image_id2);
+    const FeatureMatches batch_matches =
+        databases[1]->ReadMatches(image_id1, image_id2);
+    EXPECT_GT(matches.size(), 0);
+    ASSERT_EQ(batch_matches.size(), matches.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      EXPECT_EQ(batch_matches[i].point2D_idx1, matches[i].point2D_idx1);
+      EXPECT_EQ(batch_matches[i].point2D_idx2, matches[i].point2D_idx2);
+    }
+  }
+}
+
+TEST(HilbertCurveIndex, Nominal) {
+  EXPECT_EQ(HilbertCurveIndex(1, 0, 0), 0);
+  EXPECT_EQ(HilbertCurveIndex(2, 0, 0), 0);
+  EXPECT_EQ(HilbertCurveIndex(2, 0, 1), 1);
+  EXPECT_EQ(HilbertCurveIndex(2, 1, 1), 2);
+  EXPECT_EQ(HilbertCurveIndex(2, 1, 0), 3);
+  EXPECT_THROW(HilbertCurveIndex(3, 0, 0), std::invalid_argument);
+  EXPECT_THROW(HilbertCurveIndex(2, 2, 0), std::invalid_argument);
+
+  // The curve visits every cell once and consecutive cells are adjacent.
+  const uint64_t kNumCells = 16;
+  std::vector<std::pair<uint64_t, uint64_t>> cells(kNumCells * kNumCells);
+  std::set<uint64_t> indices;
+  for (uint64_t x = 0; x < kNumCells; ++x) {
+    for (uint64_t y = 0; y < kNumCells; ++y) {
+      const uint64_t index = HilbertCurveIndex(kNumCells, x, y);
+      ASSERT_LT(index, cells.size());
+      cells[index] = std::make_pair(x, y);
+      indices.insert(index);
+    }
+  }
+  EXPECT_EQ(indices.size(), cells.size());
+  for (size_t i = 1; i < cells.size(); ++i) {
+    const uint64_t dx = cells[i].first > cells[i - 1].first
+                            ? cells[i].first - cells[i - 1].first
+                            : cells[i - 1].first - cells[i].first;
+    const uint64_t dy = cells[i].second > cells[i - 1].second
+                            ? cells[i].second - cells[i - 1].second
+                            : cells[i - 1].second - cells[i].second;
+    EXPECT_EQ(dx + dy, 1);
+  }
+}
+
+TEST(OrderImagePairsByHilbertCurve, Nominal) {
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  OrderImagePairsByHilbertCurve(&image_pairs);
+  EXPECT_TRUE(image_pairs.empty());
+
+  // Interleave the pairs of two disjoint groups of images.
+  const std::vector<std::pair<image_t, image_t>> kImagePairs = {
+      {1, 2}, {11, 12}, {3, 1}, {13, 11}, {2, 3}, {12, 13}};
+  image_pairs = kImagePairs;
+  OrderImagePairsByHilbertCurve(&image_pairs);
+  ASSERT_EQ(image_pairs.size(), kImagePairs.size());
+  const std::set<std::pair<image_t, image_t>> ordered_image_pairs_set(
+      image_pairs.begin(), image_pairs.end());
+  const std::set<std::pair<image_t, image_t>> image_pairs_set(
+      kImagePairs.begin(), kImagePairs.end());
+  EXPECT_EQ(ordered_image_pairs_set, image_pairs_set);
+  // The pairs of each group are consecutive.
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    EXPECT_EQ(image_pairs[i].first < 10, i < 3);
+    EXPECT_EQ(image_pairs[i].second < 10, i < 3);
+  }
+}
+
+size_t CountFeatureCacheMisses(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const size_t cache_size) {
+  LRUCache<image_t, image_t> cache(
+      cache_size, [](const image_t image_id) { return image_id; });
+  for (const auto& [image_id1, image_id2] : image_pairs) {
+    cache.Get(image_id1);
+    cache.Get(image_id2);
+  }
+  return cache.NumMisses();
+}
+
+TEST(OrderImagePairsByHilbertCurve, FeatureCacheMisses) {
+  const image_t kNumImages = 100;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  for (image_t image_id1 = 1; image_id1 <= kNumImages; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 <= kNumImages;
+         ++image_id2) {
+      image_pairs.emplace_back(image_id1, image_id2);
+    }
+  }
+  SetPRNGSeed(0);
+  std::shuffle(image_pairs.begin(), image_pairs.end(), *PRNG);
+
+  std::vector<std::pair<image_t, image_t>> ordered_image_pairs = image_pairs;
+  OrderImagePairsByHilbertCurve(&ordered_image_pairs);
+
+  // The Hilbert curve order reads the features much less often from the
+  // database for caches much smaller than the number of images.
+  for (const size_t cache_size : {10, 20, 40}) {
+    EXPECT_LT(2 * CountFeatureCacheMisses(ordered_image_pairs, cache_size),
+              CountFeatureCacheMisses(image_pairs, cache_size));
+  }
+}
+
+}  // namespace
+}  // namespace colmap
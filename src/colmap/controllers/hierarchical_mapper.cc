@@ -107,6 +107,7 @@ bool HierarchicalMapperController::Options::Check() const {
   clustering_options.Check();
   THROW_CHECK_EQ(clustering_options.branching, 2);
   incremental_options.Check();
+  partitioned_ba_options.Check();
   return true;
 }
 
@@ -191,6 +192,15 @@ void HierarchicalMapperController::Run() {
               image_id_to_name.at(image_id));
         }
 
+        // Each cluster loads a different subset of the database.
+        if (!incremental_options->database_cache_path.empty()) {
+          const size_t cluster_idx =
+              std::find(leaf_clusters.begin(), leaf_clusters.end(), &cluster) -
+              leaf_clusters.begin();
+          incremental_options->database_cache_path +=
+              "." + std::to_string(cluster_idx);
+        }
+
         IncrementalMapperController mapper(std::move(incremental_options),
                                            options_.image_path,
                                            options_.database_path,
@@ -235,6 +245,32 @@ void HierarchicalMapperController::Run() {
       reconstruction_managers.begin()->second->Get(0)->NumRegImages(), 0);
   *reconstruction_manager_ = *reconstruction_managers.begin()->second;
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Refine merged clusters
+  //////////////////////////////////////////////////////////////////////////////
+
+  if (options_.ba_global_partitioned) {
+    PrintHeading1("Partitioned bundle adjustment");
+
+    std::vector<std::vector<image_t>> partitions;
+    partitions.reserve(leaf_clusters.size());
+    for (const auto& cluster : leaf_clusters) {
+      partitions.push_back(cluster->image_ids);
+    }
+
+    for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+      const auto reconstruction = reconstruction_manager_->Get(i);
+      if (reconstruction->NumRegImages() < 2) {
+        continue;
+      }
+      PartitionedBundleAdjuster bundle_adjuster(
+          options_.incremental_options.GlobalBundleAdjustment(),
+          options_.partitioned_ba_options,
+          partitions);
+      bundle_adjuster.Solve(reconstruction.get());
+    }
+  }
+
   run_timer.PrintMinutes();
 }
 
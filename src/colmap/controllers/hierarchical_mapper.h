@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/controllers/incremental_mapper.h"
+#include "colmap/estimators/bundle_adjustment.h"
 #include "colmap/scene/reconstruction_manager.h"
 #include "colmap/scene/scene_clustering.h"
 #include "colmap/util/base_controller.h"
@@ -64,6 +65,13 @@ class HierarchicalMapperController : public BaseController {
     // Options used to reconstruction each cluster individually.
     IncrementalMapperOptions incremental_options;
 
+    // Whether to refine the merged reconstruction using bundle adjustment
+    // partitioned by the leaf clusters.
+    bool ba_global_partitioned = false;
+
+    // Options for the partitioned bundle adjustment of the merged clusters.
+    PartitionedBundleAdjuster::Options partitioned_ba_options;
+
     bool Check() const;
   };
 
@@ -45,8 +45,13 @@ bool ImageReaderOptions::Check() const {
   return true;
 }
 
-ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
-    : options_(options), database_(database), image_index_(0) {
+ImageReader::ImageReader(const ImageReaderOptions& options,
+                         Database* database,
+                         const FeatureStore* feature_store)
+    : options_(options),
+      database_(database),
+      feature_store_(feature_store),
+      image_index_(0) {
   THROW_CHECK(options_.Check());
 
   // Ensure trailing slash, so that we can build the correct image name.
@@ -89,9 +94,16 @@ ImageReader::Status ImageReader::Next(Camera* camera,
                                       Image* image,
                                       Bitmap* bitmap,
                                       Bitmap* mask) {
+  const Status status = NextMetadata(camera, image);
+  if (status != Status::SUCCESS) {
+    return status;
+  }
+  return ReadBitmap(*camera, *image, bitmap, mask);
+}
+
+ImageReader::Status ImageReader::NextMetadata(Camera* camera, Image* image) {
   THROW_CHECK_NOTNULL(camera);
   THROW_CHECK_NOTNULL(image);
-  THROW_CHECK_NOTNULL(bitmap);
 
   image_index_ += 1;
   THROW_CHECK_LE(image_index_, options_.image_list.size());
@@ -120,9 +132,14 @@ ImageReader::Status ImageReader::Next(Camera* camera,
 
   if (exists_image) {
     *image = database_->ReadImageWithName(image->Name());
-    const bool exists_keypoints = database_->ExistsKeypoints(image->ImageId());
+    const bool exists_keypoints =
+        feature_store_ != nullptr
+            ? feature_store_->ExistsKeypoints(image->ImageId())
+            : database_->ExistsKeypoints(image->ImageId());
     const bool exists_descriptors =
-        database_->ExistsDescriptors(image->ImageId());
+        feature_store_ != nullptr
+            ? feature_store_->ExistsDescriptors(image->ImageId())
+            : database_->ExistsDescriptors(image->ImageId());
 
     if (exists_keypoints && exists_descriptors) {
       return Status::IMAGE_EXISTS;
@@ -130,26 +147,16 @@ ImageReader::Status ImageReader::Next(Camera* camera,
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Read image.
+  // Read image dimensions and metadata.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!bitmap->Read(image_path, false)) {
+  // Only the header is read here, since the camera assignment must be done
+  // sequentially, while the pixels can be decoded in parallel afterwards.
+  Bitmap header;
+  if (!header.ReadHeader(image_path)) {
     return Status::BITMAP_ERROR;
   }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Read mask.
-  //////////////////////////////////////////////////////////////////////////////
-
-  if (mask && !options_.mask_path.empty()) {
-    const std::string mask_path =
-        JoinPaths(options_.mask_path, image->Name() + ".png");
-    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
-      // NOTE: Maybe introduce a separate error type MASK_ERROR?
-      return Status::BITMAP_ERROR;
-    }
-  }
-
   //////////////////////////////////////////////////////////////////////////////
   // Check for well-formed data.
   //////////////////////////////////////////////////////////////////////////////
@@ -163,8 +170,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
-    if (static_cast<size_t>(bitmap->Width()) != current_camera.width ||
-        static_cast<size_t>(bitmap->Height()) != current_camera.height) {
+    if (static_cast<size_t>(header.Width()) != current_camera.width ||
+        static_cast<size_t>(header.Height()) != current_camera.height) {
       return Status::CAMERA_EXIST_DIM_ERROR;
     }
 
@@ -179,8 +186,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         ((options_.single_camera && !options_.single_camera_per_folder) ||
          (options_.single_camera_per_folder &&
           image_folder == prev_image_folder_)) &&
-        (prev_camera_.width != static_cast<size_t>(bitmap->Width()) ||
-         prev_camera_.height != static_cast<size_t>(bitmap->Height()))) {
+        (prev_camera_.width != static_cast<size_t>(header.Width()) ||
+         prev_camera_.height != static_cast<size_t>(header.Height()))) {
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
@@ -188,12 +195,12 @@ ImageReader::Status ImageReader::Next(Camera* camera,
     // Read camera model and check for consistency if it exists
     //////////////////////////////////////////////////////////////////////////////
     std::string camera_model;
-    const bool valid_camera_model = bitmap->ExifCameraModel(&camera_model);
+    const bool valid_camera_model = header.ExifCameraModel(&camera_model);
     if (camera_model_to_id_.count(camera_model) > 0) {
       Camera camera =
           database_->ReadCamera(camera_model_to_id_.at(camera_model));
-      if (camera.width != static_cast<size_t>(bitmap->Width()) ||
-          camera.height != static_cast<size_t>(bitmap->Height())) {
+      if (camera.width != static_cast<size_t>(header.Width()) ||
+          camera.height != static_cast<size_t>(header.Height())) {
         return Status::CAMERA_EXIST_DIM_ERROR;
       }
       prev_camera_ = std::move(camera);
@@ -215,23 +222,23 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         // Extract focal length.
         double focal_length = 0.0;
         bool has_focal_length = false;
-        if (bitmap->ExifFocalLength(&focal_length)) {
+        if (header.ExifFocalLength(&focal_length)) {
           has_focal_length = true;
         } else {
           focal_length = options_.default_focal_length_factor *
-                         std::max(bitmap->Width(), bitmap->Height());
+                         std::max(header.Width(), header.Height());
         }
 
         prev_camera_ = Camera::CreateFromModelId(prev_camera_.camera_id,
                                                  prev_camera_.model_id,
                                                  focal_length,
-                                                 bitmap->Width(),
-                                                 bitmap->Height());
+                                                 header.Width(),
+                                                 header.Height());
         prev_camera_.has_prior_focal_length = has_focal_length;
       }
 
-      prev_camera_.width = static_cast<size_t>(bitmap->Width());
-      prev_camera_.height = static_cast<size_t>(bitmap->Height());
+      prev_camera_.width = static_cast<size_t>(header.Width());
+      prev_camera_.height = static_cast<size_t>(header.Height());
 
       if (!prev_camera_.VerifyParams()) {
         return Status::CAMERA_PARAM_ERROR;
@@ -250,9 +257,9 @@ ImageReader::Status ImageReader::Next(Camera* camera,
     //////////////////////////////////////////////////////////////////////////////
 
     Eigen::Vector3d& translation_prior = image->CamFromWorldPrior().translation;
-    if (!bitmap->ExifLatitude(&translation_prior.x()) ||
-        !bitmap->ExifLongitude(&translation_prior.y()) ||
-        !bitmap->ExifAltitude(&translation_prior.z())) {
+    if (!header.ExifLatitude(&translation_prior.x()) ||
+        !header.ExifLongitude(&translation_prior.y()) ||
+        !header.ExifAltitude(&translation_prior.z())) {
       translation_prior.setConstant(std::numeric_limits<double>::quiet_NaN());
     }
   }
@@ -265,6 +272,33 @@ ImageReader::Status ImageReader::Next(Camera* camera,
   return Status::SUCCESS;
 }
 
+ImageReader::Status ImageReader::ReadBitmap(const Camera& camera,
+                                            const Image& image,
+                                            Bitmap* bitmap,
+                                            Bitmap* mask) const {
+  THROW_CHECK_NOTNULL(bitmap);
+
+  if (!bitmap->Read(JoinPaths(options_.image_path, image.Name()), false)) {
+    return Status::BITMAP_ERROR;
+  }
+
+  if (static_cast<size_t>(bitmap->Width()) != camera.width ||
+      static_cast<size_t>(bitmap->Height()) != camera.height) {
+    return Status::CAMERA_EXIST_DIM_ERROR;
+  }
+
+  if (mask && !options_.mask_path.empty()) {
+    const std::string mask_path =
+        JoinPaths(options_.mask_path, image.Name() + ".png");
+    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
+      // NOTE: Maybe introduce a separate error type MASK_ERROR?
+      return Status::BITMAP_ERROR;
+    }
+  }
+
+  return Status::SUCCESS;
+}
+
 size_t ImageReader::NextIndex() const { return image_index_; }
 
 size_t ImageReader::NumImages() const { return options_.image_list.size(); }
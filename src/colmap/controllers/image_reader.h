@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/threading.h"
 
@@ -41,6 +42,10 @@ struct ImageReaderOptions {
   // Path to database in which to store the extracted data.
   std::string database_path = "";
 
+  // Optional path to a feature store directory, in which the extracted
+  // keypoints and descriptors are stored instead of the database.
+  std::string feature_store_path = "";
+
   // Root path to folder which contains the images.
   std::string image_path = "";
 
@@ -91,7 +96,8 @@ struct ImageReaderOptions {
 };
 
 // Recursively iterate over the images in a directory. Skips an image if it
-// already exists in the database. Extracts the camera intrinsics from EXIF and
+// already exists in the database and its features exist in the database or,
+// if given, in the feature store. Extracts the camera intrinsics from EXIF and
 // writes the camera information to the database.
 class ImageReader {
  public:
@@ -105,9 +111,25 @@ class ImageReader {
     CAMERA_PARAM_ERROR
   };
 
-  ImageReader(const ImageReaderOptions& options, Database* database);
+  ImageReader(const ImageReaderOptions& options,
+              Database* database,
+              const FeatureStore* feature_store = nullptr);
 
+  // Read the metadata and decode the pixels of the next image. Equivalent to
+  // `NextMetadata` followed by `ReadBitmap`.
   Status Next(Camera* camera, Image* image, Bitmap* bitmap, Bitmap* mask);
+
+  // Read the metadata of the next image and assign its camera without decoding
+  // the pixels. Cameras are assigned in the order of the images, so this must
+  // be called sequentially.
+  Status NextMetadata(Camera* camera, Image* image);
+
+  // Decode the pixels and the optional mask of an image returned by
+  // `NextMetadata`. Can be called concurrently for different images.
+  Status ReadBitmap(const Camera& camera,
+                    const Image& image,
+                    Bitmap* bitmap,
+                    Bitmap* mask) const;
   size_t NextIndex() const;
   size_t NumImages() const;
 
@@ -115,6 +137,7 @@ class ImageReader {
   // Image reader options.
   ImageReaderOptions options_;
   Database* database_;
+  const FeatureStore* feature_store_;
   // Index of previously processed image.
   size_t image_index_;
   // Previously processed camera.
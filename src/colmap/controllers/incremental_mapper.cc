@@ -29,8 +29,10 @@
 
 #include "colmap/controllers/incremental_mapper.h"
 
+#include "colmap/scene/feature_store.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
+#include "colmap/util/trace.h"
 
 namespace colmap {
 namespace {
@@ -222,6 +224,7 @@ void IncrementalMapperController::Run() {
 }
 
 bool IncrementalMapperController::LoadDatabase() {
+  COLMAP_TRACE_SCOPE("incremental_mapper_controller/load_database");
   LOG(INFO) << "Loading database";
 
   // Make sure images of the given reconstruction are also included when
@@ -236,11 +239,31 @@ bool IncrementalMapperController::LoadDatabase() {
   }
 
   Database database(database_path_);
+  std::unique_ptr<FeatureStore> feature_store;
+  if (!options_->feature_store_path.empty()) {
+    feature_store =
+        std::make_unique<FeatureStore>(options_->feature_store_path);
+  }
   Timer timer;
   timer.Start();
   const size_t min_num_matches = static_cast<size_t>(options_->min_num_matches);
-  database_cache_ = DatabaseCache::Create(
-      database, min_num_matches, options_->ignore_watermarks, image_names);
+  if (options_->database_cache_path.empty()) {
+    database_cache_ = DatabaseCache::Create(database,
+                                            min_num_matches,
+                                            options_->ignore_watermarks,
+                                            image_names,
+                                            options_->num_threads,
+                                            feature_store.get());
+  } else {
+    database_cache_ =
+        DatabaseCache::CreateWithSnapshot(options_->database_cache_path,
+                                          database,
+                                          min_num_matches,
+                                          options_->ignore_watermarks,
+                                          image_names,
+                                          options_->num_threads,
+                                          feature_store.get());
+  }
   timer.PrintMinutes();
 
   if (database_cache_->NumImages() == 0) {
@@ -351,6 +374,37 @@ IncrementalMapperController::ReconstructSubModel(
   size_t ba_prev_num_reg_images = reconstruction->NumRegImages();
   size_t ba_prev_num_points = reconstruction->NumPoints3D();
 
+  // Triangulate and refine the reconstruction after an image was registered.
+  auto ProcessRegisteredImage = [&](const image_t image_id) {
+    mapper.TriangulateImage(options_->Triangulation(), image_id);
+    mapper.IterativeLocalRefinement(options_->ba_local_max_refinements,
+                                    options_->ba_local_max_refinement_change,
+                                    mapper_options,
+                                    options_->LocalBundleAdjustment(),
+                                    options_->Triangulation(),
+                                    image_id);
+
+    if (CheckRunGlobalRefinement(
+            *reconstruction, ba_prev_num_reg_images, ba_prev_num_points)) {
+      IterativeGlobalRefinement(*options_, mapper_options, mapper);
+      ba_prev_num_points = reconstruction->NumPoints3D();
+      ba_prev_num_reg_images = reconstruction->NumRegImages();
+    }
+
+    if (options_->extract_colors) {
+      ExtractColors(image_path_, image_id, *reconstruction);
+    }
+
+    if (options_->snapshot_images_freq > 0 &&
+        reconstruction->NumRegImages() >=
+            options_->snapshot_images_freq + snapshot_prev_num_reg_images) {
+      snapshot_prev_num_reg_images = reconstruction->NumRegImages();
+      WriteSnapshot(*reconstruction, options_->snapshot_path);
+    }
+
+    Callback(NEXT_IMAGE_REG_CALLBACK);
+  };
+
   bool reg_next_success = true;
   bool prev_reg_next_success = true;
   do {
@@ -361,16 +415,32 @@ IncrementalMapperController::ReconstructSubModel(
     prev_reg_next_success = reg_next_success;
     reg_next_success = false;
 
-    const std::vector<image_t> next_images =
-        mapper.FindNextImages(mapper_options);
+    // Fetch the ranked next images in growing batches, since usually one of
+    // the first images can be registered. Images that failed to register are
+    // re-ranked by the mapper, so they are explicitly skipped in later
+    // batches to try each image at most once.
+    size_t max_num_next_images = 16;
+    std::vector<image_t> next_images =
+        mapper.FindNextImages(mapper_options, max_num_next_images);
+    std::unordered_set<image_t> tried_image_ids;
 
     if (next_images.empty()) {
       break;
     }
 
+    // Poses of the next images speculatively estimated in parallel. Every
+    // registration changes the reconstruction, so `RegisterNextImage`
+    // re-validates each pose against the current 2D-3D correspondences and
+    // inliers before committing it.
+    const size_t num_speculative_reg_images =
+        mapper_options.num_speculative_reg_images;
+    std::vector<IncrementalMapper::NextImagePose> next_image_poses;
+
     image_t next_image_id;
-    for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
+    size_t reg_trial = 0;
+    for (; reg_trial < next_images.size(); ++reg_trial) {
       next_image_id = next_images[reg_trial];
+      tried_image_ids.insert(next_image_id);
       const Image& next_image = reconstruction->Image(next_image_id);
 
       LOG(INFO) << StringPrintf("Registering image #%d (%d)",
@@ -380,8 +450,25 @@ IncrementalMapperController::ReconstructSubModel(
                                 next_image.NumVisiblePoints3D(),
                                 next_image.NumObservations());
 
-      reg_next_success =
-          mapper.RegisterNextImage(mapper_options, next_image_id);
+      if (num_speculative_reg_images > 1) {
+        if (reg_trial == next_image_poses.size()) {
+          const size_t num_images = std::min(num_speculative_reg_images,
+                                             next_images.size() - reg_trial);
+          const std::vector<IncrementalMapper::NextImagePose> poses =
+              mapper.EstimateNextImagePoses(
+                  mapper_options,
+                  std::vector<image_t>(
+                      next_images.begin() + reg_trial,
+                      next_images.begin() + reg_trial + num_images));
+          next_image_poses.insert(
+              next_image_poses.end(), poses.begin(), poses.end());
+        }
+        reg_next_success = mapper.RegisterNextImage(
+            mapper_options, next_image_id, &next_image_poses[reg_trial]);
+      } else {
+        reg_next_success =
+            mapper.RegisterNextImage(mapper_options, next_image_id);
+      }
 
       if (reg_next_success) {
         break;
@@ -396,37 +483,46 @@ IncrementalMapperController::ReconstructSubModel(
                 static_cast<size_t>(options_->min_model_size)) {
           break;
         }
+
+        if (reg_trial + 1 == next_images.size()) {
+          max_num_next_images *= 2;
+          const std::vector<image_t> more_next_images = mapper.FindNextImages(
+              mapper_options, max_num_next_images, tried_image_ids);
+          next_images.insert(next_images.end(),
+                             more_next_images.begin(),
+                             more_next_images.end());
+        }
       }
     }
 
     if (reg_next_success) {
-      mapper.TriangulateImage(options_->Triangulation(), next_image_id);
-      mapper.IterativeLocalRefinement(options_->ba_local_max_refinements,
-                                      options_->ba_local_max_refinement_change,
-                                      mapper_options,
-                                      options_->LocalBundleAdjustment(),
-                                      options_->Triangulation(),
-                                      next_image_id);
-
-      if (CheckRunGlobalRefinement(
-              *reconstruction, ba_prev_num_reg_images, ba_prev_num_points)) {
-        IterativeGlobalRefinement(*options_, mapper_options, mapper);
-        ba_prev_num_points = reconstruction->NumPoints3D();
-        ba_prev_num_reg_images = reconstruction->NumRegImages();
-      }
-
-      if (options_->extract_colors) {
-        ExtractColors(image_path_, next_image_id, *reconstruction);
-      }
+      ProcessRegisteredImage(next_image_id);
+
+      // Commit the remaining successfully estimated poses of the speculative
+      // batch in rank order. Each one is re-validated after the previous
+      // image was registered and triangulated.
+      for (size_t spec_trial = reg_trial + 1;
+           spec_trial < next_image_poses.size();
+           ++spec_trial) {
+        if (CheckIfStopped()) {
+          break;
+        }
+        if (!next_image_poses[spec_trial].success) {
+          continue;
+        }
 
-      if (options_->snapshot_images_freq > 0 &&
-          reconstruction->NumRegImages() >=
-              options_->snapshot_images_freq + snapshot_prev_num_reg_images) {
-        snapshot_prev_num_reg_images = reconstruction->NumRegImages();
-        WriteSnapshot(*reconstruction, options_->snapshot_path);
+        next_image_id = next_images[spec_trial];
+        LOG(INFO) << StringPrintf("Registering image #%d (%d)",
+                                  next_image_id,
+                                  reconstruction->NumRegImages() + 1);
+        if (mapper.RegisterNextImage(mapper_options,
+                                     next_image_id,
+                                     &next_image_poses[spec_trial])) {
+          ProcessRegisteredImage(next_image_id);
+        } else {
+          LOG(INFO) << "=> Could not register speculatively estimated pose.";
+        }
       }
-
-      Callback(NEXT_IMAGE_REG_CALLBACK);
     }
 
     const size_t max_model_overlap =
@@ -458,6 +554,7 @@ IncrementalMapperController::ReconstructSubModel(
 
 void IncrementalMapperController::Reconstruct(
     const IncrementalMapper::Options& mapper_options) {
+  COLMAP_TRACE_SCOPE("incremental_mapper_controller/reconstruct");
   IncrementalMapper mapper(database_cache_);
 
   // Is there a sub-model before we start the reconstruction? I.e. the user
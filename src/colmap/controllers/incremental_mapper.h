@@ -120,6 +120,19 @@ struct IncrementalMapperOptions {
   std::string snapshot_path = "";
   int snapshot_images_freq = 0;
 
+  // Path to a binary snapshot of the loaded database. If it was written for
+  // the same database and options, the database is loaded from it instead of
+  // building the correspondence graph. Otherwise, it is (re-)written. Changes
+  // are detected by a counter of all writes to the cameras, images, keypoints,
+  // and two-view geometries in the database (or keypoints in the feature
+  // store), but not if the database is replaced by a different database with
+  // the same cameras, images, and numbers of keypoints and inlier matches.
+  std::string database_cache_path = "";
+
+  // Optional path to a feature store directory, from which the keypoints are
+  // read instead of the database.
+  std::string feature_store_path = "";
+
   // Which images to reconstruct. If no images are specified, all images will
   // be reconstructed by default.
   std::unordered_set<std::string> image_names;
@@ -32,6 +32,7 @@
 #include "colmap/estimators/alignment.h"
 #include "colmap/scene/synthetic.h"
 #include "colmap/util/testing.h"
+#include "colmap/util/trace.h"
 
 #include <gtest/gtest.h>
 
@@ -120,6 +121,35 @@ TEST(IncrementalMapperController, WithNoise) {
                              /*num_obs_tolerance=*/0.02);
 }
 
+TEST(IncrementalMapperController, PersistentLocalBundleAdjustment) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 7;
+  synthetic_dataset_options.num_points3D = 100;
+  synthetic_dataset_options.point2D_stddev = 0.5;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  auto mapper_options = std::make_shared<IncrementalMapperOptions>();
+  mapper_options->mapper.local_ba_persistent = true;
+  IncrementalMapperController mapper(mapper_options,
+                                     /*image_path=*/"",
+                                     database_path,
+                                     reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-1,
+                             /*max_proj_center_error=*/1e-1,
+                             /*num_obs_tolerance=*/0.02);
+}
+
 TEST(IncrementalMapperController, MultiReconstruction) {
   const std::string database_path = CreateTestDir() + "/database.db";
 
@@ -196,5 +226,49 @@ TEST(IncrementalMapperController, ChainedMatches) {
                              /*num_obs_tolerance=*/0);
 }
 
+TEST(IncrementalMapperController, SpeculativeRegistration) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 10;
+  synthetic_dataset_options.num_points3D = 100;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  auto mapper_options = std::make_shared<IncrementalMapperOptions>();
+  mapper_options->mapper.num_speculative_reg_images = 8;
+  IncrementalMapperController mapper(mapper_options,
+                                     /*image_path=*/"",
+                                     database_path,
+                                     reconstruction_manager);
+
+  // Count the speculative batches to check that all poses of a batch are
+  // committed and not only the first successful one.
+  Tracer& tracer = Tracer::Instance();
+  tracer.Enable(Tracer::Options());
+  mapper.Run();
+  size_t num_speculative_batches = 0;
+  for (const TraceStats& stats : tracer.Stats()) {
+    if (stats.name == "incremental_mapper/estimate_next_image_poses") {
+      num_speculative_batches = stats.count;
+    }
+  }
+  tracer.Disable();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+  // The 8 images following the initial pair are registered in one batch.
+  EXPECT_GE(num_speculative_batches, 1);
+  EXPECT_LT(num_speculative_batches, gt_reconstruction.NumRegImages() - 2);
+}
+
 }  // namespace
 }  // namespace colmap
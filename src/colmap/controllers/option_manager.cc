@@ -42,6 +42,7 @@
 #include "colmap/mvs/patch_match.h"
 #include "colmap/ui/render_options.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/trace.h"
 #include "colmap/util/version.h"
 
 #include <boost/filesystem/operations.hpp>
@@ -55,6 +56,7 @@ OptionManager::OptionManager(bool add_project_options) {
   project_path = std::make_shared<std::string>();
   database_path = std::make_shared<std::string>();
   image_path = std::make_shared<std::string>();
+  trace_path = std::make_shared<std::string>();
 
   image_reader = std::make_shared<ImageReaderOptions>();
   sift_extraction = std::make_shared<SiftExtractionOptions>();
@@ -200,6 +202,7 @@ void OptionManager::AddLogOptions() {
 
   AddAndRegisterDefaultOption("log_to_stderr", &FLAGS_logtostderr);
   AddAndRegisterDefaultOption("log_level", &FLAGS_v);
+  AddAndRegisterDefaultOption("trace_path", trace_path.get());
 }
 
 void OptionManager::AddRandomOptions() {
@@ -253,6 +256,8 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   AddAndRegisterDefaultOption("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  AddAndRegisterDefaultOption("ImageReader.feature_store_path",
+                              &image_reader->feature_store_path);
 
   AddAndRegisterDefaultOption("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
@@ -278,6 +283,12 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->estimate_affine_shape);
   AddAndRegisterDefaultOption("SiftExtraction.max_num_orientations",
                               &sift_extraction->max_num_orientations);
+  AddAndRegisterDefaultOption("SiftExtraction.two_pass_extraction",
+                              &sift_extraction->two_pass_extraction);
+  AddAndRegisterDefaultOption("SiftExtraction.num_image_threads",
+                              &sift_extraction->num_image_threads);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_size",
+                              &sift_extraction->tile_size);
   AddAndRegisterDefaultOption("SiftExtraction.upright",
                               &sift_extraction->upright);
   AddAndRegisterDefaultOption("SiftExtraction.domain_size_pooling",
@@ -311,12 +322,24 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->guided_matching);
   AddAndRegisterDefaultOption("SiftMatching.max_num_matches",
                               &sift_matching->max_num_matches);
+  AddAndRegisterDefaultOption("SiftMatching.cpu_index_cache_size",
+                              &sift_matching->cpu_index_cache_size);
+  AddAndRegisterDefaultOption("SiftMatching.cpu_index_cache_path",
+                              &sift_matching->cpu_index_cache_path);
+  AddAndRegisterDefaultOption("SiftMatching.cpu_batch_size",
+                              &sift_matching->cpu_batch_size);
+  AddAndRegisterDefaultOption("SiftMatching.feature_store_path",
+                              &sift_matching->feature_store_path);
   AddAndRegisterDefaultOption("TwoViewGeometry.min_num_inliers",
                               &two_view_geometry->min_num_inliers);
   AddAndRegisterDefaultOption("TwoViewGeometry.multiple_models",
                               &two_view_geometry->multiple_models);
   AddAndRegisterDefaultOption("TwoViewGeometry.compute_relative_pose",
                               &two_view_geometry->compute_relative_pose);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_prosac",
+                              &two_view_geometry->use_prosac);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_sprt",
+                              &two_view_geometry->ransac_options.use_sprt);
   AddAndRegisterDefaultOption("TwoViewGeometry.max_error",
                               &two_view_geometry->ransac_options.max_error);
   AddAndRegisterDefaultOption("TwoViewGeometry.confidence",
@@ -540,6 +563,10 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption("Mapper.snapshot_path", &mapper->snapshot_path);
   AddAndRegisterDefaultOption("Mapper.snapshot_images_freq",
                               &mapper->snapshot_images_freq);
+  AddAndRegisterDefaultOption("Mapper.database_cache_path",
+                              &mapper->database_cache_path);
+  AddAndRegisterDefaultOption("Mapper.feature_store_path",
+                              &mapper->feature_store_path);
   AddAndRegisterDefaultOption("Mapper.fix_existing_images",
                               &mapper->fix_existing_images);
 
@@ -554,20 +581,28 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.init_min_tri_angle);
   AddAndRegisterDefaultOption("Mapper.init_max_reg_trials",
                               &mapper->mapper.init_max_reg_trials);
+  AddAndRegisterDefaultOption("Mapper.init_num_scored_pairs",
+                              &mapper->mapper.init_num_scored_pairs);
   AddAndRegisterDefaultOption("Mapper.abs_pose_max_error",
                               &mapper->mapper.abs_pose_max_error);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_num_inliers",
                               &mapper->mapper.abs_pose_min_num_inliers);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_inlier_ratio",
                               &mapper->mapper.abs_pose_min_inlier_ratio);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_use_prosac",
+                              &mapper->mapper.abs_pose_use_prosac);
   AddAndRegisterDefaultOption("Mapper.filter_max_reproj_error",
                               &mapper->mapper.filter_max_reproj_error);
   AddAndRegisterDefaultOption("Mapper.filter_min_tri_angle",
                               &mapper->mapper.filter_min_tri_angle);
   AddAndRegisterDefaultOption("Mapper.max_reg_trials",
                               &mapper->mapper.max_reg_trials);
+  AddAndRegisterDefaultOption("Mapper.num_speculative_reg_images",
+                              &mapper->mapper.num_speculative_reg_images);
   AddAndRegisterDefaultOption("Mapper.local_ba_min_tri_angle",
                               &mapper->mapper.local_ba_min_tri_angle);
+  AddAndRegisterDefaultOption("Mapper.local_ba_persistent",
+                              &mapper->mapper.local_ba_persistent);
 
   // IncrementalTriangulator.
   AddAndRegisterDefaultOption("Mapper.tri_max_transitivity",
@@ -602,8 +637,12 @@ void OptionManager::AddPatchMatchStereoOptions() {
 
   AddAndRegisterDefaultOption("PatchMatchStereo.max_image_size",
                               &patch_match_stereo->max_image_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.use_gpu",
+                              &patch_match_stereo->use_gpu);
   AddAndRegisterDefaultOption("PatchMatchStereo.gpu_index",
                               &patch_match_stereo->gpu_index);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_threads",
+                              &patch_match_stereo->num_threads);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_min",
                               &patch_match_stereo->depth_min);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_max",
@@ -780,6 +819,7 @@ void OptionManager::ResetOptions(const bool reset_paths) {
     *project_path = "";
     *database_path = "";
     *image_path = "";
+    *trace_path = "";
   }
   *image_reader = ImageReaderOptions();
   *sift_extraction = SiftExtractionOptions();
@@ -880,6 +920,12 @@ void OptionManager::Parse(const int argc, char** argv) {
     // NOLINTNEXTLINE(concurrency-mt-unsafe)
     exit(EXIT_FAILURE);
   }
+
+  if (!trace_path->empty()) {
+    Tracer::Options trace_options;
+    trace_options.output_path = *trace_path;
+    Tracer::Instance().Enable(trace_options);
+  }
 }
 
 bool OptionManager::Read(const std::string& path) {
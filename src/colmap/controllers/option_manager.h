@@ -120,6 +120,7 @@ class OptionManager {
   std::shared_ptr<std::string> project_path;
   std::shared_ptr<std::string> database_path;
   std::shared_ptr<std::string> image_path;
+  std::shared_ptr<std::string> trace_path;
 
   std::shared_ptr<ImageReaderOptions> image_reader;
   std::shared_ptr<SiftExtractionOptions> sift_extraction;
@@ -175,6 +175,16 @@ void P3PEstimator::Residuals(const std::vector<X_t>& points2D,
   ComputeSquaredReprojectionError(points2D, points3D, proj_matrix, residuals);
 }
 
+void P3PEstimator::Residuals(const XBatch_t& points2D,
+                             const YBatch_t& points3D,
+                             const M_t& proj_matrix,
+                             const size_t begin,
+                             const size_t end,
+                             std::vector<double>* residuals) {
+  ComputeSquaredReprojectionError(
+      points2D, points3D, proj_matrix, begin, end, residuals);
+}
+
 void EPNPEstimator::Estimate(const std::vector<X_t>& points2D,
                              const std::vector<Y_t>& points3D,
                              std::vector<M_t>* models) {
@@ -201,6 +211,16 @@ void EPNPEstimator::Residuals(const std::vector<X_t>& points2D,
   ComputeSquaredReprojectionError(points2D, points3D, proj_matrix, residuals);
 }
 
+void EPNPEstimator::Residuals(const XBatch_t& points2D,
+                              const YBatch_t& points3D,
+                              const M_t& proj_matrix,
+                              const size_t begin,
+                              const size_t end,
+                              std::vector<double>* residuals) {
+  ComputeSquaredReprojectionError(
+      points2D, points3D, proj_matrix, begin, end, residuals);
+}
+
 bool EPNPEstimator::ComputePose(const std::vector<Eigen::Vector2d>& points2D,
                                 const std::vector<Eigen::Vector3d>& points3D,
                                 Eigen::Matrix3x4d* proj_matrix) {
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include "colmap/estimators/utils.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
@@ -54,6 +55,9 @@ class P3PEstimator {
   typedef Eigen::Vector3d Y_t;
   // The transformation from the world to the camera frame.
   typedef Eigen::Matrix3x4d M_t;
+  // Structure-of-arrays layout of the 2D and 3D features.
+  typedef Point2DArray XBatch_t;
+  typedef Point3DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 3;
@@ -80,6 +84,15 @@ class P3PEstimator {
                         const std::vector<Y_t>& points3D,
                         const M_t& proj_matrix,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points2D,
+                        const YBatch_t& points3D,
+                        const M_t& proj_matrix,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 // EPNP solver for the PNP (Perspective-N-Point) problem. The solver needs a
@@ -101,6 +114,9 @@ class EPNPEstimator {
   typedef Eigen::Vector3d Y_t;
   // The transformation from the world to the camera frame.
   typedef Eigen::Matrix3x4d M_t;
+  // Structure-of-arrays layout of the 2D and 3D features.
+  typedef Point2DArray XBatch_t;
+  typedef Point3DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 4;
@@ -128,6 +144,15 @@ class EPNPEstimator {
                         const M_t& proj_matrix,
                         std::vector<double>* residuals);
 
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points2D,
+                        const YBatch_t& points3D,
+                        const M_t& proj_matrix,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
+
  private:
   bool ComputePose(const std::vector<Eigen::Vector2d>& points2D,
                    const std::vector<Eigen::Vector3d>& points3D,
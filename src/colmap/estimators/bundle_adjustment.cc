@@ -35,7 +35,10 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
+#include "colmap/util/trace.h"
 
+#include <algorithm>
+#include <future>
 #include <iomanip>
 
 namespace colmap {
@@ -256,6 +259,7 @@ BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
 }
 
 bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
+  COLMAP_TRACE_SCOPE("bundle_adjustment/solve");
   THROW_CHECK_NOTNULL(reconstruction);
   THROW_CHECK(!problem_) << "Cannot use the same BundleAdjuster multiple times";
 
@@ -307,6 +311,7 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
   THROW_CHECK(solver_options.IsValid(&solver_error)) << solver_error;
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
+  TraceValue("bundle_adjustment/num_residuals", summary_.num_residuals_reduced);
 
   if (options_.print_summary || VLOG_IS_ON(1)) {
     PrintSolverSummary(summary_, "Bundle adjustment report");
@@ -516,6 +521,7 @@ RigBundleAdjuster::RigBundleAdjuster(const BundleAdjustmentOptions& options,
 
 bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
                               std::vector<CameraRig>* camera_rigs) {
+  COLMAP_TRACE_SCOPE("rig_bundle_adjustment/solve");
   THROW_CHECK_NOTNULL(reconstruction);
   THROW_CHECK_NOTNULL(camera_rigs);
   THROW_CHECK(!problem_) << "Cannot use the same BundleAdjuster multiple times";
@@ -581,6 +587,7 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
   THROW_CHECK(solver_options.IsValid(&solver_error)) << solver_error;
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
+  TraceValue("bundle_adjustment/num_residuals", summary_.num_residuals_reduced);
 
   if (options_.print_summary || VLOG_IS_ON(1)) {
     PrintSolverSummary(summary_, "Rig Bundle adjustment report");
@@ -813,6 +820,759 @@ void RigBundleAdjuster::ParameterizeCameraRigs(Reconstruction* reconstruction) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PersistentBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+inline uint64_t ObservationKey(const image_t image_id,
+                               const point2D_t point2D_idx) {
+  return (static_cast<uint64_t>(image_id) << 32) | point2D_idx;
+}
+
+inline image_t ObservationKeyToImageId(const uint64_t observation_key) {
+  return static_cast<image_t>(observation_key >> 32);
+}
+
+inline point2D_t ObservationKeyToPoint2DIdx(const uint64_t observation_key) {
+  return static_cast<point2D_t>(observation_key & 0xFFFFFFFF);
+}
+
+// Whether the options differ in any way that affects the persistent problem.
+bool HaveDifferentProblemOptions(const BundleAdjustmentOptions& options1,
+                                 const BundleAdjustmentOptions& options2) {
+  return options1.loss_function_type != options2.loss_function_type ||
+         options1.loss_function_scale != options2.loss_function_scale ||
+         options1.refine_focal_length != options2.refine_focal_length ||
+         options1.refine_principal_point != options2.refine_principal_point ||
+         options1.refine_extra_params != options2.refine_extra_params ||
+         options1.refine_extrinsics != options2.refine_extrinsics;
+}
+
+}  // namespace
+
+bool PersistentBundleAdjuster::Solve(const BundleAdjustmentOptions& options,
+                                     const BundleAdjustmentConfig& config,
+                                     Reconstruction* reconstruction) {
+  COLMAP_TRACE_SCOPE("persistent_bundle_adjustment/solve");
+  THROW_CHECK_NOTNULL(reconstruction);
+  THROW_CHECK(options.Check());
+
+  if (problem_ && (reconstruction != reconstruction_ ||
+                   HaveDifferentProblemOptions(options, options_))) {
+    Reset();
+  }
+
+  options_ = options;
+  reconstruction_ = reconstruction;
+  num_added_residuals_ = 0;
+  num_removed_residuals_ = 0;
+
+  if (!problem_) {
+    ceres::Problem::Options problem_options;
+    problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    problem_options.enable_fast_removal = true;
+    problem_ = std::make_unique<ceres::Problem>(problem_options);
+    loss_function_.reset(options_.CreateLossFunction());
+  }
+
+  // Determine the observations of the problem in the same way as the
+  // BundleAdjuster and whether they have a constant pose.
+  std::unordered_map<uint64_t, bool> observations;
+  std::unordered_map<point3D_t, size_t> point3D_num_observations;
+  std::unordered_set<camera_t> camera_ids;
+  std::unordered_set<camera_t> constant_camera_ids;
+
+  for (const image_t image_id : config.Images()) {
+    Image& image = reconstruction->Image(image_id);
+
+    // CostFunction assumes unit quaternions.
+    image.CamFromWorld().rotation.normalize();
+
+    const bool constant_cam_pose =
+        !options_.refine_extrinsics || config.HasConstantCamPose(image_id);
+
+    size_t num_observations = 0;
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (!point2D.HasPoint3D()) {
+        continue;
+      }
+      num_observations += 1;
+      point3D_num_observations[point2D.point3D_id] += 1;
+      observations.emplace(ObservationKey(image_id, point2D_idx),
+                           constant_cam_pose);
+    }
+
+    if (num_observations > 0) {
+      camera_ids.insert(image.CameraId());
+    }
+  }
+
+  auto AddPointObservations = [&](const point3D_t point3D_id) {
+    const Point3D& point3D = reconstruction->Point3D(point3D_id);
+    size_t& num_observations = point3D_num_observations[point3D_id];
+    if (num_observations == point3D.track.Length()) {
+      return;
+    }
+    for (const auto& track_el : point3D.track.Elements()) {
+      if (config.HasImage(track_el.image_id)) {
+        continue;
+      }
+      num_observations += 1;
+      Image& image = reconstruction->Image(track_el.image_id);
+      image.CamFromWorld().rotation.normalize();
+      observations.emplace(
+          ObservationKey(track_el.image_id, track_el.point2D_idx), true);
+      // Do not refine the cameras of images outside of the configuration.
+      if (camera_ids.insert(image.CameraId()).second) {
+        constant_camera_ids.insert(image.CameraId());
+      }
+    }
+  };
+
+  for (const point3D_t point3D_id : config.VariablePoints()) {
+    AddPointObservations(point3D_id);
+  }
+  for (const point3D_t point3D_id : config.ConstantPoints()) {
+    AddPointObservations(point3D_id);
+  }
+
+  // Remove residuals that left the problem or that became outdated through
+  // changes of the reconstruction since the last call.
+  std::vector<const double*> removed_parameter_blocks;
+  for (auto it = residuals_.begin(); it != residuals_.end();) {
+    const auto observation_it = observations.find(it->first);
+    if (observation_it != observations.end() &&
+        IsResidualValid(it->first,
+                        it->second,
+                        observation_it->second,
+                        config,
+                        *reconstruction)) {
+      ++it;
+      continue;
+    }
+
+    problem_->RemoveResidualBlock(it->second.residual_block_id);
+    num_removed_residuals_ += 1;
+
+    removed_parameter_blocks.push_back(it->second.point3D_xyz);
+    removed_parameter_blocks.push_back(it->second.camera_params);
+    if (it->second.cam_from_world_rotation != nullptr) {
+      removed_parameter_blocks.push_back(it->second.cam_from_world_rotation);
+      const Image& image =
+          reconstruction->Image(ObservationKeyToImageId(it->first));
+      removed_parameter_blocks.push_back(
+          image.CamFromWorld().translation.data());
+    }
+
+    it = residuals_.erase(it);
+  }
+
+  // Remove unused parameters, as they may refer to deleted points.
+  std::sort(removed_parameter_blocks.begin(), removed_parameter_blocks.end());
+  removed_parameter_blocks.erase(std::unique(removed_parameter_blocks.begin(),
+                                             removed_parameter_blocks.end()),
+                                 removed_parameter_blocks.end());
+  for (const double* values : removed_parameter_blocks) {
+    RemoveParameterBlockIfUnused(values);
+  }
+
+  // Add the residuals that are not yet part of the problem.
+  for (const auto& observation : observations) {
+    if (residuals_.count(observation.first) == 0) {
+      AddResidual(observation.first,
+                  observation.second,
+                  options_,
+                  config,
+                  reconstruction);
+    }
+  }
+
+  if (problem_->NumResiduals() == 0) {
+    return false;
+  }
+
+  // Set the parameters constant or variable for the current configuration.
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  for (const camera_t camera_id : camera_ids) {
+    double* camera_params = reconstruction->Camera(camera_id).params.data();
+    if (constant_camera || config.HasConstantCamIntrinsics(camera_id) ||
+        constant_camera_ids.count(camera_id)) {
+      problem_->SetParameterBlockConstant(camera_params);
+    } else {
+      problem_->SetParameterBlockVariable(camera_params);
+    }
+  }
+
+  for (const auto& num_observations : point3D_num_observations) {
+    Point3D& point3D = reconstruction->Point3D(num_observations.first);
+    if (config.HasConstantPoint(num_observations.first) ||
+        point3D.track.Length() > num_observations.second) {
+      problem_->SetParameterBlockConstant(point3D.xyz.data());
+    } else {
+      problem_->SetParameterBlockVariable(point3D.xyz.data());
+    }
+  }
+
+  ceres::Solver::Options solver_options = options_.solver_options;
+  const bool has_sparse =
+      solver_options.sparse_linear_algebra_library_type != ceres::NO_SPARSE;
+
+  // Empirical choice.
+  const size_t kMaxNumImagesDirectDenseSolver = 50;
+  const size_t kMaxNumImagesDirectSparseSolver = 1000;
+  const size_t num_images = config.NumImages();
+  if (num_images <= kMaxNumImagesDirectDenseSolver) {
+    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
+  } else if (num_images <= kMaxNumImagesDirectSparseSolver && has_sparse) {
+    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {  // Indirect sparse (preconditioned CG) solver.
+    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
+    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
+  }
+
+  if (problem_->NumResiduals() <
+      options_.min_num_residuals_for_multi_threading) {
+    solver_options.num_threads = 1;
+#if CERES_VERSION_MAJOR < 2
+    solver_options.num_linear_solver_threads = 1;
+#endif  // CERES_VERSION_MAJOR
+  } else {
+    solver_options.num_threads =
+        GetEffectiveNumThreads(solver_options.num_threads);
+#if CERES_VERSION_MAJOR < 2
+    solver_options.num_linear_solver_threads =
+        GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
+#endif  // CERES_VERSION_MAJOR
+  }
+
+  std::string solver_error;
+  THROW_CHECK(solver_options.IsValid(&solver_error)) << solver_error;
+
+  ceres::Solve(solver_options, problem_.get(), &summary_);
+  TraceValue("bundle_adjustment/num_residuals", summary_.num_residuals_reduced);
+
+  if (options_.print_summary || VLOG_IS_ON(1)) {
+    PrintSolverSummary(summary_, "Bundle adjustment report");
+  }
+
+  return true;
+}
+
+void PersistentBundleAdjuster::Reset() {
+  problem_.reset();
+  loss_function_.reset();
+  reconstruction_ = nullptr;
+  residuals_.clear();
+  constant_cam_positions_.clear();
+}
+
+const ceres::Solver::Summary& PersistentBundleAdjuster::Summary() const {
+  return summary_;
+}
+
+size_t PersistentBundleAdjuster::NumAddedResiduals() const {
+  return num_added_residuals_;
+}
+
+size_t PersistentBundleAdjuster::NumRemovedResiduals() const {
+  return num_removed_residuals_;
+}
+
+bool PersistentBundleAdjuster::IsResidualValid(
+    const uint64_t observation_key,
+    const Residual& residual,
+    const bool constant_cam_pose,
+    const BundleAdjustmentConfig& config,
+    const Reconstruction& reconstruction) const {
+  const image_t image_id = ObservationKeyToImageId(observation_key);
+  const Image& image = reconstruction.Image(image_id);
+  const Point2D& point2D =
+      image.Point2D(ObservationKeyToPoint2DIdx(observation_key));
+
+  // The observation was re-triangulated or the point was deleted and its
+  // memory reused by another point.
+  if (point2D.point3D_id != residual.point3D_id ||
+      reconstruction.Point3D(point2D.point3D_id).xyz.data() !=
+          residual.point3D_xyz) {
+    return false;
+  }
+
+  if (reconstruction.Camera(image.CameraId()).params.data() !=
+      residual.camera_params) {
+    return false;
+  }
+
+  if (constant_cam_pose) {
+    // The pose is baked into the cost function.
+    return residual.cam_from_world_rotation == nullptr &&
+           residual.cam_from_world.rotation.coeffs() ==
+               image.CamFromWorld().rotation.coeffs() &&
+           residual.cam_from_world.translation ==
+               image.CamFromWorld().translation;
+  }
+
+  if (residual.cam_from_world_rotation !=
+      image.CamFromWorld().rotation.coeffs().data()) {
+    return false;
+  }
+
+  // The pose parameters must be re-added to change their manifold.
+  const std::vector<int> kNoConstantCamPositions;
+  const std::vector<int>& constant_cam_positions =
+      config.HasConstantCamPositions(image_id)
+          ? config.ConstantCamPositions(image_id)
+          : kNoConstantCamPositions;
+  return constant_cam_positions_.at(image_id) == constant_cam_positions;
+}
+
+void PersistentBundleAdjuster::AddResidual(
+    const uint64_t observation_key,
+    const bool constant_cam_pose,
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentConfig& config,
+    Reconstruction* reconstruction) {
+  const image_t image_id = ObservationKeyToImageId(observation_key);
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Point2D& point2D =
+      image.Point2D(ObservationKeyToPoint2DIdx(observation_key));
+  Point3D& point3D = reconstruction->Point3D(point2D.point3D_id);
+
+  double* cam_from_world_rotation =
+      image.CamFromWorld().rotation.coeffs().data();
+  double* cam_from_world_translation = image.CamFromWorld().translation.data();
+  double* camera_params = camera.params.data();
+
+  const bool is_new_camera = !problem_->HasParameterBlock(camera_params);
+  const bool is_new_pose =
+      !constant_cam_pose &&
+      !problem_->HasParameterBlock(cam_from_world_rotation);
+
+  Residual residual;
+  residual.point3D_id = point2D.point3D_id;
+  residual.point3D_xyz = point3D.xyz.data();
+  residual.camera_params = camera_params;
+  if (constant_cam_pose) {
+    residual.residual_block_id = problem_->AddResidualBlock(
+        CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
+            camera.model_id, image.CamFromWorld(), point2D.xy),
+        loss_function_.get(),
+        point3D.xyz.data(),
+        camera_params);
+    residual.cam_from_world_rotation = nullptr;
+    residual.cam_from_world = image.CamFromWorld();
+  } else {
+    residual.residual_block_id = problem_->AddResidualBlock(
+        CameraCostFunction<ReprojErrorCostFunction>(camera.model_id,
+                                                    point2D.xy),
+        loss_function_.get(),
+        cam_from_world_rotation,
+        cam_from_world_translation,
+        point3D.xyz.data(),
+        camera_params);
+    residual.cam_from_world_rotation = cam_from_world_rotation;
+  }
+
+  residuals_.emplace(observation_key, residual);
+  num_added_residuals_ += 1;
+
+  if (is_new_pose) {
+    SetQuaternionManifold(problem_.get(), cam_from_world_rotation);
+    std::vector<int>& constant_cam_positions =
+        constant_cam_positions_[image_id];
+    constant_cam_positions.clear();
+    if (config.HasConstantCamPositions(image_id)) {
+      constant_cam_positions = config.ConstantCamPositions(image_id);
+      SetSubsetManifold(3,
+                        constant_cam_positions,
+                        problem_.get(),
+                        cam_from_world_translation);
+    }
+  }
+
+  // Whether the camera is constant changes between calls, while the refined
+  // parameter groups are fixed for the lifetime of the problem.
+  if (is_new_camera) {
+    std::vector<int> const_camera_params;
+    if (!options.refine_focal_length) {
+      const span<const size_t> params_idxs = camera.FocalLengthIdxs();
+      const_camera_params.insert(
+          const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+    }
+    if (!options.refine_principal_point) {
+      const span<const size_t> params_idxs = camera.PrincipalPointIdxs();
+      const_camera_params.insert(
+          const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+    }
+    if (!options.refine_extra_params) {
+      const span<const size_t> params_idxs = camera.ExtraParamsIdxs();
+      const_camera_params.insert(
+          const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+    }
+
+    if (const_camera_params.size() > 0) {
+      SetSubsetManifold(static_cast<int>(camera.params.size()),
+                        const_camera_params,
+                        problem_.get(),
+                        camera_params);
+    }
+  }
+}
+
+void PersistentBundleAdjuster::RemoveParameterBlockIfUnused(
+    const double* values) {
+  if (!problem_->HasParameterBlock(values)) {
+    return;
+  }
+  std::vector<ceres::ResidualBlockId> residual_block_ids;
+  problem_->GetResidualBlocksForParameterBlock(values, &residual_block_ids);
+  if (residual_block_ids.empty()) {
+    problem_->RemoveParameterBlock(values);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PartitionedBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct BundleAdjustmentPartition {
+  // The images owned and refined by the partition.
+  std::vector<image_t> image_ids;
+  // All points observed by the owned images and the owned points, which
+  // are refined by the partition.
+  std::vector<point3D_t> point3D_ids;
+  std::unordered_set<point3D_t> owned_point3D_ids;
+  // Images of other partitions observing the owned points.
+  std::unordered_set<image_t> boundary_image_ids;
+  // Number of observations in the owned images per camera.
+  std::unordered_map<camera_t, size_t> camera_num_observations;
+  // Images with constant pose or constant x-position to fix the gauge.
+  std::vector<image_t> constant_pose_image_ids;
+  std::vector<image_t> constant_position_image_ids;
+};
+
+struct BundleAdjustmentPartitionSolution {
+  std::vector<image_t> image_ids;
+  std::vector<Rigid3d> cams_from_world;
+  std::vector<point3D_t> point3D_ids;
+  std::vector<Eigen::Vector3d> points3D;
+  std::vector<camera_t> camera_ids;
+  std::vector<std::vector<double>> camera_params;
+};
+
+// Solves one partition on a copy of the relevant part of the reconstruction,
+// such that partitions can be solved concurrently.
+BundleAdjustmentPartitionSolution SolveBundleAdjustmentPartition(
+    const BundleAdjustmentOptions& ba_options,
+    const BundleAdjustmentPartition& partition,
+    const Reconstruction& reconstruction) {
+  Reconstruction sub_reconstruction;
+  BundleAdjustmentConfig config;
+
+  std::unordered_set<camera_t> camera_ids;
+  auto AddImage = [&](const image_t image_id) {
+    const class Image& image = reconstruction.Image(image_id);
+    if (camera_ids.insert(image.CameraId()).second) {
+      sub_reconstruction.AddCamera(reconstruction.Camera(image.CameraId()));
+    }
+    sub_reconstruction.AddImage(image);
+  };
+
+  for (const image_t image_id : partition.image_ids) {
+    AddImage(image_id);
+    config.AddImage(image_id);
+  }
+  for (const image_t image_id : partition.boundary_image_ids) {
+    AddImage(image_id);
+  }
+
+  for (const point3D_t point3D_id : partition.point3D_ids) {
+    struct Point3D point3D = reconstruction.Point3D(point3D_id);
+    if (partition.owned_point3D_ids.count(point3D_id)) {
+      config.AddVariablePoint(point3D_id);
+    } else {
+      // Only keep the observations in the partition, such that the constant
+      // point does not pull in any other images.
+      std::vector<TrackElement> track_elements;
+      for (const auto& track_el : point3D.track.Elements()) {
+        if (config.HasImage(track_el.image_id)) {
+          track_elements.push_back(track_el);
+        }
+      }
+      point3D.track.SetElements(std::move(track_elements));
+      config.AddConstantPoint(point3D_id);
+    }
+    sub_reconstruction.AddPoint3D(point3D_id, std::move(point3D));
+  }
+
+  for (const image_t image_id : partition.constant_pose_image_ids) {
+    config.SetConstantCamPose(image_id);
+  }
+  for (const image_t image_id : partition.constant_position_image_ids) {
+    if (!config.HasConstantCamPose(image_id)) {
+      config.SetConstantCamPositions(image_id, {0});
+    }
+  }
+
+  BundleAdjustmentPartitionSolution solution;
+  BundleAdjuster bundle_adjuster(ba_options, config);
+  if (!bundle_adjuster.Solve(&sub_reconstruction)) {
+    return solution;
+  }
+
+  solution.image_ids = partition.image_ids;
+  solution.cams_from_world.reserve(partition.image_ids.size());
+  for (const image_t image_id : partition.image_ids) {
+    solution.cams_from_world.push_back(
+        sub_reconstruction.Image(image_id).CamFromWorld());
+  }
+
+  solution.point3D_ids.reserve(partition.owned_point3D_ids.size());
+  solution.points3D.reserve(partition.owned_point3D_ids.size());
+  for (const point3D_t point3D_id : partition.owned_point3D_ids) {
+    solution.point3D_ids.push_back(point3D_id);
+    solution.points3D.push_back(sub_reconstruction.Point3D(point3D_id).xyz);
+  }
+
+  for (const auto& camera_num_observations :
+       partition.camera_num_observations) {
+    solution.camera_ids.push_back(camera_num_observations.first);
+    solution.camera_params.push_back(
+        sub_reconstruction.Camera(camera_num_observations.first).params);
+  }
+
+  return solution;
+}
+
+}  // namespace
+
+bool PartitionedBundleAdjuster::Options::Check() const {
+  CHECK_OPTION_GT(num_iterations, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  return true;
+}
+
+PartitionedBundleAdjuster::PartitionedBundleAdjuster(
+    const BundleAdjustmentOptions& ba_options,
+    const Options& options,
+    std::vector<std::vector<image_t>> partitions)
+    : ba_options_(ba_options),
+      options_(options),
+      partitions_(std::move(partitions)) {
+  THROW_CHECK(ba_options_.Check());
+  THROW_CHECK(options_.Check());
+}
+
+bool PartitionedBundleAdjuster::Solve(Reconstruction* reconstruction) {
+  COLMAP_TRACE_SCOPE("partitioned_bundle_adjustment/solve");
+  THROW_CHECK_NOTNULL(reconstruction);
+
+  const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
+  THROW_CHECK_GE(reg_image_ids.size(), 2) << "At least two images must be "
+                                             "registered for global "
+                                             "bundle-adjustment";
+
+  // Assign every registered image to exactly one partition.
+  std::vector<BundleAdjustmentPartition> partitions;
+  std::unordered_map<image_t, int> image_id_to_partition;
+  image_id_to_partition.reserve(reg_image_ids.size());
+  auto AddPartition = [&](const std::vector<image_t>& image_ids) {
+    BundleAdjustmentPartition partition;
+    for (const image_t image_id : image_ids) {
+      if (reconstruction->ExistsImage(image_id) &&
+          reconstruction->Image(image_id).IsRegistered() &&
+          image_id_to_partition.emplace(image_id, partitions.size()).second) {
+        partition.image_ids.push_back(image_id);
+      }
+    }
+    if (!partition.image_ids.empty()) {
+      partitions.push_back(std::move(partition));
+    }
+  };
+  for (const auto& image_ids : partitions_) {
+    AddPartition(image_ids);
+  }
+  AddPartition(reg_image_ids);
+
+  // Determine the points of every partition and their owners.
+  std::vector<std::pair<int, size_t>> partition_num_observations;
+  for (const auto& point3D : reconstruction->Points3D()) {
+    partition_num_observations.clear();
+    for (const auto& track_el : point3D.second.track.Elements()) {
+      const auto it = image_id_to_partition.find(track_el.image_id);
+      if (it == image_id_to_partition.end()) {
+        continue;
+      }
+      auto num_observations_it =
+          std::find_if(partition_num_observations.begin(),
+                       partition_num_observations.end(),
+                       [&it](const std::pair<int, size_t>& num_observations) {
+                         return num_observations.first == it->second;
+                       });
+      if (num_observations_it == partition_num_observations.end()) {
+        partition_num_observations.emplace_back(it->second, 1);
+      } else {
+        num_observations_it->second += 1;
+      }
+    }
+
+    if (partition_num_observations.empty()) {
+      continue;
+    }
+
+    int owner = partition_num_observations[0].first;
+    size_t owner_num_observations = partition_num_observations[0].second;
+    for (const auto& num_observations : partition_num_observations) {
+      partitions[num_observations.first].point3D_ids.push_back(point3D.first);
+      if (num_observations.second > owner_num_observations ||
+          (num_observations.second == owner_num_observations &&
+           num_observations.first < owner)) {
+        owner = num_observations.first;
+        owner_num_observations = num_observations.second;
+      }
+    }
+
+    BundleAdjustmentPartition& owner_partition = partitions[owner];
+    owner_partition.owned_point3D_ids.insert(point3D.first);
+    for (const auto& track_el : point3D.second.track.Elements()) {
+      const auto it = image_id_to_partition.find(track_el.image_id);
+      if (it == image_id_to_partition.end() || it->second != owner) {
+        owner_partition.boundary_image_ids.insert(track_el.image_id);
+      }
+    }
+  }
+
+  // Fix 7-DOFs of the overall problem as in the global bundle adjustment.
+  // Partitions without any connection to the others need their own gauge.
+  for (auto& partition : partitions) {
+    for (const image_t image_id : partition.image_ids) {
+      const Image& image = reconstruction->Image(image_id);
+      partition.camera_num_observations[image.CameraId()] +=
+          image.NumPoints3D();
+    }
+    const bool is_connected =
+        !partition.boundary_image_ids.empty() ||
+        partition.owned_point3D_ids.size() < partition.point3D_ids.size();
+    if (!is_connected) {
+      partition.constant_pose_image_ids.push_back(partition.image_ids[0]);
+      if (partition.image_ids.size() > 1) {
+        partition.constant_position_image_ids.push_back(
+            partition.image_ids[1]);
+      }
+    }
+  }
+  partitions[image_id_to_partition.at(reg_image_ids[0])]
+      .constant_pose_image_ids.push_back(reg_image_ids[0]);
+  partitions[image_id_to_partition.at(reg_image_ids[1])]
+      .constant_position_image_ids.push_back(reg_image_ids[1]);
+
+  // Distribute the available threads over the concurrently solved partitions.
+  const int num_eff_threads = GetEffectiveNumThreads(options_.num_threads);
+  const int num_workers =
+      std::min(num_eff_threads, static_cast<int>(partitions.size()));
+  BundleAdjustmentOptions partition_ba_options = ba_options_;
+  partition_ba_options.print_summary = false;
+  partition_ba_options.solver_options.num_threads =
+      std::max(1, num_eff_threads / num_workers);
+#if CERES_VERSION_MAJOR < 2
+  partition_ba_options.solver_options.num_linear_solver_threads =
+      partition_ba_options.solver_options.num_threads;
+#endif  // CERES_VERSION_MAJOR
+
+  LOG(INFO) << StringPrintf(
+      "Partitioned bundle adjustment with %d partitions on %d workers",
+      partitions.size(),
+      num_workers);
+
+  ThreadPool thread_pool(num_workers);
+
+  bool success = false;
+  for (int iteration = 0; iteration < options_.num_iterations; ++iteration) {
+    std::vector<std::future<BundleAdjustmentPartitionSolution>> futures;
+    futures.reserve(partitions.size());
+    for (const auto& partition : partitions) {
+      futures.push_back(thread_pool.AddTask([&]() {
+        return SolveBundleAdjustmentPartition(
+            partition_ba_options, partition, *reconstruction);
+      }));
+    }
+
+    // Wait for all partitions before writing back, since the partitions read
+    // the shared separator parameters from the reconstruction.
+    std::vector<BundleAdjustmentPartitionSolution> solutions;
+    solutions.reserve(futures.size());
+    for (auto& future : futures) {
+      solutions.push_back(future.get());
+    }
+
+    // Average the intrinsics of shared cameras weighted by the number of
+    // observations of the camera in each partition. Partitions that failed to
+    // solve do not contribute to the average.
+    std::unordered_map<camera_t, std::vector<double>> camera_params_sums;
+    std::unordered_map<camera_t, double> camera_weight_sums;
+    for (size_t i = 0; i < solutions.size(); ++i) {
+      const BundleAdjustmentPartitionSolution& solution = solutions[i];
+      if (solution.image_ids.empty()) {
+        continue;
+      }
+
+      success = true;
+
+      for (size_t j = 0; j < solution.image_ids.size(); ++j) {
+        reconstruction->Image(solution.image_ids[j]).CamFromWorld() =
+            solution.cams_from_world[j];
+      }
+
+      for (size_t j = 0; j < solution.point3D_ids.size(); ++j) {
+        reconstruction->Point3D(solution.point3D_ids[j]).xyz =
+            solution.points3D[j];
+      }
+
+      for (size_t j = 0; j < solution.camera_ids.size(); ++j) {
+        const camera_t camera_id = solution.camera_ids[j];
+        const double weight = static_cast<double>(
+            partitions[i].camera_num_observations.at(camera_id));
+        camera_weight_sums[camera_id] += weight;
+        std::vector<double>& params_sum = camera_params_sums[camera_id];
+        params_sum.resize(solution.camera_params[j].size(), 0.0);
+        for (size_t k = 0; k < params_sum.size(); ++k) {
+          params_sum[k] += weight * solution.camera_params[j][k];
+        }
+      }
+    }
+
+    for (auto& params_sum : camera_params_sums) {
+      const double weight_sum = camera_weight_sums.at(params_sum.first);
+      if (weight_sum == 0) {
+        continue;
+      }
+      for (double& param : params_sum.second) {
+        param /= weight_sum;
+      }
+      reconstruction->Camera(params_sum.first).params =
+          std::move(params_sum.second);
+    }
+
+    if (ba_options_.print_summary || VLOG_IS_ON(1)) {
+      reconstruction->UpdatePoint3DErrors();
+      LOG(INFO) << StringPrintf(
+          "Partitioned bundle adjustment iteration %d: %f [px]",
+          iteration + 1,
+          reconstruction->ComputeMeanReprojectionError());
+    }
+  }
+
+  return success;
+}
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header) {
   std::ostringstream log;
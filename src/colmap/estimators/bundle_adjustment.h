@@ -256,6 +256,107 @@ class RigBundleAdjuster : public BundleAdjuster {
   std::unordered_set<double*> parameterized_quats_;
 };
 
+// Bundle adjuster that keeps its Ceres problem alive across calls to `Solve`.
+// Every call sets up the same problem as `BundleAdjuster` for the given
+// configuration, but only the residuals of observations that entered or left
+// the configuration since the previous call are added or removed, which
+// avoids rebuilding the entire problem for heavily overlapping configurations
+// as in incremental local bundle adjustment. Modifications of the
+// reconstruction in between calls, e.g., deleted points or changed poses of
+// constant images, are detected and the affected residuals are replaced.
+class PersistentBundleAdjuster {
+ public:
+  bool Solve(const BundleAdjustmentOptions& options,
+             const BundleAdjustmentConfig& config,
+             Reconstruction* reconstruction);
+
+  // Remove all residuals and parameters from the problem. Must be called
+  // before the reconstruction is destroyed and another one is adjusted.
+  void Reset();
+
+  // Get the Ceres solver summary for the last call to `Solve`.
+  const ceres::Solver::Summary& Summary() const;
+
+  // Number of residuals added and removed in the last call to `Solve`.
+  size_t NumAddedResiduals() const;
+  size_t NumRemovedResiduals() const;
+
+ private:
+  struct Residual {
+    ceres::ResidualBlockId residual_block_id;
+    point3D_t point3D_id;
+    const double* point3D_xyz;
+    const double* camera_params;
+    // Only set for residuals with variable pose.
+    const double* cam_from_world_rotation;
+    // Only set for residuals with constant pose.
+    Rigid3d cam_from_world;
+  };
+
+  bool IsResidualValid(uint64_t observation_key,
+                       const Residual& residual,
+                       bool constant_cam_pose,
+                       const BundleAdjustmentConfig& config,
+                       const Reconstruction& reconstruction) const;
+
+  void AddResidual(uint64_t observation_key,
+                   bool constant_cam_pose,
+                   const BundleAdjustmentOptions& options,
+                   const BundleAdjustmentConfig& config,
+                   Reconstruction* reconstruction);
+
+  void RemoveParameterBlockIfUnused(const double* values);
+
+  std::unique_ptr<ceres::Problem> problem_;
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+  BundleAdjustmentOptions options_;
+  const Reconstruction* reconstruction_ = nullptr;
+  ceres::Solver::Summary summary_;
+  // Residual for each observation in the problem.
+  std::unordered_map<uint64_t, Residual> residuals_;
+  // Constant position indices of variable pose parameters in the problem.
+  std::unordered_map<image_t, std::vector<int>> constant_cam_positions_;
+  size_t num_added_residuals_ = 0;
+  size_t num_removed_residuals_ = 0;
+};
+
+// Bundle adjustment of large reconstructions by partitioning the registered
+// images into disjoint blocks, which are solved in parallel. Each block refines
+// the poses of its images, the points observed only by its images, and the
+// separator points it owns, i.e., the points shared with other blocks for
+// which it has the most observations. Observations of owned separator points
+// in other blocks enter as constant-pose residuals, while the remaining
+// separator points are held constant. The blocks are solved repeatedly in a
+// block-Jacobi fashion, and the intrinsics of cameras shared between blocks
+// are reconciled after each iteration by averaging them, weighted by each
+// block's number of observations in the camera's images.
+class PartitionedBundleAdjuster {
+ public:
+  struct Options {
+    // The number of iterations over all blocks.
+    int num_iterations = 3;
+
+    // The number of blocks solved in parallel.
+    int num_threads = -1;
+
+    bool Check() const;
+  };
+
+  // Every registered image is assigned to the first given partition that
+  // contains it. Registered images not contained in any partition are
+  // grouped into an additional partition.
+  PartitionedBundleAdjuster(const BundleAdjustmentOptions& ba_options,
+                            const Options& options,
+                            std::vector<std::vector<image_t>> partitions);
+
+  bool Solve(Reconstruction* reconstruction);
+
+ private:
+  const BundleAdjustmentOptions ba_options_;
+  const Options options_;
+  const std::vector<std::vector<image_t>> partitions_;
+};
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header);
 
@@ -847,5 +847,139 @@ TEST(BundleAdjustment, RigFourViewPartial) {
   }
 }
 
+TEST(PartitionedBundleAdjuster, TwoPartitions) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(6, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  reconstruction.UpdatePoint3DErrors();
+  const double orig_mean_reproj_error =
+      reconstruction.ComputeMeanReprojectionError();
+
+  BundleAdjustmentOptions options;
+  PartitionedBundleAdjuster::Options partitioned_options;
+  partitioned_options.num_iterations = 2;
+  partitioned_options.num_threads = 2;
+  PartitionedBundleAdjuster bundle_adjuster(
+      options, partitioned_options, {{0, 1, 2}, {3, 4, 5}});
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  // The first image fixes the gauge of the whole problem.
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+  for (image_t image_id = 2; image_id < 6; ++image_id) {
+    CheckVariableImage(reconstruction.Image(image_id),
+                       orig_reconstruction.Image(image_id));
+  }
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+
+  reconstruction.UpdatePoint3DErrors();
+  EXPECT_LT(reconstruction.ComputeMeanReprojectionError(),
+            orig_mean_reproj_error);
+}
+
+TEST(PartitionedBundleAdjuster, UnpartitionedImages) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(4, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  // Images missing from the partitions are refined in an extra partition and
+  // images contained in multiple partitions are assigned to the first one.
+  BundleAdjustmentOptions options;
+  PartitionedBundleAdjuster::Options partitioned_options;
+  PartitionedBundleAdjuster bundle_adjuster(
+      options, partitioned_options, {{0, 1}, {1}});
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+  CheckVariableImage(reconstruction.Image(2), orig_reconstruction.Image(2));
+  CheckVariableImage(reconstruction.Image(3), orig_reconstruction.Image(3));
+}
+
+TEST(PersistentBundleAdjuster, UpdateConfig) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(4, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  PersistentBundleAdjuster bundle_adjuster;
+
+  auto CheckSameProblem = [&]() {
+    Reconstruction orig_reconstruction = reconstruction;
+    BundleAdjuster orig_bundle_adjuster(options, config);
+    ASSERT_TRUE(orig_bundle_adjuster.Solve(&orig_reconstruction));
+    ASSERT_TRUE(bundle_adjuster.Solve(options, config, &reconstruction));
+    EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced,
+              orig_bundle_adjuster.Summary().num_residuals_reduced);
+    EXPECT_EQ(bundle_adjuster.Summary().num_effective_parameters_reduced,
+              orig_bundle_adjuster.Summary().num_effective_parameters_reduced);
+  };
+
+  CheckSameProblem();
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 300);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 0);
+
+  // Only the observations of the new image are added.
+  config.AddImage(3);
+  CheckSameProblem();
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 100);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 0);
+
+  // Observations of images that become constant are replaced.
+  config.SetConstantCamPose(3);
+  CheckSameProblem();
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 100);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 100);
+
+  // Observations of removed images are removed.
+  config.RemoveImage(3);
+  CheckSameProblem();
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 0);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 100);
+}
+
+TEST(PersistentBundleAdjuster, UpdateReconstruction) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+  config.AddVariablePoint(1);
+
+  BundleAdjustmentOptions options;
+  PersistentBundleAdjuster bundle_adjuster;
+  ASSERT_TRUE(bundle_adjuster.Solve(options, config, &reconstruction));
+  // 2 x 100 observations in the images, 1 observation of the point in the
+  // image outside of the configuration.
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 201);
+
+  // Deleted points are removed from the problem.
+  reconstruction.DeletePoint3D(2);
+  ASSERT_TRUE(bundle_adjuster.Solve(options, config, &reconstruction));
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 0);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 2);
+  EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced, 2 * 199);
+
+  // Changed poses of images outside of the configuration are updated.
+  reconstruction.Image(2).CamFromWorld().translation.x() += 0.1;
+  ASSERT_TRUE(bundle_adjuster.Solve(options, config, &reconstruction));
+  EXPECT_EQ(bundle_adjuster.NumAddedResiduals(), 1);
+  EXPECT_EQ(bundle_adjuster.NumRemovedResiduals(), 1);
+}
+
 }  // namespace
 }  // namespace colmap
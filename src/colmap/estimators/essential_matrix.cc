@@ -158,6 +158,16 @@ void EssentialMatrixFivePointEstimator::Residuals(
   ComputeSquaredSampsonError(points1, points2, E, residuals);
 }
 
+void EssentialMatrixFivePointEstimator::Residuals(
+    const XBatch_t& points1,
+    const YBatch_t& points2,
+    const M_t& E,
+    const size_t begin,
+    const size_t end,
+    std::vector<double>* residuals) {
+  ComputeSquaredSampsonError(points1, points2, E, begin, end, residuals);
+}
+
 void EssentialMatrixEightPointEstimator::Estimate(
     const std::vector<X_t>& points1,
     const std::vector<Y_t>& points2,
@@ -218,4 +228,14 @@ void EssentialMatrixEightPointEstimator::Residuals(
   ComputeSquaredSampsonError(points1, points2, E, residuals);
 }
 
+void EssentialMatrixEightPointEstimator::Residuals(
+    const XBatch_t& points1,
+    const YBatch_t& points2,
+    const M_t& E,
+    const size_t begin,
+    const size_t end,
+    std::vector<double>* residuals) {
+  ComputeSquaredSampsonError(points1, points2, E, begin, end, residuals);
+}
+
 }  // namespace colmap
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include "colmap/estimators/utils.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
@@ -51,6 +52,9 @@ class EssentialMatrixFivePointEstimator {
   typedef Eigen::Vector2d X_t;
   typedef Eigen::Vector2d Y_t;
   typedef Eigen::Matrix3d M_t;
+  // Structure-of-arrays layout of the corresponding points.
+  typedef Point2DArray XBatch_t;
+  typedef Point2DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 5;
@@ -81,6 +85,15 @@ class EssentialMatrixFivePointEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& E,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points1,
+                        const YBatch_t& points2,
+                        const M_t& E,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 // Essential matrix estimator from corresponding normalized point pairs.
@@ -93,6 +106,9 @@ class EssentialMatrixEightPointEstimator {
   typedef Eigen::Vector2d X_t;
   typedef Eigen::Vector2d Y_t;
   typedef Eigen::Matrix3d M_t;
+  // Structure-of-arrays layout of the corresponding points.
+  typedef Point2DArray XBatch_t;
+  typedef Point2DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 8;
@@ -120,6 +136,15 @@ class EssentialMatrixEightPointEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& E,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points1,
+                        const YBatch_t& points2,
+                        const M_t& E,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 }  // namespace colmap
@@ -150,6 +150,16 @@ void FundamentalMatrixSevenPointEstimator::Residuals(
   ComputeSquaredSampsonError(points1, points2, F, residuals);
 }
 
+void FundamentalMatrixSevenPointEstimator::Residuals(
+    const XBatch_t& points1,
+    const YBatch_t& points2,
+    const M_t& F,
+    const size_t begin,
+    const size_t end,
+    std::vector<double>* residuals) {
+  ComputeSquaredSampsonError(points1, points2, F, begin, end, residuals);
+}
+
 void FundamentalMatrixEightPointEstimator::Estimate(
     const std::vector<X_t>& points1,
     const std::vector<Y_t>& points2,
@@ -205,4 +215,14 @@ void FundamentalMatrixEightPointEstimator::Residuals(
   ComputeSquaredSampsonError(points1, points2, E, residuals);
 }
 
+void FundamentalMatrixEightPointEstimator::Residuals(
+    const XBatch_t& points1,
+    const YBatch_t& points2,
+    const M_t& F,
+    const size_t begin,
+    const size_t end,
+    std::vector<double>* residuals) {
+  ComputeSquaredSampsonError(points1, points2, F, begin, end, residuals);
+}
+
 }  // namespace colmap
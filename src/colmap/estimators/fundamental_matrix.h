@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/estimators/homography_matrix.h"
+#include "colmap/estimators/utils.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
@@ -52,6 +53,9 @@ class FundamentalMatrixSevenPointEstimator {
   typedef Eigen::Vector2d X_t;
   typedef Eigen::Vector2d Y_t;
   typedef Eigen::Matrix3d M_t;
+  // Structure-of-arrays layout of the corresponding points.
+  typedef Point2DArray XBatch_t;
+  typedef Point2DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 7;
@@ -82,6 +86,15 @@ class FundamentalMatrixSevenPointEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& F,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points1,
+                        const YBatch_t& points2,
+                        const M_t& F,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 // Fundamental matrix estimator from corresponding point pairs.
@@ -94,6 +107,9 @@ class FundamentalMatrixEightPointEstimator {
   typedef Eigen::Vector2d X_t;
   typedef Eigen::Vector2d Y_t;
   typedef Eigen::Matrix3d M_t;
+  // Structure-of-arrays layout of the corresponding points.
+  typedef Point2DArray XBatch_t;
+  typedef Point2DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 8;
@@ -123,6 +139,15 @@ class FundamentalMatrixEightPointEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& F,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points1,
+                        const YBatch_t& points2,
+                        const M_t& F,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 }  // namespace colmap
@@ -132,4 +132,13 @@ void HomographyMatrixEstimator::Residuals(const std::vector<X_t>& points1,
   }
 }
 
+void HomographyMatrixEstimator::Residuals(const XBatch_t& points1,
+                                          const YBatch_t& points2,
+                                          const M_t& H,
+                                          const size_t begin,
+                                          const size_t end,
+                                          std::vector<double>* residuals) {
+  ComputeSquaredTransferError(points1, points2, H, begin, end, residuals);
+}
+
 }  // namespace colmap
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include "colmap/estimators/utils.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
@@ -46,6 +47,9 @@ class HomographyMatrixEstimator {
   typedef Eigen::Vector2d X_t;
   typedef Eigen::Vector2d Y_t;
   typedef Eigen::Matrix3d M_t;
+  // Structure-of-arrays layout of the corresponding points.
+  typedef Point2DArray XBatch_t;
+  typedef Point2DArray YBatch_t;
 
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 4;
@@ -75,6 +79,15 @@ class HomographyMatrixEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& H,
                         std::vector<double>* residuals);
+
+  // Vectorized residual computation for the range [begin, end), which
+  // leaves the remaining entries of the residuals untouched.
+  static void Residuals(const XBatch_t& points1,
+                        const YBatch_t& points2,
+                        const M_t& H,
+                        size_t begin,
+                        size_t end,
+                        std::vector<double>* residuals);
 };
 
 }  // namespace colmap
@@ -63,6 +63,11 @@ struct AbsolutePoseEstimationOptions {
   // Number of threads for parallel estimation of focal length.
   int num_threads = ThreadPool::kMaxNumThreads;
 
+  // Whether to sample the minimal sets with PROSAC instead of uniformly at
+  // random. PROSAC assumes that the 2D-3D correspondences are ordered by
+  // decreasing quality.
+  bool use_prosac = false;
+
   // Options used for P3P RANSAC.
   RANSACOptions ransac_options;
 
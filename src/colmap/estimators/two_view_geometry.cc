@@ -39,6 +39,7 @@
 #include "colmap/geometry/triangulation.h"
 #include "colmap/math/random.h"
 #include "colmap/optim/loransac.h"
+#include "colmap/optim/progressive_sampler.h"
 #include "colmap/optim/ransac.h"
 #include "colmap/scene/camera.h"
 
@@ -47,6 +48,33 @@
 namespace colmap {
 namespace {
 
+// Robustly estimate a model from the corresponding points with LO-RANSAC,
+// either with random sampling or with PROSAC, which assumes that the
+// correspondences are ordered by decreasing match quality.
+template <typename Estimator, typename LocalEstimator>
+typename LORANSAC<Estimator, LocalEstimator>::Report EstimateLORANSAC(
+    const TwoViewGeometryOptions& options,
+    const RANSACOptions& ransac_options,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  if (!options.use_prosac) {
+    LORANSAC<Estimator, LocalEstimator> ransac(ransac_options);
+    return ransac.Estimate(X, Y);
+  }
+
+  LORANSAC<Estimator, LocalEstimator, InlierSupportMeasurer, ProgressiveSampler>
+      ransac(ransac_options);
+  auto prosac_report = ransac.Estimate(X, Y);
+
+  typename LORANSAC<Estimator, LocalEstimator>::Report report;
+  report.success = prosac_report.success;
+  report.num_trials = prosac_report.num_trials;
+  report.support = prosac_report.support;
+  report.inlier_mask = std::move(prosac_report.inlier_mask);
+  report.model = prosac_report.model;
+  return report;
+}
+
 FeatureMatches ExtractInlierMatches(const FeatureMatches& matches,
                                     const size_t num_inliers,
                                     const std::vector<char>& inlier_mask) {
@@ -118,9 +146,9 @@ TwoViewGeometry EstimateCalibratedHomography(
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options, options.ransac_options, matched_points1, matched_points2);
   geometry.H = H_report.model;
 
   if (!H_report.success || H_report.support.num_inliers < min_num_inliers) {
@@ -174,17 +202,17 @@ TwoViewGeometry EstimateUncalibratedTwoViewGeometry(
 
   // Estimate epipolar model.
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
+  const auto F_report =
+      EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                       FundamentalMatrixEightPointEstimator>(
+          options, options.ransac_options, matched_points1, matched_points2);
   geometry.F = F_report.model;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options, options.ransac_options, matched_points1, matched_points2);
   geometry.H = H_report.model;
 
   if ((!F_report.success && !H_report.success) ||
@@ -449,23 +477,26 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
        camera2.CamFromImgThreshold(options.ransac_options.max_error)) /
       2;
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      E_ransac(E_ransac_options);
   const auto E_report =
-      E_ransac.Estimate(matched_points1_normalized, matched_points2_normalized);
+      EstimateLORANSAC<EssentialMatrixFivePointEstimator,
+                       EssentialMatrixFivePointEstimator>(
+          options,
+          E_ransac_options,
+          matched_points1_normalized,
+          matched_points2_normalized);
   geometry.E = E_report.model;
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
+  const auto F_report =
+      EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                       FundamentalMatrixEightPointEstimator>(
+          options, options.ransac_options, matched_points1, matched_points2);
   geometry.F = F_report.model;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options, options.ransac_options, matched_points1, matched_points2);
   geometry.H = H_report.model;
 
   if ((!E_report.success && !F_report.success && !H_report.success) ||
@@ -94,6 +94,12 @@ struct TwoViewGeometryOptions {
   // field will be initialized.
   bool multiple_models = false;
 
+  // Whether to sample the minimal sets with PROSAC instead of uniformly at
+  // random. PROSAC assumes that the matches are ordered by decreasing quality,
+  // see `SortFeatureMatchesByDescriptorDistance`, and typically requires
+  // much fewer trials for low inlier ratios.
+  bool use_prosac = false;
+
   // TwoViewGeometryOptions used to robustly estimate the geometry.
   RANSACOptions ransac_options;
 
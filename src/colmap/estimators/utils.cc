@@ -34,7 +34,257 @@
 
 #include <Eigen/Geometry>
 
+#if defined(COLMAP_SIMD_ENABLED) &&                  \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define COLMAP_ESTIMATORS_X86_KERNELS
+#include <immintrin.h>
+#define COLMAP_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
 namespace colmap {
+namespace {
+
+bool IsAVX2Supported() {
+#if defined(COLMAP_ESTIMATORS_X86_KERNELS)
+  static const bool is_supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return is_supported;
+#else
+  return false;
+#endif
+}
+
+void ComputeSquaredSampsonErrorPortable(const Point2DArray& points1,
+                                        const Point2DArray& points2,
+                                        const Eigen::Matrix3d& E,
+                                        const size_t begin,
+                                        const size_t end,
+                                        double* residuals) {
+  for (size_t i = begin; i < end; ++i) {
+    const double x1 = points1.x[i];
+    const double y1 = points1.y[i];
+    const double x2 = points2.x[i];
+    const double y2 = points2.y[i];
+    const double line_x = E(0, 0) * x1 + E(0, 1) * y1 + E(0, 2);
+    const double line_y = E(1, 0) * x1 + E(1, 1) * y1 + E(1, 2);
+    const double line_z = E(2, 0) * x1 + E(2, 1) * y1 + E(2, 2);
+    const double num = x2 * line_x + y2 * line_y + line_z;
+    const double denom_x = x2 * E(0, 0) + y2 * E(1, 0) + E(2, 0);
+    const double denom_y = x2 * E(0, 1) + y2 * E(1, 1) + E(2, 1);
+    residuals[i] = num * num / (denom_x * denom_x + denom_y * denom_y +
+                                line_x * line_x + line_y * line_y);
+  }
+}
+
+void ComputeSquaredReprojectionErrorPortable(
+    const Point2DArray& points2D,
+    const Point3DArray& points3D,
+    const Eigen::Matrix3x4d& cam_from_world,
+    const size_t begin,
+    const size_t end,
+    double* residuals) {
+  const Eigen::Matrix3x4d& P = cam_from_world;
+  for (size_t i = begin; i < end; ++i) {
+    const double X = points3D.x[i];
+    const double Y = points3D.y[i];
+    const double Z = points3D.z[i];
+    const double pz = P(2, 0) * X + P(2, 1) * Y + P(2, 2) * Z + P(2, 3);
+    // Check if 3D point is in front of camera.
+    if (pz > std::numeric_limits<double>::epsilon()) {
+      const double px = P(0, 0) * X + P(0, 1) * Y + P(0, 2) * Z + P(0, 3);
+      const double py = P(1, 0) * X + P(1, 1) * Y + P(1, 2) * Z + P(1, 3);
+      const double inv_pz = 1.0 / pz;
+      const double dx = px * inv_pz - points2D.x[i];
+      const double dy = py * inv_pz - points2D.y[i];
+      residuals[i] = dx * dx + dy * dy;
+    } else {
+      residuals[i] = std::numeric_limits<double>::max();
+    }
+  }
+}
+
+void ComputeSquaredTransferErrorPortable(const Point2DArray& points1,
+                                         const Point2DArray& points2,
+                                         const Eigen::Matrix3d& H,
+                                         const size_t begin,
+                                         const size_t end,
+                                         double* residuals) {
+  for (size_t i = begin; i < end; ++i) {
+    const double x1 = points1.x[i];
+    const double y1 = points1.y[i];
+    const double pd_0 = H(0, 0) * x1 + H(0, 1) * y1 + H(0, 2);
+    const double pd_1 = H(1, 0) * x1 + H(1, 1) * y1 + H(1, 2);
+    const double pd_2 = H(2, 0) * x1 + H(2, 1) * y1 + H(2, 2);
+    const double inv_pd_2 = 1.0 / pd_2;
+    const double dd_0 = points2.x[i] - pd_0 * inv_pd_2;
+    const double dd_1 = points2.y[i] - pd_1 * inv_pd_2;
+    residuals[i] = dd_0 * dd_0 + dd_1 * dd_1;
+  }
+}
+
+#if defined(COLMAP_ESTIMATORS_X86_KERNELS)
+
+// The AVX2 kernels process four points per iteration and leave the remaining
+// points to the portable kernels.
+
+COLMAP_TARGET_AVX2 size_t
+ComputeSquaredSampsonErrorAVX2(const Point2DArray& points1,
+                               const Point2DArray& points2,
+                               const Eigen::Matrix3d& E,
+                               const size_t begin,
+                               const size_t end,
+                               double* residuals) {
+  const __m256d e00 = _mm256_set1_pd(E(0, 0));
+  const __m256d e01 = _mm256_set1_pd(E(0, 1));
+  const __m256d e02 = _mm256_set1_pd(E(0, 2));
+  const __m256d e10 = _mm256_set1_pd(E(1, 0));
+  const __m256d e11 = _mm256_set1_pd(E(1, 1));
+  const __m256d e12 = _mm256_set1_pd(E(1, 2));
+  const __m256d e20 = _mm256_set1_pd(E(2, 0));
+  const __m256d e21 = _mm256_set1_pd(E(2, 1));
+  const __m256d e22 = _mm256_set1_pd(E(2, 2));
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m256d x1 = _mm256_loadu_pd(points1.x.data() + i);
+    const __m256d y1 = _mm256_loadu_pd(points1.y.data() + i);
+    const __m256d x2 = _mm256_loadu_pd(points2.x.data() + i);
+    const __m256d y2 = _mm256_loadu_pd(points2.y.data() + i);
+    const __m256d line_x =
+        _mm256_fmadd_pd(e00, x1, _mm256_fmadd_pd(e01, y1, e02));
+    const __m256d line_y =
+        _mm256_fmadd_pd(e10, x1, _mm256_fmadd_pd(e11, y1, e12));
+    const __m256d line_z =
+        _mm256_fmadd_pd(e20, x1, _mm256_fmadd_pd(e21, y1, e22));
+    const __m256d num =
+        _mm256_fmadd_pd(x2, line_x, _mm256_fmadd_pd(y2, line_y, line_z));
+    const __m256d denom_x =
+        _mm256_fmadd_pd(x2, e00, _mm256_fmadd_pd(y2, e10, e20));
+    const __m256d denom_y =
+        _mm256_fmadd_pd(x2, e01, _mm256_fmadd_pd(y2, e11, e21));
+    const __m256d denom = _mm256_fmadd_pd(
+        denom_x,
+        denom_x,
+        _mm256_fmadd_pd(denom_y,
+                        denom_y,
+                        _mm256_fmadd_pd(
+                            line_x, line_x, _mm256_mul_pd(line_y, line_y))));
+    _mm256_storeu_pd(residuals + i,
+                     _mm256_div_pd(_mm256_mul_pd(num, num), denom));
+  }
+
+  return i;
+}
+
+COLMAP_TARGET_AVX2 size_t
+ComputeSquaredReprojectionErrorAVX2(const Point2DArray& points2D,
+                                    const Point3DArray& points3D,
+                                    const Eigen::Matrix3x4d& cam_from_world,
+                                    const size_t begin,
+                                    const size_t end,
+                                    double* residuals) {
+  __m256d P[3][4];
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      P[r][c] = _mm256_set1_pd(cam_from_world(r, c));
+    }
+  }
+
+  const __m256d min_depth =
+      _mm256_set1_pd(std::numeric_limits<double>::epsilon());
+  const __m256d max_residual =
+      _mm256_set1_pd(std::numeric_limits<double>::max());
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m256d X = _mm256_loadu_pd(points3D.x.data() + i);
+    const __m256d Y = _mm256_loadu_pd(points3D.y.data() + i);
+    const __m256d Z = _mm256_loadu_pd(points3D.z.data() + i);
+    __m256d p[3];
+    for (int r = 0; r < 3; ++r) {
+      p[r] = _mm256_fmadd_pd(
+          P[r][0],
+          X,
+          _mm256_fmadd_pd(P[r][1], Y, _mm256_fmadd_pd(P[r][2], Z, P[r][3])));
+    }
+    const __m256d inv_pz = _mm256_div_pd(one, p[2]);
+    const __m256d dx = _mm256_fmsub_pd(
+        p[0], inv_pz, _mm256_loadu_pd(points2D.x.data() + i));
+    const __m256d dy = _mm256_fmsub_pd(
+        p[1], inv_pz, _mm256_loadu_pd(points2D.y.data() + i));
+    const __m256d squared_error =
+        _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+    // Check if 3D point is in front of camera.
+    const __m256d in_front = _mm256_cmp_pd(p[2], min_depth, _CMP_GT_OQ);
+    _mm256_storeu_pd(residuals + i,
+                     _mm256_blendv_pd(max_residual, squared_error, in_front));
+  }
+
+  return i;
+}
+
+COLMAP_TARGET_AVX2 size_t
+ComputeSquaredTransferErrorAVX2(const Point2DArray& points1,
+                                const Point2DArray& points2,
+                                const Eigen::Matrix3d& H,
+                                const size_t begin,
+                                const size_t end,
+                                double* residuals) {
+  const __m256d h00 = _mm256_set1_pd(H(0, 0));
+  const __m256d h01 = _mm256_set1_pd(H(0, 1));
+  const __m256d h02 = _mm256_set1_pd(H(0, 2));
+  const __m256d h10 = _mm256_set1_pd(H(1, 0));
+  const __m256d h11 = _mm256_set1_pd(H(1, 1));
+  const __m256d h12 = _mm256_set1_pd(H(1, 2));
+  const __m256d h20 = _mm256_set1_pd(H(2, 0));
+  const __m256d h21 = _mm256_set1_pd(H(2, 1));
+  const __m256d h22 = _mm256_set1_pd(H(2, 2));
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m256d x1 = _mm256_loadu_pd(points1.x.data() + i);
+    const __m256d y1 = _mm256_loadu_pd(points1.y.data() + i);
+    const __m256d pd_0 =
+        _mm256_fmadd_pd(h00, x1, _mm256_fmadd_pd(h01, y1, h02));
+    const __m256d pd_1 =
+        _mm256_fmadd_pd(h10, x1, _mm256_fmadd_pd(h11, y1, h12));
+    const __m256d pd_2 =
+        _mm256_fmadd_pd(h20, x1, _mm256_fmadd_pd(h21, y1, h22));
+    const __m256d inv_pd_2 = _mm256_div_pd(one, pd_2);
+    const __m256d dd_0 = _mm256_fnmadd_pd(
+        pd_0, inv_pd_2, _mm256_loadu_pd(points2.x.data() + i));
+    const __m256d dd_1 = _mm256_fnmadd_pd(
+        pd_1, inv_pd_2, _mm256_loadu_pd(points2.y.data() + i));
+    _mm256_storeu_pd(residuals + i,
+                     _mm256_fmadd_pd(dd_0, dd_0, _mm256_mul_pd(dd_1, dd_1)));
+  }
+
+  return i;
+}
+
+#endif  // COLMAP_ESTIMATORS_X86_KERNELS
+
+}  // namespace
+
+Point2DArray::Point2DArray(const std::vector<Eigen::Vector2d>& points)
+    : x(points.size()), y(points.size()) {
+  for (size_t i = 0; i < points.size(); ++i) {
+    x[i] = points[i].x();
+    y[i] = points[i].y();
+  }
+}
+
+Point3DArray::Point3DArray(const std::vector<Eigen::Vector3d>& points)
+    : x(points.size()), y(points.size()), z(points.size()) {
+  for (size_t i = 0; i < points.size(); ++i) {
+    x[i] = points[i].x();
+    y[i] = points[i].y();
+    z[i] = points[i].z();
+  }
+}
 
 void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
                                    std::vector<Eigen::Vector2d>* normed_points,
@@ -109,4 +359,64 @@ void ComputeSquaredReprojectionError(
   }
 }
 
+void ComputeSquaredSampsonError(const Point2DArray& points1,
+                                const Point2DArray& points2,
+                                const Eigen::Matrix3d& E,
+                                size_t begin,
+                                const size_t end,
+                                std::vector<double>* residuals) {
+  THROW_CHECK_EQ(points1.size(), points2.size());
+  THROW_CHECK_LE(begin, end);
+  THROW_CHECK_LE(end, points1.size());
+  THROW_CHECK_LE(end, residuals->size());
+#if defined(COLMAP_ESTIMATORS_X86_KERNELS)
+  if (IsAVX2Supported()) {
+    begin = ComputeSquaredSampsonErrorAVX2(
+        points1, points2, E, begin, end, residuals->data());
+  }
+#endif
+  ComputeSquaredSampsonErrorPortable(
+      points1, points2, E, begin, end, residuals->data());
+}
+
+void ComputeSquaredReprojectionError(const Point2DArray& points2D,
+                                     const Point3DArray& points3D,
+                                     const Eigen::Matrix3x4d& cam_from_world,
+                                     size_t begin,
+                                     const size_t end,
+                                     std::vector<double>* residuals) {
+  THROW_CHECK_EQ(points2D.size(), points3D.size());
+  THROW_CHECK_LE(begin, end);
+  THROW_CHECK_LE(end, points2D.size());
+  THROW_CHECK_LE(end, residuals->size());
+#if defined(COLMAP_ESTIMATORS_X86_KERNELS)
+  if (IsAVX2Supported()) {
+    begin = ComputeSquaredReprojectionErrorAVX2(
+        points2D, points3D, cam_from_world, begin, end, residuals->data());
+  }
+#endif
+  ComputeSquaredReprojectionErrorPortable(
+      points2D, points3D, cam_from_world, begin, end, residuals->data());
+}
+
+void ComputeSquaredTransferError(const Point2DArray& points1,
+                                 const Point2DArray& points2,
+                                 const Eigen::Matrix3d& H,
+                                 size_t begin,
+                                 const size_t end,
+                                 std::vector<double>* residuals) {
+  THROW_CHECK_EQ(points1.size(), points2.size());
+  THROW_CHECK_LE(begin, end);
+  THROW_CHECK_LE(end, points1.size());
+  THROW_CHECK_LE(end, residuals->size());
+#if defined(COLMAP_ESTIMATORS_X86_KERNELS)
+  if (IsAVX2Supported()) {
+    begin = ComputeSquaredTransferErrorAVX2(
+        points1, points2, H, begin, end, residuals->data());
+  }
+#endif
+  ComputeSquaredTransferErrorPortable(
+      points1, points2, H, begin, end, residuals->data());
+}
+
 }  // namespace colmap
@@ -38,6 +38,30 @@
 
 namespace colmap {
 
+// Structure-of-arrays layout of 2D points, which enables the vectorized
+// computation of residuals for many correspondences at once.
+struct Point2DArray {
+  Point2DArray() = default;
+  explicit Point2DArray(const std::vector<Eigen::Vector2d>& points);
+
+  inline size_t size() const { return x.size(); }
+
+  std::vector<double> x;
+  std::vector<double> y;
+};
+
+// Structure-of-arrays layout of 3D points.
+struct Point3DArray {
+  Point3DArray() = default;
+  explicit Point3DArray(const std::vector<Eigen::Vector3d>& points);
+
+  inline size_t size() const { return x.size(); }
+
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+};
+
 // Center and normalize image points.
 //
 // The points are transformed in a two-step procedure that is expressed
@@ -85,4 +109,31 @@ void ComputeSquaredReprojectionError(
     const Eigen::Matrix3x4d& cam_from_world,
     std::vector<double>* residuals);
 
+// Vectorized variants of the residual functions for the structure-of-arrays
+// layout, which compute the residuals of the points in the range [begin, end)
+// and store them at the same indices in the pre-allocated residuals.
+void ComputeSquaredSampsonError(const Point2DArray& points1,
+                                const Point2DArray& points2,
+                                const Eigen::Matrix3d& E,
+                                size_t begin,
+                                size_t end,
+                                std::vector<double>* residuals);
+void ComputeSquaredReprojectionError(const Point2DArray& points2D,
+                                     const Point3DArray& points3D,
+                                     const Eigen::Matrix3x4d& cam_from_world,
+                                     size_t begin,
+                                     size_t end,
+                                     std::vector<double>* residuals);
+
+// Calculate the squared transfer error of a set of corresponding points and a
+// given homography, i.e., the squared distance between the second points and
+// the first points transformed by the homography, for the points in the range
+// [begin, end).
+void ComputeSquaredTransferError(const Point2DArray& points1,
+                                 const Point2DArray& points2,
+                                 const Eigen::Matrix3d& H,
+                                 size_t begin,
+                                 size_t end,
+                                 std::vector<double>* residuals);
+
 }  // namespace colmap
@@ -29,6 +29,7 @@
 
 #include "colmap/estimators/utils.h"
 
+#include "colmap/estimators/homography_matrix.h"
 #include "colmap/geometry/essential_matrix.h"
 
 #include <gtest/gtest.h>
@@ -104,5 +105,92 @@ TEST(ComputeSquaredReprojectionError, Nominal) {
   EXPECT_EQ(residuals[2], 13);
 }
 
+TEST(ComputeSquaredSampsonError, PointArray) {
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  for (int i = 0; i < 11; ++i) {
+    points1.push_back(Eigen::Vector2d::Random());
+    points2.push_back(Eigen::Vector2d::Random());
+  }
+
+  const Eigen::Matrix3d E = EssentialMatrixFromPose(
+      Rigid3d(Eigen::Quaterniond::UnitRandom(), Eigen::Vector3d(1, 0, 0)));
+
+  std::vector<double> expected_residuals;
+  ComputeSquaredSampsonError(points1, points2, E, &expected_residuals);
+
+  const Point2DArray point_array1(points1);
+  const Point2DArray point_array2(points2);
+  EXPECT_EQ(point_array1.size(), points1.size());
+  std::vector<double> residuals(points1.size(), -1);
+  ComputeSquaredSampsonError(
+      point_array1, point_array2, E, 2, points1.size(), &residuals);
+  EXPECT_EQ(residuals[0], -1);
+  EXPECT_EQ(residuals[1], -1);
+  for (size_t i = 2; i < points1.size(); ++i) {
+    EXPECT_NEAR(residuals[i], expected_residuals[i], 1e-12);
+  }
+}
+
+TEST(ComputeSquaredReprojectionError, PointArray) {
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  for (int i = 0; i < 11; ++i) {
+    points2D.push_back(Eigen::Vector2d::Random());
+    points3D.push_back(Eigen::Vector3d::Random());
+  }
+
+  const Rigid3d cam_from_world(Eigen::Quaterniond::Identity(),
+                               Eigen::Vector3d(0, 0, 0.5));
+
+  std::vector<double> expected_residuals;
+  ComputeSquaredReprojectionError(
+      points2D, points3D, cam_from_world.ToMatrix(), &expected_residuals);
+
+  std::vector<double> residuals(points2D.size());
+  ComputeSquaredReprojectionError(Point2DArray(points2D),
+                                  Point3DArray(points3D),
+                                  cam_from_world.ToMatrix(),
+                                  0,
+                                  points2D.size(),
+                                  &residuals);
+  for (size_t i = 0; i < points2D.size(); ++i) {
+    if (expected_residuals[i] == std::numeric_limits<double>::max()) {
+      EXPECT_EQ(residuals[i], std::numeric_limits<double>::max());
+    } else {
+      EXPECT_NEAR(residuals[i], expected_residuals[i], 1e-9);
+    }
+  }
+}
+
+TEST(ComputeSquaredTransferError, PointArray) {
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  for (int i = 0; i < 11; ++i) {
+    points1.push_back(Eigen::Vector2d::Random());
+    points2.push_back(Eigen::Vector2d::Random());
+  }
+
+  Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+  H(0, 1) = 0.2;
+  H(1, 2) = -0.5;
+  H(2, 0) = 0.1;
+
+  std::vector<double> expected_residuals;
+  HomographyMatrixEstimator::Residuals(
+      points1, points2, H, &expected_residuals);
+
+  std::vector<double> residuals(points1.size());
+  ComputeSquaredTransferError(Point2DArray(points1),
+                              Point2DArray(points2),
+                              H,
+                              0,
+                              points1.size(),
+                              &residuals);
+  for (size_t i = 0; i < points1.size(); ++i) {
+    EXPECT_NEAR(residuals[i], expected_residuals[i], 1e-12);
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -35,6 +35,7 @@
 #include "colmap/exe/mvs.h"
 #include "colmap/exe/sfm.h"
 #include "colmap/exe/vocab_tree.h"
+#include "colmap/util/trace.h"
 #include "colmap/util/version.h"
 
 namespace {
@@ -105,6 +106,8 @@ int main(int argc, char** argv) {
   commands.emplace_back("exhaustive_matcher", &colmap::RunExhaustiveMatcher);
   commands.emplace_back("feature_extractor", &colmap::RunFeatureExtractor);
   commands.emplace_back("feature_importer", &colmap::RunFeatureImporter);
+  commands.emplace_back("feature_store_converter",
+                        &colmap::RunFeatureStoreConverter);
   commands.emplace_back("hierarchical_mapper", &colmap::RunHierarchicalMapper);
   commands.emplace_back("image_deleter", &colmap::RunImageDeleter);
   commands.emplace_back("image_filterer", &colmap::RunImageFilterer);
@@ -164,7 +167,10 @@ int main(int argc, char** argv) {
       int command_argc = argc - 1;
       char** command_argv = &argv[1];
       command_argv[0] = argv[0];
-      return matched_command_func(command_argc, command_argv);
+      const int return_code = matched_command_func(command_argc, command_argv);
+      // Write the trace, if enabled through the `trace_path` option.
+      colmap::Tracer::Instance().Finish();
+      return return_code;
     }
   }
 
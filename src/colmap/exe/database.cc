@@ -31,6 +31,7 @@
 
 #include "colmap/controllers/option_manager.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/util/misc.h"
 
 namespace colmap {
@@ -109,4 +110,32 @@ int RunDatabaseMerger(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunFeatureStoreConverter(int argc, char** argv) {
+  std::string feature_store_path;
+  std::string direction;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("feature_store_path", &feature_store_path);
+  options.AddRequiredOption(
+      "direction", &direction, "{database_to_store, store_to_database}");
+  options.Parse(argc, argv);
+
+  StringToLower(&direction);
+  Database database(*options.database_path);
+  FeatureStore feature_store(feature_store_path);
+  if (direction == "database_to_store") {
+    PrintHeading1("Exporting features to feature store");
+    ExportFeaturesToFeatureStore(database, &feature_store);
+  } else if (direction == "store_to_database") {
+    PrintHeading1("Importing features from feature store");
+    ImportFeaturesFromFeatureStore(feature_store, &database);
+  } else {
+    LOG(ERROR) << "Invalid conversion direction";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 }  // namespace colmap
@@ -32,5 +32,6 @@ namespace colmap {
 int RunDatabaseCleaner(int argc, char** argv);
 int RunDatabaseCreator(int argc, char** argv);
 int RunDatabaseMerger(int argc, char** argv);
+int RunFeatureStoreConverter(int argc, char** argv);
 
 }  // namespace colmap
@@ -32,6 +32,7 @@
 #include "colmap/controllers/incremental_mapper.h"
 #include "colmap/controllers/option_manager.h"
 #include "colmap/image/undistortion.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sfm/incremental_mapper.h"
 #include "colmap/util/base_controller.h"
@@ -265,10 +266,29 @@ int RunImageRegistrator(int argc, char** argv) {
     timer.Start();
     const size_t min_num_matches =
         static_cast<size_t>(options.mapper->min_num_matches);
-    database_cache = DatabaseCache::Create(Database(*options.database_path),
-                                           min_num_matches,
-                                           options.mapper->ignore_watermarks,
-                                           options.mapper->image_names);
+    const Database database(*options.database_path);
+    std::unique_ptr<FeatureStore> feature_store;
+    if (!options.mapper->feature_store_path.empty()) {
+      feature_store =
+          std::make_unique<FeatureStore>(options.mapper->feature_store_path);
+    }
+    if (options.mapper->database_cache_path.empty()) {
+      database_cache = DatabaseCache::Create(database,
+                                             min_num_matches,
+                                             options.mapper->ignore_watermarks,
+                                             options.mapper->image_names,
+                                             options.mapper->num_threads,
+                                             feature_store.get());
+    } else {
+      database_cache = DatabaseCache::CreateWithSnapshot(
+          options.mapper->database_cache_path,
+          database,
+          min_num_matches,
+          options.mapper->ignore_watermarks,
+          options.mapper->image_names,
+          options.mapper->num_threads,
+          feature_store.get());
+    }
     timer.PrintMinutes();
   }
 
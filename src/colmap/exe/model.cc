@@ -36,7 +36,9 @@
 #include "colmap/geometry/pose.h"
 #include "colmap/optim/ransac.h"
 #include "colmap/scene/reconstruction_io.h"
+#include "colmap/scene/reconstruction_reader.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/ply.h"
 #include "colmap/util/threading.h"
 
 namespace colmap {
@@ -217,6 +219,104 @@ void PrintComparisonSummary(std::ostream& out,
   PrintErrorStats(out, proj_center_errors);
 }
 
+bool ExistsBinaryModel(const std::string& path) {
+  return ExistsFile(JoinPaths(path, "cameras.bin")) &&
+         ExistsFile(JoinPaths(path, "images.bin")) &&
+         ExistsFile(JoinPaths(path, "points3D.bin"));
+}
+
+// Prints the same statistics as for a loaded reconstruction but in a single
+// streaming pass over the binary files, without materializing the model.
+void AnalyzeBinaryModel(const std::string& path, const bool verbose) {
+  BinaryReconstructionReader reader(path);
+
+  size_t num_observations = 0;
+  reader.VisitImages([&num_observations](const ImageBinaryView& image) {
+    for (size_t idx = 0; idx < image.num_points2D; ++idx) {
+      if (image.Point3DId(idx) != kInvalidPoint3DId) {
+        num_observations += 1;
+      }
+    }
+  });
+
+  const int num_threads = GetEffectiveNumThreads(-1);
+  std::vector<double> error_sums(num_threads, 0.0);
+  std::vector<size_t> num_valid_errors(num_threads, 0);
+  reader.VisitPoints3DParallel(
+      [&](const int thread_idx, const Point3DBinaryView& point3D) {
+        if (point3D.HasError()) {
+          error_sums[thread_idx] += point3D.error;
+          num_valid_errors[thread_idx] += 1;
+        }
+      },
+      num_threads);
+  double error_sum = 0.0;
+  size_t num_errors = 0;
+  for (int thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
+    error_sum += error_sums[thread_idx];
+    num_errors += num_valid_errors[thread_idx];
+  }
+
+  // All images in the binary format are registered.
+  const size_t num_images = reader.NumImages();
+  const size_t num_points3D = reader.NumPoints3D();
+  LOG(INFO) << StringPrintf("Cameras: %d", reader.NumCameras());
+  LOG(INFO) << StringPrintf("Images: %d", num_images);
+  LOG(INFO) << StringPrintf("Registered images: %d", num_images);
+  LOG(INFO) << StringPrintf("Points: %d", num_points3D);
+  LOG(INFO) << StringPrintf("Observations: %d", num_observations);
+  LOG(INFO) << StringPrintf(
+      "Mean track length: %f",
+      num_points3D == 0 ? 0.0
+                        : num_observations / static_cast<double>(num_points3D));
+  LOG(INFO) << StringPrintf(
+      "Mean observations per image: %f",
+      num_images == 0 ? 0.0
+                      : num_observations / static_cast<double>(num_images));
+  LOG(INFO) << StringPrintf("Mean reprojection error: %fpx",
+                            num_errors == 0 ? 0.0 : error_sum / num_errors);
+
+  if (verbose) {
+    PrintHeading2("Cameras");
+    reader.VisitCameras([](const Camera& camera) {
+      LOG(INFO) << StringPrintf(" - Camera Id: %d, Model Name: %s, Params: %s",
+                                camera.camera_id,
+                                camera.ModelName().c_str(),
+                                camera.ParamsToString().c_str());
+    });
+
+    PrintHeading2("Images");
+    reader.VisitImages([](const ImageBinaryView& image) {
+      LOG(INFO) << StringPrintf(" - Registered Image Id: %d, Name: %s",
+                                image.image_id,
+                                image.name.c_str());
+    });
+  }
+}
+
+// Exports the points of a binary model to PLY without loading the model.
+void ExportBinaryModelPLY(const std::string& input_path,
+                          const std::string& output_path) {
+  BinaryReconstructionReader reader(input_path);
+
+  std::vector<PlyPoint> ply_points;
+  ply_points.reserve(reader.NumPoints3D());
+  reader.VisitPoints3D([&ply_points](const Point3DBinaryView& point3D) {
+    PlyPoint ply_point;
+    ply_point.x = point3D.xyz(0);
+    ply_point.y = point3D.xyz(1);
+    ply_point.z = point3D.xyz(2);
+    ply_point.r = point3D.color(0);
+    ply_point.g = point3D.color(1);
+    ply_point.b = point3D.color(2);
+    ply_points.push_back(ply_point);
+  });
+
+  const bool kWriteNormal = false;
+  const bool kWriteRGB = true;
+  WriteBinaryPlyPoints(output_path, ply_points, kWriteNormal, kWriteRGB);
+}
+
 }  // namespace
 
 // Align given reconstruction with user provided cameras positions
@@ -426,6 +526,11 @@ int RunModelAnalyzer(int argc, char** argv) {
   options.AddDefaultOption("verbose", &verbose);
   options.Parse(argc, argv);
 
+  if (ExistsBinaryModel(path)) {
+    AnalyzeBinaryModel(path, verbose);
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
   reconstruction.Read(path);
 
@@ -591,10 +696,17 @@ int RunModelConverter(int argc, char** argv) {
   options.AddDefaultOption("skip_distortion", &skip_distortion);
   options.Parse(argc, argv);
 
+  StringToLower(&output_type);
+
+  // Points-only exports can stream the binary model instead of loading it.
+  if (output_type == "ply" && ExistsBinaryModel(input_path)) {
+    ExportBinaryModelPLY(input_path, output_path);
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
 
-  StringToLower(&output_type);
   if (output_type == "bin") {
     reconstruction.WriteBinary(output_path);
   } else if (output_type == "txt") {
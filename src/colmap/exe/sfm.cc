@@ -314,6 +314,11 @@ int RunHierarchicalMapper(int argc, char** argv) {
   options.AddDefaultOption(
       "leaf_max_num_images",
       &mapper_options.clustering_options.leaf_max_num_images);
+  options.AddDefaultOption("ba_global_partitioned",
+                           &mapper_options.ba_global_partitioned);
+  options.AddDefaultOption(
+      "ba_global_partitioned_num_iterations",
+      &mapper_options.partitioned_ba_options.num_iterations);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -175,7 +175,7 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   options.Parse(argc, argv);
 
   retrieval::VisualIndex<> visual_index;
-  visual_index.Read(vocab_tree_path);
+  visual_index.Read(vocab_tree_path, /*memory_map=*/true);
 
   Database database(*options.database_path);
 
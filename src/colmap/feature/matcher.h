@@ -31,11 +31,25 @@
 
 #include "colmap/estimators/two_view_geometry.h"
 #include "colmap/feature/types.h"
+#include "colmap/util/logging.h"
 
 #include <memory>
+#include <vector>
 
 namespace colmap {
 
+// Search data structure over the descriptors of a single image, e.g., to
+// accelerate nearest neighbor queries. Indices are immutable after creation,
+// so that they can be built once and shared among matchers across threads.
+class FeatureDescriptorIndex {
+ public:
+  virtual ~FeatureDescriptorIndex() = default;
+
+  // Approximate memory footprint of the index in bytes, excluding the indexed
+  // descriptors, which are owned by the caller.
+  virtual size_t NumBytes() const = 0;
+};
+
 class FeatureMatcher {
  public:
   virtual ~FeatureMatcher() = default;
@@ -52,6 +66,47 @@ class FeatureMatcher {
       const std::shared_ptr<const FeatureDescriptors>& descriptors2,
       FeatureMatches* matches) = 0;
 
+  // Same as Match but with search indices over the descriptors, as created by
+  // the matcher's index factory, e.g., CreateSiftCPUDescriptorIndex. A nullptr
+  // index for non-null descriptors lets the implementation build the index
+  // itself. Implementations without index support ignore the indices.
+  virtual void MatchWithIndices(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index1,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors2,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index2,
+      FeatureMatches* matches) {
+    Match(descriptors1, descriptors2, matches);
+  }
+
+  // Match the descriptors of one image against the descriptors of multiple
+  // other images, where (*matches)[k] are the matches between descriptors1 and
+  // descriptors2[k]. The indices may be empty or otherwise have the same size
+  // as descriptors2, with the same semantics as in MatchWithIndices.
+  // Implementations may exploit that descriptors1 is shared by all pairs,
+  // e.g., to scan them in a single pass. By default, the pairs are matched one
+  // by one while reusing descriptors1 as described above.
+  virtual void MatchOneToMany(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index1,
+      const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+          descriptors2,
+      const std::vector<std::shared_ptr<const FeatureDescriptorIndex>>&
+          indices2,
+      std::vector<FeatureMatches>* matches) {
+    THROW_CHECK_NOTNULL(descriptors1);
+    THROW_CHECK(indices2.empty() || indices2.size() == descriptors2.size());
+    THROW_CHECK_NOTNULL(matches);
+    matches->resize(descriptors2.size());
+    for (size_t k = 0; k < descriptors2.size(); ++k) {
+      MatchWithIndices(k == 0 ? descriptors1 : nullptr,
+                       k == 0 ? index1 : nullptr,
+                       THROW_CHECK_NOTNULL(descriptors2[k]),
+                       indices2.empty() ? nullptr : indices2[k],
+                       &(*matches)[k]);
+    }
+  }
+
   virtual void MatchGuided(
       const TwoViewGeometryOptions& options,
       const std::shared_ptr<const FeatureKeypoints>& keypoints1,
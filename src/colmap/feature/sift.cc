@@ -29,9 +29,11 @@
 
 #include "colmap/feature/sift.h"
 
+#include "colmap/feature/sift_brute_force.h"
 #include "colmap/feature/utils.h"
 #include "colmap/math/math.h"
 #include "colmap/util/cuda.h"
+#include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
@@ -50,7 +52,11 @@
 
 #include <array>
 #include <fstream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <random>
+#include <sstream>
 
 #include <Eigen/Geometry>
 #include <flann/flann.hpp>
@@ -67,6 +73,7 @@ bool SiftExtractionOptions::Check() const {
   CHECK_OPTION_GT(peak_threshold, 0.0);
   CHECK_OPTION_GT(edge_threshold, 0.0);
   CHECK_OPTION_GT(max_num_orientations, 0);
+  CHECK_OPTION_GE(tile_size, 0);
   if (domain_size_pooling) {
     CHECK_OPTION_GT(dsp_min_scale, 0);
     CHECK_OPTION_GE(dsp_max_scale, dsp_min_scale);
@@ -82,6 +89,8 @@ bool SiftMatchingOptions::Check() const {
   CHECK_OPTION_GT(max_ratio, 0.0);
   CHECK_OPTION_GT(max_distance, 0.0);
   CHECK_OPTION_GT(max_num_matches, 0);
+  CHECK_OPTION_GE(cpu_index_cache_size, 0);
+  CHECK_OPTION_GT(cpu_batch_size, 0);
   return true;
 }
 
@@ -123,6 +132,11 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     if (options_.darkness_adaptivity) {
       WarnDarknessAdaptivityNotAvailable();
     }
+    const int num_image_threads =
+        GetEffectiveNumThreads(options_.num_image_threads);
+    if (num_image_threads > 1) {
+      thread_pool_ = std::make_unique<ThreadPool>(num_image_threads);
+    }
   }
 
   static std::unique_ptr<FeatureExtractor> Create(
@@ -136,21 +150,18 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     THROW_CHECK(bitmap.IsGrey());
     THROW_CHECK_NOTNULL(keypoints);
 
-    if (sift_ == nullptr || sift_->width != bitmap.Width() ||
-        sift_->height != bitmap.Height()) {
-      sift_ = VlSiftType(vl_sift_new(bitmap.Width(),
-                                     bitmap.Height(),
-                                     options_.num_octaves,
-                                     options_.octave_resolution,
-                                     options_.first_octave),
-                         &vl_sift_delete);
-      if (!sift_) {
-        return false;
-      }
+    if (options_.tile_size > 0 &&
+        std::max(bitmap.Width(), bitmap.Height()) > options_.tile_size) {
+      return ExtractTiled(bitmap, keypoints, descriptors);
     }
 
-    vl_sift_set_peak_thresh(sift_.get(), options_.peak_threshold);
-    vl_sift_set_edge_thresh(sift_.get(), options_.edge_threshold);
+    if (options_.two_pass_extraction) {
+      return ExtractTwoPass(bitmap, keypoints, descriptors);
+    }
+
+    if (!SetUpSift(bitmap)) {
+      return false;
+    }
 
     // Iterate through octaves.
     std::vector<size_t> level_num_features;
@@ -167,6 +178,7 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
         if (vl_sift_process_first_octave(sift_.get(), data_float.data())) {
           break;
         }
+        InvalidateGradients(sift_.get());
         first_octave = false;
       } else {
         if (vl_sift_process_next_octave(sift_.get())) {
@@ -212,48 +224,13 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
         level_num_features.back() += 1;
         prev_level = vl_keypoints[i].is;
 
-        // Extract feature orientations.
-        double angles[4];
-        int num_orientations;
-        if (options_.upright) {
-          num_orientations = 1;
-          angles[0] = 0.0;
-        } else {
-          num_orientations = vl_sift_calc_keypoint_orientations(
-              sift_.get(), angles, &vl_keypoints[i]);
-        }
-
-        // Note that this is different from SiftGPU, which selects the top
-        // global maxima as orientations while this selects the first two
-        // local maxima. It is not clear which procedure is better.
-        const int num_used_orientations =
-            std::min(num_orientations, options_.max_num_orientations);
-
-        for (int o = 0; o < num_used_orientations; ++o) {
-          level_keypoints.back()[level_idx] =
-              FeatureKeypoint(vl_keypoints[i].x + 0.5f,
-                              vl_keypoints[i].y + 0.5f,
-                              vl_keypoints[i].sigma,
-                              angles[o]);
-          if (descriptors != nullptr) {
-            vl_sift_calc_keypoint_descriptor(
-                sift_.get(), desc.data(), &vl_keypoints[i], angles[o]);
-            if (options_.normalization ==
-                SiftExtractionOptions::Normalization::L2) {
-              L2NormalizeFeatureDescriptors(&desc);
-            } else if (options_.normalization ==
-                       SiftExtractionOptions::Normalization::L1_ROOT) {
-              L1RootNormalizeFeatureDescriptors(&desc);
-            } else {
-              LOG(FATAL_THROW) << "Normalization type not supported";
-            }
-
-            level_descriptors.back().row(level_idx) =
-                FeatureDescriptorsToUnsignedByte(desc);
-          }
-
-          level_idx += 1;
-        }
+        level_idx += DescribeKeypoint(
+            sift_.get(),
+            vl_keypoints[i],
+            &level_keypoints.back()[level_idx],
+            &desc,
+            descriptors == nullptr ? nullptr : &level_descriptors.back(),
+            level_idx);
       }
 
       // Resize containers for last DOG level in octave.
@@ -305,8 +282,549 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
   }
 
  private:
+  VlSiftType CreateSift(const int width, const int height) const {
+    VlSiftType sift(vl_sift_new(width,
+                                height,
+                                options_.num_octaves,
+                                options_.octave_resolution,
+                                options_.first_octave),
+                    &vl_sift_delete);
+    if (sift) {
+      vl_sift_set_peak_thresh(sift.get(), options_.peak_threshold);
+      vl_sift_set_edge_thresh(sift.get(), options_.edge_threshold);
+    }
+    return sift;
+  }
+
+  bool SetUpSift(const Bitmap& bitmap) {
+    if (sift_ == nullptr || sift_->width != bitmap.Width() ||
+        sift_->height != bitmap.Height()) {
+      sift_ = CreateSift(bitmap.Width(), bitmap.Height());
+    }
+    return sift_ != nullptr;
+  }
+
+  // VLFeat caches the gradients of the last octave, for which orientations or
+  // descriptors were computed, and only identifies them by the octave index.
+  // When the filter is reused for another image or pass, the cached gradients
+  // would be used for the same octave of the new scale space.
+  static void InvalidateGradients(VlSiftFilt* sift) {
+    sift->grad_o = sift->o_min - 1;
+  }
+
+  // Computes the scale space of the next octave and returns false if there
+  // are no more octaves.
+  static bool ProcessNextOctave(VlSiftFilt* sift,
+                                const std::vector<float>& data_float,
+                                const bool first_octave) {
+    if (first_octave) {
+      if (vl_sift_process_first_octave(sift, data_float.data()) != VL_ERR_OK) {
+        return false;
+      }
+      InvalidateGradients(sift);
+      return true;
+    }
+    return vl_sift_process_next_octave(sift) == VL_ERR_OK;
+  }
+
+  // Computes the orientations and optionally the descriptors of a keypoint in
+  // the current octave. Returns the number of computed features.
+  int DescribeKeypoint(VlSiftFilt* sift,
+                       const VlSiftKeypoint& vl_keypoint,
+                       FeatureKeypoint* keypoints,
+                       FeatureDescriptorsFloat* desc,
+                       FeatureDescriptors* descriptors,
+                       const FeatureDescriptors::Index descriptors_row) const {
+    double angles[4];
+    int num_orientations;
+    if (options_.upright) {
+      num_orientations = 1;
+      angles[0] = 0.0;
+    } else {
+      num_orientations =
+          vl_sift_calc_keypoint_orientations(sift, angles, &vl_keypoint);
+    }
+
+    // Note that this is different from SiftGPU, which selects the top
+    // global maxima as orientations while this selects the first two
+    // local maxima. It is not clear which procedure is better.
+    const int num_used_orientations =
+        std::min(num_orientations, options_.max_num_orientations);
+
+    for (int o = 0; o < num_used_orientations; ++o) {
+      keypoints[o] = FeatureKeypoint(vl_keypoint.x + 0.5f,
+                                     vl_keypoint.y + 0.5f,
+                                     vl_keypoint.sigma,
+                                     angles[o]);
+      if (descriptors != nullptr) {
+        vl_sift_calc_keypoint_descriptor(
+            sift, desc->data(), &vl_keypoint, angles[o]);
+        if (options_.normalization ==
+            SiftExtractionOptions::Normalization::L2) {
+          L2NormalizeFeatureDescriptors(desc);
+        } else if (options_.normalization ==
+                   SiftExtractionOptions::Normalization::L1_ROOT) {
+          L1RootNormalizeFeatureDescriptors(desc);
+        } else {
+          LOG(FATAL_THROW) << "Normalization type not supported";
+        }
+        descriptors->row(descriptors_row + o) =
+            FeatureDescriptorsToUnsignedByte(*desc);
+      }
+    }
+
+    return num_used_orientations;
+  }
+
+  bool ExtractTwoPass(const Bitmap& bitmap,
+                      FeatureKeypoints* keypoints,
+                      FeatureDescriptors* descriptors) {
+    if (!SetUpSift(bitmap)) {
+      return false;
+    }
+
+    const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
+    std::vector<float> data_float(data_uint8.size());
+    for (size_t i = 0; i < data_uint8.size(); ++i) {
+      data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
+    }
+
+    // First pass: Detect the keypoints in all octaves.
+    std::vector<std::vector<VlSiftKeypoint>> octave_keypoints;
+    for (bool first_octave = true;
+         ProcessNextOctave(sift_.get(), data_float, first_octave);
+         first_octave = false) {
+      vl_sift_detect(sift_.get());
+      const VlSiftKeypoint* vl_keypoints = vl_sift_get_keypoints(sift_.get());
+      octave_keypoints.emplace_back(
+          vl_keypoints, vl_keypoints + vl_sift_get_nkeypoints(sift_.get()));
+    }
+
+    // Determine how many DOG levels to keep to satisfy max_num_features option,
+    // exactly as in the single-pass extraction. Within an octave, the
+    // keypoints are ordered by DOG level, so the kept keypoints of each octave
+    // are a suffix starting at the returned index.
+    std::vector<size_t> octave_first_kept_idxs(octave_keypoints.size(), 0);
+    {
+      int num_features = 0;
+      for (int octave = octave_keypoints.size() - 1; octave >= 0; --octave) {
+        const std::vector<VlSiftKeypoint>& vl_keypoints =
+            octave_keypoints[octave];
+        size_t level_end = vl_keypoints.size();
+        while (level_end > 0 && num_features <= options_.max_num_features) {
+          size_t level_begin = level_end - 1;
+          while (level_begin > 0 && vl_keypoints[level_begin - 1].is ==
+                                        vl_keypoints[level_end - 1].is) {
+            level_begin -= 1;
+          }
+          num_features += level_end - level_begin;
+          octave_first_kept_idxs[octave] = level_begin;
+          level_end = level_begin;
+        }
+        if (num_features > options_.max_num_features) {
+          for (int prev_octave = 0; prev_octave < octave; ++prev_octave) {
+            octave_first_kept_idxs[prev_octave] =
+                octave_keypoints[prev_octave].size();
+          }
+          break;
+        }
+      }
+    }
+
+    // Second pass: Compute the orientations and descriptors of the kept
+    // keypoints. Each keypoint yields up to max_num_orientations features,
+    // whose slots are compacted after describing all keypoints in an octave.
+    const int max_num_orientations = options_.max_num_orientations;
+    keypoints->clear();
+    FeatureDescriptors all_descriptors;
+    size_t octave = 0;
+    for (bool first_octave = true;
+         octave < octave_keypoints.size() &&
+         ProcessNextOctave(sift_.get(), data_float, first_octave);
+         first_octave = false, ++octave) {
+      const std::vector<VlSiftKeypoint>& vl_keypoints =
+          octave_keypoints[octave];
+      const size_t first_kept_idx = octave_first_kept_idxs[octave];
+      const size_t num_kept = vl_keypoints.size() - first_kept_idx;
+      if (num_kept == 0) {
+        continue;
+      }
+
+      FeatureKeypoints octave_features(max_num_orientations * num_kept);
+      FeatureDescriptors octave_descriptors;
+      if (descriptors != nullptr) {
+        octave_descriptors.resize(max_num_orientations * num_kept, 128);
+      }
+      std::vector<int> num_features(num_kept, 0);
+
+      auto DescribeKeypoints = [this,
+                                &vl_keypoints,
+                                first_kept_idx,
+                                max_num_orientations,
+                                &octave_features,
+                                &octave_descriptors,
+                                &num_features,
+                                descriptors](const size_t begin,
+                                             const size_t end) {
+        FeatureDescriptorsFloat desc(1, 128);
+        for (size_t i = begin; i < end; ++i) {
+          num_features[i] = DescribeKeypoint(
+              sift_.get(),
+              vl_keypoints[first_kept_idx + i],
+              &octave_features[max_num_orientations * i],
+              &desc,
+              descriptors == nullptr ? nullptr : &octave_descriptors,
+              max_num_orientations * i);
+        }
+      };
+
+      // VLFeat lazily computes the gradients of the current octave on first
+      // use, so the keypoints are described serially until the gradients are
+      // available. Afterwards, the scale space is only read.
+      size_t i = 0;
+      while (i < num_kept && sift_->grad_o != sift_->o_cur) {
+        DescribeKeypoints(i, i + 1);
+        i += 1;
+      }
+
+      if (thread_pool_ == nullptr) {
+        DescribeKeypoints(i, num_kept);
+      } else {
+        const size_t kChunkSize = 64;
+        std::vector<std::future<void>> futures;
+        for (; i < num_kept; i += kChunkSize) {
+          futures.push_back(thread_pool_->AddTask(
+              DescribeKeypoints, i, std::min(i + kChunkSize, num_kept)));
+        }
+        for (auto& future : futures) {
+          future.get();
+        }
+      }
+
+      const size_t prev_num_features = keypoints->size();
+      keypoints->reserve(prev_num_features + octave_features.size());
+      for (size_t i = 0; i < num_kept; ++i) {
+        for (int o = 0; o < num_features[i]; ++o) {
+          keypoints->push_back(octave_features[max_num_orientations * i + o]);
+        }
+      }
+
+      if (descriptors != nullptr) {
+        all_descriptors.conservativeResize(keypoints->size(), 128);
+        FeatureDescriptors::Index row = prev_num_features;
+        for (size_t i = 0; i < num_kept; ++i) {
+          for (int o = 0; o < num_features[i]; ++o) {
+            all_descriptors.row(row) =
+                octave_descriptors.row(max_num_orientations * i + o);
+            row += 1;
+          }
+        }
+      }
+    }
+
+    if (descriptors != nullptr) {
+      all_descriptors.conservativeResize(keypoints->size(), 128);
+      *descriptors = TransformVLFeatToUBCFeatureDescriptors(all_descriptors);
+    }
+
+    return true;
+  }
+
+  // DOG level identified by its octave and level index within the octave.
+  using DogLevel = std::pair<int, int>;
+
+  // Determines the first DOG level to keep to satisfy max_num_features option,
+  // given the number of keypoints per DOG level.
+  DogLevel FindFirstKeptDogLevel(
+      const std::map<DogLevel, int>& level_num_keypoints) const {
+    int num_features = 0;
+    for (auto it = level_num_keypoints.rbegin();
+         it != level_num_keypoints.rend();
+         ++it) {
+      num_features += it->second;
+      if (num_features > options_.max_num_features) {
+        return it->first;
+      }
+    }
+    return DogLevel(std::numeric_limits<int>::min(),
+                    std::numeric_limits<int>::min());
+  }
+
+  struct Tile {
+    // Region of the image covered by the tile.
+    int x0 = 0;
+    int y0 = 0;
+    int width = 0;
+    int height = 0;
+    // Core region of the tile, in which the tile owns the keypoints. The core
+    // regions of all tiles partition the image.
+    double core_x0 = 0;
+    double core_y0 = 0;
+    double core_x1 = 0;
+    double core_y1 = 0;
+  };
+
+  struct TileFeatures {
+    // Number of keypoints owned by the tile per DOG level.
+    std::map<DogLevel, int> level_num_keypoints;
+    // DOG level and detection position in the octave of the whole image, by
+    // which the features are ordered as in the extraction of the whole image.
+    std::vector<std::pair<DogLevel, std::pair<int, int>>> orders;
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+  };
+
+  // Extracts the keypoints owned by the tile. If describe is true, the
+  // orientations and descriptors of the keypoints in DOG levels not before
+  // first_kept_level are computed.
+  bool ExtractTile(const std::vector<uint8_t>& data_uint8,
+                   const int image_width,
+                   const Tile& tile,
+                   const bool describe,
+                   const DogLevel& first_kept_level,
+                   const bool extract_descriptors,
+                   TileFeatures* tile_features) const {
+    std::vector<float> data_float(tile.width * tile.height);
+    for (int y = 0; y < tile.height; ++y) {
+      for (int x = 0; x < tile.width; ++x) {
+        data_float[y * tile.width + x] =
+            static_cast<float>(
+                data_uint8[(tile.y0 + y) * image_width + tile.x0 + x]) /
+            255.0f;
+      }
+    }
+
+    VlSiftType sift = CreateSift(tile.width, tile.height);
+    if (!sift) {
+      return false;
+    }
+
+    const int max_num_orientations = options_.max_num_orientations;
+    FeatureDescriptorsFloat desc(1, 128);
+    for (bool first_octave = true;
+         ProcessNextOctave(sift.get(), data_float, first_octave);
+         first_octave = false) {
+      vl_sift_detect(sift.get());
+      const VlSiftKeypoint* vl_keypoints = vl_sift_get_keypoints(sift.get());
+      const int num_keypoints = vl_sift_get_nkeypoints(sift.get());
+      const int octave = vl_sift_get_octave_index(sift.get());
+
+      // The tile offsets are aligned to the pixels of the coarsest octave.
+      const int octave_x0 = static_cast<int>(std::ldexp(tile.x0, -octave));
+      const int octave_y0 = static_cast<int>(std::ldexp(tile.y0, -octave));
+
+      FeatureKeypoints octave_features;
+      FeatureDescriptors octave_descriptors;
+      if (describe) {
+        octave_features.resize(max_num_orientations * num_keypoints);
+        if (extract_descriptors) {
+          octave_descriptors.resize(max_num_orientations * num_keypoints, 128);
+        }
+      }
+
+      int num_features = 0;
+      for (int i = 0; i < num_keypoints; ++i) {
+        const VlSiftKeypoint& vl_keypoint = vl_keypoints[i];
+        const double x = vl_keypoint.x + tile.x0;
+        const double y = vl_keypoint.y + tile.y0;
+        if (x < tile.core_x0 || x >= tile.core_x1 || y < tile.core_y0 ||
+            y >= tile.core_y1) {
+          continue;
+        }
+
+        const DogLevel level(octave, vl_keypoint.is);
+        tile_features->level_num_keypoints[level] += 1;
+        if (!describe || level < first_kept_level) {
+          continue;
+        }
+
+        const int num_keypoint_features = DescribeKeypoint(
+            sift.get(),
+            vl_keypoint,
+            &octave_features[num_features],
+            &desc,
+            extract_descriptors ? &octave_descriptors : nullptr,
+            num_features);
+        for (int o = 0; o < num_keypoint_features; ++o) {
+          octave_features[num_features + o].x += tile.x0;
+          octave_features[num_features + o].y += tile.y0;
+          tile_features->orders.emplace_back(
+              level,
+              std::make_pair(vl_keypoint.iy + octave_y0,
+                             vl_keypoint.ix + octave_x0));
+        }
+        num_features += num_keypoint_features;
+      }
+
+      if (num_features == 0) {
+        continue;
+      }
+
+      tile_features->keypoints.insert(tile_features->keypoints.end(),
+                                      octave_features.begin(),
+                                      octave_features.begin() + num_features);
+      if (extract_descriptors) {
+        const FeatureDescriptors::Index prev_num_features =
+            tile_features->descriptors.rows();
+        tile_features->descriptors.conservativeResize(
+            prev_num_features + num_features, 128);
+        tile_features->descriptors.bottomRows(num_features) =
+            octave_descriptors.topRows(num_features);
+      }
+    }
+
+    return true;
+  }
+
+  // Splits the image into overlapping tiles, which are extracted in parallel
+  // if multiple image threads are used. The features are selected and ordered
+  // as in the extraction of the whole image.
+  bool ExtractTiled(const Bitmap& bitmap,
+                    FeatureKeypoints* keypoints,
+                    FeatureDescriptors* descriptors) {
+    const int width = bitmap.Width();
+    const int height = bitmap.Height();
+    const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
+
+    // Align the tiles to the pixels of the coarsest octave, such that the
+    // octaves of the tiles sample the same pixels as those of the image.
+    const int max_octave = options_.first_octave + options_.num_octaves - 1;
+    const int alignment = 1 << std::max(0, max_octave);
+    const int tile_size =
+        (options_.tile_size + alignment - 1) / alignment * alignment;
+
+    // The coarsest features are detected at the last level of the coarsest
+    // octave. Their descriptor window has a radius of about 10.6 sigma and
+    // the smoothing of the scale space adds a few sigma.
+    const double max_sigma =
+        1.6 * std::pow(2.0, 1.0 / options_.octave_resolution + max_octave + 1);
+    const int border =
+        (static_cast<int>(std::ceil(15 * max_sigma)) + alignment - 1) /
+        alignment * alignment;
+
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += tile_size) {
+      for (int x = 0; x < width; x += tile_size) {
+        Tile tile;
+        tile.x0 = std::max(0, x - border);
+        tile.y0 = std::max(0, y - border);
+        tile.width = std::min(width, x + tile_size + border) - tile.x0;
+        tile.height = std::min(height, y + tile_size + border) - tile.y0;
+        tile.core_x0 = x == 0 ? -std::numeric_limits<double>::infinity() : x;
+        tile.core_y0 = y == 0 ? -std::numeric_limits<double>::infinity() : y;
+        tile.core_x1 = x + tile_size >= width
+                           ? std::numeric_limits<double>::infinity()
+                           : x + tile_size;
+        tile.core_y1 = y + tile_size >= height
+                           ? std::numeric_limits<double>::infinity()
+                           : y + tile_size;
+        tiles.push_back(tile);
+      }
+    }
+
+    std::vector<TileFeatures> tile_features;
+    auto ExtractTiles = [this,
+                         &data_uint8,
+                         width,
+                         &tiles,
+                         &tile_features,
+                         descriptors](const bool describe,
+                                      const DogLevel& first_kept_level) {
+      tile_features.clear();
+      tile_features.resize(tiles.size());
+      auto ExtractTileFeatures = [&](const size_t i) {
+        return ExtractTile(data_uint8,
+                           width,
+                           tiles[i],
+                           describe,
+                           first_kept_level,
+                           descriptors != nullptr,
+                           &tile_features[i]);
+      };
+      bool success = true;
+      if (thread_pool_ == nullptr) {
+        for (size_t i = 0; i < tiles.size(); ++i) {
+          success &= ExtractTileFeatures(i);
+        }
+      } else {
+        std::vector<std::future<bool>> futures;
+        futures.reserve(tiles.size());
+        for (size_t i = 0; i < tiles.size(); ++i) {
+          futures.push_back(thread_pool_->AddTask(ExtractTileFeatures, i));
+        }
+        for (auto& future : futures) {
+          success &= future.get();
+        }
+      }
+      return success;
+    };
+
+    auto FindFirstKeptTileDogLevel = [this, &tile_features]() {
+      std::map<DogLevel, int> level_num_keypoints;
+      for (const auto& features : tile_features) {
+        for (const auto& level : features.level_num_keypoints) {
+          level_num_keypoints[level.first] += level.second;
+        }
+      }
+      return FindFirstKeptDogLevel(level_num_keypoints);
+    };
+
+    // In two-pass extraction, the kept DOG levels are determined before
+    // describing any keypoints.
+    DogLevel first_kept_level(std::numeric_limits<int>::min(),
+                              std::numeric_limits<int>::min());
+    if (options_.two_pass_extraction) {
+      if (!ExtractTiles(/*describe=*/false, first_kept_level)) {
+        return false;
+      }
+      first_kept_level = FindFirstKeptTileDogLevel();
+    }
+
+    if (!ExtractTiles(/*describe=*/true, first_kept_level)) {
+      return false;
+    }
+    first_kept_level = FindFirstKeptTileDogLevel();
+
+    // Order the kept features as in the extraction of the whole image, where
+    // the orientations of a keypoint are consecutive.
+    std::vector<std::pair<size_t, size_t>> feature_idxs;
+    for (size_t i = 0; i < tile_features.size(); ++i) {
+      for (size_t j = 0; j < tile_features[i].keypoints.size(); ++j) {
+        if (tile_features[i].orders[j].first >= first_kept_level) {
+          feature_idxs.emplace_back(i, j);
+        }
+      }
+    }
+    std::stable_sort(feature_idxs.begin(),
+                     feature_idxs.end(),
+                     [&tile_features](const std::pair<size_t, size_t>& idx1,
+                                      const std::pair<size_t, size_t>& idx2) {
+                       return tile_features[idx1.first].orders[idx1.second] <
+                              tile_features[idx2.first].orders[idx2.second];
+                     });
+
+    keypoints->resize(feature_idxs.size());
+    for (size_t i = 0; i < feature_idxs.size(); ++i) {
+      const auto& idx = feature_idxs[i];
+      (*keypoints)[i] = tile_features[idx.first].keypoints[idx.second];
+    }
+
+    if (descriptors != nullptr) {
+      FeatureDescriptors vlfeat_descriptors(feature_idxs.size(), 128);
+      for (size_t i = 0; i < feature_idxs.size(); ++i) {
+        const auto& idx = feature_idxs[i];
+        vlfeat_descriptors.row(i) =
+            tile_features[idx.first].descriptors.row(idx.second);
+      }
+      *descriptors = TransformVLFeatToUBCFeatureDescriptors(vlfeat_descriptors);
+    }
+
+    return true;
+  }
+
   const SiftExtractionOptions options_;
   VlSiftType sift_;
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
@@ -723,38 +1241,27 @@ std::unique_ptr<FeatureExtractor> CreateSiftFeatureExtractor(
 
 namespace {
 
-size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
-                                       const float max_ratio,
-                                       const float max_distance,
-                                       std::vector<int>* matches) {
+size_t FindBestMatchesOneWayBruteForce(
+    const std::vector<SiftTopTwoMatch>& top_two_matches,
+    const float max_ratio,
+    const float max_distance,
+    std::vector<int>* matches) {
   // SIFT descriptor vectors are normalized to length 512.
   const float kDistNorm = 1.0f / (512.0f * 512.0f);
 
   size_t num_matches = 0;
-  matches->resize(dists.rows(), -1);
+  matches->resize(top_two_matches.size(), -1);
 
-  for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
-    int best_i2 = -1;
-    int best_dist = 0;
-    int second_best_dist = 0;
-    for (Eigen::Index i2 = 0; i2 < dists.cols(); ++i2) {
-      const int dist = dists(i1, i2);
-      if (dist > best_dist) {
-        best_i2 = i2;
-        second_best_dist = best_dist;
-        best_dist = dist;
-      } else if (dist > second_best_dist) {
-        second_best_dist = dist;
-      }
-    }
+  for (size_t i1 = 0; i1 < top_two_matches.size(); ++i1) {
+    const SiftTopTwoMatch& top_two = top_two_matches[i1];
 
     // Check if any match found.
-    if (best_i2 == -1) {
+    if (top_two.best_idx == -1) {
       continue;
     }
 
     const float best_dist_normed =
-        std::acos(std::min(kDistNorm * best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * top_two.best_dot, 1.0f));
 
     // Check if match distance passes threshold.
     if (best_dist_normed > max_distance) {
@@ -762,7 +1269,7 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     const float second_best_dist_normed =
-        std::acos(std::min(kDistNorm * second_best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * top_two.second_best_dot, 1.0f));
 
     // Check if match passes ratio test. Keep this comparison >= in order to
     // ensure that the case of best == second_best is detected.
@@ -771,13 +1278,16 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     num_matches += 1;
-    (*matches)[i1] = best_i2;
+    (*matches)[i1] = top_two.best_idx;
   }
 
   return num_matches;
 }
 
-void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
+// Extracts the matches from the top two matches in both directions, where
+// top_two_2to1 is only required for cross checking.
+void FindBestMatchesFromTopTwo(const std::vector<SiftTopTwoMatch>& top_two_1to2,
+                               const std::vector<SiftTopTwoMatch>& top_two_2to1,
                                const float max_ratio,
                                const float max_distance,
                                const bool cross_check,
@@ -786,12 +1296,12 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
 
   std::vector<int> matches12;
   const size_t num_matches12 = FindBestMatchesOneWayBruteForce(
-      dists, max_ratio, max_distance, &matches12);
+      top_two_1to2, max_ratio, max_distance, &matches12);
 
   if (cross_check) {
     std::vector<int> matches21;
     const size_t num_matches21 = FindBestMatchesOneWayBruteForce(
-        dists.transpose(), max_ratio, max_distance, &matches21);
+        top_two_2to1, max_ratio, max_distance, &matches21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -815,41 +1325,26 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
   }
 }
 
-Eigen::MatrixXi ComputeSiftDistanceMatrix(
-    const FeatureKeypoints* keypoints1,
-    const FeatureKeypoints* keypoints2,
-    const FeatureDescriptors& descriptors1,
-    const FeatureDescriptors& descriptors2,
-    const std::function<bool(float, float, float, float)>& guided_filter) {
-  if (guided_filter != nullptr) {
-    THROW_CHECK_NOTNULL(keypoints1);
-    THROW_CHECK_NOTNULL(keypoints2);
-    THROW_CHECK_EQ(keypoints1->size(), descriptors1.rows());
-    THROW_CHECK_EQ(keypoints2->size(), descriptors2.rows());
-  }
-
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
-      descriptors1.cast<int>();
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
-      descriptors2.cast<int>();
-
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dists(
-      descriptors1.rows(), descriptors2.rows());
-
-  for (FeatureDescriptors::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
-    for (FeatureDescriptors::Index i2 = 0; i2 < descriptors2.rows(); ++i2) {
-      if (guided_filter != nullptr && guided_filter((*keypoints1)[i1].x,
-                                                    (*keypoints1)[i1].y,
-                                                    (*keypoints2)[i2].x,
-                                                    (*keypoints2)[i2].y)) {
-        dists(i1, i2) = 0;
-      } else {
-        dists(i1, i2) = descriptors1_int.row(i1).dot(descriptors2_int.row(i2));
-      }
-    }
-  }
-
-  return dists;
+void FindBestMatchesBruteForce(const FeatureDescriptors& descriptors1,
+                               const FeatureDescriptors& descriptors2,
+                               const std::function<bool(int, int)>& filter,
+                               const float max_ratio,
+                               const float max_distance,
+                               const bool cross_check,
+                               FeatureMatches* matches) {
+  std::vector<SiftTopTwoMatch> top_two_1to2;
+  std::vector<SiftTopTwoMatch> top_two_2to1;
+  ComputeSiftTopTwoMatches(descriptors1,
+                           descriptors2,
+                           filter,
+                           &top_two_1to2,
+                           cross_check ? &top_two_2to1 : nullptr);
+  FindBestMatchesFromTopTwo(top_two_1to2,
+                            top_two_2to1,
+                            max_ratio,
+                            max_distance,
+                            cross_check,
+                            matches);
 }
 
 void FindNearestNeighborsFlann(
@@ -1000,6 +1495,73 @@ void FindBestMatchesFlann(
   }
 }
 
+class SiftCPUDescriptorIndex : public FeatureDescriptorIndex {
+ public:
+  using FlannIndexType = flann::Index<flann::L2<uint8_t>>;
+
+  SiftCPUDescriptorIndex(std::shared_ptr<const FeatureDescriptors> descriptors,
+                         std::unique_ptr<FlannIndexType> flann_index)
+      : descriptors_(std::move(descriptors)),
+        flann_index_(std::move(flann_index)) {
+    THROW_CHECK_NOTNULL(descriptors_);
+  }
+
+  static std::shared_ptr<const SiftCPUDescriptorIndex> Build(
+      std::shared_ptr<const FeatureDescriptors> descriptors) {
+    THROW_CHECK_NOTNULL(descriptors);
+    THROW_CHECK_EQ(descriptors->cols(), 128);
+    std::unique_ptr<FlannIndexType> flann_index;
+    // Flann is not happy when the input has no descriptors.
+    if (descriptors->rows() > 0) {
+      flann_index = std::make_unique<FlannIndexType>(
+          DescriptorsMatrix(*descriptors),
+          flann::KDTreeIndexParams(kNumTreesInForest));
+      flann_index->buildIndex();
+    }
+    return std::make_shared<const SiftCPUDescriptorIndex>(
+        std::move(descriptors), std::move(flann_index));
+  }
+
+  static flann::Matrix<uint8_t> DescriptorsMatrix(
+      const FeatureDescriptors& descriptors) {
+    return flann::Matrix<uint8_t>(
+        const_cast<uint8_t*>(descriptors.data()), descriptors.rows(), 128);
+  }
+
+  size_t NumBytes() const override {
+    // Each of the randomized kd-trees stores roughly one node and one point
+    // index per descriptor. The referenced descriptors are not counted.
+    return kNumTreesInForest * kNumBytesPerTreeNode * descriptors_->rows();
+  }
+
+  const FeatureDescriptors& Descriptors() const { return *descriptors_; }
+
+  // The FLANN index or nullptr if there are no descriptors.
+  FlannIndexType* FlannIndex() const { return flann_index_.get(); }
+
+ private:
+  static const int kNumTreesInForest = 4;
+  static const int kNumBytesPerTreeNode = 48;
+
+  const std::shared_ptr<const FeatureDescriptors> descriptors_;
+  const std::unique_ptr<FlannIndexType> flann_index_;
+};
+
+uint64_t ComputeDescriptorsChecksum(const FeatureDescriptors& descriptors) {
+  // 64-bit FNV-1a hash over the dimensions and the data of the descriptors.
+  uint64_t checksum = 14695981039346656037ULL;
+  const auto update = [&checksum](const uint64_t value) {
+    checksum ^= value;
+    checksum *= 1099511628211ULL;
+  };
+  update(descriptors.rows());
+  update(descriptors.cols());
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    update(descriptors.data()[i]);
+  }
+  return checksum;
+}
+
 class SiftCPUFeatureMatcher : public FeatureMatcher {
  public:
   explicit SiftCPUFeatureMatcher(const SiftMatchingOptions& options)
@@ -1015,19 +1577,28 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
   void Match(const std::shared_ptr<const FeatureDescriptors>& descriptors1,
              const std::shared_ptr<const FeatureDescriptors>& descriptors2,
              FeatureMatches* matches) override {
+    MatchWithIndices(descriptors1, nullptr, descriptors2, nullptr, matches);
+  }
+
+  void MatchWithIndices(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index1,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors2,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index2,
+      FeatureMatches* matches) override {
     THROW_CHECK_NOTNULL(matches);
     matches->clear();
 
     if (descriptors1 != nullptr) {
       THROW_CHECK_EQ(descriptors1->cols(), 128);
       descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      index1_ = GetSiftCPUDescriptorIndex(index1);
     }
 
     if (descriptors2 != nullptr) {
       THROW_CHECK_EQ(descriptors2->cols(), 128);
       descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      index2_ = GetSiftCPUDescriptorIndex(index2);
     }
 
     THROW_CHECK_NOTNULL(descriptors1_);
@@ -1038,9 +1609,9 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     }
 
     if (options_.brute_force_cpu_matcher) {
-      const Eigen::MatrixXi distances = ComputeSiftDistanceMatrix(
-          nullptr, nullptr, *descriptors1_, *descriptors2_, nullptr);
-      FindBestMatchesBruteForce(distances,
+      FindBestMatchesBruteForce(*descriptors1_,
+                                *descriptors2_,
+                                nullptr,
                                 options_.max_ratio,
                                 options_.max_distance,
                                 options_.cross_check,
@@ -1059,13 +1630,13 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
 
     FindNearestNeighborsFlann(*descriptors1_,
                               *descriptors2_,
-                              *flann_index2_,
+                              *GetOrBuildIndex(descriptors2_, &index2_),
                               &indices_1to2,
                               &distances_1to2);
     if (options_.cross_check) {
       FindNearestNeighborsFlann(*descriptors2_,
                                 *descriptors1_,
-                                *flann_index1_,
+                                *GetOrBuildIndex(descriptors1_, &index1_),
                                 &indices_2to1,
                                 &distances_2to1);
     }
@@ -1080,6 +1651,59 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
                          matches);
   }
 
+  void MatchOneToMany(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::shared_ptr<const FeatureDescriptorIndex>& index1,
+      const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+          descriptors2,
+      const std::vector<std::shared_ptr<const FeatureDescriptorIndex>>&
+          indices2,
+      std::vector<FeatureMatches>* matches) override {
+    if (!options_.brute_force_cpu_matcher) {
+      FeatureMatcher::MatchOneToMany(
+          descriptors1, index1, descriptors2, indices2, matches);
+      return;
+    }
+
+    THROW_CHECK_NOTNULL(descriptors1);
+    THROW_CHECK_EQ(descriptors1->cols(), 128);
+    THROW_CHECK_NOTNULL(matches);
+
+    std::vector<const FeatureDescriptors*> descriptors2_ptrs;
+    descriptors2_ptrs.reserve(descriptors2.size());
+    for (const auto& descriptors : descriptors2) {
+      descriptors2_ptrs.push_back(THROW_CHECK_NOTNULL(descriptors).get());
+    }
+
+    std::vector<std::vector<SiftTopTwoMatch>> top_two_1to2;
+    std::vector<std::vector<SiftTopTwoMatch>> top_two_2to1;
+    ComputeSiftTopTwoMatchesOneToMany(
+        *descriptors1,
+        descriptors2_ptrs,
+        &top_two_1to2,
+        options_.cross_check ? &top_two_2to1 : nullptr);
+    top_two_2to1.resize(descriptors2.size());
+
+    matches->resize(descriptors2.size());
+    for (size_t k = 0; k < descriptors2.size(); ++k) {
+      FindBestMatchesFromTopTwo(top_two_1to2[k],
+                                top_two_2to1[k],
+                                options_.max_ratio,
+                                options_.max_distance,
+                                options_.cross_check,
+                                &(*matches)[k]);
+    }
+
+    // Subsequent calls may refer to the last matched pair.
+    descriptors1_ = descriptors1;
+    index1_ = GetSiftCPUDescriptorIndex(index1);
+    if (!descriptors2.empty()) {
+      descriptors2_ = descriptors2.back();
+      index2_ = indices2.empty() ? nullptr
+                                 : GetSiftCPUDescriptorIndex(indices2.back());
+    }
+  }
+
   void MatchGuided(
       const TwoViewGeometryOptions& options,
       const std::shared_ptr<const FeatureKeypoints>& keypoints1,
@@ -1096,7 +1720,7 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
       THROW_CHECK_EQ(descriptors1->cols(), 128);
       keypoints1_ = keypoints1;
       descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      index1_.reset();
     }
 
     if (descriptors2 != nullptr) {
@@ -1105,7 +1729,7 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
       THROW_CHECK_EQ(descriptors2->cols(), 128);
       keypoints2_ = keypoints2;
       descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      index2_.reset();
     }
 
     const float max_residual =
@@ -1145,57 +1769,51 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
 
     THROW_CHECK(guided_filter);
 
-    const Eigen::MatrixXi dists = ComputeSiftDistanceMatrix(keypoints1_.get(),
-                                                            keypoints2_.get(),
-                                                            *descriptors1_,
-                                                            *descriptors2_,
-                                                            guided_filter);
-
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        indices_1to2(dists.rows(), dists.cols());
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        indices_2to1(dists.cols(), dists.rows());
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        distances_1to2 = dists;
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        distances_2to1 = dists.transpose();
-
-    for (int i = 0; i < indices_1to2.rows(); ++i) {
-      indices_1to2.row(i) = Eigen::VectorXi::LinSpaced(
-          indices_1to2.cols(), 0, indices_1to2.cols() - 1);
-    }
-    for (int i = 0; i < indices_2to1.rows(); ++i) {
-      indices_2to1.row(i) = Eigen::VectorXi::LinSpaced(
-          indices_2to1.cols(), 0, indices_2to1.cols() - 1);
-    }
-
-    FindBestMatchesFlann(indices_1to2,
-                         distances_1to2,
-                         indices_2to1,
-                         distances_2to1,
-                         options_.max_ratio,
-                         options_.max_distance,
-                         options_.cross_check,
-                         &two_view_geometry->inlier_matches);
+    THROW_CHECK_NOTNULL(keypoints1_);
+    THROW_CHECK_NOTNULL(keypoints2_);
+    THROW_CHECK_EQ(keypoints1_->size(), descriptors1_->rows());
+    THROW_CHECK_EQ(keypoints2_->size(), descriptors2_->rows());
+    const FeatureKeypoints& keypoints1_ref = *keypoints1_;
+    const FeatureKeypoints& keypoints2_ref = *keypoints2_;
+
+    FindBestMatchesBruteForce(
+        *descriptors1_,
+        *descriptors2_,
+        [&](const int i1, const int i2) {
+          return guided_filter(keypoints1_ref[i1].x,
+                               keypoints1_ref[i1].y,
+                               keypoints2_ref[i2].x,
+                               keypoints2_ref[i2].y);
+        },
+        options_.max_ratio,
+        options_.max_distance,
+        options_.cross_check,
+        &two_view_geometry->inlier_matches);
   }
 
  private:
-  using FlannIndexType = flann::Index<flann::L2<uint8_t>>;
-
-  static std::unique_ptr<FlannIndexType> BuildFlannIndex(
-      const FeatureDescriptors& descriptors) {
-    THROW_CHECK_EQ(descriptors.cols(), 128);
-    if (descriptors.rows() == 0) {
-      // Flann is not happy when the input has no descriptors.
+  static std::shared_ptr<const SiftCPUDescriptorIndex>
+  GetSiftCPUDescriptorIndex(
+      const std::shared_ptr<const FeatureDescriptorIndex>& index) {
+    if (index == nullptr) {
       return nullptr;
     }
-    const flann::Matrix<uint8_t> descriptors_matrix(
-        const_cast<uint8_t*>(descriptors.data()), descriptors.rows(), 128);
-    constexpr size_t kNumTreesInForest = 4;
-    auto index = std::make_unique<FlannIndexType>(
-        descriptors_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
-    index->buildIndex();
-    return index;
+    auto sift_index =
+        std::dynamic_pointer_cast<const SiftCPUDescriptorIndex>(index);
+    THROW_CHECK_NOTNULL(sift_index);
+    return sift_index;
+  }
+
+  // Returns the FLANN index for the descriptors and lazily builds it, if no
+  // index was passed in by the caller.
+  static SiftCPUDescriptorIndex::FlannIndexType* GetOrBuildIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors,
+      std::shared_ptr<const SiftCPUDescriptorIndex>* index) {
+    if (*index == nullptr) {
+      *index = SiftCPUDescriptorIndex::Build(descriptors);
+    }
+    THROW_CHECK_EQ((*index)->Descriptors().rows(), descriptors->rows());
+    return THROW_CHECK_NOTNULL((*index)->FlannIndex());
   }
 
   const SiftMatchingOptions options_;
@@ -1203,8 +1821,8 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
   std::shared_ptr<const FeatureKeypoints> keypoints2_;
   std::shared_ptr<const FeatureDescriptors> descriptors1_;
   std::shared_ptr<const FeatureDescriptors> descriptors2_;
-  std::unique_ptr<FlannIndexType> flann_index1_;
-  std::unique_ptr<FlannIndexType> flann_index2_;
+  std::shared_ptr<const SiftCPUDescriptorIndex> index1_;
+  std::shared_ptr<const SiftCPUDescriptorIndex> index2_;
 };
 
 #if defined(COLMAP_GPU_ENABLED)
@@ -1456,6 +2074,77 @@ std::unique_ptr<FeatureMatcher> CreateSiftFeatureMatcher(
   }
 }
 
+std::shared_ptr<const FeatureDescriptorIndex> CreateSiftCPUDescriptorIndex(
+    std::shared_ptr<const FeatureDescriptors> descriptors) {
+  return SiftCPUDescriptorIndex::Build(std::move(descriptors));
+}
+
+void WriteSiftCPUDescriptorIndex(const std::string& path,
+                                 const FeatureDescriptorIndex& index) {
+  const auto* sift_index = dynamic_cast<const SiftCPUDescriptorIndex*>(&index);
+  THROW_CHECK_NOTNULL(sift_index);
+
+  // Write to a temporary file first, so that concurrent readers never see a
+  // partially written index. The random suffix keeps the temporary files of
+  // concurrent writers apart, also across processes sharing the directory.
+  std::random_device random_device;
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp" << std::hex << random_device() << random_device();
+
+  if (sift_index->FlannIndex() != nullptr) {
+    sift_index->FlannIndex()->save(tmp_path.str());
+  }
+
+  // FLANN ignores trailing data when loading, so the checksum of the indexed
+  // descriptors is appended as a footer.
+  std::ofstream file(tmp_path.str(), std::ios::binary | std::ios::app);
+  THROW_CHECK_FILE_OPEN(file, tmp_path.str());
+  WriteBinaryLittleEndian<uint64_t>(&file, sift_index->Descriptors().rows());
+  WriteBinaryLittleEndian<uint64_t>(
+      &file, ComputeDescriptorsChecksum(sift_index->Descriptors()));
+  file.close();
+
+  THROW_CHECK_EQ(std::rename(tmp_path.str().c_str(), path.c_str()), 0)
+      << "Failed to write " << path;
+}
+
+std::shared_ptr<const FeatureDescriptorIndex> ReadSiftCPUDescriptorIndex(
+    const std::string& path,
+    std::shared_ptr<const FeatureDescriptors> descriptors) {
+  THROW_CHECK_NOTNULL(descriptors);
+  THROW_CHECK_EQ(descriptors->cols(), 128);
+
+  if (!ExistsFile(path)) {
+    return nullptr;
+  }
+
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  THROW_CHECK_FILE_OPEN(file, path);
+  const std::streamoff kFooterNumBytes = 2 * sizeof(uint64_t);
+  if (static_cast<std::streamoff>(file.tellg()) < kFooterNumBytes) {
+    return nullptr;
+  }
+  file.seekg(-kFooterNumBytes, std::ios::end);
+  const uint64_t num_descriptors = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t checksum = ReadBinaryLittleEndian<uint64_t>(&file);
+  file.close();
+
+  if (num_descriptors != static_cast<uint64_t>(descriptors->rows()) ||
+      checksum != ComputeDescriptorsChecksum(*descriptors)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<SiftCPUDescriptorIndex::FlannIndexType> flann_index;
+  if (descriptors->rows() > 0) {
+    flann_index = std::make_unique<SiftCPUDescriptorIndex::FlannIndexType>(
+        SiftCPUDescriptorIndex::DescriptorsMatrix(*descriptors),
+        flann::SavedIndexParams(path));
+  }
+
+  return std::make_shared<const SiftCPUDescriptorIndex>(std::move(descriptors),
+                                                        std::move(flann_index));
+}
+
 void LoadSiftFeaturesFromTextFile(const std::string& path,
                                   FeatureKeypoints* keypoints,
                                   FeatureDescriptors* descriptors) {
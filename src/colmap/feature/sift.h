@@ -98,6 +98,26 @@ struct SiftExtractionOptions {
   // Sift implementation is faster.
   bool force_covariant_extractor = false;
 
+  // Whether the CPU extractor first detects the keypoints in all octaves and
+  // only then computes orientations and descriptors for the keypoints kept
+  // under max_num_features. This builds the scale space twice but avoids
+  // describing discarded keypoints, which pays off if far more keypoints are
+  // detected than kept, e.g., for high-resolution images.
+  bool two_pass_extraction = false;
+
+  // Number of threads used within a single image by the CPU extractor, i.e.,
+  // to describe the keypoints in two-pass extraction and to extract the tiles
+  // of large images. Note that num_threads images are extracted in parallel,
+  // each with this number of threads.
+  int num_image_threads = 1;
+
+  // If positive, images larger than this size are split into tiles of this
+  // size, which are extracted in parallel with num_image_threads. The tiles
+  // overlap by the support region of the coarsest features, but the output is
+  // only approximately equal to that of the whole image due to boundary
+  // effects at the tile borders. Disabled by default.
+  int tile_size = 0;
+
   enum class Normalization {
     // L1-normalizes each descriptor followed by element-wise square rooting.
     // This normalization is usually better than standard L2-normalization.
@@ -150,12 +170,50 @@ struct SiftMatchingOptions {
   // Whether to use brute-force instead of FLANN based CPU matching.
   bool brute_force_cpu_matcher = false;
 
+  // Maximum memory in megabytes of the per-image search indices for FLANN
+  // based CPU matching, including their descriptors, which are cached and
+  // shared by all matching threads.
+  // Set to 0 to disable the cache and build the indices in each thread.
+  int cpu_index_cache_size = 1024;
+
+  // Optional directory, e.g., next to the database, in which the search
+  // indices for CPU matching are persisted and reused in later matching runs.
+  std::string cpu_index_cache_path = "";
+
+  // Maximum number of image pairs with the same first image that one CPU
+  // matching thread matches together, such that the descriptors of the first
+  // image are loaded once and scanned in a single pass for all pairs. Set to 1
+  // to match every pair separately.
+  int cpu_batch_size = 32;
+
+  // Optional path to a feature store directory, from which keypoints and
+  // descriptors are read and to which the raw matches are written instead of
+  // the database. Two-view geometries are always written to the database.
+  std::string feature_store_path = "";
+
   bool Check() const;
 };
 
 std::unique_ptr<FeatureMatcher> CreateSiftFeatureMatcher(
     const SiftMatchingOptions& options);
 
+// Build the search index used by the FLANN based CPU matcher over the given
+// descriptors. The index keeps a reference to the descriptors.
+std::shared_ptr<const FeatureDescriptorIndex> CreateSiftCPUDescriptorIndex(
+    std::shared_ptr<const FeatureDescriptors> descriptors);
+
+// Write the search index of the CPU matcher to a binary file. The descriptors
+// themselves are not written but only a checksum of them.
+void WriteSiftCPUDescriptorIndex(const std::string& path,
+                                 const FeatureDescriptorIndex& index);
+
+// Read the search index of the CPU matcher for the given descriptors from a
+// binary file. Returns nullptr if the file does not exist or if the index was
+// built for different descriptors.
+std::shared_ptr<const FeatureDescriptorIndex> ReadSiftCPUDescriptorIndex(
+    const std::string& path,
+    std::shared_ptr<const FeatureDescriptors> descriptors);
+
 // Load keypoints and descriptors from text file in the following format:
 //
 //    LINE_0:            NUM_FEATURES DIM
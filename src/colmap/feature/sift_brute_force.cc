@@ -0,0 +1,441 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/sift_brute_force.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+
+#if defined(COLMAP_SIMD_ENABLED) &&                  \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define COLMAP_SIFT_X86_KERNELS
+#include <immintrin.h>
+#define COLMAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define COLMAP_TARGET_AVX512_VNNI \
+  __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#endif
+
+namespace colmap {
+namespace {
+
+constexpr int kDim = 128;
+
+// Number of descriptors of the first and second set processed per tile. A tile
+// of the second set occupies 32KB and the corresponding dot products 64KB, so
+// that both stay in the L2 cache while the first set is streamed over them.
+constexpr int kRowTileSize = 64;
+constexpr int kColTileSize = 256;
+
+// Number of descriptors of the first set, i.e., 128KB, that stay in the L2
+// cache while matching them against multiple other sets.
+constexpr int kRowBlockSize = 1024;
+
+// Computes the row-major num_a x num_b matrix of dot products between the
+// 128-dimensional descriptors stored contiguously in a and b.
+typedef void (*DotProductsFunc)(const uint8_t* a,
+                                int num_a,
+                                const uint8_t* b,
+                                int num_b,
+                                int* dots);
+
+void ComputeDotProductsPortable(const uint8_t* a,
+                                const int num_a,
+                                const uint8_t* b,
+                                const int num_b,
+                                int* dots) {
+  for (int i = 0; i < num_a; ++i) {
+    const uint8_t* a_i = a + i * kDim;
+    for (int j = 0; j < num_b; ++j) {
+      const uint8_t* b_j = b + j * kDim;
+      int dot = 0;
+      for (int k = 0; k < kDim; ++k) {
+        dot += static_cast<int>(a_i[k]) * static_cast<int>(b_j[k]);
+      }
+      dots[i * num_b + j] = dot;
+    }
+  }
+}
+
+#if defined(COLMAP_SIFT_X86_KERNELS)
+
+COLMAP_TARGET_AVX2 inline int HorizontalSumAvx2(const __m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Zero-extends 16 bytes to 16-bit integers. Products of two such values are
+// at most 2 * 255 * 255 after the pairwise addition in madd, so the 32-bit
+// accumulation is exact.
+COLMAP_TARGET_AVX2 inline __m256i LoadWidenedAvx2(const uint8_t* ptr) {
+  return _mm256_cvtepu8_epi16(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+}
+
+COLMAP_TARGET_AVX2 inline int DotProductAvx2(const uint8_t* a,
+                                             const uint8_t* b) {
+  __m256i acc = _mm256_setzero_si256();
+  for (int k = 0; k < kDim; k += 16) {
+    acc = _mm256_add_epi32(
+        acc, _mm256_madd_epi16(LoadWidenedAvx2(a + k), LoadWidenedAvx2(b + k)));
+  }
+  return HorizontalSumAvx2(acc);
+}
+
+COLMAP_TARGET_AVX2 void ComputeDotProductsAvx2(const uint8_t* a,
+                                               const int num_a,
+                                               const uint8_t* b,
+                                               const int num_b,
+                                               int* dots) {
+  int i = 0;
+  // Register-blocked 2x2 micro-kernel: every loaded chunk is used twice.
+  for (; i + 1 < num_a; i += 2) {
+    const uint8_t* a0 = a + i * kDim;
+    const uint8_t* a1 = a0 + kDim;
+    int* dots0 = dots + i * num_b;
+    int* dots1 = dots0 + num_b;
+    int j = 0;
+    for (; j + 1 < num_b; j += 2) {
+      const uint8_t* b0 = b + j * kDim;
+      const uint8_t* b1 = b0 + kDim;
+      __m256i acc00 = _mm256_setzero_si256();
+      __m256i acc01 = _mm256_setzero_si256();
+      __m256i acc10 = _mm256_setzero_si256();
+      __m256i acc11 = _mm256_setzero_si256();
+      for (int k = 0; k < kDim; k += 16) {
+        const __m256i va0 = LoadWidenedAvx2(a0 + k);
+        const __m256i va1 = LoadWidenedAvx2(a1 + k);
+        const __m256i vb0 = LoadWidenedAvx2(b0 + k);
+        const __m256i vb1 = LoadWidenedAvx2(b1 + k);
+        acc00 = _mm256_add_epi32(acc00, _mm256_madd_epi16(va0, vb0));
+        acc01 = _mm256_add_epi32(acc01, _mm256_madd_epi16(va0, vb1));
+        acc10 = _mm256_add_epi32(acc10, _mm256_madd_epi16(va1, vb0));
+        acc11 = _mm256_add_epi32(acc11, _mm256_madd_epi16(va1, vb1));
+      }
+      dots0[j] = HorizontalSumAvx2(acc00);
+      dots0[j + 1] = HorizontalSumAvx2(acc01);
+      dots1[j] = HorizontalSumAvx2(acc10);
+      dots1[j + 1] = HorizontalSumAvx2(acc11);
+    }
+    if (j < num_b) {
+      dots0[j] = DotProductAvx2(a0, b + j * kDim);
+      dots1[j] = DotProductAvx2(a1, b + j * kDim);
+    }
+  }
+  if (i < num_a) {
+    for (int j = 0; j < num_b; ++j) {
+      dots[i * num_b + j] = DotProductAvx2(a + i * kDim, b + j * kDim);
+    }
+  }
+}
+
+// VNNI only provides unsigned x signed byte products. The identity
+// a * b = a * (b - 128) + 128 * sum(a) makes the uint8 x uint8 dot product
+// exact, since b - 128 fits into a signed byte.
+COLMAP_TARGET_AVX512_VNNI inline int SumBytesAvx512(const __m512i lo,
+                                                    const __m512i hi) {
+  const __m512i zero = _mm512_setzero_si512();
+  return static_cast<int>(_mm512_reduce_add_epi64(
+      _mm512_add_epi64(_mm512_sad_epu8(lo, zero), _mm512_sad_epu8(hi, zero))));
+}
+
+COLMAP_TARGET_AVX512_VNNI void ComputeDotProductsAvx512Vnni(const uint8_t* a,
+                                                            const int num_a,
+                                                            const uint8_t* b,
+                                                            const int num_b,
+                                                            int* dots) {
+  const __m512i sign_flip = _mm512_set1_epi8(static_cast<char>(0x80));
+  for (int i = 0; i < num_a; ++i) {
+    const uint8_t* a_i = a + i * kDim;
+    const __m512i va_lo = _mm512_loadu_si512(a_i);
+    const __m512i va_hi = _mm512_loadu_si512(a_i + 64);
+    const int offset = 128 * SumBytesAvx512(va_lo, va_hi);
+    int* dots_i = dots + i * num_b;
+    int j = 0;
+    for (; j + 1 < num_b; j += 2) {
+      const uint8_t* b0 = b + j * kDim;
+      const uint8_t* b1 = b0 + kDim;
+      const __m512i vb0_lo =
+          _mm512_xor_si512(_mm512_loadu_si512(b0), sign_flip);
+      const __m512i vb0_hi =
+          _mm512_xor_si512(_mm512_loadu_si512(b0 + 64), sign_flip);
+      const __m512i vb1_lo =
+          _mm512_xor_si512(_mm512_loadu_si512(b1), sign_flip);
+      const __m512i vb1_hi =
+          _mm512_xor_si512(_mm512_loadu_si512(b1 + 64), sign_flip);
+      __m512i acc0 = _mm512_dpbusd_epi32(_mm512_setzero_si512(), va_lo, vb0_lo);
+      __m512i acc1 = _mm512_dpbusd_epi32(_mm512_setzero_si512(), va_lo, vb1_lo);
+      acc0 = _mm512_dpbusd_epi32(acc0, va_hi, vb0_hi);
+      acc1 = _mm512_dpbusd_epi32(acc1, va_hi, vb1_hi);
+      dots_i[j] = _mm512_reduce_add_epi32(acc0) + offset;
+      dots_i[j + 1] = _mm512_reduce_add_epi32(acc1) + offset;
+    }
+    if (j < num_b) {
+      const uint8_t* b0 = b + j * kDim;
+      const __m512i vb0_lo =
+          _mm512_xor_si512(_mm512_loadu_si512(b0), sign_flip);
+      const __m512i vb0_hi =
+          _mm512_xor_si512(_mm512_loadu_si512(b0 + 64), sign_flip);
+      __m512i acc0 = _mm512_dpbusd_epi32(_mm512_setzero_si512(), va_lo, vb0_lo);
+      acc0 = _mm512_dpbusd_epi32(acc0, va_hi, vb0_hi);
+      dots_i[j] = _mm512_reduce_add_epi32(acc0) + offset;
+    }
+  }
+}
+
+#endif  // COLMAP_SIFT_X86_KERNELS
+
+DotProductsFunc GetDotProductsFunc(const SiftDotProductKernel kernel) {
+  THROW_CHECK(IsSiftDotProductKernelSupported(kernel))
+      << "SIFT dot product kernel " << static_cast<int>(kernel)
+      << " not supported";
+  switch (kernel) {
+#if defined(COLMAP_SIFT_X86_KERNELS)
+    case SiftDotProductKernel::AVX2:
+      return &ComputeDotProductsAvx2;
+    case SiftDotProductKernel::AVX512_VNNI:
+      return &ComputeDotProductsAvx512Vnni;
+#endif  // COLMAP_SIFT_X86_KERNELS
+    default:
+      return &ComputeDotProductsPortable;
+  }
+}
+
+inline void UpdateTopTwoMatch(const int idx,
+                              const int dot,
+                              SiftTopTwoMatch* top_two) {
+  if (dot > top_two->best_dot) {
+    top_two->best_idx = idx;
+    top_two->second_best_dot = top_two->best_dot;
+    top_two->best_dot = dot;
+  } else if (dot > top_two->second_best_dot) {
+    top_two->second_best_dot = dot;
+  }
+}
+
+// Updates the top two matches of the num_rows x num_cols tile of dot products
+// between the descriptors starting at row_begin in the first set and at
+// col_begin in the second set.
+void UpdateTopTwoMatchesInTile(const int* tile_dots,
+                               const int row_begin,
+                               const int num_rows,
+                               const int col_begin,
+                               const int num_cols,
+                               const std::function<bool(int, int)>& filter,
+                               SiftTopTwoMatch* top_two_1to2,
+                               SiftTopTwoMatch* top_two_2to1) {
+  for (int r = 0; r < num_rows; ++r) {
+    const int i1 = row_begin + r;
+    const int* row_dots = tile_dots + r * num_cols;
+    SiftTopTwoMatch& top_two1 = top_two_1to2[i1];
+    for (int c = 0; c < num_cols; ++c) {
+      const int i2 = col_begin + c;
+      const int dot = (filter != nullptr && filter(i1, i2)) ? 0 : row_dots[c];
+      UpdateTopTwoMatch(i2, dot, &top_two1);
+      if (top_two_2to1 != nullptr) {
+        UpdateTopTwoMatch(i1, dot, &top_two_2to1[i2]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool IsSiftDotProductKernelSupported(const SiftDotProductKernel kernel) {
+  switch (kernel) {
+    case SiftDotProductKernel::PORTABLE:
+      return true;
+#if defined(COLMAP_SIFT_X86_KERNELS)
+    case SiftDotProductKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case SiftDotProductKernel::AVX512_VNNI:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vnni");
+#endif  // COLMAP_SIFT_X86_KERNELS
+    default:
+      return false;
+  }
+}
+
+SiftDotProductKernel GetBestSiftDotProductKernel() {
+  static const SiftDotProductKernel kBestKernel = []() {
+    for (const SiftDotProductKernel kernel :
+         {SiftDotProductKernel::AVX512_VNNI, SiftDotProductKernel::AVX2}) {
+      if (IsSiftDotProductKernelSupported(kernel)) {
+        return kernel;
+      }
+    }
+    return SiftDotProductKernel::PORTABLE;
+  }();
+  return kBestKernel;
+}
+
+void ComputeSiftDotProducts(const FeatureDescriptors& descriptors1,
+                            const FeatureDescriptors& descriptors2,
+                            const SiftDotProductKernel kernel,
+                            int* dots) {
+  THROW_CHECK_EQ(descriptors1.cols(), kDim);
+  THROW_CHECK_EQ(descriptors2.cols(), kDim);
+  THROW_CHECK_NOTNULL(dots);
+  GetDotProductsFunc(kernel)(descriptors1.data(),
+                             descriptors1.rows(),
+                             descriptors2.data(),
+                             descriptors2.rows(),
+                             dots);
+}
+
+void ComputeSiftTopTwoMatches(const FeatureDescriptors& descriptors1,
+                              const FeatureDescriptors& descriptors2,
+                              const std::function<bool(int, int)>& filter,
+                              std::vector<SiftTopTwoMatch>* top_two_1to2,
+                              std::vector<SiftTopTwoMatch>* top_two_2to1,
+                              const SiftDotProductKernel kernel) {
+  THROW_CHECK_EQ(descriptors1.cols(), kDim);
+  THROW_CHECK_EQ(descriptors2.cols(), kDim);
+  THROW_CHECK_NOTNULL(top_two_1to2);
+
+  const int num_descriptors1 = descriptors1.rows();
+  const int num_descriptors2 = descriptors2.rows();
+
+  top_two_1to2->clear();
+  top_two_1to2->resize(num_descriptors1);
+  if (top_two_2to1 != nullptr) {
+    top_two_2to1->clear();
+    top_two_2to1->resize(num_descriptors2);
+  }
+
+  const DotProductsFunc dot_products_func = GetDotProductsFunc(kernel);
+
+  std::vector<int> tile_dots(kRowTileSize * kColTileSize);
+
+  // The outer loop over tiles of the second set and the inner loop over the
+  // first set ensure that every row and every column sees its candidates in
+  // increasing index order, which keeps the tie-breaking identical to a
+  // sequential scan over the full distance matrix.
+  for (int col_begin = 0; col_begin < num_descriptors2;
+       col_begin += kColTileSize) {
+    const int num_cols = std::min(kColTileSize, num_descriptors2 - col_begin);
+    const uint8_t* cols_data = descriptors2.data() + col_begin * kDim;
+    for (int row_begin = 0; row_begin < num_descriptors1;
+         row_begin += kRowTileSize) {
+      const int num_rows =
+          std::min(kRowTileSize, num_descriptors1 - row_begin);
+      dot_products_func(descriptors1.data() + row_begin * kDim,
+                        num_rows,
+                        cols_data,
+                        num_cols,
+                        tile_dots.data());
+      UpdateTopTwoMatchesInTile(
+          tile_dots.data(),
+          row_begin,
+          num_rows,
+          col_begin,
+          num_cols,
+          filter,
+          top_two_1to2->data(),
+          top_two_2to1 != nullptr ? top_two_2to1->data() : nullptr);
+    }
+  }
+}
+
+void ComputeSiftTopTwoMatchesOneToMany(
+    const FeatureDescriptors& descriptors1,
+    const std::vector<const FeatureDescriptors*>& descriptors2,
+    std::vector<std::vector<SiftTopTwoMatch>>* top_two_1to2,
+    std::vector<std::vector<SiftTopTwoMatch>>* top_two_2to1,
+    const SiftDotProductKernel kernel) {
+  THROW_CHECK_EQ(descriptors1.cols(), kDim);
+  THROW_CHECK_NOTNULL(top_two_1to2);
+
+  const int num_descriptors1 = descriptors1.rows();
+
+  top_two_1to2->clear();
+  top_two_1to2->resize(descriptors2.size());
+  if (top_two_2to1 != nullptr) {
+    top_two_2to1->clear();
+    top_two_2to1->resize(descriptors2.size());
+  }
+  for (size_t k = 0; k < descriptors2.size(); ++k) {
+    THROW_CHECK_NOTNULL(descriptors2[k]);
+    THROW_CHECK_EQ(descriptors2[k]->cols(), kDim);
+    (*top_two_1to2)[k].resize(num_descriptors1);
+    if (top_two_2to1 != nullptr) {
+      (*top_two_2to1)[k].resize(descriptors2[k]->rows());
+    }
+  }
+
+  const DotProductsFunc dot_products_func = GetDotProductsFunc(kernel);
+
+  std::vector<int> tile_dots(kRowTileSize * kColTileSize);
+
+  // Within a block, the loops are the same as in ComputeSiftTopTwoMatches and
+  // the blocks are processed in increasing order, so every row and every
+  // column still sees its candidates in increasing index order.
+  for (int block_begin = 0; block_begin < num_descriptors1;
+       block_begin += kRowBlockSize) {
+    const int block_end =
+        std::min(block_begin + kRowBlockSize, num_descriptors1);
+    for (size_t k = 0; k < descriptors2.size(); ++k) {
+      const FeatureDescriptors& descriptors2_k = *descriptors2[k];
+      const int num_descriptors2 = descriptors2_k.rows();
+      SiftTopTwoMatch* top_two_2to1_k =
+          top_two_2to1 != nullptr ? (*top_two_2to1)[k].data() : nullptr;
+      for (int col_begin = 0; col_begin < num_descriptors2;
+           col_begin += kColTileSize) {
+        const int num_cols =
+            std::min(kColTileSize, num_descriptors2 - col_begin);
+        const uint8_t* cols_data = descriptors2_k.data() + col_begin * kDim;
+        for (int row_begin = block_begin; row_begin < block_end;
+             row_begin += kRowTileSize) {
+          const int num_rows = std::min(kRowTileSize, block_end - row_begin);
+          dot_products_func(descriptors1.data() + row_begin * kDim,
+                            num_rows,
+                            cols_data,
+                            num_cols,
+                            tile_dots.data());
+          UpdateTopTwoMatchesInTile(tile_dots.data(),
+                                    row_begin,
+                                    num_rows,
+                                    col_begin,
+                                    num_cols,
+                                    nullptr,
+                                    (*top_two_1to2)[k].data(),
+                                    top_two_2to1_k);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace colmap
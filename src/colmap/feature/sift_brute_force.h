@@ -0,0 +1,97 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/feature/types.h"
+
+#include <functional>
+#include <vector>
+
+namespace colmap {
+
+// Implementations of the uint8 SIFT descriptor dot product. The vectorized
+// kernels are selected at runtime depending on the capabilities of the CPU.
+enum class SiftDotProductKernel {
+  PORTABLE = 0,
+  AVX2 = 1,
+  AVX512_VNNI = 2,
+};
+
+// Whether the given kernel is compiled in and supported by the current CPU.
+bool IsSiftDotProductKernelSupported(SiftDotProductKernel kernel);
+
+// The fastest kernel supported by the current CPU.
+SiftDotProductKernel GetBestSiftDotProductKernel();
+
+// Best and second best dot product of one descriptor against a set of
+// descriptors. A best index of -1 means that all dot products are zero.
+struct SiftTopTwoMatch {
+  int best_idx = -1;
+  int best_dot = 0;
+  int second_best_dot = 0;
+};
+
+// Compute the dot products of all rows in descriptors1 against all rows in
+// descriptors2 and store them in the row-major num_descriptors1 x
+// num_descriptors2 matrix dots. Mainly intended for testing and small inputs.
+void ComputeSiftDotProducts(const FeatureDescriptors& descriptors1,
+                            const FeatureDescriptors& descriptors2,
+                            SiftDotProductKernel kernel,
+                            int* dots);
+
+// Find the best and second best match of every descriptor in descriptors1
+// among descriptors2 (top_two_1to2) and, optionally, vice versa
+// (top_two_2to1). The dot products are computed tile by tile in a single
+// streaming pass, so the full distance matrix is never materialized. Pairs for
+// which the optional filter returns true are treated as having a dot product
+// of zero. Ties are resolved in favor of the smaller index.
+void ComputeSiftTopTwoMatches(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    const std::function<bool(int, int)>& filter,
+    std::vector<SiftTopTwoMatch>* top_two_1to2,
+    std::vector<SiftTopTwoMatch>* top_two_2to1,
+    SiftDotProductKernel kernel = GetBestSiftDotProductKernel());
+
+// Same as ComputeSiftTopTwoMatches without filter for one set of descriptors
+// against multiple other sets, where (*top_two_1to2)[k] and, optionally,
+// (*top_two_2to1)[k] hold the top two matches between descriptors1 and
+// *descriptors2[k]. Blocks of descriptors1 stay in the cache while the tiles of
+// all other sets are streamed over them, so that descriptors1 is read from
+// memory once per block instead of once per tile of every other set. The
+// results are identical to separate calls of ComputeSiftTopTwoMatches.
+void ComputeSiftTopTwoMatchesOneToMany(
+    const FeatureDescriptors& descriptors1,
+    const std::vector<const FeatureDescriptors*>& descriptors2,
+    std::vector<std::vector<SiftTopTwoMatch>>* top_two_1to2,
+    std::vector<std::vector<SiftTopTwoMatch>>* top_two_2to1,
+    SiftDotProductKernel kernel = GetBestSiftDotProductKernel());
+
+}  // namespace colmap
@@ -0,0 +1,253 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/sift_brute_force.h"
+
+#include "colmap/math/random.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+FeatureDescriptors CreateRandomDescriptors(const int num_descriptors) {
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = RandomUniformInteger<int>(0, 255);
+  }
+  return descriptors;
+}
+
+std::vector<int> ComputeReferenceDotProducts(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2) {
+  const Eigen::MatrixXi dots =
+      descriptors1.cast<int>() * descriptors2.cast<int>().transpose();
+  std::vector<int> dots_row_major;
+  for (Eigen::Index i1 = 0; i1 < dots.rows(); ++i1) {
+    for (Eigen::Index i2 = 0; i2 < dots.cols(); ++i2) {
+      dots_row_major.push_back(dots(i1, i2));
+    }
+  }
+  return dots_row_major;
+}
+
+const std::vector<SiftDotProductKernel> kAllKernels = {
+    SiftDotProductKernel::PORTABLE,
+    SiftDotProductKernel::AVX2,
+    SiftDotProductKernel::AVX512_VNNI,
+};
+
+TEST(ComputeSiftDotProducts, Nominal) {
+  SetPRNGSeed(0);
+  EXPECT_TRUE(IsSiftDotProductKernelSupported(SiftDotProductKernel::PORTABLE));
+  EXPECT_TRUE(IsSiftDotProductKernelSupported(GetBestSiftDotProductKernel()));
+  // Odd sizes exercise the remainder paths of the blocked kernels.
+  const FeatureDescriptors descriptors1 = CreateRandomDescriptors(17);
+  const FeatureDescriptors descriptors2 = CreateRandomDescriptors(33);
+  const std::vector<int> ref_dots =
+      ComputeReferenceDotProducts(descriptors1, descriptors2);
+  for (const SiftDotProductKernel kernel : kAllKernels) {
+    if (!IsSiftDotProductKernelSupported(kernel)) {
+      continue;
+    }
+    std::vector<int> dots(ref_dots.size());
+    ComputeSiftDotProducts(descriptors1, descriptors2, kernel, dots.data());
+    EXPECT_EQ(dots, ref_dots);
+  }
+}
+
+TEST(ComputeSiftDotProducts, MaxValues) {
+  FeatureDescriptors descriptors1(3, 128);
+  descriptors1.setConstant(255);
+  FeatureDescriptors descriptors2(2, 128);
+  descriptors2.setConstant(255);
+  for (const SiftDotProductKernel kernel : kAllKernels) {
+    if (!IsSiftDotProductKernelSupported(kernel)) {
+      continue;
+    }
+    std::vector<int> dots(6);
+    ComputeSiftDotProducts(descriptors1, descriptors2, kernel, dots.data());
+    EXPECT_EQ(dots, std::vector<int>(6, 128 * 255 * 255));
+  }
+}
+
+TEST(ComputeSiftTopTwoMatches, Nominal) {
+  SetPRNGSeed(0);
+  // Sizes larger than a tile and with duplicate descriptors to test ties.
+  const int kNumDescriptors1 = 150;
+  const int kNumDescriptors2 = 301;
+  const FeatureDescriptors descriptors1 =
+      CreateRandomDescriptors(kNumDescriptors1);
+  FeatureDescriptors descriptors2 = CreateRandomDescriptors(kNumDescriptors2);
+  descriptors2.row(7) = descriptors2.row(3);
+  descriptors2.row(280) = descriptors1.row(5);
+  const std::vector<int> ref_dots =
+      ComputeReferenceDotProducts(descriptors1, descriptors2);
+
+  const std::function<bool(int, int)> filter = [](const int i1,
+                                                  const int i2) {
+    return (i1 + i2) % 5 == 0;
+  };
+
+  for (const bool use_filter : {false, true}) {
+    std::vector<SiftTopTwoMatch> ref_top_two_1to2(kNumDescriptors1);
+    std::vector<SiftTopTwoMatch> ref_top_two_2to1(kNumDescriptors2);
+    const auto update = [](const int idx,
+                           const int dot,
+                           SiftTopTwoMatch* top_two) {
+      if (dot > top_two->best_dot) {
+        top_two->best_idx = idx;
+        top_two->second_best_dot = top_two->best_dot;
+        top_two->best_dot = dot;
+      } else if (dot > top_two->second_best_dot) {
+        top_two->second_best_dot = dot;
+      }
+    };
+    for (int i1 = 0; i1 < kNumDescriptors1; ++i1) {
+      for (int i2 = 0; i2 < kNumDescriptors2; ++i2) {
+        const int dot = (use_filter && filter(i1, i2))
+                            ? 0
+                            : ref_dots[i1 * kNumDescriptors2 + i2];
+        update(i2, dot, &ref_top_two_1to2[i1]);
+        update(i1, dot, &ref_top_two_2to1[i2]);
+      }
+    }
+
+    for (const SiftDotProductKernel kernel : kAllKernels) {
+      if (!IsSiftDotProductKernelSupported(kernel)) {
+        continue;
+      }
+      std::vector<SiftTopTwoMatch> top_two_1to2;
+      std::vector<SiftTopTwoMatch> top_two_2to1;
+      ComputeSiftTopTwoMatches(descriptors1,
+                               descriptors2,
+                               use_filter ? filter : nullptr,
+                               &top_two_1to2,
+                               &top_two_2to1,
+                               kernel);
+      ASSERT_EQ(top_two_1to2.size(), kNumDescriptors1);
+      ASSERT_EQ(top_two_2to1.size(), kNumDescriptors2);
+      for (int i1 = 0; i1 < kNumDescriptors1; ++i1) {
+        EXPECT_EQ(top_two_1to2[i1].best_idx, ref_top_two_1to2[i1].best_idx);
+        EXPECT_EQ(top_two_1to2[i1].best_dot, ref_top_two_1to2[i1].best_dot);
+        EXPECT_EQ(top_two_1to2[i1].second_best_dot,
+                  ref_top_two_1to2[i1].second_best_dot);
+      }
+      for (int i2 = 0; i2 < kNumDescriptors2; ++i2) {
+        EXPECT_EQ(top_two_2to1[i2].best_idx, ref_top_two_2to1[i2].best_idx);
+        EXPECT_EQ(top_two_2to1[i2].best_dot, ref_top_two_2to1[i2].best_dot);
+        EXPECT_EQ(top_two_2to1[i2].second_best_dot,
+                  ref_top_two_2to1[i2].second_best_dot);
+      }
+    }
+  }
+}
+
+TEST(ComputeSiftTopTwoMatches, Empty) {
+  const FeatureDescriptors descriptors1 = CreateRandomDescriptors(0);
+  const FeatureDescriptors descriptors2 = CreateRandomDescriptors(3);
+  std::vector<SiftTopTwoMatch> top_two_1to2;
+  std::vector<SiftTopTwoMatch> top_two_2to1;
+  ComputeSiftTopTwoMatches(
+      descriptors1, descriptors2, nullptr, &top_two_1to2, &top_two_2to1);
+  EXPECT_TRUE(top_two_1to2.empty());
+  ASSERT_EQ(top_two_2to1.size(), 3);
+  for (const auto& top_two : top_two_2to1) {
+    EXPECT_EQ(top_two.best_idx, -1);
+  }
+}
+
+TEST(ComputeSiftTopTwoMatchesOneToMany, Nominal) {
+  SetPRNGSeed(0);
+  // Query larger than a block and sets of different sizes including ties.
+  const FeatureDescriptors descriptors1 = CreateRandomDescriptors(1100);
+  std::vector<FeatureDescriptors> descriptors2;
+  descriptors2.push_back(CreateRandomDescriptors(301));
+  descriptors2.push_back(CreateRandomDescriptors(0));
+  descriptors2.push_back(CreateRandomDescriptors(17));
+  descriptors2[0].row(7) = descriptors2[0].row(3);
+  descriptors2[0].row(280) = descriptors1.row(1050);
+  descriptors2[2].row(1) = descriptors1.row(5);
+  std::vector<const FeatureDescriptors*> descriptors2_ptrs;
+  for (const auto& descriptors : descriptors2) {
+    descriptors2_ptrs.push_back(&descriptors);
+  }
+
+  for (const SiftDotProductKernel kernel : kAllKernels) {
+    if (!IsSiftDotProductKernelSupported(kernel)) {
+      continue;
+    }
+    for (const bool cross_check : {false, true}) {
+      std::vector<std::vector<SiftTopTwoMatch>> top_two_1to2;
+      std::vector<std::vector<SiftTopTwoMatch>> top_two_2to1;
+      ComputeSiftTopTwoMatchesOneToMany(descriptors1,
+                                        descriptors2_ptrs,
+                                        &top_two_1to2,
+                                        cross_check ? &top_two_2to1 : nullptr,
+                                        kernel);
+      ASSERT_EQ(top_two_1to2.size(), descriptors2.size());
+      ASSERT_EQ(top_two_2to1.size(), cross_check ? descriptors2.size() : 0);
+      for (size_t k = 0; k < descriptors2.size(); ++k) {
+        std::vector<SiftTopTwoMatch> ref_top_two_1to2;
+        std::vector<SiftTopTwoMatch> ref_top_two_2to1;
+        ComputeSiftTopTwoMatches(descriptors1,
+                                 descriptors2[k],
+                                 nullptr,
+                                 &ref_top_two_1to2,
+                                 &ref_top_two_2to1,
+                                 kernel);
+        ASSERT_EQ(top_two_1to2[k].size(), ref_top_two_1to2.size());
+        for (size_t i1 = 0; i1 < ref_top_two_1to2.size(); ++i1) {
+          EXPECT_EQ(top_two_1to2[k][i1].best_idx,
+                    ref_top_two_1to2[i1].best_idx);
+          EXPECT_EQ(top_two_1to2[k][i1].best_dot,
+                    ref_top_two_1to2[i1].best_dot);
+          EXPECT_EQ(top_two_1to2[k][i1].second_best_dot,
+                    ref_top_two_1to2[i1].second_best_dot);
+        }
+        if (!cross_check) {
+          continue;
+        }
+        ASSERT_EQ(top_two_2to1[k].size(), ref_top_two_2to1.size());
+        for (size_t i2 = 0; i2 < ref_top_two_2to1.size(); ++i2) {
+          EXPECT_EQ(top_two_2to1[k][i2].best_idx,
+                    ref_top_two_2to1[i2].best_idx);
+          EXPECT_EQ(top_two_2to1[k][i2].best_dot,
+                    ref_top_two_2to1[i2].best_dot);
+          EXPECT_EQ(top_two_2to1[k][i2].second_best_dot,
+                    ref_top_two_2to1[i2].second_best_dot);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace colmap
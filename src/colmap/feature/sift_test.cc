@@ -40,6 +40,7 @@
 #include "colmap/math/math.h"
 #include "colmap/math/random.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/testing.h"
 
 #include "thirdparty/SiftGPU/SiftGPU.h"
 
@@ -88,6 +89,162 @@ TEST(ExtractSiftFeaturesCPU, Nominal) {
   }
 }
 
+TEST(ExtractSiftFeaturesCPU, TwoPass) {
+  Bitmap bitmap;
+  CreateImageWithSquare(256, &bitmap);
+
+  for (const int max_num_features : {1, 10, 8192}) {
+    SiftExtractionOptions options;
+    options.use_gpu = false;
+    options.max_num_features = max_num_features;
+    auto extractor = CreateSiftFeatureExtractor(options);
+    options.two_pass_extraction = true;
+    options.num_image_threads = 2;
+    auto two_pass_extractor = CreateSiftFeatureExtractor(options);
+
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+    FeatureKeypoints two_pass_keypoints;
+    FeatureDescriptors two_pass_descriptors;
+    EXPECT_TRUE(two_pass_extractor->Extract(
+        bitmap, &two_pass_keypoints, &two_pass_descriptors));
+
+    ASSERT_EQ(keypoints.size(), two_pass_keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); ++i) {
+      EXPECT_EQ(keypoints[i].x, two_pass_keypoints[i].x);
+      EXPECT_EQ(keypoints[i].y, two_pass_keypoints[i].y);
+      EXPECT_EQ(keypoints[i].ComputeScale(),
+                two_pass_keypoints[i].ComputeScale());
+      EXPECT_EQ(keypoints[i].ComputeOrientation(),
+                two_pass_keypoints[i].ComputeOrientation());
+    }
+    EXPECT_EQ(descriptors, two_pass_descriptors);
+  }
+}
+
+TEST(ExtractSiftFeaturesCPU, ReuseForImagesOfSameSize) {
+  Bitmap bitmap1;
+  CreateImageWithSquare(256, &bitmap1);
+  Bitmap bitmap2;
+  bitmap2.Allocate(256, 256, false);
+  bitmap2.Fill(BitmapColor<uint8_t>(0));
+  for (int y = 68; y < 132; ++y) {
+    for (int x = 58; x < 122; ++x) {
+      bitmap2.SetPixel(x, y, BitmapColor<uint8_t>(200));
+    }
+  }
+
+  // The extractor keeps its VLFeat filter for images of the same size, which
+  // must not leak the gradients of the previously extracted image. Only a few
+  // features are kept, such that the first octaves are skipped when
+  // describing the features in the two-pass extraction.
+  for (const bool two_pass_extraction : {false, true}) {
+    SiftExtractionOptions options;
+    options.use_gpu = false;
+    options.max_num_features = 5;
+    options.two_pass_extraction = two_pass_extraction;
+    auto extractor = CreateSiftFeatureExtractor(options);
+    auto fresh_extractor = CreateSiftFeatureExtractor(options);
+
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    EXPECT_TRUE(extractor->Extract(bitmap1, &keypoints, &descriptors));
+    EXPECT_TRUE(extractor->Extract(bitmap2, &keypoints, &descriptors));
+
+    FeatureKeypoints fresh_keypoints;
+    FeatureDescriptors fresh_descriptors;
+    EXPECT_TRUE(fresh_extractor->Extract(
+        bitmap2, &fresh_keypoints, &fresh_descriptors));
+
+    ASSERT_EQ(keypoints.size(), fresh_keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); ++i) {
+      EXPECT_EQ(keypoints[i].x, fresh_keypoints[i].x);
+      EXPECT_EQ(keypoints[i].y, fresh_keypoints[i].y);
+      EXPECT_EQ(keypoints[i].ComputeOrientation(),
+                fresh_keypoints[i].ComputeOrientation());
+    }
+    EXPECT_EQ(descriptors, fresh_descriptors);
+  }
+}
+
+TEST(ExtractSiftFeaturesCPU, Tiled) {
+  // The squares are not aligned with the tiles, such that many features are
+  // detected close to the tile seams and in the overlap of adjacent tiles.
+  Bitmap bitmap;
+  bitmap.Allocate(1024, 768, false);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      const bool inside = (x % 96) > 24 + y / 64 && (y % 96) > 32 + x / 64;
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(inside ? 255 : 0));
+    }
+  }
+
+  for (const bool two_pass_extraction : {false, true}) {
+    SiftExtractionOptions options;
+    options.use_gpu = false;
+    // Few octaves keep the overlap of the tiles small, such that the image is
+    // split into 8x6 tiles that each cover only a fraction of the image.
+    options.num_octaves = 2;
+    options.two_pass_extraction = two_pass_extraction;
+    auto extractor = CreateSiftFeatureExtractor(options);
+    options.num_image_threads = 2;
+    options.tile_size = 128;
+    auto tiled_extractor = CreateSiftFeatureExtractor(options);
+
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+    FeatureKeypoints tiled_keypoints;
+    FeatureDescriptors tiled_descriptors;
+    EXPECT_TRUE(
+        tiled_extractor->Extract(bitmap, &tiled_keypoints, &tiled_descriptors));
+
+    // The features only differ due to boundary effects at the tile borders.
+    ASSERT_GT(keypoints.size(), 1000);
+    EXPECT_NEAR(keypoints.size(),
+                tiled_keypoints.size(),
+                0.05 * keypoints.size());
+    EXPECT_EQ(tiled_descriptors.rows(), tiled_keypoints.size());
+
+    // Each feature is found once at the same position with a similar
+    // descriptor and in the same order as in the extraction of the whole
+    // image, also if it lies in the overlap of multiple tiles.
+    std::vector<bool> matched(keypoints.size(), false);
+    size_t num_equal_features = 0;
+    size_t num_ordered_features = 0;
+    int prev_idx = -1;
+    for (size_t i = 0; i < tiled_keypoints.size(); ++i) {
+      for (size_t j = 0; j < keypoints.size(); ++j) {
+        if (matched[j] ||
+            std::abs(keypoints[j].x - tiled_keypoints[i].x) > 1e-3 ||
+            std::abs(keypoints[j].y - tiled_keypoints[i].y) > 1e-3 ||
+            std::abs(keypoints[j].ComputeOrientation() -
+                     tiled_keypoints[i].ComputeOrientation()) > 1e-3) {
+          continue;
+        }
+        matched[j] = true;
+        const double descriptor_dist =
+            (descriptors.row(j).cast<double>() -
+             tiled_descriptors.row(i).cast<double>())
+                .norm();
+        if (descriptor_dist < 0.05 * descriptors.row(j).cast<double>().norm()) {
+          num_equal_features += 1;
+        }
+        if (static_cast<int>(j) > prev_idx) {
+          num_ordered_features += 1;
+        }
+        prev_idx = j;
+        break;
+      }
+    }
+    EXPECT_GE(num_equal_features, 0.9 * keypoints.size());
+    EXPECT_GE(num_ordered_features, 0.9 * keypoints.size());
+  }
+}
+
 TEST(ExtractCovariantSiftFeaturesCPU, Nominal) {
   Bitmap bitmap;
   CreateImageWithSquare(256, &bitmap);
@@ -366,6 +523,136 @@ TEST(SiftCPUFeatureMatcher, Nominal) {
   EXPECT_EQ(matches.size(), 0);
 }
 
+TEST(SiftCPUFeatureMatcherWithIndices, Nominal) {
+  const auto empty_descriptors = std::make_shared<FeatureDescriptors>(0, 128);
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+  EXPECT_EQ(matches.size(), 50);
+
+  const auto index1 = CreateSiftCPUDescriptorIndex(descriptors1);
+  const auto index2 = CreateSiftCPUDescriptorIndex(descriptors2);
+  EXPECT_GT(index1->NumBytes(), 0);
+
+  FeatureMatches matches_with_indices;
+  matcher->MatchWithIndices(
+      descriptors1, index1, descriptors2, index2, &matches_with_indices);
+  CheckEqualMatches(matches, matches_with_indices);
+
+  matcher->MatchWithIndices(
+      descriptors1, nullptr, nullptr, nullptr, &matches_with_indices);
+  CheckEqualMatches(matches, matches_with_indices);
+
+  matcher->MatchWithIndices(empty_descriptors,
+                            CreateSiftCPUDescriptorIndex(empty_descriptors),
+                            descriptors2,
+                            index2,
+                            &matches_with_indices);
+  EXPECT_EQ(matches_with_indices.size(), 0);
+}
+
+TEST(SiftCPUFeatureMatcherOneToMany, Nominal) {
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const std::vector<std::shared_ptr<const FeatureDescriptors>> descriptors2 = {
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse()),
+      std::make_shared<FeatureDescriptors>(0, 128),
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(30)),
+      std::make_shared<FeatureDescriptors>(*descriptors1),
+  };
+
+  for (const bool brute_force_cpu_matcher : {false, true}) {
+    for (const bool cross_check : {false, true}) {
+      SiftMatchingOptions options;
+      options.use_gpu = false;
+      options.brute_force_cpu_matcher = brute_force_cpu_matcher;
+      options.cross_check = cross_check;
+      auto matcher = CreateSiftFeatureMatcher(options);
+
+      std::vector<FeatureMatches> matches;
+      matcher->MatchOneToMany(
+          descriptors1, nullptr, descriptors2, {}, &matches);
+      ASSERT_EQ(matches.size(), descriptors2.size());
+      EXPECT_EQ(matches[0].size(), 50);
+      EXPECT_EQ(matches[1].size(), 0);
+      EXPECT_EQ(matches[3].size(), 50);
+
+      auto pair_matcher = CreateSiftFeatureMatcher(options);
+      for (size_t k = 0; k < descriptors2.size(); ++k) {
+        FeatureMatches pair_matches;
+        pair_matcher->Match(descriptors1, descriptors2[k], &pair_matches);
+        CheckEqualMatches(matches[k], pair_matches);
+      }
+
+      // Subsequent calls can reuse the descriptors of the last pair.
+      FeatureMatches last_matches;
+      matcher->Match(nullptr, nullptr, &last_matches);
+      CheckEqualMatches(matches.back(), last_matches);
+
+      std::vector<std::shared_ptr<const FeatureDescriptorIndex>> indices2;
+      for (const auto& descriptors : descriptors2) {
+        indices2.push_back(CreateSiftCPUDescriptorIndex(descriptors));
+      }
+      std::vector<FeatureMatches> matches_with_indices;
+      matcher->MatchOneToMany(descriptors1,
+                              CreateSiftCPUDescriptorIndex(descriptors1),
+                              descriptors2,
+                              indices2,
+                              &matches_with_indices);
+      ASSERT_EQ(matches_with_indices.size(), descriptors2.size());
+      for (size_t k = 0; k < descriptors2.size(); ++k) {
+        CheckEqualMatches(matches[k], matches_with_indices[k]);
+      }
+    }
+  }
+}
+
+TEST(SiftCPUDescriptorIndex, ReadWrite) {
+  const std::string test_dir = CreateTestDir();
+  const std::string index_path = test_dir + "/index.flann";
+  const std::string empty_index_path = test_dir + "/empty_index.flann";
+
+  const auto empty_descriptors = std::make_shared<FeatureDescriptors>(0, 128);
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+
+  EXPECT_EQ(ReadSiftCPUDescriptorIndex(index_path, descriptors2), nullptr);
+
+  WriteSiftCPUDescriptorIndex(index_path,
+                              *CreateSiftCPUDescriptorIndex(descriptors2));
+  WriteSiftCPUDescriptorIndex(
+      empty_index_path, *CreateSiftCPUDescriptorIndex(empty_descriptors));
+
+  // Indices are only valid for the descriptors they were built from.
+  EXPECT_EQ(ReadSiftCPUDescriptorIndex(index_path, descriptors1), nullptr);
+  EXPECT_EQ(ReadSiftCPUDescriptorIndex(index_path, empty_descriptors),
+            nullptr);
+  EXPECT_NE(ReadSiftCPUDescriptorIndex(empty_index_path, empty_descriptors),
+            nullptr);
+
+  const auto index2 = ReadSiftCPUDescriptorIndex(index_path, descriptors2);
+  ASSERT_NE(index2, nullptr);
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.cross_check = false;
+  auto matcher = CreateSiftFeatureMatcher(options);
+  FeatureMatches matches;
+  matcher->MatchWithIndices(
+      descriptors1, nullptr, descriptors2, index2, &matches);
+  EXPECT_EQ(matches.size(), 50);
+}
+
 TEST(SiftCPUFeatureMatcherFlannVsBruteForce, Nominal) {
   SiftMatchingOptions match_options;
   match_options.max_num_matches = 1000;
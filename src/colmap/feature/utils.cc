@@ -30,6 +30,9 @@
 #include "colmap/feature/utils.h"
 
 #include "colmap/math/math.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
 
 namespace colmap {
 
@@ -102,4 +105,32 @@ void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
   *descriptors = std::move(top_scale_descriptors);
 }
 
+void SortFeatureMatchesByDescriptorDistance(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    FeatureMatches* matches) {
+  THROW_CHECK_EQ(descriptors1.cols(), descriptors2.cols());
+
+  std::vector<std::pair<int, FeatureMatch>> distances;
+  distances.reserve(matches->size());
+  for (const auto& match : *matches) {
+    const int distance =
+        (descriptors1.row(match.point2D_idx1).cast<int>() -
+         descriptors2.row(match.point2D_idx2).cast<int>())
+            .squaredNorm();
+    distances.emplace_back(distance, match);
+  }
+
+  std::stable_sort(distances.begin(),
+                   distances.end(),
+                   [](const std::pair<int, FeatureMatch>& distance1,
+                      const std::pair<int, FeatureMatch>& distance2) {
+                     return distance1.first < distance2.first;
+                   });
+
+  for (size_t i = 0; i < distances.size(); ++i) {
+    (*matches)[i] = distances[i].second;
+  }
+}
+
 }  // namespace colmap
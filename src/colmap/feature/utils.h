@@ -57,4 +57,12 @@ void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
                              FeatureDescriptors* descriptors,
                              size_t num_features);
 
+// Sort the matches by increasing descriptor distance, i.e., by decreasing
+// match quality, as assumed by PROSAC. Matches with equal distance keep their
+// relative order.
+void SortFeatureMatchesByDescriptorDistance(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    FeatureMatches* matches);
+
 }  // namespace colmap
@@ -110,5 +110,25 @@ TEST(ExtractTopScaleFeatures, Nominal) {
   EXPECT_EQ(top_descriptors6, descriptors);
 }
 
+TEST(SortFeatureMatchesByDescriptorDistance, Nominal) {
+  FeatureDescriptors descriptors1 = FeatureDescriptors::Zero(3, 128);
+  FeatureDescriptors descriptors2 = FeatureDescriptors::Zero(3, 128);
+  descriptors2(0, 0) = 3;
+  descriptors2(1, 0) = 1;
+  descriptors2(2, 0) = 2;
+
+  FeatureMatches matches = {{0, 0}, {1, 1}, {2, 2}, {0, 1}};
+  SortFeatureMatchesByDescriptorDistance(descriptors1, descriptors2, &matches);
+  ASSERT_EQ(matches.size(), 4);
+  EXPECT_EQ(matches[0].point2D_idx1, 1);
+  EXPECT_EQ(matches[0].point2D_idx2, 1);
+  EXPECT_EQ(matches[1].point2D_idx1, 0);
+  EXPECT_EQ(matches[1].point2D_idx2, 1);
+  EXPECT_EQ(matches[2].point2D_idx1, 2);
+  EXPECT_EQ(matches[2].point2D_idx2, 2);
+  EXPECT_EQ(matches[3].point2D_idx1, 0);
+  EXPECT_EQ(matches[3].point2D_idx2, 0);
+}
+
 }  // namespace
 }  // namespace colmap
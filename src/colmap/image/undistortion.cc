@@ -37,10 +37,55 @@
 #include "colmap/util/threading.h"
 
 #include <fstream>
+#include <map>
+#include <tuple>
 
 namespace colmap {
 namespace {
 
+// Memory budget of the remap table caches of the undistorters. The undistorters
+// process images in a thread pool, so tables that are not precomputed are
+// computed single-threaded in each task.
+const size_t kRemapTableCacheNumBytes = 1 << 30;
+
+// Compute the remap tables of the cameras shared by multiple images with all
+// workers of the thread pool, before the images are undistorted in its tasks.
+// Otherwise, the first task would compute the table of a shared camera alone,
+// while the other tasks wait for it. The tables of cameras of single images
+// are computed by their tasks in parallel, and no more tables are precomputed
+// than fit into the cache.
+void PrecomputeRemapTables(const UndistortCameraOptions& options,
+                           const std::vector<const Camera*>& cameras,
+                           ThreadPool* thread_pool,
+                           WarpRemapTableCache* remap_table_cache) {
+  // Not all undistorters have camera identifiers, so cameras are identified
+  // by the same properties as in the cache.
+  using CameraKey =
+      std::tuple<CameraModelId, size_t, size_t, std::vector<double>>;
+  std::map<CameraKey, int> num_camera_images;
+  for (const Camera* camera : cameras) {
+    num_camera_images[CameraKey(
+        camera->model_id, camera->width, camera->height, camera->params)] += 1;
+  }
+
+  for (const Camera* camera : cameras) {
+    int& num_images = num_camera_images[CameraKey(
+        camera->model_id, camera->width, camera->height, camera->params)];
+    if (num_images < 2) {
+      continue;
+    }
+    // Mark the camera as done.
+    num_images = 0;
+    const size_t num_tables = remap_table_cache->NumTables();
+    remap_table_cache->Get(
+        *camera, UndistortCamera(options, *camera), thread_pool);
+    if (remap_table_cache->NumTables() <= num_tables) {
+      // The table evicted another table from the cache.
+      break;
+    }
+  }
+}
+
 template <typename Derived>
 void WriteMatrix(const Eigen::MatrixBase<Derived>& matrix,
                  std::ofstream* file) {
@@ -167,7 +212,8 @@ COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
       copy_type_(copy_type),
       num_patch_match_src_images_(num_patch_match_src_images),
       reconstruction_(reconstruction),
-      image_ids_(image_ids) {}
+      image_ids_(image_ids),
+      remap_table_cache_(kRemapTableCacheNumBytes, /*num_threads=*/1) {}
 
 void COLMAPUndistorter::Run() {
   PrintHeading1("Image undistortion");
@@ -188,6 +234,19 @@ void COLMAPUndistorter::Run() {
       JoinPaths(output_path_, "stereo/consistency_graphs"));
 
   ThreadPool thread_pool;
+
+  // Already undistorted images are copied without a remap table.
+  std::vector<const Camera*> cameras;
+  for (const image_t image_id :
+       image_ids_.empty() ? reconstruction_.RegImageIds() : image_ids_) {
+    const Camera& camera =
+        reconstruction_.Camera(reconstruction_.Image(image_id).CameraId());
+    if (!camera.IsUndistorted() || options_.max_image_size >= 0) {
+      cameras.push_back(&camera);
+    }
+  }
+  PrecomputeRemapTables(options_, cameras, &thread_pool, &remap_table_cache_);
+
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
   if (image_ids_.empty()) {
@@ -271,7 +330,8 @@ bool COLMAPUndistorter::Undistort(const image_t image_id) const {
                  distorted_bitmap,
                  camera,
                  &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera,
+                 &remap_table_cache_);
   return undistorted_bitmap.Write(output_image_path);
 }
 
@@ -313,7 +373,8 @@ PMVSUndistorter::PMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      remap_table_cache_(kRemapTableCacheNumBytes, /*num_threads=*/1) {}
 
 void PMVSUndistorter::Run() {
   Timer run_timer;
@@ -326,6 +387,14 @@ void PMVSUndistorter::Run() {
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs/models"));
 
   ThreadPool thread_pool;
+
+  std::vector<const Camera*> cameras;
+  for (const image_t image_id : reconstruction_.RegImageIds()) {
+    cameras.push_back(
+        &reconstruction_.Camera(reconstruction_.Image(image_id).CameraId()));
+  }
+  PrecomputeRemapTables(options_, cameras, &thread_pool, &remap_table_cache_);
+
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
   for (size_t i = 0; i < reconstruction_.NumRegImages(); ++i) {
@@ -395,7 +464,8 @@ bool PMVSUndistorter::Undistort(const size_t reg_image_idx) const {
                  distorted_bitmap,
                  camera,
                  &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera,
+                 &remap_table_cache_);
 
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
   return undistorted_bitmap.Write(output_image_path);
@@ -552,7 +622,8 @@ CMPMVSUndistorter::CMPMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      remap_table_cache_(kRemapTableCacheNumBytes, /*num_threads=*/1) {}
 
 void CMPMVSUndistorter::Run() {
   Timer run_timer;
@@ -560,6 +631,14 @@ void CMPMVSUndistorter::Run() {
   PrintHeading1("Image undistortion (CMP-MVS)");
 
   ThreadPool thread_pool;
+
+  std::vector<const Camera*> cameras;
+  for (const image_t image_id : reconstruction_.RegImageIds()) {
+    cameras.push_back(
+        &reconstruction_.Camera(reconstruction_.Image(image_id).CameraId()));
+  }
+  PrecomputeRemapTables(options_, cameras, &thread_pool, &remap_table_cache_);
+
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
   for (size_t i = 0; i < reconstruction_.NumRegImages(); ++i) {
@@ -604,7 +683,8 @@ bool CMPMVSUndistorter::Undistort(const size_t reg_image_idx) const {
                  distorted_bitmap,
                  camera,
                  &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera,
+                 &remap_table_cache_);
 
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
   return undistorted_bitmap.Write(output_image_path);
@@ -618,7 +698,8 @@ PureImageUndistorter::PureImageUndistorter(
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      image_names_and_cameras_(image_names_and_cameras) {}
+      image_names_and_cameras_(image_names_and_cameras),
+      remap_table_cache_(kRemapTableCacheNumBytes, /*num_threads=*/1) {}
 
 void PureImageUndistorter::Run() {
   Timer run_timer;
@@ -628,6 +709,13 @@ void PureImageUndistorter::Run() {
   CreateDirIfNotExists(output_path_);
 
   ThreadPool thread_pool;
+
+  std::vector<const Camera*> cameras;
+  for (const auto& image_name_and_camera : image_names_and_cameras_) {
+    cameras.push_back(&image_name_and_camera.second);
+  }
+  PrecomputeRemapTables(options_, cameras, &thread_pool, &remap_table_cache_);
+
   std::vector<std::future<bool>> futures;
   size_t num_images = image_names_and_cameras_.size();
   futures.reserve(num_images);
@@ -669,7 +757,8 @@ bool PureImageUndistorter::Undistort(const size_t image_idx) const {
                  distorted_bitmap,
                  camera,
                  &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera,
+                 &remap_table_cache_);
 
   return undistorted_bitmap.Write(output_image_path);
 }
@@ -756,6 +845,7 @@ void StereoImageRectifier::Rectify(const image_t image_id1,
   Bitmap undistorted_bitmap2;
   Camera undistorted_camera;
   Eigen::Matrix4d Q;
+  // The pairs are already rectified in parallel by the thread pool.
   RectifyAndUndistortStereoImages(options_,
                                   distorted_bitmap1,
                                   distorted_bitmap2,
@@ -765,7 +855,8 @@ void StereoImageRectifier::Rectify(const image_t image_id1,
                                   &undistorted_bitmap1,
                                   &undistorted_bitmap2,
                                   &undistorted_camera,
-                                  &Q);
+                                  &Q,
+                                  /*num_threads=*/1);
 
   undistorted_bitmap1.Write(output_image1_path);
   undistorted_bitmap2.Write(output_image2_path);
@@ -959,7 +1050,8 @@ void UndistortImage(const UndistortCameraOptions& options,
                     const Bitmap& distorted_bitmap,
                     const Camera& distorted_camera,
                     Bitmap* undistorted_bitmap,
-                    Camera* undistorted_camera) {
+                    Camera* undistorted_camera,
+                    WarpRemapTableCache* remap_table_cache) {
   THROW_CHECK_EQ(distorted_camera.width, distorted_bitmap.Width());
   THROW_CHECK_EQ(distorted_camera.height, distorted_bitmap.Height());
 
@@ -969,10 +1061,17 @@ void UndistortImage(const UndistortCameraOptions& options,
                                distorted_bitmap.IsRGB());
   distorted_bitmap.CloneMetadata(undistorted_bitmap);
 
-  WarpImageBetweenCameras(distorted_camera,
-                          *undistorted_camera,
-                          distorted_bitmap,
-                          undistorted_bitmap);
+  if (remap_table_cache == nullptr) {
+    WarpImageBetweenCameras(distorted_camera,
+                            *undistorted_camera,
+                            distorted_bitmap,
+                            undistorted_bitmap);
+  } else {
+    WarpImageWithRemapTable(
+        *remap_table_cache->Get(distorted_camera, *undistorted_camera),
+        distorted_bitmap,
+        undistorted_bitmap);
+  }
 }
 
 void UndistortReconstruction(const UndistortCameraOptions& options,
@@ -1071,7 +1170,8 @@ void RectifyAndUndistortStereoImages(const UndistortCameraOptions& options,
                                      Bitmap* undistorted_image1,
                                      Bitmap* undistorted_image2,
                                      Camera* undistorted_camera,
-                                     Eigen::Matrix4d* Q) {
+                                     Eigen::Matrix4d* Q,
+                                     const int num_threads) {
   THROW_CHECK_EQ(distorted_camera1.width, distorted_image1.Width());
   THROW_CHECK_EQ(distorted_camera1.height, distorted_image1.Height());
   THROW_CHECK_EQ(distorted_camera2.width, distorted_image2.Width());
@@ -1093,16 +1193,17 @@ void RectifyAndUndistortStereoImages(const UndistortCameraOptions& options,
   RectifyStereoCameras(
       *undistorted_camera, *undistorted_camera, cam2_from_cam1, &H1, &H2, Q);
 
-  WarpImageWithHomographyBetweenCameras(H1.inverse(),
-                                        distorted_camera1,
-                                        *undistorted_camera,
-                                        distorted_image1,
-                                        undistorted_image1);
-  WarpImageWithHomographyBetweenCameras(H2.inverse(),
-                                        distorted_camera2,
-                                        *undistorted_camera,
-                                        distorted_image2,
-                                        undistorted_image2);
+  // The homographies differ for every pair, so the tables are not cached.
+  WarpImageWithRemapTable(
+      ComputeWarpRemapTableWithHomography(
+          H1.inverse(), distorted_camera1, *undistorted_camera, num_threads),
+      distorted_image1,
+      undistorted_image1);
+  WarpImageWithRemapTable(
+      ComputeWarpRemapTableWithHomography(
+          H2.inverse(), distorted_camera2, *undistorted_camera, num_threads),
+      distorted_image2,
+      undistorted_image2);
 }
 
 }  // namespace colmap
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/geometry/rigid3.h"
+#include "colmap/image/warp.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/base_controller.h"
@@ -88,6 +89,7 @@ class COLMAPUndistorter : public BaseController {
   const Reconstruction& reconstruction_;
   const std::vector<image_t> image_ids_;
   std::vector<std::string> image_names_;
+  mutable WarpRemapTableCache remap_table_cache_;
 };
 
 // Undistort images and prepare data for CMVS/PMVS.
@@ -113,6 +115,7 @@ class PMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  mutable WarpRemapTableCache remap_table_cache_;
 };
 
 // Undistort images and prepare data for CMP-MVS.
@@ -132,6 +135,7 @@ class CMPMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  mutable WarpRemapTableCache remap_table_cache_;
 };
 
 // Undistort images and export undistorted cameras without the need for a
@@ -154,6 +158,7 @@ class PureImageUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const std::vector<std::pair<std::string, Camera>>& image_names_and_cameras_;
+  mutable WarpRemapTableCache remap_table_cache_;
 };
 
 // Rectify stereo image pairs.
@@ -200,12 +205,15 @@ Camera UndistortCamera(const UndistortCameraOptions& options,
 
 // Undistort image such that the viewing geometry of the undistorted image
 // follows a pinhole camera model. See `UndistortCamera` for more details
-// on the undistortion conventions.
+// on the undistortion conventions. If a remap table cache is given, the
+// pixel mapping is looked up in (or added to) the cache, so that it is only
+// computed once for all images with the same camera.
 void UndistortImage(const UndistortCameraOptions& options,
                     const Bitmap& distorted_image,
                     const Camera& distorted_camera,
                     Bitmap* undistorted_image,
-                    Camera* undistorted_camera);
+                    Camera* undistorted_camera,
+                    WarpRemapTableCache* remap_table_cache = nullptr);
 
 // Undistort all cameras in the reconstruction and accordingly all
 // observations in their corresponding images.
@@ -224,7 +232,8 @@ void RectifyStereoCameras(const Camera& camera1,
                           Eigen::Matrix3d* H2,
                           Eigen::Matrix4d* Q);
 
-// Rectify and undistort the stereo image pair using the given geometry.
+// Rectify and undistort the stereo image pair using the given geometry. The
+// pixel mappings are computed using the given number of threads.
 void RectifyAndUndistortStereoImages(const UndistortCameraOptions& options,
                                      const Bitmap& distorted_image1,
                                      const Bitmap& distorted_image2,
@@ -234,6 +243,7 @@ void RectifyAndUndistortStereoImages(const UndistortCameraOptions& options,
                                      Bitmap* undistorted_image1,
                                      Bitmap* undistorted_image2,
                                      Camera* undistorted_camera,
-                                     Eigen::Matrix4d* Q);
+                                     Eigen::Matrix4d* Q,
+                                     int num_threads = -1);
 
 }  // namespace colmap
@@ -31,6 +31,7 @@
 
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
 #include "thirdparty/VLFeat/imopv.h"
 
@@ -51,6 +52,164 @@ float GetPixelConstantBorder(const float* data,
   }
 }
 
+// Set the table entry of the given pixel for the given source coordinate,
+// which uses the same pixel and border conventions as
+// Bitmap::InterpolateBilinear.
+void SetWarpRemapTableEntry(const Eigen::Vector2d& source_point,
+                            const int idx,
+                            WarpRemapTable* table) {
+  const double x = source_point.x() - 0.5;
+  const double y = source_point.y() - 0.5;
+  if (x >= 0 && x < table->width - 1 && y > 0 && y <= table->height - 1) {
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::ceil(y)) - 1;
+    table->source_x[idx] = x0;
+    table->source_y[idx] = y0;
+    table->weight_x[idx] = static_cast<float>(x - x0);
+    table->weight_y[idx] = static_cast<float>(y - y0);
+  } else {
+    table->source_x[idx] = -1;
+    table->source_y[idx] = -1;
+    table->weight_x[idx] = 0;
+    table->weight_y[idx] = 0;
+  }
+}
+
+WarpRemapTable AllocateWarpRemapTable(const Camera& source_camera,
+                                      const Camera& target_camera) {
+  WarpRemapTable table;
+  table.width = static_cast<int>(source_camera.width);
+  table.height = static_cast<int>(source_camera.height);
+  table.target_width = static_cast<int>(target_camera.width);
+  table.target_height = static_cast<int>(target_camera.height);
+  const size_t num_pixels = static_cast<size_t>(table.width) * table.height;
+  table.source_x.resize(num_pixels);
+  table.source_y.resize(num_pixels);
+  table.weight_x.resize(num_pixels);
+  table.weight_y.resize(num_pixels);
+  return table;
+}
+
+// Fill the table rows in parallel, where source_from_target maps the target
+// pixel coordinates (with the upper left pixel center at (0.5, 0.5)) to
+// source pixel coordinates.
+template <typename Func>
+void FillWarpRemapTable(const Func& source_from_target,
+                        const int num_threads,
+                        ThreadPool* thread_pool,
+                        WarpRemapTable* table) {
+  auto FillRows = [&source_from_target, table](const int begin_row,
+                                               const int end_row) {
+    Eigen::Vector2d image_point;
+    for (int y = begin_row; y < end_row; ++y) {
+      image_point.y() = y + 0.5;
+      for (int x = 0; x < table->width; ++x) {
+        image_point.x() = x + 0.5;
+        SetWarpRemapTableEntry(
+            source_from_target(image_point), y * table->width + x, table);
+      }
+    }
+  };
+
+  std::unique_ptr<ThreadPool> owned_thread_pool;
+  if (thread_pool == nullptr) {
+    const int effective_num_threads = GetEffectiveNumThreads(num_threads);
+    if (effective_num_threads == 1) {
+      FillRows(0, table->height);
+      return;
+    }
+    owned_thread_pool = std::make_unique<ThreadPool>(effective_num_threads);
+    thread_pool = owned_thread_pool.get();
+  }
+
+  const int kNumRowsPerTask = 32;
+  thread_pool->ParallelFor(0, table->height, kNumRowsPerTask, FillRows);
+}
+
+template <int kNumChannels>
+void WarpScanlinesWithRemapTable(const WarpRemapTable& table,
+                                 const Bitmap& source_image,
+                                 Bitmap* target_image) {
+  std::vector<const uint8_t*> source_lines(table.height);
+  for (int y = 0; y < table.height; ++y) {
+    source_lines[y] = source_image.GetScanline(y);
+  }
+
+  for (int y = 0; y < table.height; ++y) {
+    uint8_t* target_line = target_image->GetScanline(y);
+    const int* source_x = &table.source_x[y * table.width];
+    const int* source_y = &table.source_y[y * table.width];
+    const float* weight_x = &table.weight_x[y * table.width];
+    const float* weight_y = &table.weight_y[y * table.width];
+    for (int x = 0; x < table.width; ++x) {
+      uint8_t* target_pixel = target_line + kNumChannels * x;
+      if (source_x[x] < 0) {
+        for (int c = 0; c < kNumChannels; ++c) {
+          target_pixel[c] = 0;
+        }
+        continue;
+      }
+
+      const uint8_t* p0 =
+          source_lines[source_y[x]] + kNumChannels * source_x[x];
+      const uint8_t* p1 =
+          source_lines[source_y[x] + 1] + kNumChannels * source_x[x];
+      const float wx = weight_x[x];
+      const float wy = weight_y[x];
+      const float wx_1 = 1 - wx;
+      const float wy_1 = 1 - wy;
+      for (int c = 0; c < kNumChannels; ++c) {
+        const float v0 = wx_1 * p0[c] + wx * p0[kNumChannels + c];
+        const float v1 = wx_1 * p1[c] + wx * p1[kNumChannels + c];
+        // The interpolated value is non-negative, so adding 0.5 before the
+        // truncation rounds to the nearest integer.
+        target_pixel[c] = static_cast<uint8_t>(
+            std::min(255.0f, wy_1 * v0 + wy * v1 + 0.5f));
+      }
+    }
+  }
+}
+
+// Computes the remap table with num_threads threads or, if given, with the
+// workers of the thread pool.
+WarpRemapTable ComputeWarpRemapTableInternal(const Camera& source_camera,
+                                             const Camera& target_camera,
+                                             const int num_threads,
+                                             ThreadPool* thread_pool) {
+  WarpRemapTable table = AllocateWarpRemapTable(source_camera, target_camera);
+
+  Camera scaled_target_camera = target_camera;
+  if (target_camera.width != source_camera.width ||
+      target_camera.height != source_camera.height) {
+    scaled_target_camera.Rescale(source_camera.width, source_camera.height);
+  }
+
+  FillWarpRemapTable(
+      [&](const Eigen::Vector2d& image_point) {
+        return source_camera.ImgFromCam(
+            scaled_target_camera.CamFromImg(image_point));
+      },
+      num_threads,
+      thread_pool,
+      &table);
+
+  return table;
+}
+
+template <typename T>
+void AppendToCacheKey(const T& value, std::string* key) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendCameraToCacheKey(const Camera& camera, std::string* key) {
+  AppendToCacheKey(camera.model_id, key);
+  AppendToCacheKey(camera.width, key);
+  AppendToCacheKey(camera.height, key);
+  for (const double param : camera.params) {
+    AppendToCacheKey(param, key);
+  }
+}
+
 }  // namespace
 
 void WarpImageBetweenCameras(const Camera& source_camera,
@@ -176,6 +335,133 @@ void WarpImageWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
   }
 }
 
+size_t WarpRemapTable::NumBytes() const {
+  return source_x.size() * sizeof(int) + source_y.size() * sizeof(int) +
+         weight_x.size() * sizeof(float) + weight_y.size() * sizeof(float);
+}
+
+WarpRemapTable ComputeWarpRemapTable(const Camera& source_camera,
+                                     const Camera& target_camera,
+                                     const int num_threads) {
+  return ComputeWarpRemapTableInternal(
+      source_camera, target_camera, num_threads, /*thread_pool=*/nullptr);
+}
+
+WarpRemapTable ComputeWarpRemapTable(const Camera& source_camera,
+                                     const Camera& target_camera,
+                                     ThreadPool* thread_pool) {
+  THROW_CHECK_NOTNULL(thread_pool);
+  return ComputeWarpRemapTableInternal(
+      source_camera, target_camera, /*num_threads=*/1, thread_pool);
+}
+
+WarpRemapTable ComputeWarpRemapTableWithHomography(
+    const Eigen::Matrix3d& H,
+    const Camera& source_camera,
+    const Camera& target_camera,
+    const int num_threads) {
+  WarpRemapTable table = AllocateWarpRemapTable(source_camera, target_camera);
+
+  FillWarpRemapTable(
+      [&](const Eigen::Vector2d& image_point) {
+        return source_camera.ImgFromCam(target_camera.CamFromImg(
+            (H * image_point.homogeneous()).hnormalized()));
+      },
+      num_threads,
+      /*thread_pool=*/nullptr,
+      &table);
+
+  return table;
+}
+
+void WarpImageWithRemapTable(const WarpRemapTable& table,
+                             const Bitmap& source_image,
+                             Bitmap* target_image) {
+  THROW_CHECK_EQ(table.width, source_image.Width());
+  THROW_CHECK_EQ(table.height, source_image.Height());
+  THROW_CHECK_NOTNULL(target_image);
+
+  target_image->Allocate(table.width, table.height, source_image.IsRGB());
+
+  if (source_image.IsRGB()) {
+    WarpScanlinesWithRemapTable<3>(table, source_image, target_image);
+  } else {
+    WarpScanlinesWithRemapTable<1>(table, source_image, target_image);
+  }
+
+  if (table.target_width != table.width ||
+      table.target_height != table.height) {
+    target_image->Rescale(table.target_width, table.target_height);
+  }
+}
+
+WarpRemapTableCache::WarpRemapTableCache(const size_t max_num_bytes,
+                                         const int num_threads)
+    : num_threads_(num_threads),
+      tables_(max_num_bytes, [](const std::string&) { return Entry(); }) {}
+
+std::shared_ptr<const WarpRemapTable> WarpRemapTableCache::Get(
+    const Camera& source_camera,
+    const Camera& target_camera,
+    ThreadPool* thread_pool) {
+  std::string key;
+  AppendCameraToCacheKey(source_camera, &key);
+  AppendCameraToCacheKey(target_camera, &key);
+
+  // The first request computes the table outside of the lock and fulfills
+  // the promise, on which concurrent requests for the same key wait.
+  std::promise<std::shared_ptr<const WarpRemapTable>> promise;
+  std::shared_future<std::shared_ptr<const WarpRemapTable>> table;
+  bool promise_pending = false;
+  uint64_t entry_id = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tables_.Exists(key)) {
+      table = tables_.Get(key).table;
+    } else {
+      Entry entry;
+      entry.table = promise.get_future().share();
+      entry.id = entry_id = next_entry_id_++;
+      // The table has one entry per pixel in the source resolution.
+      entry.num_bytes = source_camera.width * source_camera.height *
+                        (2 * sizeof(int) + 2 * sizeof(float));
+      table = entry.table;
+      tables_.Set(key, std::move(entry));
+      promise_pending = true;
+    }
+  }
+
+  if (promise_pending) {
+    try {
+      promise.set_value(std::make_shared<const WarpRemapTable>(
+          ComputeWarpRemapTableInternal(
+              source_camera, target_camera, num_threads_, thread_pool)));
+    } catch (...) {
+      // Remove the failed entry, unless it was already evicted and replaced,
+      // such that later requests do not rethrow the same error.
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tables_.Exists(key) && tables_.Get(key).id == entry_id) {
+          tables_.Erase(key);
+        }
+      }
+      promise.set_exception(std::current_exception());
+    }
+  }
+
+  return table.get();
+}
+
+size_t WarpRemapTableCache::NumTables() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tables_.NumElems();
+}
+
+size_t WarpRemapTableCache::NumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tables_.NumBytes();
+}
+
 void ResampleImageBilinear(const float* data,
                            const int rows,
                            const int cols,
@@ -31,9 +31,18 @@
 
 #include "colmap/scene/camera.h"
 #include "colmap/sensor/bitmap.h"
+#include "colmap/util/cache.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace colmap {
 
+class ThreadPool;
+
 // Warp source image to target image by projecting the pixels of the target
 // image up to infinity and projecting it down into the source image
 // (i.e. an inverse mapping). The function allocates the target image.
@@ -59,6 +68,96 @@ void WarpImageWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
                                            const Bitmap& source_image,
                                            Bitmap* target_image);
 
+// Precomputed inverse mapping from target to source pixels. The mapping only
+// depends on the cameras (and homography) but not on the image content, so
+// one table can be shared by all images with the same camera. The warping is
+// performed in the source resolution, as in WarpImageBetweenCameras, and the
+// result is rescaled to the target resolution at the end.
+struct WarpRemapTable {
+  // Dimensions of the table, which equal the source image dimensions.
+  int width = 0;
+  int height = 0;
+
+  // Dimensions of the final target image.
+  int target_width = 0;
+  int target_height = 0;
+
+  // For each pixel in row-major order, the upper left source pixel of the
+  // bilinear interpolation or -1 if the pixel maps outside the source image.
+  std::vector<int> source_x;
+  std::vector<int> source_y;
+
+  // Bilinear interpolation weights of the right and bottom source pixels.
+  std::vector<float> weight_x;
+  std::vector<float> weight_y;
+
+  size_t NumBytes() const;
+};
+
+// Compute the remap tables equivalent to WarpImageBetweenCameras and
+// WarpImageWithHomographyBetweenCameras. The rows of the table are computed
+// in parallel using the given number of threads.
+WarpRemapTable ComputeWarpRemapTable(const Camera& source_camera,
+                                     const Camera& target_camera,
+                                     int num_threads = -1);
+WarpRemapTable ComputeWarpRemapTableWithHomography(
+    const Eigen::Matrix3d& H,
+    const Camera& source_camera,
+    const Camera& target_camera,
+    int num_threads = -1);
+
+// Same as ComputeWarpRemapTable, but the rows of the table are computed by the
+// workers of the given thread pool. It can also be called from a worker of the
+// pool, which then computes rows itself.
+WarpRemapTable ComputeWarpRemapTable(const Camera& source_camera,
+                                     const Camera& target_camera,
+                                     ThreadPool* thread_pool);
+
+// Warp source image to target image using a precomputed remap table. The
+// interpolation operates directly on the raw scanlines of the bitmaps. The
+// function allocates the target image.
+void WarpImageWithRemapTable(const WarpRemapTable& table,
+                             const Bitmap& source_image,
+                             Bitmap* target_image);
+
+// Thread-safe cache of remap tables keyed by the source and target cameras
+// (model, parameters, and dimensions). Tables are computed once on first
+// access and evicted in least recently used order once their total size
+// exceeds the given number of bytes. A table is computed without holding the
+// lock of the cache, and concurrent requests for the same cameras wait for
+// the result instead of duplicating the work. If the computation fails, the
+// error is propagated to all waiting requests and the table is recomputed on
+// the next request. If the cache is used from the tasks of a thread pool, pass
+// num_threads=1 or the pool to Get to avoid oversubscribing the cores.
+class WarpRemapTableCache {
+ public:
+  explicit WarpRemapTableCache(size_t max_num_bytes = 1 << 30,
+                               int num_threads = -1);
+
+  // If a thread pool is given, a table that is not cached yet is computed by
+  // the workers of the pool instead of with num_threads threads.
+  std::shared_ptr<const WarpRemapTable> Get(const Camera& source_camera,
+                                            const Camera& target_camera,
+                                            ThreadPool* thread_pool = nullptr);
+
+  size_t NumTables() const;
+  size_t NumBytes() const;
+
+ private:
+  struct Entry {
+    std::shared_future<std::shared_ptr<const WarpRemapTable>> table;
+    // Distinguishes a failed entry from a later entry with the same key.
+    uint64_t id = 0;
+    size_t num_bytes = 0;
+    size_t NumBytes() const { return num_bytes; }
+  };
+
+  const int num_threads_;
+  mutable std::mutex mutex_;
+  uint64_t next_entry_id_ = 0;
+  MemoryConstrainedLRUCache<std::string, Entry> tables_;
+};
+
 // Resample row-major image using bilinear interpolation.
 void ResampleImageBilinear(const float* data,
                            int rows,
@@ -30,6 +30,10 @@
 #include "colmap/image/warp.h"
 
 #include "colmap/math/random.h"
+#include "colmap/util/threading.h"
+
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -87,6 +91,25 @@ void CheckBitmapsTransposed(const Bitmap& bitmap1, const Bitmap& bitmap2) {
   }
 }
 
+// Check that the two bitmaps differ by at most one intensity level, which
+// accounts for rounding differences between single and double precision.
+void CheckBitmapsNear(const Bitmap& bitmap1, const Bitmap& bitmap2) {
+  ASSERT_EQ(bitmap1.IsRGB(), bitmap2.IsRGB());
+  ASSERT_EQ(bitmap1.Width(), bitmap2.Width());
+  ASSERT_EQ(bitmap1.Height(), bitmap2.Height());
+  for (int x = 0; x < bitmap1.Width(); ++x) {
+    for (int y = 0; y < bitmap1.Height(); ++y) {
+      BitmapColor<uint8_t> color1;
+      BitmapColor<uint8_t> color2;
+      EXPECT_TRUE(bitmap1.GetPixel(x, y, &color1));
+      EXPECT_TRUE(bitmap2.GetPixel(x, y, &color2));
+      EXPECT_LE(std::abs(color1.r - color2.r), 1);
+      EXPECT_LE(std::abs(color1.g - color2.g), 1);
+      EXPECT_LE(std::abs(color1.b - color2.b), 1);
+    }
+  }
+}
+
 }  // namespace
 
 TEST(Warp, IdenticalCameras) {
@@ -216,6 +239,147 @@ TEST(Warp, WarpImageWithHomographyBetweenCamerasTransposed) {
   CheckBitmapsTransposed(source_image_rgb, target_image_rgb);
 }
 
+TEST(Warp, WarpImageWithRemapTable) {
+  Camera source_camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 80, 100, 90);
+  source_camera.params[3] = 0.1;
+  Camera target_camera = source_camera;
+  target_camera.model_id = PinholeCameraModel::model_id;
+  target_camera.params = {90, 80, 48, 46};
+  for (const bool as_rgb : {false, true}) {
+    Bitmap source_image;
+    GenerateRandomBitmap(100, 90, as_rgb, &source_image);
+    Bitmap target_image;
+    WarpImageBetweenCameras(
+        source_camera, target_camera, source_image, &target_image);
+    for (const int num_threads : {1, 3}) {
+      const WarpRemapTable table =
+          ComputeWarpRemapTable(source_camera, target_camera, num_threads);
+      EXPECT_EQ(table.width, 100);
+      EXPECT_EQ(table.height, 90);
+      Bitmap remapped_image;
+      WarpImageWithRemapTable(table, source_image, &remapped_image);
+      CheckBitmapsNear(target_image, remapped_image);
+    }
+    ThreadPool thread_pool(3);
+    Bitmap remapped_image;
+    WarpImageWithRemapTable(
+        ComputeWarpRemapTable(source_camera, target_camera, &thread_pool),
+        source_image,
+        &remapped_image);
+    CheckBitmapsNear(target_image, remapped_image);
+  }
+}
+
+TEST(Warp, WarpImageWithRemapTableWithHomography) {
+  const Camera camera = Camera::CreateFromModelName(1, "PINHOLE", 1, 100, 100);
+  Eigen::Matrix3d H;
+  H << 0.9, 0.1, 2, -0.05, 1.1, 3, 0.0001, 0, 1;
+  for (const bool as_rgb : {false, true}) {
+    Bitmap source_image;
+    GenerateRandomBitmap(100, 100, as_rgb, &source_image);
+    Bitmap target_image;
+    WarpImageWithHomographyBetweenCameras(
+        H, camera, camera, source_image, &target_image);
+    Bitmap remapped_image;
+    WarpImageWithRemapTable(
+        ComputeWarpRemapTableWithHomography(H, camera, camera),
+        source_image,
+        &remapped_image);
+    CheckBitmapsNear(target_image, remapped_image);
+  }
+}
+
+TEST(WarpRemapTableCache, Nominal) {
+  const Camera camera1 = Camera::CreateFromModelName(1, "PINHOLE", 1, 10, 10);
+  const Camera camera2 = Camera::CreateFromModelName(2, "PINHOLE", 2, 10, 10);
+  const Camera camera3 = Camera::CreateFromModelName(3, "PINHOLE", 3, 10, 10);
+  const size_t kNumTableBytes = 10 * 10 * 16;
+  WarpRemapTableCache cache(/*max_num_bytes=*/2 * kNumTableBytes);
+  EXPECT_EQ(cache.NumTables(), 0);
+  EXPECT_EQ(cache.NumBytes(), 0);
+  const auto table1 = cache.Get(camera1, camera2);
+  EXPECT_EQ(cache.NumTables(), 1);
+  EXPECT_EQ(cache.NumBytes(), table1->NumBytes());
+  EXPECT_EQ(table1->NumBytes(), kNumTableBytes);
+  EXPECT_EQ(cache.Get(camera1, camera2), table1);
+  EXPECT_EQ(cache.NumTables(), 1);
+  const auto table2 = cache.Get(camera2, camera1);
+  EXPECT_NE(table2, table1);
+  EXPECT_EQ(cache.NumTables(), 2);
+  EXPECT_EQ(cache.NumBytes(), 2 * kNumTableBytes);
+  const auto table3 = cache.Get(camera1, camera3);
+  EXPECT_EQ(cache.NumTables(), 2);
+  EXPECT_EQ(cache.NumBytes(), 2 * kNumTableBytes);
+  // The least recently used table was evicted.
+  EXPECT_NE(cache.Get(camera1, camera2), table1);
+  EXPECT_EQ(cache.Get(camera1, camera3), table3);
+}
+
+TEST(WarpRemapTableCache, Failure) {
+  Camera invalid_camera = Camera::CreateFromModelName(1, "PINHOLE", 1, 10, 10);
+  invalid_camera.model_id = CameraModelId::kInvalid;
+  const Camera camera = Camera::CreateFromModelName(2, "PINHOLE", 1, 10, 10);
+  WarpRemapTableCache cache(/*max_num_bytes=*/1 << 20, /*num_threads=*/1);
+  EXPECT_ANY_THROW(cache.Get(invalid_camera, camera));
+  // The failed table is not cached.
+  EXPECT_EQ(cache.NumTables(), 0);
+  EXPECT_EQ(cache.NumBytes(), 0);
+  EXPECT_ANY_THROW(cache.Get(invalid_camera, camera));
+  EXPECT_EQ(cache.NumTables(), 0);
+  EXPECT_NE(cache.Get(camera, camera), nullptr);
+  EXPECT_EQ(cache.NumTables(), 1);
+}
+
+TEST(WarpRemapTableCache, Concurrent) {
+  const Camera camera1 =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 200, 100);
+  Camera camera2 = camera1;
+  camera2.params[3] = 0;
+  WarpRemapTableCache cache;
+  const int kNumThreads = 8;
+  std::vector<std::shared_ptr<const WarpRemapTable>> tables(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(
+        [&, i]() { tables[i] = cache.Get(camera1, camera2); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(cache.NumTables(), 1);
+  for (int i = 0; i < kNumThreads; ++i) {
+    EXPECT_EQ(tables[i], tables[0]);
+  }
+}
+
+TEST(WarpRemapTableCache, ThreadPool) {
+  const Camera camera1 =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 200, 100);
+  Camera camera2 = camera1;
+  camera2.params[3] = 0;
+  const WarpRemapTable expected_table =
+      ComputeWarpRemapTable(camera1, camera2, /*num_threads=*/1);
+  WarpRemapTableCache cache(/*max_num_bytes=*/1 << 30, /*num_threads=*/1);
+  ThreadPool thread_pool(4);
+  // The workers that request the table while it is computed by another worker
+  // wait for it, while the computing worker processes rows itself.
+  std::vector<std::future<std::shared_ptr<const WarpRemapTable>>> futures;
+  for (int i = 0; i < 8; ++i) {
+    futures.push_back(thread_pool.AddTask(
+        [&]() { return cache.Get(camera1, camera2, &thread_pool); }));
+  }
+  const auto table = futures[0].get();
+  for (size_t i = 1; i < futures.size(); ++i) {
+    EXPECT_EQ(futures[i].get(), table);
+  }
+  EXPECT_EQ(cache.NumTables(), 1);
+  EXPECT_EQ(table->source_x, expected_table.source_x);
+  EXPECT_EQ(table->source_y, expected_table.source_y);
+  EXPECT_EQ(table->weight_x, expected_table.weight_x);
+  EXPECT_EQ(table->weight_y, expected_table.weight_y);
+}
+
 TEST(Warp, ResampleImageBilinear) {
   std::vector<float> image(16);
   for (size_t i = 0; i < image.size(); ++i) {
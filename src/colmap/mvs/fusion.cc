@@ -33,6 +33,7 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
+#include "colmap/util/trace.h"
 
 #include <Eigen/Geometry>
 
@@ -142,6 +143,7 @@ const std::vector<std::vector<int>>& StereoFusion::GetFusedPointsVisibility()
 }
 
 void StereoFusion::Run() {
+  COLMAP_TRACE_SCOPE("stereo_fusion/run");
   Timer run_timer;
   run_timer.Start();
 
@@ -261,17 +263,16 @@ void StereoFusion::Run() {
   // pixels are likely to get fused into the same point.
   const int kRowStride = 10;
   auto ProcessImageRows = [&, this](const int row_start,
-                                    const int height,
+                                    const int row_end,
                                     const int width,
                                     const int image_idx,
                                     const Mat<char>& fused_pixel_mask) {
-    const int row_end = std::min(height, row_start + kRowStride);
+    const int thread_id = thread_pool.GetThreadIndex();
     for (int row = row_start; row < row_end; ++row) {
       for (int col = 0; col < width; ++col) {
         if (fused_pixel_mask.Get(row, col) > 0) {
           continue;
         }
-        const int thread_id = thread_pool.GetThreadIndex();
         Fuse(thread_id, image_idx, row, col);
       }
     }
@@ -286,6 +287,7 @@ void StereoFusion::Run() {
       break;
     }
 
+    COLMAP_TRACE_SCOPE("stereo_fusion/fuse_image");
     Timer timer;
     timer.Start();
 
@@ -299,15 +301,10 @@ void StereoFusion::Run() {
     const int height = depth_map_sizes_.at(image_idx).second;
     const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
 
-    for (int row_start = 0; row_start < height; row_start += kRowStride) {
-      thread_pool.AddTask(ProcessImageRows,
-                          row_start,
-                          height,
-                          width,
-                          image_idx,
-                          fused_pixel_mask);
-    }
-    thread_pool.Wait();
+    thread_pool.ParallelFor(
+        0, height, kRowStride, [&](const size_t begin, const size_t end) {
+          ProcessImageRows(begin, end, width, image_idx, fused_pixel_mask);
+        });
 
     num_fused_images += 1;
     fused_images_.at(image_idx) = true;
@@ -31,10 +31,15 @@
 
 #include "colmap/math/math.h"
 #include "colmap/mvs/consistency_graph.h"
-#include "colmap/mvs/patch_match_cuda.h"
+#include "colmap/mvs/patch_match_cpu.h"
 #include "colmap/mvs/workspace.h"
 #include "colmap/util/misc.h"
 
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/mvs/patch_match_cuda.h"
+#include "colmap/util/cuda.h"
+#endif  // COLMAP_CUDA_ENABLED
+
 #include <numeric>
 #include <unordered_set>
 
@@ -51,7 +56,9 @@ PatchMatch::~PatchMatch() {}
 void PatchMatchOptions::Print() const {
   PrintHeading2("PatchMatchOptions");
   PrintOption(max_image_size);
+  PrintOption(use_gpu);
   PrintOption(gpu_index);
+  PrintOption(num_threads);
   PrintOption(depth_min);
   PrintOption(depth_max);
   PrintOption(window_radius);
@@ -156,27 +163,57 @@ void PatchMatch::Run() {
 
   Check();
 
-  patch_match_cuda_ = std::make_unique<PatchMatchCuda>(options_, problem_);
-  patch_match_cuda_->Run();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options_.use_gpu) {
+    patch_match_cuda_ = std::make_unique<PatchMatchCuda>(options_, problem_);
+    patch_match_cuda_->Run();
+    return;
+  }
+#endif  // COLMAP_CUDA_ENABLED
+
+  patch_match_cpu_ = std::make_unique<PatchMatchCpu>(options_, problem_);
+  patch_match_cpu_->Run();
 }
 
 DepthMap PatchMatch::GetDepthMap() const {
-  return patch_match_cuda_->GetDepthMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_) {
+    return patch_match_cuda_->GetDepthMap();
+  }
+#endif  // COLMAP_CUDA_ENABLED
+  return patch_match_cpu_->GetDepthMap();
 }
 
 NormalMap PatchMatch::GetNormalMap() const {
-  return patch_match_cuda_->GetNormalMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_) {
+    return patch_match_cuda_->GetNormalMap();
+  }
+#endif  // COLMAP_CUDA_ENABLED
+  return patch_match_cpu_->GetNormalMap();
 }
 
 Mat<float> PatchMatch::GetSelProbMap() const {
-  return patch_match_cuda_->GetSelProbMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_) {
+    return patch_match_cuda_->GetSelProbMap();
+  }
+#endif  // COLMAP_CUDA_ENABLED
+  return patch_match_cpu_->GetSelProbMap();
 }
 
 ConsistencyGraph PatchMatch::GetConsistencyGraph() const {
   const auto& ref_image = problem_.images->at(problem_.ref_image_idx);
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_) {
+    return ConsistencyGraph(ref_image.GetWidth(),
+                            ref_image.GetHeight(),
+                            patch_match_cuda_->GetConsistentImageIdxs());
+  }
+#endif  // COLMAP_CUDA_ENABLED
   return ConsistencyGraph(ref_image.GetWidth(),
                           ref_image.GetHeight(),
-                          patch_match_cuda_->GetConsistentImageIdxs());
+                          patch_match_cpu_->GetConsistentImageIdxs());
 }
 
 PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
@@ -396,13 +433,35 @@ void PatchMatchController::ReadProblems() {
 }
 
 void PatchMatchController::ReadGpuIndices() {
-  gpu_indices_ = CSVToVector<int>(options_.gpu_index);
-  if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
-    const int num_cuda_devices = GetNumCudaDevices();
-    THROW_CHECK_GT(num_cuda_devices, 0);
-    gpu_indices_.resize(num_cuda_devices);
-    std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options_.use_gpu) {
+    gpu_indices_ = CSVToVector<int>(options_.gpu_index);
+    if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
+      const int num_cuda_devices = GetNumCudaDevices();
+      THROW_CHECK_GT(num_cuda_devices, 0);
+      gpu_indices_.resize(num_cuda_devices);
+      std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+    }
+    return;
+  }
+#else   // COLMAP_CUDA_ENABLED
+  if (options_.use_gpu) {
+    LOG(WARNING) << "CUDA is not available, using the CPU implementation of "
+                    "patch match stereo.";
   }
+#endif  // COLMAP_CUDA_ENABLED
+
+  // The CPU implementation parallelizes each problem over scanlines, which
+  // stops scaling well beyond a few threads due to the synchronization after
+  // each sweep. Process multiple problems concurrently instead, each with its
+  // share of the threads. Note that the CPU workers have no GPU index.
+  const int kMinNumThreadsPerProblem = 8;
+  const int num_threads = GetEffectiveNumThreads(options_.num_threads);
+  const int num_workers =
+      std::max(1,
+               std::min(num_threads / kMinNumThreadsPerProblem,
+                        static_cast<int>(problems_.size())));
+  gpu_indices_.assign(num_workers, -1);
 }
 
 void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
@@ -455,6 +514,10 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
   }
 
   patch_match_options.gpu_index = std::to_string(gpu_index);
+  patch_match_options.num_threads =
+      std::max(1,
+               GetEffectiveNumThreads(options.num_threads) /
+                   static_cast<int>(gpu_indices_.size()));
 
   if (patch_match_options.sigma_spatial <= 0.0f) {
     patch_match_options.sigma_spatial = patch_match_options.window_radius;
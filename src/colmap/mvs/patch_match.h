@@ -51,6 +51,7 @@ namespace mvs {
 const static size_t kMaxPatchMatchWindowRadius = 32;
 
 class ConsistencyGraph;
+class PatchMatchCpu;
 class PatchMatchCuda;
 class Workspace;
 
@@ -58,10 +59,21 @@ struct PatchMatchOptions {
   // Maximum image size in either dimension.
   int max_image_size = -1;
 
+  // Whether to use the CUDA implementation of patch match. If false or if
+  // COLMAP was built without CUDA, the multi-threaded CPU implementation is
+  // used, which is slower. It implements the same model and sweep scheme;
+  // results are statistically equivalent but not bitwise identical.
+  bool use_gpu = true;
+
   // Index of the GPU used for patch match. For multi-GPU usage,
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // The number of threads used by the CPU implementation. Multiple reference
+  // images are processed concurrently, if this exceeds the number of threads
+  // that can be efficiently used for a single image.
+  int num_threads = -1;
+
   // Depth range in which to randomly sample depth hypotheses.
   double depth_min = -1.0f;
   double depth_max = -1.0f;
@@ -169,9 +181,9 @@ struct PatchMatchOptions {
   }
 };
 
-// This is a wrapper class around the actual PatchMatchCuda implementation. This
-// class is necessary to hide Cuda code from any boost or Eigen code, since
-// NVCC/MSVC cannot compile complex C++ code.
+// This is a wrapper class around the actual PatchMatchCuda and PatchMatchCpu
+// implementations. This class is necessary to hide Cuda code from any boost or
+// Eigen code, since NVCC/MSVC cannot compile complex C++ code.
 class PatchMatch {
  public:
   struct Problem {
@@ -212,7 +224,10 @@ class PatchMatch {
  private:
   const PatchMatchOptions options_;
   const Problem problem_;
+  std::unique_ptr<PatchMatchCpu> patch_match_cpu_;
+#if defined(COLMAP_CUDA_ENABLED)
   std::unique_ptr<PatchMatchCuda> patch_match_cuda_;
+#endif  // COLMAP_CUDA_ENABLED
 };
 
 // This thread processes all problems in a workspace. A workspace has the
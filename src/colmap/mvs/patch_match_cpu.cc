@@ -0,0 +1,1460 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/patch_match_cpu.h"
+
+#include "colmap/math/math.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <random>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Number of adjacent scanlines that are processed by one thread. The pixels
+// of a band are visited position by position across its scanlines, so that
+// vertical sweeps access consecutive memory in the row-major maps.
+constexpr int kNumLinesPerBand = 32;
+
+inline float DotProduct3(const float vec1[3], const float vec2[3]) {
+  return vec1[0] * vec2[0] + vec1[1] * vec2[1] + vec1[2] * vec2[2];
+}
+
+inline void Mat33DotVec3(const float mat[9],
+                         const float vec[3],
+                         float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+inline void Mat33DotVec3Homogeneous(const float mat[9],
+                                    const float vec[2],
+                                    float result[2]) {
+  const float inv_z = 1.0f / (mat[6] * vec[0] + mat[7] * vec[1] + mat[8]);
+  result[0] = inv_z * (mat[0] * vec[0] + mat[1] * vec[1] + mat[2]);
+  result[1] = inv_z * (mat[3] * vec[0] + mat[4] * vec[1] + mat[5]);
+}
+
+// Bilinearly interpolate the image at the given pixel coordinates, where
+// pixels outside of the image have zero intensity.
+inline float SampleBilinear(const std::vector<float>& image,
+                            const int width,
+                            const int height,
+                            const float x,
+                            const float y) {
+  if (!(x > -1.0f && y > -1.0f && x < width && y < height)) {
+    return 0.0f;
+  }
+
+  const float x0_floor = std::floor(x);
+  const float y0_floor = std::floor(y);
+  const int x0 = static_cast<int>(x0_floor);
+  const int y0 = static_cast<int>(y0_floor);
+  const int x1 = x0 + 1;
+  const int y1 = y0 + 1;
+  const float dx = x - x0_floor;
+  const float dy = y - y0_floor;
+
+  const bool valid_x0 = x0 >= 0;
+  const bool valid_x1 = x1 < width;
+  const bool valid_y0 = y0 >= 0;
+  const bool valid_y1 = y1 < height;
+
+  float value = 0.0f;
+  if (valid_y0) {
+    const float* row = image.data() + y0 * width;
+    if (valid_x0) {
+      value += (1.0f - dx) * (1.0f - dy) * row[x0];
+    }
+    if (valid_x1) {
+      value += dx * (1.0f - dy) * row[x1];
+    }
+  }
+  if (valid_y1) {
+    const float* row = image.data() + y1 * width;
+    if (valid_x0) {
+      value += (1.0f - dx) * dy * row[x0];
+    }
+    if (valid_x1) {
+      value += dx * dy * row[x1];
+    }
+  }
+
+  return value;
+}
+
+// Nearest neighbor lookup in the depth map, where pixels outside of the depth
+// map have zero depth.
+inline float SampleNearest(const std::vector<float>& depth_map,
+                           const int width,
+                           const int height,
+                           const float x,
+                           const float y) {
+  const float x_round = std::floor(x + 0.5f);
+  const float y_round = std::floor(y + 0.5f);
+  if (!(x_round >= 0 && y_round >= 0 && x_round < width &&
+        y_round < height)) {
+    return 0.0f;
+  }
+  return depth_map[static_cast<int>(y_round) * width +
+                   static_cast<int>(x_round)];
+}
+
+// Map the position along the given scanline of a sweep to image coordinates.
+// Positions outside of the scanline are mapped to coordinates outside of the
+// image, which is used to propagate depths into the first pixel of a line.
+inline void GetSweepPixel(const int direction,
+                          const int width,
+                          const int height,
+                          const int line,
+                          const int position,
+                          int* row,
+                          int* col) {
+  switch (direction) {
+    case 0:
+      *row = position;
+      *col = line;
+      break;
+    case 1:
+      *row = line;
+      *col = width - 1 - position;
+      break;
+    case 2:
+      *row = height - 1 - position;
+      *col = line;
+      break;
+    default:
+      *row = line;
+      *col = position;
+      break;
+  }
+}
+
+inline float GenerateRandomUniform(std::mt19937* rng) {
+  return std::uniform_real_distribution<float>(0.0f, 1.0f)(*rng);
+}
+
+inline float GenerateRandomDepth(const float depth_min,
+                                 const float depth_max,
+                                 std::mt19937* rng) {
+  return GenerateRandomUniform(rng) * (depth_max - depth_min) + depth_min;
+}
+
+void GenerateRandomNormal(const float ref_inv_K[4],
+                          const int row,
+                          const int col,
+                          std::mt19937* rng,
+                          float normal[3]) {
+  // Unbiased sampling of normal, according to George Marsaglia, "Choosing a
+  // Point from the Surface of a Sphere", 1972.
+  float v1 = 0.0f;
+  float v2 = 0.0f;
+  float s = 2.0f;
+  while (s >= 1.0f) {
+    v1 = 2.0f * GenerateRandomUniform(rng) - 1.0f;
+    v2 = 2.0f * GenerateRandomUniform(rng) - 1.0f;
+    s = v1 * v1 + v2 * v2;
+  }
+
+  const float s_norm = std::sqrt(1.0f - s);
+  normal[0] = 2.0f * v1 * s_norm;
+  normal[1] = 2.0f * v2 * s_norm;
+  normal[2] = 1.0f - 2.0f * s;
+
+  // Make sure normal is looking away from camera.
+  const float view_ray[3] = {ref_inv_K[0] * col + ref_inv_K[1],
+                             ref_inv_K[2] * row + ref_inv_K[3],
+                             1.0f};
+  if (DotProduct3(normal, view_ray) > 0) {
+    normal[0] = -normal[0];
+    normal[1] = -normal[1];
+    normal[2] = -normal[2];
+  }
+}
+
+inline float PerturbDepth(const float perturbation,
+                          const float depth,
+                          std::mt19937* rng) {
+  const float depth_min = (1.0f - perturbation) * depth;
+  const float depth_max = (1.0f + perturbation) * depth;
+  return GenerateRandomDepth(depth_min, depth_max, rng);
+}
+
+void PerturbNormal(const float ref_inv_K[4],
+                   const int row,
+                   const int col,
+                   const float perturbation,
+                   const float normal[3],
+                   std::mt19937* rng,
+                   float perturbed_normal[3],
+                   const int num_trials = 0) {
+  // Perturbation rotation angles.
+  const float a1 = (GenerateRandomUniform(rng) - 0.5f) * perturbation;
+  const float a2 = (GenerateRandomUniform(rng) - 0.5f) * perturbation;
+  const float a3 = (GenerateRandomUniform(rng) - 0.5f) * perturbation;
+
+  const float sin_a1 = std::sin(a1);
+  const float sin_a2 = std::sin(a2);
+  const float sin_a3 = std::sin(a3);
+  const float cos_a1 = std::cos(a1);
+  const float cos_a2 = std::cos(a2);
+  const float cos_a3 = std::cos(a3);
+
+  // R = Rx * Ry * Rz
+  float R[9];
+  R[0] = cos_a2 * cos_a3;
+  R[1] = -cos_a2 * sin_a3;
+  R[2] = sin_a2;
+  R[3] = cos_a1 * sin_a3 + cos_a3 * sin_a1 * sin_a2;
+  R[4] = cos_a1 * cos_a3 - sin_a1 * sin_a2 * sin_a3;
+  R[5] = -cos_a2 * sin_a1;
+  R[6] = sin_a1 * sin_a3 - cos_a1 * cos_a3 * sin_a2;
+  R[7] = cos_a3 * sin_a1 + cos_a1 * sin_a2 * sin_a3;
+  R[8] = cos_a1 * cos_a2;
+
+  // Perturb the normal vector.
+  Mat33DotVec3(R, normal, perturbed_normal);
+
+  // Make sure the perturbed normal is still looking in the same direction as
+  // the viewing direction, otherwise try again but with smaller perturbation.
+  const float view_ray[3] = {ref_inv_K[0] * col + ref_inv_K[1],
+                             ref_inv_K[2] * row + ref_inv_K[3],
+                             1.0f};
+  if (DotProduct3(perturbed_normal, view_ray) >= 0.0f) {
+    const int kMaxNumTrials = 3;
+    if (num_trials < kMaxNumTrials) {
+      PerturbNormal(ref_inv_K,
+                    row,
+                    col,
+                    0.5f * perturbation,
+                    normal,
+                    rng,
+                    perturbed_normal,
+                    num_trials + 1);
+    } else {
+      perturbed_normal[0] = normal[0];
+      perturbed_normal[1] = normal[1];
+      perturbed_normal[2] = normal[2];
+    }
+    return;
+  }
+
+  // Make sure normal has unit norm.
+  const float inv_norm =
+      1.0f / std::sqrt(DotProduct3(perturbed_normal, perturbed_normal));
+  perturbed_normal[0] *= inv_norm;
+  perturbed_normal[1] *= inv_norm;
+  perturbed_normal[2] *= inv_norm;
+}
+
+inline void ComputePointAtDepth(const float ref_inv_K[4],
+                                const float row,
+                                const float col,
+                                const float depth,
+                                float point[3]) {
+  point[0] = depth * (ref_inv_K[0] * col + ref_inv_K[1]);
+  point[1] = depth * (ref_inv_K[2] * row + ref_inv_K[3]);
+  point[2] = depth;
+}
+
+// Transfer depth on plane from the viewing ray of the previous pixel in the
+// sweep direction to the viewing ray of the current pixel. The returned depth
+// is the intersection of the current viewing ray with the plane at the
+// previous pixel defined by the given depth and normal. Only the image axis
+// along the sweep direction is considered, as in PatchMatchCuda.
+inline float PropagateDepth(const float ref_inv_K[4],
+                            const int direction,
+                            const float depth1,
+                            const float normal1[3],
+                            const int row1,
+                            const int col1,
+                            const int row2,
+                            const int col2) {
+  float ray1;
+  float ray2;
+  float normal_t;
+  if (direction % 2 == 0) {
+    ray1 = ref_inv_K[2] * row1 + ref_inv_K[3];
+    ray2 = ref_inv_K[2] * row2 + ref_inv_K[3];
+    normal_t = normal1[1];
+  } else {
+    ray1 = ref_inv_K[0] * col1 + ref_inv_K[1];
+    ray2 = ref_inv_K[0] * col2 + ref_inv_K[1];
+    normal_t = normal1[0];
+  }
+
+  const float denom = normal1[2] + ray2 * normal_t;
+  constexpr float kEps = 1e-5f;
+  if (std::abs(denom) < kEps) {
+    return depth1;
+  }
+  return depth1 * (normal1[2] + ray1 * normal_t) / denom;
+}
+
+// First, compute triangulation angle between reference and source image for 3D
+// point. Second, compute incident angle between viewing direction of source
+// image and normal direction of 3D point. Both angles are cosine distances.
+inline void ComputeViewingAngles(const float C[3],
+                                 const float point[3],
+                                 const float normal[3],
+                                 float* cos_triangulation_angle,
+                                 float* cos_incident_angle) {
+  // Ray from point to camera.
+  const float SX[3] = {C[0] - point[0], C[1] - point[1], C[2] - point[2]};
+
+  // Length of ray from reference image to point.
+  const float RX_inv_norm = 1.0f / std::sqrt(DotProduct3(point, point));
+
+  // Length of ray from source image to point.
+  const float SX_inv_norm = 1.0f / std::sqrt(DotProduct3(SX, SX));
+
+  *cos_incident_angle = DotProduct3(SX, normal) * SX_inv_norm;
+  *cos_triangulation_angle = DotProduct3(SX, point) * RX_inv_norm * SX_inv_norm;
+}
+
+// Compose the homography H = K * (R - T * n' / d) * Kref^-1 induced by the
+// plane at the given depth and normal of the reference pixel.
+void ComposeHomography(const float ref_inv_K[4],
+                       const float K[4],
+                       const float R[9],
+                       const float T[3],
+                       const int row,
+                       const int col,
+                       const float depth,
+                       const float normal[3],
+                       float H[9]) {
+  // Distance to the plane.
+  const float dist =
+      depth * (normal[0] * (ref_inv_K[0] * col + ref_inv_K[1]) +
+               normal[1] * (ref_inv_K[2] * row + ref_inv_K[3]) + normal[2]);
+  const float inv_dist = 1.0f / dist;
+
+  const float inv_dist_N0 = inv_dist * normal[0];
+  const float inv_dist_N1 = inv_dist * normal[1];
+  const float inv_dist_N2 = inv_dist * normal[2];
+
+  H[0] = ref_inv_K[0] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                         K[1] * (R[6] + inv_dist_N0 * T[2]));
+  H[1] = ref_inv_K[2] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                         K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[2] = K[0] * (R[2] + inv_dist_N2 * T[0]) +
+         K[1] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K[1] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                         K[1] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K[3] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                         K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[3] = ref_inv_K[0] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                         K[3] * (R[6] + inv_dist_N0 * T[2]));
+  H[4] = ref_inv_K[2] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                         K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[5] = K[2] * (R[5] + inv_dist_N2 * T[1]) +
+         K[3] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K[1] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                         K[3] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K[3] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                         K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[6] = ref_inv_K[0] * (R[6] + inv_dist_N0 * T[2]);
+  H[7] = ref_inv_K[2] * (R[7] + inv_dist_N1 * T[2]);
+  H[8] = R[8] + ref_inv_K[1] * (R[6] + inv_dist_N0 * T[2]) +
+         ref_inv_K[3] * (R[7] + inv_dist_N1 * T[2]) + inv_dist_N2 * T[2];
+}
+
+// Forward-backward reprojection error of the reference pixel at the given
+// depth through the depth map of the source image, truncated at max_cost.
+float ComputeGeomConsistencyCost(const float ref_K[4],
+                                 const float ref_inv_K[4],
+                                 const float P[12],
+                                 const float inv_P[12],
+                                 const std::vector<float>& src_depth_map,
+                                 const int src_width,
+                                 const int src_height,
+                                 const float row,
+                                 const float col,
+                                 const float depth,
+                                 const float max_cost) {
+  // Project point in reference image to world.
+  float forward_point[3];
+  ComputePointAtDepth(ref_inv_K, row, col, depth, forward_point);
+
+  // Project world point to source image.
+  const float inv_forward_z =
+      1.0f / (P[8] * forward_point[0] + P[9] * forward_point[1] +
+              P[10] * forward_point[2] + P[11]);
+  float src_col =
+      inv_forward_z * (P[0] * forward_point[0] + P[1] * forward_point[1] +
+                       P[2] * forward_point[2] + P[3]);
+  float src_row =
+      inv_forward_z * (P[4] * forward_point[0] + P[5] * forward_point[1] +
+                       P[6] * forward_point[2] + P[7]);
+
+  // Extract depth in source image.
+  const float src_depth = SampleNearest(
+      src_depth_map, src_width, src_height, src_col, src_row);
+
+  // Projection outside of source image.
+  if (!(src_depth != 0.0f) || std::isnan(src_depth)) {
+    return max_cost;
+  }
+
+  // Project point in source image to world.
+  src_col *= src_depth;
+  src_row *= src_depth;
+  const float backward_point_x =
+      inv_P[0] * src_col + inv_P[1] * src_row + inv_P[2] * src_depth + inv_P[3];
+  const float backward_point_y =
+      inv_P[4] * src_col + inv_P[5] * src_row + inv_P[6] * src_depth + inv_P[7];
+  const float backward_point_z = inv_P[8] * src_col + inv_P[9] * src_row +
+                                 inv_P[10] * src_depth + inv_P[11];
+  const float inv_backward_point_z = 1.0f / backward_point_z;
+
+  // Project world point back to reference image.
+  const float backward_col =
+      inv_backward_point_z *
+      (ref_K[0] * backward_point_x + ref_K[1] * backward_point_z);
+  const float backward_row =
+      inv_backward_point_z *
+      (ref_K[2] * backward_point_y + ref_K[3] * backward_point_z);
+
+  // Return truncated reprojection error between original observation and
+  // the forward-backward projected observation.
+  const float diff_col = col - backward_col;
+  const float diff_row = row - backward_row;
+  return std::min(max_cost,
+                  std::sqrt(diff_col * diff_col + diff_row * diff_row));
+}
+
+// Find index of minimum in given values.
+template <int kNumCosts>
+inline int FindMinCost(const float costs[kNumCosts]) {
+  float min_cost = costs[0];
+  int min_cost_idx = 0;
+  for (int idx = 1; idx < kNumCosts; ++idx) {
+    if (costs[idx] <= min_cost) {
+      min_cost = costs[idx];
+      min_cost_idx = idx;
+    }
+  }
+  return min_cost_idx;
+}
+
+void TransformPDFToCDF(float* probs, const int num_probs) {
+  float prob_sum = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    prob_sum += probs[i];
+  }
+  const float inv_prob_sum = 1.0f / prob_sum;
+
+  float cum_prob = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    const float prob = probs[i] * inv_prob_sum;
+    cum_prob += prob;
+    probs[i] = cum_prob;
+  }
+}
+
+class LikelihoodComputer {
+ public:
+  LikelihoodComputer(const float ncc_sigma,
+                     const float min_triangulation_angle,
+                     const float incident_angle_sigma)
+      : cos_min_triangulation_angle_(std::cos(min_triangulation_angle)),
+        inv_incident_angle_sigma_square_(
+            -0.5f / (incident_angle_sigma * incident_angle_sigma)),
+        inv_ncc_sigma_square_(-0.5f / (ncc_sigma * ncc_sigma)),
+        ncc_norm_factor_(ComputeNCCCostNormFactor(ncc_sigma)) {}
+
+  // Compute forward message from current cost and forward message of
+  // previous / neighboring pixel.
+  float ComputeForwardMessage(const float cost, const float prev) const {
+    return ComputeMessage<true>(cost, prev);
+  }
+
+  // Compute backward message from current cost and backward message of
+  // previous / neighboring pixel.
+  float ComputeBackwardMessage(const float cost, const float prev) const {
+    return ComputeMessage<false>(cost, prev);
+  }
+
+  // Compute the selection probability from the forward and backward message.
+  inline float ComputeSelProb(const float alpha,
+                              const float beta,
+                              const float prev,
+                              const float prev_weight) const {
+    const float zn0 = (1.0f - alpha) * (1.0f - beta);
+    const float zn1 = alpha * beta;
+    const float curr = zn1 / (zn0 + zn1);
+    return prev_weight * prev + (1.0f - prev_weight) * curr;
+  }
+
+  // Compute NCC probability. Note that cost = 1 - NCC.
+  inline float ComputeNCCProb(const float cost) const {
+    return std::exp(cost * cost * inv_ncc_sigma_square_) * ncc_norm_factor_;
+  }
+
+  // Compute the triangulation angle probability.
+  inline float ComputeTriProb(const float cos_triangulation_angle) const {
+    const float abs_cos_triangulation_angle =
+        std::abs(cos_triangulation_angle);
+    if (abs_cos_triangulation_angle > cos_min_triangulation_angle_) {
+      const float scaled = 1.0f - (1.0f - abs_cos_triangulation_angle) /
+                                      (1.0f - cos_min_triangulation_angle_);
+      const float likelihood = 1.0f - scaled * scaled;
+      return std::min(1.0f, std::max(0.0f, likelihood));
+    } else {
+      return 1.0f;
+    }
+  }
+
+  // Compute the incident angle probability.
+  inline float ComputeIncProb(const float cos_incident_angle) const {
+    const float x = 1.0f - std::max(0.0f, cos_incident_angle);
+    return std::exp(x * x * inv_incident_angle_sigma_square_);
+  }
+
+  // Compute the warping/resolution prior probability.
+  inline float ComputeResolutionProb(const int window_radius,
+                                     const float H[9],
+                                     const float row,
+                                     const float col) const {
+    // Warp corners of patch in reference image to source image.
+    float src1[2];
+    const float ref1[2] = {col - window_radius, row - window_radius};
+    Mat33DotVec3Homogeneous(H, ref1, src1);
+    float src2[2];
+    const float ref2[2] = {col - window_radius, row + window_radius};
+    Mat33DotVec3Homogeneous(H, ref2, src2);
+    float src3[2];
+    const float ref3[2] = {col + window_radius, row + window_radius};
+    Mat33DotVec3Homogeneous(H, ref3, src3);
+    float src4[2];
+    const float ref4[2] = {col + window_radius, row - window_radius};
+    Mat33DotVec3Homogeneous(H, ref4, src4);
+
+    // Compute area of patches in reference and source image.
+    const float window_size = 2 * window_radius + 1;
+    const float ref_area = window_size * window_size;
+    const float src_area = std::abs(
+        0.5f * (src1[0] * src2[1] - src2[0] * src1[1] - src1[0] * src4[1] +
+                src2[0] * src3[1] - src3[0] * src2[1] + src4[0] * src1[1] +
+                src3[0] * src4[1] - src4[0] * src3[1]));
+
+    if (ref_area > src_area) {
+      return src_area / ref_area;
+    } else {
+      return ref_area / src_area;
+    }
+  }
+
+ private:
+  // The normalization for the likelihood function, i.e. the normalization for
+  // the prior on the matching cost.
+  static inline float ComputeNCCCostNormFactor(const float ncc_sigma) {
+    // A = sqrt(2pi)*sigma/2*erf(sqrt(2)/sigma)
+    // erf(x) = 2/sqrt(pi) * integral from 0 to x of exp(-t^2) dt
+    return 2.0f / (std::sqrt(2.0f * static_cast<float>(M_PI)) * ncc_sigma *
+                   std::erf(2.0f / (ncc_sigma * 1.414213562f)));
+  }
+
+  // Compute the forward or backward message.
+  template <bool kForward>
+  inline float ComputeMessage(const float cost, const float prev) const {
+    constexpr float kUniformProb = 0.5f;
+    constexpr float kNoChangeProb = 0.99999f;
+    const float kChangeProb = 1.0f - kNoChangeProb;
+    const float emission = ComputeNCCProb(cost);
+
+    float zn0;  // Message for selection probability = 0.
+    float zn1;  // Message for selection probability = 1.
+    if (kForward) {
+      zn0 = (prev * kChangeProb + (1.0f - prev) * kNoChangeProb) * kUniformProb;
+      zn1 = (prev * kNoChangeProb + (1.0f - prev) * kChangeProb) * emission;
+    } else {
+      zn0 = prev * emission * kChangeProb +
+            (1.0f - prev) * kUniformProb * kNoChangeProb;
+      zn1 = prev * emission * kNoChangeProb +
+            (1.0f - prev) * kUniformProb * kChangeProb;
+    }
+
+    return zn1 / (zn0 + zn1);
+  }
+
+  const float cos_min_triangulation_angle_;
+  const float inv_incident_angle_sigma_square_;
+  const float inv_ncc_sigma_square_;
+  const float ncc_norm_factor_;
+};
+
+// Computes the bilaterally weighted NCC between the window around a reference
+// pixel and its warp into a source image. The return value is 1 - NCC, so the
+// range is [0, 2], the smaller the value, the better the color consistency.
+//
+// The bilateral weights and the reference statistics only depend on the
+// reference pixel and are computed once in SetRefPixel. Evaluating a
+// hypothesis then only requires to sample the source image, while the
+// weighted sums are computed as vectorized reductions over the window.
+class PhotoConsistencyCostComputer {
+ public:
+  PhotoConsistencyCostComputer(const std::vector<float>& ref_image,
+                               const int ref_width,
+                               const int ref_height,
+                               const int window_radius,
+                               const int window_step,
+                               const float sigma_spatial,
+                               const float sigma_color)
+      : ref_image_(ref_image),
+        ref_width_(ref_width),
+        ref_height_(ref_height),
+        color_normalization_(1.0f / (2.0f * sigma_color * sigma_color)) {
+    const float spatial_normalization =
+        1.0f / (2.0f * sigma_spatial * sigma_spatial);
+    const int num_steps = 2 * window_radius / window_step + 1;
+    const int num_pixels = num_steps * num_steps;
+    window_rows_.resize(num_pixels);
+    window_cols_.resize(num_pixels);
+    spatial_weights_.resize(num_pixels);
+    int i = 0;
+    for (int row = -window_radius; row <= window_radius; row += window_step) {
+      for (int col = -window_radius; col <= window_radius; col += window_step) {
+        window_rows_(i) = row;
+        window_cols_(i) = col;
+        spatial_weights_(i) =
+            std::exp(-(row * row + col * col) * spatial_normalization);
+        ++i;
+      }
+    }
+    ref_colors_.resize(num_pixels);
+    weights_.resize(num_pixels);
+    weighted_ref_colors_.resize(num_pixels);
+    src_colors_.resize(num_pixels);
+    rows_.resize(num_pixels);
+    cols_.resize(num_pixels);
+    src_cols_.resize(num_pixels);
+    src_rows_.resize(num_pixels);
+    src_inv_z_.resize(num_pixels);
+  }
+
+  // Set the center of the window in the reference image.
+  void SetRefPixel(const int row, const int col) {
+    rows_ = window_rows_ + static_cast<float>(row);
+    cols_ = window_cols_ + static_cast<float>(col);
+
+    const float center_color = ref_image_[row * ref_width_ + col];
+    for (Eigen::Index i = 0; i < ref_colors_.size(); ++i) {
+      const int ref_row = row + static_cast<int>(window_rows_(i));
+      const int ref_col = col + static_cast<int>(window_cols_(i));
+      if (ref_row >= 0 && ref_col >= 0 && ref_row < ref_height_ &&
+          ref_col < ref_width_) {
+        ref_colors_(i) = ref_image_[ref_row * ref_width_ + ref_col];
+      } else {
+        ref_colors_(i) = 0.0f;
+      }
+    }
+
+    weights_ = spatial_weights_ *
+               (-(ref_colors_ - center_color).square() * color_normalization_)
+                   .exp();
+    weights_ /= weights_.sum();
+    weighted_ref_colors_ = weights_ * ref_colors_;
+
+    ref_color_sum_ = weighted_ref_colors_.sum();
+    ref_color_squared_sum_ = (weighted_ref_colors_ * ref_colors_).sum();
+  }
+
+  float Compute(const float H[9],
+                const std::vector<float>& src_image,
+                const int src_width,
+                const int src_height) {
+    // Maximum photo consistency cost as 1 - min(NCC).
+    constexpr float kMaxCost = 2.0f;
+
+    src_inv_z_ = (H[6] * cols_ + H[7] * rows_ + H[8]).inverse();
+    src_cols_ = src_inv_z_ * (H[0] * cols_ + H[1] * rows_ + H[2]);
+    src_rows_ = src_inv_z_ * (H[3] * cols_ + H[4] * rows_ + H[5]);
+    for (Eigen::Index i = 0; i < src_colors_.size(); ++i) {
+      src_colors_(i) = SampleBilinear(
+          src_image, src_width, src_height, src_cols_(i), src_rows_(i));
+    }
+
+    const float src_color_sum = (weights_ * src_colors_).sum();
+    const float src_color_squared_sum =
+        (weights_ * src_colors_.square()).sum();
+    const float src_ref_color_sum = (weighted_ref_colors_ * src_colors_).sum();
+
+    const float ref_color_var =
+        ref_color_squared_sum_ - ref_color_sum_ * ref_color_sum_;
+    const float src_color_var =
+        src_color_squared_sum - src_color_sum * src_color_sum;
+
+    // Based on Jensen's Inequality for convex functions, the variance
+    // should always be larger than 0. Do not make this threshold smaller.
+    constexpr float kMinVar = 1e-5f;
+    if (ref_color_var < kMinVar || src_color_var < kMinVar) {
+      return kMaxCost;
+    } else {
+      const float src_ref_color_covar =
+          src_ref_color_sum - ref_color_sum_ * src_color_sum;
+      const float src_ref_color_var = std::sqrt(ref_color_var * src_color_var);
+      return std::max(
+          0.0f,
+          std::min(kMaxCost, 1.0f - src_ref_color_covar / src_ref_color_var));
+    }
+  }
+
+ private:
+  const std::vector<float>& ref_image_;
+  const int ref_width_;
+  const int ref_height_;
+  const float color_normalization_;
+
+  // Offsets and spatial weights of the window pixels.
+  Eigen::ArrayXf window_rows_;
+  Eigen::ArrayXf window_cols_;
+  Eigen::ArrayXf spatial_weights_;
+
+  // State of the current reference pixel.
+  Eigen::ArrayXf rows_;
+  Eigen::ArrayXf cols_;
+  Eigen::ArrayXf ref_colors_;
+  Eigen::ArrayXf weights_;
+  Eigen::ArrayXf weighted_ref_colors_;
+  float ref_color_sum_ = 0.0f;
+  float ref_color_squared_sum_ = 0.0f;
+
+  // Scratch memory for the warped window.
+  Eigen::ArrayXf src_cols_;
+  Eigen::ArrayXf src_rows_;
+  Eigen::ArrayXf src_inv_z_;
+  Eigen::ArrayXf src_colors_;
+};
+
+struct ParamState {
+  float depth = 0.0f;
+  float normal[3] = {0};
+};
+
+}  // namespace
+
+struct PatchMatchCpu::SweepOptions {
+  // Index of the sweep used to seed the random number generators.
+  int sweep_idx = 0;
+  float perturbation = 1.0f;
+  float prev_sel_prob_weight = 0.0f;
+  bool geom_consistency_term = false;
+  bool filter_photo_consistency = false;
+  bool filter_geom_consistency = false;
+};
+
+PatchMatchCpu::PatchMatchCpu(const PatchMatchOptions& options,
+                             const PatchMatch::Problem& problem)
+    : options_(options),
+      problem_(problem),
+      ref_width_(0),
+      ref_height_(0),
+      num_src_images_(0) {
+  thread_pool_ = std::make_unique<ThreadPool>(options_.num_threads);
+  InitRefImage();
+  InitSourceImages();
+  InitTransforms();
+  InitWorkspaceMemory();
+}
+
+void PatchMatchCpu::Run() {
+  Timer total_timer;
+  total_timer.Start();
+
+  Timer init_timer;
+  init_timer.Start();
+  ComputeInitialCost();
+  LOG(INFO) << StringPrintf("Initialization: %.4fs",
+                            init_timer.ElapsedSeconds());
+
+  const float total_num_steps = options_.num_iterations * 4;
+
+  for (int iter = 0; iter < options_.num_iterations; ++iter) {
+    Timer iter_timer;
+    iter_timer.Start();
+
+    for (int sweep = 0; sweep < 4; ++sweep) {
+      Timer sweep_timer;
+      sweep_timer.Start();
+
+      SweepOptions sweep_options;
+      sweep_options.sweep_idx = iter * 4 + sweep;
+
+      // Exponentially reduce amount of perturbation during the optimization.
+      sweep_options.perturbation = 1.0f / std::pow(2.0f, iter + sweep / 4.0f);
+
+      // Linearly increase the influence of previous selection probabilities.
+      sweep_options.prev_sel_prob_weight =
+          static_cast<float>(iter * 4 + sweep) / total_num_steps;
+
+      const bool last_sweep = iter == options_.num_iterations - 1 && sweep == 3;
+
+      sweep_options.geom_consistency_term = options_.geom_consistency;
+      if (last_sweep && options_.filter) {
+        sweep_options.filter_photo_consistency = true;
+        sweep_options.filter_geom_consistency = options_.geom_consistency;
+        consistency_mask_.assign(cost_map_.size(), 0);
+      }
+
+      Sweep(sweep, sweep_options);
+
+      // The updated selection probabilities are the prior of the next sweep.
+      prev_sel_prob_map_.swap(sel_prob_map_);
+
+      LOG(INFO) << StringPrintf(" Sweep %d: %.4fs",
+                                sweep + 1,
+                                sweep_timer.ElapsedSeconds());
+    }
+
+    LOG(INFO) << StringPrintf(
+        "Iteration %d: %.4fs", iter + 1, iter_timer.ElapsedSeconds());
+  }
+
+  LOG(INFO) << StringPrintf("Total: %.4fs", total_timer.ElapsedSeconds());
+}
+
+DepthMap PatchMatchCpu::GetDepthMap() const {
+  Mat<float> mat(ref_width_, ref_height_, 1);
+  std::copy(depth_map_.begin(), depth_map_.end(), mat.GetPtr());
+  return DepthMap(mat, options_.depth_min, options_.depth_max);
+}
+
+NormalMap PatchMatchCpu::GetNormalMap() const {
+  Mat<float> mat(ref_width_, ref_height_, 3);
+  for (int row = 0; row < ref_height_; ++row) {
+    for (int col = 0; col < ref_width_; ++col) {
+      const size_t pixel_idx = row * ref_width_ + col;
+      for (int i = 0; i < 3; ++i) {
+        mat.Set(row, col, i, normal_map_[3 * pixel_idx + i]);
+      }
+    }
+  }
+  return NormalMap(mat);
+}
+
+Mat<float> PatchMatchCpu::GetSelProbMap() const {
+  Mat<float> mat(ref_width_, ref_height_, num_src_images_);
+  for (int row = 0; row < ref_height_; ++row) {
+    for (int col = 0; col < ref_width_; ++col) {
+      const size_t pixel_idx = row * ref_width_ + col;
+      for (int i = 0; i < num_src_images_; ++i) {
+        mat.Set(
+            row, col, i, prev_sel_prob_map_[pixel_idx * num_src_images_ + i]);
+      }
+    }
+  }
+  return mat;
+}
+
+std::vector<int> PatchMatchCpu::GetConsistentImageIdxs() const {
+  std::vector<int> consistent_image_idxs;
+  if (consistency_mask_.empty()) {
+    return consistent_image_idxs;
+  }
+  std::vector<int> pixel_consistent_image_idxs;
+  pixel_consistent_image_idxs.reserve(num_src_images_);
+  for (int r = 0; r < ref_height_; ++r) {
+    for (int c = 0; c < ref_width_; ++c) {
+      const uint8_t* mask =
+          &consistency_mask_[(r * ref_width_ + c) * num_src_images_];
+      pixel_consistent_image_idxs.clear();
+      for (int d = 0; d < num_src_images_; ++d) {
+        if (mask[d]) {
+          pixel_consistent_image_idxs.push_back(problem_.src_image_idxs[d]);
+        }
+      }
+      if (pixel_consistent_image_idxs.size() > 0) {
+        consistent_image_idxs.push_back(c);
+        consistent_image_idxs.push_back(r);
+        consistent_image_idxs.push_back(pixel_consistent_image_idxs.size());
+        consistent_image_idxs.insert(consistent_image_idxs.end(),
+                                     pixel_consistent_image_idxs.begin(),
+                                     pixel_consistent_image_idxs.end());
+      }
+    }
+  }
+  return consistent_image_idxs;
+}
+
+void PatchMatchCpu::InitRefImage() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  ref_width_ = ref_image.GetWidth();
+  ref_height_ = ref_image.GetHeight();
+
+  const std::vector<uint8_t> ref_image_array =
+      ref_image.GetBitmap().ConvertToRowMajorArray();
+  ref_image_.resize(ref_image_array.size());
+  for (size_t i = 0; i < ref_image_array.size(); ++i) {
+    ref_image_[i] = ref_image_array[i] / 255.0f;
+  }
+}
+
+void PatchMatchCpu::InitSourceImages() {
+  num_src_images_ = problem_.src_image_idxs.size();
+  src_images_.resize(num_src_images_);
+  for (int i = 0; i < num_src_images_; ++i) {
+    const int image_idx = problem_.src_image_idxs[i];
+    const Image& image = problem_.images->at(image_idx);
+    SourceImage& src_image = src_images_[i];
+    src_image.width = image.GetWidth();
+    src_image.height = image.GetHeight();
+
+    const std::vector<uint8_t> image_array =
+        image.GetBitmap().ConvertToRowMajorArray();
+    src_image.image.resize(image_array.size());
+    for (size_t j = 0; j < image_array.size(); ++j) {
+      src_image.image[j] = image_array[j] / 255.0f;
+    }
+
+    if (options_.geom_consistency) {
+      const DepthMap& depth_map = problem_.depth_maps->at(image_idx);
+      src_image.depth_map.assign(
+          depth_map.GetPtr(),
+          depth_map.GetPtr() + depth_map.GetWidth() * depth_map.GetHeight());
+    }
+  }
+}
+
+void PatchMatchCpu::InitTransforms() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  ref_K_[0] = ref_image.GetK()[0];
+  ref_K_[1] = ref_image.GetK()[2];
+  ref_K_[2] = ref_image.GetK()[4];
+  ref_K_[3] = ref_image.GetK()[5];
+
+  ref_inv_K_[0] = 1.0f / ref_K_[0];
+  ref_inv_K_[1] = -ref_K_[1] / ref_K_[0];
+  ref_inv_K_[2] = 1.0f / ref_K_[2];
+  ref_inv_K_[3] = -ref_K_[3] / ref_K_[2];
+
+  for (int i = 0; i < num_src_images_; ++i) {
+    const Image& image = problem_.images->at(problem_.src_image_idxs[i]);
+    SourceImage& src_image = src_images_[i];
+
+    src_image.K[0] = image.GetK()[0];
+    src_image.K[1] = image.GetK()[2];
+    src_image.K[2] = image.GetK()[4];
+    src_image.K[3] = image.GetK()[5];
+
+    ComputeRelativePose(ref_image.GetR(),
+                        ref_image.GetT(),
+                        image.GetR(),
+                        image.GetT(),
+                        src_image.R,
+                        src_image.T);
+    ComputeProjectionCenter(src_image.R, src_image.T, src_image.C);
+    ComposeProjectionMatrix(
+        image.GetK(), src_image.R, src_image.T, src_image.P);
+    ComposeInverseProjectionMatrix(
+        image.GetK(), src_image.R, src_image.T, src_image.inv_P);
+  }
+}
+
+void PatchMatchCpu::InitWorkspaceMemory() {
+  const size_t num_pixels = ref_width_ * ref_height_;
+
+  depth_map_.resize(num_pixels);
+  normal_map_.resize(3 * num_pixels);
+  if (options_.geom_consistency) {
+    const DepthMap& init_depth_map =
+        problem_.depth_maps->at(problem_.ref_image_idx);
+    std::copy(init_depth_map.GetPtr(),
+              init_depth_map.GetPtr() + num_pixels,
+              depth_map_.begin());
+    const NormalMap& init_normal_map =
+        problem_.normal_maps->at(problem_.ref_image_idx);
+    for (int row = 0; row < ref_height_; ++row) {
+      for (int col = 0; col < ref_width_; ++col) {
+        const size_t pixel_idx = row * ref_width_ + col;
+        init_normal_map.GetSlice(row, col, &normal_map_[3 * pixel_idx]);
+      }
+    }
+  } else {
+    ProcessInBands(ref_height_, [this](const int row_begin, const int row_end) {
+      std::mt19937 rng(row_begin);
+      for (int row = row_begin; row < row_end; ++row) {
+        for (int col = 0; col < ref_width_; ++col) {
+          const size_t pixel_idx = row * ref_width_ + col;
+          depth_map_[pixel_idx] = GenerateRandomDepth(
+              options_.depth_min, options_.depth_max, &rng);
+          GenerateRandomNormal(
+              ref_inv_K_, row, col, &rng, &normal_map_[3 * pixel_idx]);
+        }
+      }
+    });
+  }
+
+  // Note that it is not necessary to keep the selection probability map in
+  // memory for all pixels. However, it is useful to keep the probabilities
+  // for the entire image in memory, so that it can be exported.
+  sel_prob_map_.resize(num_pixels * num_src_images_);
+  prev_sel_prob_map_.assign(num_pixels * num_src_images_, 0.5f);
+  cost_map_.resize(num_pixels * num_src_images_);
+  consistency_mask_.clear();
+}
+
+void PatchMatchCpu::ProcessInBands(
+    const int num_lines, const std::function<void(int, int)>& func) {
+  std::vector<std::future<void>> futures;
+  futures.reserve((num_lines - 1) / kNumLinesPerBand + 1);
+  for (int line_begin = 0; line_begin < num_lines;
+       line_begin += kNumLinesPerBand) {
+    const int line_end = std::min(num_lines, line_begin + kNumLinesPerBand);
+    futures.push_back(thread_pool_->AddTask(func, line_begin, line_end));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+void PatchMatchCpu::ComputeInitialCost() {
+  ProcessInBands(ref_height_, [this](const int row_begin, const int row_end) {
+    PhotoConsistencyCostComputer pcc_computer(ref_image_,
+                                              ref_width_,
+                                              ref_height_,
+                                              options_.window_radius,
+                                              options_.window_step,
+                                              options_.sigma_spatial,
+                                              options_.sigma_color);
+    float H[9];
+    for (int row = row_begin; row < row_end; ++row) {
+      for (int col = 0; col < ref_width_; ++col) {
+        const size_t pixel_idx = row * ref_width_ + col;
+        const float depth = depth_map_[pixel_idx];
+        const float* normal = &normal_map_[3 * pixel_idx];
+        pcc_computer.SetRefPixel(row, col);
+        for (int image_idx = 0; image_idx < num_src_images_; ++image_idx) {
+          const SourceImage& src_image = src_images_[image_idx];
+          ComposeHomography(ref_inv_K_,
+                            src_image.K,
+                            src_image.R,
+                            src_image.T,
+                            row,
+                            col,
+                            depth,
+                            normal,
+                            H);
+          cost_map_[pixel_idx * num_src_images_ + image_idx] =
+              pcc_computer.Compute(
+                  H, src_image.image, src_image.width, src_image.height);
+        }
+      }
+    }
+  });
+}
+
+void PatchMatchCpu::Sweep(const int direction,
+                          const SweepOptions& sweep_options) {
+  const int num_lines = direction % 2 == 0 ? ref_width_ : ref_height_;
+  ProcessInBands(num_lines, [&](const int line_begin, const int line_end) {
+    SweepLines(direction, line_begin, line_end, sweep_options);
+  });
+}
+
+void PatchMatchCpu::SweepLines(const int direction,
+                               const int line_begin,
+                               const int line_end,
+                               const SweepOptions& sweep_options) {
+  const int num_lines = line_end - line_begin;
+  const int num_positions = direction % 2 == 0 ? ref_height_ : ref_width_;
+  const int num_images = num_src_images_;
+
+  // Probability for boundary pixels.
+  constexpr float kUniformProb = 0.5f;
+
+  const LikelihoodComputer likelihood_computer(
+      options_.ncc_sigma,
+      DegToRad(options_.min_triangulation_angle),
+      options_.incident_angle_sigma);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compute backward message for all positions. Note that the backward
+  // messages are temporarily stored in the sel_prob_map and replaced pixel by
+  // pixel as the updated forward messages are computed further below.
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::vector<float> messages(num_lines * num_images, kUniformProb);
+  for (int position = num_positions - 1; position >= 0; --position) {
+    for (int line = line_begin; line < line_end; ++line) {
+      int row;
+      int col;
+      GetSweepPixel(
+          direction, ref_width_, ref_height_, line, position, &row, &col);
+      const size_t pixel_idx = row * ref_width_ + col;
+      float* beta = &messages[(line - line_begin) * num_images];
+      for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+        const size_t idx = pixel_idx * num_images + image_idx;
+        beta[image_idx] =
+            likelihood_computer.ComputeBackwardMessage(cost_map_[idx],
+                                                       beta[image_idx]);
+        sel_prob_map_[idx] = beta[image_idx];
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Estimate parameters for all positions and compute selection probabilities.
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Initialize forward messages.
+  std::vector<float>& forward_messages = messages;
+  std::fill(forward_messages.begin(), forward_messages.end(), kUniformProb);
+
+  PhotoConsistencyCostComputer pcc_computer(ref_image_,
+                                            ref_width_,
+                                            ref_height_,
+                                            options_.window_radius,
+                                            options_.window_step,
+                                            options_.sigma_spatial,
+                                            options_.sigma_color);
+
+  // Parameters of previous pixel in each line.
+  std::vector<ParamState> prev_param_states(num_lines);
+  // Random number generators of each line, seeded deterministically for
+  // reproducible results independent of the number of threads.
+  std::vector<std::mt19937> rngs;
+  rngs.reserve(num_lines);
+  for (int line = line_begin; line < line_end; ++line) {
+    std::seed_seq seed{sweep_options.sweep_idx, line};
+    rngs.emplace_back(seed);
+
+    int row;
+    int col;
+    GetSweepPixel(direction, ref_width_, ref_height_, line, 0, &row, &col);
+    const size_t pixel_idx = row * ref_width_ + col;
+    ParamState& prev_param_state = prev_param_states[line - line_begin];
+    prev_param_state.depth = depth_map_[pixel_idx];
+    std::copy_n(&normal_map_[3 * pixel_idx], 3, prev_param_state.normal);
+  }
+
+  std::vector<float> sampling_probs(num_images);
+
+  const float min_ncc_prob =
+      likelihood_computer.ComputeNCCProb(1.0f - options_.filter_min_ncc);
+  const float cos_min_triangulation_angle =
+      std::cos(DegToRad(options_.filter_min_triangulation_angle));
+
+  for (int position = 0; position < num_positions; ++position) {
+    for (int line = line_begin; line < line_end; ++line) {
+      int row;
+      int col;
+      GetSweepPixel(
+          direction, ref_width_, ref_height_, line, position, &row, &col);
+      int prev_row;
+      int prev_col;
+      GetSweepPixel(direction,
+                    ref_width_,
+                    ref_height_,
+                    line,
+                    position - 1,
+                    &prev_row,
+                    &prev_col);
+      const size_t pixel_idx = row * ref_width_ + col;
+      float* forward_message =
+          &forward_messages[(line - line_begin) * num_images];
+      float* cost_map = &cost_map_[pixel_idx * num_images];
+      float* sel_prob_map = &sel_prob_map_[pixel_idx * num_images];
+      const float* prev_sel_prob_map =
+          &prev_sel_prob_map_[pixel_idx * num_images];
+      ParamState& prev_param_state = prev_param_states[line - line_begin];
+      std::mt19937* rng = &rngs[line - line_begin];
+
+      // Propagate the depth at which the current ray intersects with the plane
+      // of the normal of the previous ray. This helps to better estimate
+      // the depth of very oblique structures, i.e. pixels whose normal
+      // direction is significantly different from their viewing direction.
+      prev_param_state.depth = PropagateDepth(ref_inv_K_,
+                                              direction,
+                                              prev_param_state.depth,
+                                              prev_param_state.normal,
+                                              prev_row,
+                                              prev_col,
+                                              row,
+                                              col);
+
+      // Read parameters for current pixel from previous sweep.
+      ParamState curr_param_state;
+      curr_param_state.depth = depth_map_[pixel_idx];
+      std::copy_n(&normal_map_[3 * pixel_idx], 3, curr_param_state.normal);
+
+      // Generate random parameters.
+      ParamState rand_param_state;
+      rand_param_state.depth = PerturbDepth(
+          sweep_options.perturbation, curr_param_state.depth, rng);
+      PerturbNormal(ref_inv_K_,
+                    row,
+                    col,
+                    sweep_options.perturbation * M_PI,
+                    curr_param_state.normal,
+                    rng,
+                    rand_param_state.normal);
+
+      // Read in the backward message, compute selection probabilities and
+      // modulate selection probabilities with priors.
+
+      float point[3];
+      ComputePointAtDepth(ref_inv_K_, row, col, curr_param_state.depth, point);
+
+      for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+        const SourceImage& src_image = src_images_[image_idx];
+
+        const float alpha = likelihood_computer.ComputeForwardMessage(
+            cost_map[image_idx], forward_message[image_idx]);
+        const float sel_prob = likelihood_computer.ComputeSelProb(
+            alpha,
+            sel_prob_map[image_idx],
+            prev_sel_prob_map[image_idx],
+            sweep_options.prev_sel_prob_weight);
+
+        float cos_triangulation_angle;
+        float cos_incident_angle;
+        ComputeViewingAngles(src_image.C,
+                             point,
+                             curr_param_state.normal,
+                             &cos_triangulation_angle,
+                             &cos_incident_angle);
+        const float tri_prob =
+            likelihood_computer.ComputeTriProb(cos_triangulation_angle);
+        const float inc_prob =
+            likelihood_computer.ComputeIncProb(cos_incident_angle);
+
+        float H[9];
+        ComposeHomography(ref_inv_K_,
+                          src_image.K,
+                          src_image.R,
+                          src_image.T,
+                          row,
+                          col,
+                          curr_param_state.depth,
+                          curr_param_state.normal,
+                          H);
+        const float res_prob = likelihood_computer.ComputeResolutionProb(
+            options_.window_radius, H, row, col);
+
+        sampling_probs[image_idx] = sel_prob * tri_prob * inc_prob * res_prob;
+      }
+
+      TransformPDFToCDF(sampling_probs.data(), num_images);
+
+      // Compute matching cost using Monte Carlo sampling of source images.
+      // Images with higher selection probability are more likely to be
+      // sampled. Hence, if only very few source images see the reference image
+      // pixel, the same source image is likely to be sampled many times.
+      // Instead of taking the best K probabilities, this sampling scheme has
+      // the advantage of being adaptive to any distribution of selection
+      // probabilities.
+
+      pcc_computer.SetRefPixel(row, col);
+
+      constexpr int kNumCosts = 5;
+      float costs[kNumCosts] = {0};
+      const float depths[kNumCosts] = {curr_param_state.depth,
+                                       prev_param_state.depth,
+                                       rand_param_state.depth,
+                                       curr_param_state.depth,
+                                       rand_param_state.depth};
+      const float* normals[kNumCosts] = {curr_param_state.normal,
+                                         prev_param_state.normal,
+                                         rand_param_state.normal,
+                                         rand_param_state.normal,
+                                         curr_param_state.normal};
+
+      for (int sample = 0; sample < options_.num_samples; ++sample) {
+        const float rand_prob = GenerateRandomUniform(rng) - FLT_EPSILON;
+
+        int src_image_idx = -1;
+        for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+          if (sampling_probs[image_idx] > rand_prob) {
+            src_image_idx = image_idx;
+            break;
+          }
+        }
+
+        if (src_image_idx == -1) {
+          continue;
+        }
+
+        const SourceImage& src_image = src_images_[src_image_idx];
+
+        for (int i = 0; i < kNumCosts; ++i) {
+          if (i == 0) {
+            costs[0] += cost_map[src_image_idx];
+          } else {
+            float H[9];
+            ComposeHomography(ref_inv_K_,
+                              src_image.K,
+                              src_image.R,
+                              src_image.T,
+                              row,
+                              col,
+                              depths[i],
+                              normals[i],
+                              H);
+            costs[i] += pcc_computer.Compute(
+                H, src_image.image, src_image.width, src_image.height);
+          }
+          if (sweep_options.geom_consistency_term) {
+            costs[i] += options_.geom_consistency_regularizer *
+                        ComputeGeomConsistencyCost(
+                            ref_K_,
+                            ref_inv_K_,
+                            src_image.P,
+                            src_image.inv_P,
+                            src_image.depth_map,
+                            src_image.width,
+                            src_image.height,
+                            row,
+                            col,
+                            depths[i],
+                            options_.geom_consistency_max_cost);
+          }
+        }
+      }
+
+      // Find the parameters of the minimum cost.
+      const int min_cost_idx = FindMinCost<kNumCosts>(costs);
+      ParamState best_param_state;
+      best_param_state.depth = depths[min_cost_idx];
+      std::copy_n(normals[min_cost_idx], 3, best_param_state.normal);
+
+      // Save best new parameters.
+      depth_map_[pixel_idx] = best_param_state.depth;
+      std::copy_n(best_param_state.normal, 3, &normal_map_[3 * pixel_idx]);
+
+      // Use the new cost to recompute the updated forward message and
+      // the selection probability.
+      for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+        // Determine the cost for best depth.
+        if (min_cost_idx != 0) {
+          const SourceImage& src_image = src_images_[image_idx];
+          float H[9];
+          ComposeHomography(ref_inv_K_,
+                            src_image.K,
+                            src_image.R,
+                            src_image.T,
+                            row,
+                            col,
+                            best_param_state.depth,
+                            best_param_state.normal,
+                            H);
+          cost_map[image_idx] = pcc_computer.Compute(
+              H, src_image.image, src_image.width, src_image.height);
+        }
+
+        const float alpha = likelihood_computer.ComputeForwardMessage(
+            cost_map[image_idx], forward_message[image_idx]);
+        forward_message[image_idx] = alpha;
+        sel_prob_map[image_idx] = likelihood_computer.ComputeSelProb(
+            alpha,
+            sel_prob_map[image_idx],
+            prev_sel_prob_map[image_idx],
+            sweep_options.prev_sel_prob_weight);
+      }
+
+      if (sweep_options.filter_photo_consistency ||
+          sweep_options.filter_geom_consistency) {
+        uint8_t* consistency_mask =
+            &consistency_mask_[pixel_idx * num_images];
+        int num_consistent = 0;
+
+        float best_point[3];
+        ComputePointAtDepth(
+            ref_inv_K_, row, col, best_param_state.depth, best_point);
+
+        for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+          const SourceImage& src_image = src_images_[image_idx];
+
+          float cos_triangulation_angle;
+          float cos_incident_angle;
+          ComputeViewingAngles(src_image.C,
+                               best_point,
+                               best_param_state.normal,
+                               &cos_triangulation_angle,
+                               &cos_incident_angle);
+          if (cos_triangulation_angle > cos_min_triangulation_angle ||
+              cos_incident_angle <= 0.0f) {
+            continue;
+          }
+
+          bool consistent = true;
+          if (sweep_options.filter_photo_consistency) {
+            consistent = sel_prob_map[image_idx] >= min_ncc_prob;
+          }
+          if (consistent && sweep_options.filter_geom_consistency) {
+            const float geom_consistency_cost =
+                ComputeGeomConsistencyCost(ref_K_,
+                                           ref_inv_K_,
+                                           src_image.P,
+                                           src_image.inv_P,
+                                           src_image.depth_map,
+                                           src_image.width,
+                                           src_image.height,
+                                           row,
+                                           col,
+                                           best_param_state.depth,
+                                           options_.geom_consistency_max_cost);
+            consistent = geom_consistency_cost <=
+                         options_.filter_geom_consistency_max_cost;
+          }
+
+          if (consistent) {
+            consistency_mask[image_idx] = 1;
+            num_consistent += 1;
+          }
+        }
+
+        if (num_consistent < options_.filter_min_num_consistent) {
+          depth_map_[pixel_idx] = 0.0f;
+          std::fill_n(&normal_map_[3 * pixel_idx], 3, 0.0f);
+          std::fill_n(consistency_mask, num_images, 0);
+        }
+      }
+
+      // Update previous parameters for next position.
+      prev_param_state = best_param_state;
+    }
+  }
+}
+
+}  // namespace mvs
+}  // namespace colmap
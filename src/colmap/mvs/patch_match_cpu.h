@@ -0,0 +1,144 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/mvs/depth_map.h"
+#include "colmap/mvs/image.h"
+#include "colmap/mvs/mat.h"
+#include "colmap/mvs/normal_map.h"
+#include "colmap/mvs/patch_match.h"
+#include "colmap/util/threading.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+// Multi-threaded CPU implementation of the patch match stereo algorithm, so
+// that dense reconstruction is possible on machines without a CUDA device. It
+// implements the same probabilistic model and sweep scheme as PatchMatchCuda;
+// results are statistically equivalent but not bitwise identical, since the
+// random sampling and floating point arithmetic differ. Instead of rotating
+// the reference image between sweeps, the four sweep directions are processed
+// in the original image frame. All scanlines of a sweep are independent and
+// are processed in parallel in bands of adjacent scanlines to maintain memory
+// locality.
+class PatchMatchCpu {
+ public:
+  PatchMatchCpu(const PatchMatchOptions& options,
+                const PatchMatch::Problem& problem);
+
+  void Run();
+
+  DepthMap GetDepthMap() const;
+  NormalMap GetNormalMap() const;
+  Mat<float> GetSelProbMap() const;
+  std::vector<int> GetConsistentImageIdxs() const;
+
+ private:
+  struct SourceImage {
+    int width = 0;
+    int height = 0;
+    // Image intensities normalized to the range [0, 1].
+    std::vector<float> image;
+    // Depth map for the geometric consistency term.
+    std::vector<float> depth_map;
+    // Calibration as {fx, cx, fy, cy}.
+    float K[4];
+    // Relative rotation, translation, camera center, projection, and inverse
+    // projection from the reference image to this source image.
+    float R[9];
+    float T[3];
+    float C[3];
+    float P[12];
+    float inv_P[12];
+  };
+
+  struct SweepOptions;
+
+  void InitRefImage();
+  void InitSourceImages();
+  void InitTransforms();
+  void InitWorkspaceMemory();
+
+  // Split the given number of scanlines into bands of adjacent scanlines and
+  // process them in parallel as func(line_begin, line_end).
+  void ProcessInBands(int num_lines,
+                      const std::function<void(int, int)>& func);
+
+  void ComputeInitialCost();
+
+  // Sweep over all scanlines in the given direction, where 0 is from top to
+  // bottom, 1 from right to left, 2 from bottom to top, and 3 from left to
+  // right. Equivalent to the sweeps of PatchMatchCuda after the given number of
+  // counter-clockwise rotations of the reference image.
+  void Sweep(int direction, const SweepOptions& sweep_options);
+  void SweepLines(int direction,
+                  int line_begin,
+                  int line_end,
+                  const SweepOptions& sweep_options);
+
+  const PatchMatchOptions options_;
+  const PatchMatch::Problem problem_;
+
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  int ref_width_;
+  int ref_height_;
+  int num_src_images_;
+
+  // Reference image intensities normalized to the range [0, 1].
+  std::vector<float> ref_image_;
+
+  // Calibration of reference image as {fx, cx, fy, cy}.
+  float ref_K_[4];
+  // Calibration of reference image as {1/fx, -cx/fx, 1/fy, -cy/fy}.
+  float ref_inv_K_[4];
+
+  // Source image data and relative poses from the reference image.
+  std::vector<SourceImage> src_images_;
+
+  // Per-pixel state of the reference image. Multi-channel maps are stored
+  // pixel-interleaved, i.e. the values of all channels of one pixel are
+  // contiguous in memory, and only converted to the planar Mat layout on
+  // output.
+  std::vector<float> depth_map_;
+  std::vector<float> normal_map_;
+  std::vector<float> cost_map_;
+  std::vector<float> sel_prob_map_;
+  std::vector<float> prev_sel_prob_map_;
+  std::vector<uint8_t> consistency_mask_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
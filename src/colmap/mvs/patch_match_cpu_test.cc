@@ -0,0 +1,230 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/patch_match_cpu.h"
+
+#include "colmap/mvs/consistency_graph.h"
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+constexpr int kWidth = 80;
+constexpr int kHeight = 60;
+constexpr float kFocalLength = 80;
+constexpr float kPlaneDepth = 5;
+
+// Render a textured fronto-parallel plane at kPlaneDepth as seen by a camera
+// with identity rotation, which is translated along the x-axis.
+Image CreatePlaneImage(const float tx) {
+  const float K[9] = {
+      kFocalLength, 0, kWidth / 2.0f, 0, kFocalLength, kHeight / 2.0f, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  const float T[3] = {tx, 0, 0};
+  Image image("", kWidth, kHeight, K, R, T);
+
+  Bitmap bitmap;
+  bitmap.Allocate(kWidth, kHeight, /*as_rgb=*/false);
+  for (int row = 0; row < kHeight; ++row) {
+    for (int col = 0; col < kWidth; ++col) {
+      const float x = kPlaneDepth * (col - K[2]) / kFocalLength - tx;
+      const float y = kPlaneDepth * (row - K[5]) / kFocalLength;
+      const float intensity =
+          127.5f + 50 * std::sin(7.1f * x) * std::sin(5.3f * y) +
+          40 * std::sin(13.7f * x + 11.3f * y);
+      bitmap.SetPixel(
+          col, row, BitmapColor<uint8_t>(static_cast<uint8_t>(intensity)));
+    }
+  }
+  image.SetBitmap(bitmap);
+
+  return image;
+}
+
+PatchMatchOptions CreateOptions() {
+  PatchMatchOptions options;
+  options.use_gpu = false;
+  options.num_threads = 2;
+  options.depth_min = 2;
+  options.depth_max = 10;
+  options.window_radius = 3;
+  options.sigma_spatial = options.window_radius;
+  options.num_iterations = 3;
+  options.geom_consistency = false;
+  options.filter = false;
+  return options;
+}
+
+TEST(PatchMatchCpu, FrontoParallelPlane) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-0.5), CreatePlaneImage(0.5)};
+
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+
+  PatchMatchOptions options = CreateOptions();
+  options.filter = true;
+  PatchMatchCpu patch_match(options, problem);
+  patch_match.Run();
+
+  const DepthMap depth_map = patch_match.GetDepthMap();
+  const NormalMap normal_map = patch_match.GetNormalMap();
+  EXPECT_EQ(depth_map.GetWidth(), kWidth);
+  EXPECT_EQ(depth_map.GetHeight(), kHeight);
+  EXPECT_EQ(normal_map.GetWidth(), kWidth);
+  EXPECT_EQ(normal_map.GetHeight(), kHeight);
+
+  const Mat<float> sel_prob_map = patch_match.GetSelProbMap();
+  EXPECT_EQ(sel_prob_map.GetWidth(), kWidth);
+  EXPECT_EQ(sel_prob_map.GetHeight(), kHeight);
+  EXPECT_EQ(sel_prob_map.GetDepth(), 2);
+
+  // Only evaluate pixels away from the border, which are visible in both
+  // source images.
+  const int kBorder = 10;
+  int num_pixels = 0;
+  int num_accurate_depths = 0;
+  int num_accurate_normals = 0;
+  for (int row = kBorder; row < kHeight - kBorder; ++row) {
+    for (int col = kBorder; col < kWidth - kBorder; ++col) {
+      num_pixels += 1;
+      if (std::abs(depth_map.Get(row, col) - kPlaneDepth) <
+          0.02 * kPlaneDepth) {
+        num_accurate_depths += 1;
+      }
+      if (normal_map.Get(row, col, 2) < -0.95f) {
+        num_accurate_normals += 1;
+      }
+    }
+  }
+  EXPECT_GT(num_accurate_depths, 0.9 * num_pixels);
+  EXPECT_GT(num_accurate_normals, 0.9 * num_pixels);
+
+  const ConsistencyGraph consistency_graph(
+      kWidth, kHeight, patch_match.GetConsistentImageIdxs());
+  int num_consistent_pixels = 0;
+  for (int row = kBorder; row < kHeight - kBorder; ++row) {
+    for (int col = kBorder; col < kWidth - kBorder; ++col) {
+      int num_images;
+      const int* image_idxs;
+      consistency_graph.GetImageIdxs(row, col, &num_images, &image_idxs);
+      if (num_images == 2) {
+        num_consistent_pixels += 1;
+      }
+    }
+  }
+  EXPECT_GT(num_consistent_pixels, 0.9 * num_pixels);
+}
+
+TEST(PatchMatchCpu, GeometricConsistency) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-0.5), CreatePlaneImage(0.5)};
+  std::vector<DepthMap> depth_maps(images.size());
+  std::vector<NormalMap> normal_maps(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    depth_maps[i] = DepthMap(kWidth, kHeight, 2, 10);
+    depth_maps[i].Fill(kPlaneDepth);
+    normal_maps[i] = NormalMap(kWidth, kHeight);
+    for (int row = 0; row < kHeight; ++row) {
+      for (int col = 0; col < kWidth; ++col) {
+        normal_maps[i].Set(row, col, 2, -1);
+      }
+    }
+  }
+
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+  problem.depth_maps = &depth_maps;
+  problem.normal_maps = &normal_maps;
+
+  PatchMatchOptions options = CreateOptions();
+  options.num_iterations = 1;
+  options.geom_consistency = true;
+  options.filter = true;
+  PatchMatchCpu patch_match(options, problem);
+  patch_match.Run();
+
+  const DepthMap depth_map = patch_match.GetDepthMap();
+  const ConsistencyGraph consistency_graph(
+      kWidth, kHeight, patch_match.GetConsistentImageIdxs());
+  const int kBorder = 10;
+  int num_pixels = 0;
+  int num_consistent_pixels = 0;
+  for (int row = kBorder; row < kHeight - kBorder; ++row) {
+    for (int col = kBorder; col < kWidth - kBorder; ++col) {
+      num_pixels += 1;
+      int num_images;
+      const int* image_idxs;
+      consistency_graph.GetImageIdxs(row, col, &num_images, &image_idxs);
+      if (num_images == 2 && std::abs(depth_map.Get(row, col) - kPlaneDepth) <
+                                 0.02 * kPlaneDepth) {
+        num_consistent_pixels += 1;
+      }
+    }
+  }
+  EXPECT_GT(num_consistent_pixels, 0.9 * num_pixels);
+}
+
+TEST(PatchMatchCpu, Deterministic) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-0.5), CreatePlaneImage(0.5)};
+
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+
+  PatchMatchOptions options = CreateOptions();
+  options.num_iterations = 1;
+
+  options.num_threads = 1;
+  PatchMatchCpu patch_match1(options, problem);
+  patch_match1.Run();
+
+  options.num_threads = 3;
+  PatchMatchCpu patch_match2(options, problem);
+  patch_match2.Run();
+
+  EXPECT_EQ(patch_match1.GetDepthMap().GetData(),
+            patch_match2.GetDepthMap().GetData());
+  EXPECT_EQ(patch_match1.GetNormalMap().GetData(),
+            patch_match2.GetNormalMap().GetData());
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
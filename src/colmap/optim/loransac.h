@@ -119,6 +119,14 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   std::vector<typename LocalEstimator::X_t> X_inlier;
   std::vector<typename LocalEstimator::Y_t> Y_inlier;
 
+  internal::ModelSupportEvaluator<Estimator, SupportMeasurer> evaluator(X, Y);
+  internal::ModelSupportEvaluator<LocalEstimator, SupportMeasurer>
+      local_evaluator(X, Y);
+  SPRT sprt(internal::CreateSPRTOptions(options_));
+  if (options_.use_sprt) {
+    evaluator.SetSPRT(&sprt);
+  }
+
   std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::M_t> sample_models;
@@ -145,13 +153,17 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+      typename SupportMeasurer::Support support;
+      const bool is_complete = evaluator.Evaluate(estimator,
+                                                  support_measurer,
+                                                  sample_model,
+                                                  max_residual,
+                                                  best_support,
+                                                  &support,
+                                                  &residuals);
 
       // Do local optimization if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+      if (is_complete && support_measurer.Compare(support, best_support)) {
         best_support = support;
         best_model = sample_model;
         best_model_is_local = false;
@@ -180,14 +192,19 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
             const size_t prev_best_num_inliers = best_support.num_inliers;
 
             for (const auto& local_model : local_models) {
-              local_estimator.Residuals(X, Y, local_model, &residuals);
-              THROW_CHECK_EQ(residuals.size(), num_samples);
-
-              const auto local_support =
-                  support_measurer.Evaluate(residuals, max_residual);
+              typename SupportMeasurer::Support local_support;
+              const bool is_complete =
+                  local_evaluator.Evaluate(local_estimator,
+                                           support_measurer,
+                                           local_model,
+                                           max_residual,
+                                           best_support,
+                                           &local_support,
+                                           &residuals);
 
               // Check if locally optimized model is better.
-              if (support_measurer.Compare(local_support, best_support)) {
+              if (is_complete &&
+                  support_measurer.Compare(local_support, best_support)) {
                 best_support = local_support;
                 best_model = local_model;
                 best_model_is_local = true;
@@ -207,12 +224,32 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
           }
         }
 
+        sprt.UpdateInlierRatio(static_cast<double>(best_support.num_inliers) /
+                               num_samples);
+
         dyn_max_num_trials =
             RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
                 best_support.num_inliers,
                 num_samples,
                 options_.confidence,
                 options_.dyn_num_trials_multiplier);
+        if (std::is_base_of<ProgressiveSampler, Sampler>::value) {
+          // The residuals of the best model are not retained during local
+          // optimization, so they are recomputed here.
+          if (best_model_is_local) {
+            local_estimator.Residuals(X, Y, best_model, &residuals);
+          } else {
+            estimator.Residuals(X, Y, best_model, &residuals);
+          }
+          dyn_max_num_trials = std::min(
+              dyn_max_num_trials,
+              RANSAC<Estimator, SupportMeasurer, Sampler>::
+                  ComputeProgressiveNumTrials(
+                      residuals,
+                      max_residual,
+                      options_.confidence,
+                      options_.dyn_num_trials_multiplier));
+        }
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -82,7 +82,8 @@ void ProgressiveSampler::Sample(std::vector<size_t>* sampled_idxs) {
   }
 
   // Decide how many samples to draw from which part of the data as
-  // specified in equation 5.
+  // specified in equation 5. Note that `n_` is the size of the current subset
+  // of the top-ranked data, so its last element has index `n_ - 1`.
   size_t num_random_samples = num_samples_;
   size_t max_random_sample_idx = n_ - 1;
   if (T_n_p_ >= t_) {
@@ -104,7 +105,7 @@ void ProgressiveSampler::Sample(std::vector<size_t>* sampled_idxs) {
 
   // In progressive sampling mode, the last element is mandatory.
   if (T_n_p_ >= t_) {
-    sampled_idxs->push_back(n_);
+    sampled_idxs->push_back(n_ - 1);
   }
 }
 
@@ -29,6 +29,7 @@
 
 #include "colmap/optim/progressive_sampler.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 #include <gtest/gtest.h>
@@ -59,6 +60,7 @@ TEST(ProgressiveSampler, EqualSamples) {
     EXPECT_EQ(samples.size(), 5);
     EXPECT_EQ(std::unordered_set<size_t>(samples.begin(), samples.end()).size(),
               5);
+    EXPECT_LT(*std::max_element(samples.begin(), samples.end()), 5);
   }
 }
 
@@ -66,7 +68,7 @@ TEST(ProgressiveSampler, Progressive) {
   const size_t kNumSamples = 5;
   ProgressiveSampler sampler(kNumSamples);
   sampler.Initialize(50);
-  size_t prev_last_sample = 5;
+  size_t prev_last_sample = kNumSamples - 1;
   for (size_t i = 0; i < 100; ++i) {
     std::vector<size_t> samples;
     sampler.Sample(&samples);
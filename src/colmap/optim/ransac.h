@@ -29,13 +29,17 @@
 
 #pragma once
 
+#include "colmap/optim/progressive_sampler.h"
 #include "colmap/optim/random_sampler.h"
+#include "colmap/optim/sprt.h"
 #include "colmap/optim/support_measurement.h"
 #include "colmap/util/logging.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <random>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace colmap {
@@ -61,6 +65,14 @@ struct RANSACOptions {
   int min_num_trials = 0;
   int max_num_trials = std::numeric_limits<int>::max();
 
+  // Whether to verify models with the Sequential Probability Ratio Test
+  // (SPRT), which rejects bad models after evaluating only a part of the
+  // samples. The test adapts to the inlier ratio of the best model and to the
+  // consistency of rejected models. Note that good models are rejected with a
+  // small probability, so the results differ from standard verification. The
+  // test assumes that the inliers are not clustered in the order of samples.
+  bool use_sprt = false;
+
   void Check() const {
     THROW_CHECK_GT(max_error, 0);
     THROW_CHECK_GE(min_inlier_ratio, 0);
@@ -71,6 +83,144 @@ struct RANSACOptions {
   }
 };
 
+namespace internal {
+
+template <typename... Ts>
+struct MakeVoid {
+  typedef void type;
+};
+
+// Whether the estimator provides a structure-of-arrays layout of the samples
+// through `XBatch_t` and `YBatch_t` together with a range-based overload of
+// `Residuals` operating on it.
+template <typename Estimator, typename = void>
+struct HasBatchedResiduals : std::false_type {};
+
+template <typename Estimator>
+struct HasBatchedResiduals<
+    Estimator,
+    typename MakeVoid<typename Estimator::XBatch_t,
+                      typename Estimator::YBatch_t>::type> : std::true_type {
+};
+
+// Evaluates the support of models on a fixed set of samples.
+template <typename Estimator,
+          typename SupportMeasurer,
+          bool kBatched = HasBatchedResiduals<Estimator>::value>
+class ModelSupportEvaluator {
+ public:
+  ModelSupportEvaluator(const std::vector<typename Estimator::X_t>& X,
+                        const std::vector<typename Estimator::Y_t>& Y)
+      : X_(X), Y_(Y) {}
+
+  // Optionally verify models with the given SPRT, which must outlive the
+  // evaluator.
+  void SetSPRT(SPRT* sprt) { sprt_ = sprt; }
+
+  // Compute the residuals and the support of the model. Returns false if the
+  // model was rejected, because it cannot be better than `best_support` or
+  // because it failed the SPRT, in which case the residuals and support are
+  // incomplete.
+  bool Evaluate(Estimator& estimator,
+                SupportMeasurer& support_measurer,
+                const typename Estimator::M_t& model,
+                const double max_residual,
+                const typename SupportMeasurer::Support& best_support,
+                typename SupportMeasurer::Support* support,
+                std::vector<double>* residuals) {
+    estimator.Residuals(X_, Y_, model, residuals);
+    THROW_CHECK_EQ(residuals->size(), X_.size());
+    if (sprt_ != nullptr) {
+      SPRT::State sprt_state;
+      if (!sprt_->Evaluate(
+              *residuals, max_residual, 0, residuals->size(), &sprt_state)) {
+        sprt_->AddRejectedModel(sprt_state);
+        return false;
+      }
+    }
+    *support = support_measurer.Evaluate(*residuals, max_residual);
+    return true;
+  }
+
+ private:
+  const std::vector<typename Estimator::X_t>& X_;
+  const std::vector<typename Estimator::Y_t>& Y_;
+  SPRT* sprt_ = nullptr;
+};
+
+// Specialization for estimators with vectorized residuals. The samples are
+// converted to the structure-of-arrays layout once and the residuals are then
+// evaluated block-wise, such that models that can no longer beat the best
+// support are rejected without computing all of their residuals. The
+// rejection is exact and does not change the selected model.
+template <typename Estimator, typename SupportMeasurer>
+class ModelSupportEvaluator<Estimator, SupportMeasurer, true> {
+ public:
+  // Number of residuals evaluated between checks for early rejection.
+  static const size_t kBlockSize = 256;
+
+  ModelSupportEvaluator(const std::vector<typename Estimator::X_t>& X,
+                        const std::vector<typename Estimator::Y_t>& Y)
+      : X_(X), Y_(Y) {
+    THROW_CHECK_EQ(X_.size(), Y_.size());
+  }
+
+  void SetSPRT(SPRT* sprt) { sprt_ = sprt; }
+
+  bool Evaluate(Estimator& estimator,
+                SupportMeasurer& support_measurer,
+                const typename Estimator::M_t& model,
+                const double max_residual,
+                const typename SupportMeasurer::Support& best_support,
+                typename SupportMeasurer::Support* support,
+                std::vector<double>* residuals) {
+    const size_t num_samples = X_.size();
+    residuals->resize(num_samples);
+    size_t num_outliers = 0;
+    SPRT::State sprt_state;
+    for (size_t begin = 0; begin < num_samples; begin += kBlockSize) {
+      const size_t end = std::min(begin + kBlockSize, num_samples);
+      estimator.Residuals(X_, Y_, model, begin, end, residuals);
+      if (sprt_ != nullptr &&
+          !sprt_->Evaluate(*residuals, max_residual, begin, end, &sprt_state)) {
+        sprt_->AddRejectedModel(sprt_state);
+        return false;
+      }
+      for (size_t i = begin; i < end; ++i) {
+        // Written as a negation to also count NaN residuals as outliers.
+        if (!((*residuals)[i] <= max_residual)) {
+          ++num_outliers;
+        }
+      }
+      if (end < num_samples &&
+          !support_measurer.IsPossiblyBetter(num_samples - num_outliers,
+                                             num_samples,
+                                             max_residual,
+                                             best_support)) {
+        return false;
+      }
+    }
+    *support = support_measurer.Evaluate(*residuals, max_residual);
+    return true;
+  }
+
+ private:
+  const typename Estimator::XBatch_t X_;
+  const typename Estimator::YBatch_t Y_;
+  SPRT* sprt_ = nullptr;
+};
+
+// Initial SPRT options derived from the a priori assumed minimum inlier ratio.
+inline SPRT::Options CreateSPRTOptions(const RANSACOptions& options) {
+  SPRT::Options sprt_options;
+  sprt_options.epsilon =
+      std::min(std::max(options.min_inlier_ratio, 0.02), 0.99);
+  sprt_options.delta = std::min(sprt_options.delta, 0.5 * sprt_options.epsilon);
+  return sprt_options;
+}
+
+}  // namespace internal
+
 template <typename Estimator,
           typename SupportMeasurer = InlierSupportMeasurer,
           typename Sampler = RandomSampler>
@@ -112,6 +262,26 @@ class RANSAC {
                                  double confidence,
                                  double num_trials_multiplier);
 
+  // Determine the maximum number of trials for progressive sampling, which
+  // draws the samples from the top-ranked data first. Following the
+  // maximality and non-randomness criteria of PROSAC, this is the minimum
+  // number of trials over all subsets of top-ranked samples, whose number of
+  // inliers is unlikely to be supported by a random model.
+  //
+  // @param residuals               Residuals of the best model.
+  // @param max_residual            Maximum residual of an inlier.
+  // @param confidence              Confidence that one sample is
+  //                                outlier-free.
+  // @param num_trials_multiplier   Multiplication factor to the computed
+  //                                number of trials.
+  //
+  // @return               The required number of iterations.
+  static size_t ComputeProgressiveNumTrials(
+      const std::vector<double>& residuals,
+      double max_residual,
+      double confidence,
+      double num_trials_multiplier);
+
   // Robustly estimate model with RANSAC (RANdom SAmple Consensus).
   //
   // @param X              Independent variables.
@@ -178,6 +348,51 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
       std::ceil(std::log(nom) / std::log(denom) * num_trials_multiplier));
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeProgressiveNumTrials(
+    const std::vector<double>& residuals,
+    const double max_residual,
+    const double confidence,
+    const double num_trials_multiplier) {
+  // Probability that a sample is consistent with a random model and the
+  // corresponding quantile of the normal distribution for a 5% probability of
+  // the inliers being supported by a random model.
+  const double kRandomInlierRatio = 0.05;
+  const double kQuantile = 1.645;
+
+  const size_t num_min_samples = Estimator::kMinNumSamples;
+
+  size_t num_trials = std::numeric_limits<size_t>::max();
+  size_t num_inliers = 0;
+  for (size_t i = 0; i < residuals.size(); ++i) {
+    if (residuals[i] <= max_residual) {
+      num_inliers += 1;
+    }
+
+    const size_t num_samples = i + 1;
+    if (num_samples < num_min_samples) {
+      continue;
+    }
+
+    const double num_random_samples = num_samples - num_min_samples;
+    const double min_num_inliers =
+        num_min_samples + kRandomInlierRatio * num_random_samples +
+        kQuantile * std::sqrt(num_random_samples * kRandomInlierRatio *
+                              (1 - kRandomInlierRatio));
+    if (num_inliers < min_num_inliers) {
+      continue;
+    }
+
+    num_trials = std::min(num_trials,
+                          ComputeNumTrials(num_inliers,
+                                           num_samples,
+                                           confidence,
+                                           num_trials_multiplier));
+  }
+
+  return num_trials;
+}
+
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 typename RANSAC<Estimator, SupportMeasurer, Sampler>::Report
 RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
@@ -204,6 +419,12 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
   std::vector<double> residuals(num_samples);
 
+  internal::ModelSupportEvaluator<Estimator, SupportMeasurer> evaluator(X, Y);
+  SPRT sprt(internal::CreateSPRTOptions(options_));
+  if (options_.use_sprt) {
+    evaluator.SetSPRT(&sprt);
+  }
+
   std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::M_t> sample_models;
@@ -229,21 +450,36 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models.
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+      typename SupportMeasurer::Support support;
+      const bool is_complete = evaluator.Evaluate(estimator,
+                                                  support_measurer,
+                                                  sample_model,
+                                                  max_residual,
+                                                  best_support,
+                                                  &support,
+                                                  &residuals);
 
       // Save as best subset if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+      if (is_complete && support_measurer.Compare(support, best_support)) {
         best_support = support;
         best_model = sample_model;
 
+        sprt.UpdateInlierRatio(static_cast<double>(best_support.num_inliers) /
+                               num_samples);
+
         dyn_max_num_trials =
             ComputeNumTrials(best_support.num_inliers,
                              num_samples,
                              options_.confidence,
                              options_.dyn_num_trials_multiplier);
+        if (std::is_base_of<ProgressiveSampler, Sampler>::value) {
+          dyn_max_num_trials = std::min(
+              dyn_max_num_trials,
+              ComputeProgressiveNumTrials(residuals,
+                                          max_residual,
+                                          options_.confidence,
+                                          options_.dyn_num_trials_multiplier));
+        }
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -134,5 +134,41 @@ TEST(RANSAC, SimilarityTransform) {
   EXPECT_LT(matrix_diff, 1e-6);
 }
 
+TEST(RANSAC, SimilarityTransformSPRT) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+
+  const Sim3d expectedTgtFromSrc(
+      2, Eigen::Quaterniond::UnitRandom(), Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> tgt;
+  std::vector<char> expected_inlier_mask;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    if (i % 5 < 2) {
+      tgt.emplace_back(RandomUniformReal(-3000.0, -2000.0),
+                       RandomUniformReal(-4000.0, -3000.0),
+                       RandomUniformReal(-5000.0, -4000.0));
+      expected_inlier_mask.push_back(false);
+    } else {
+      tgt.push_back(expectedTgtFromSrc * src.back());
+      expected_inlier_mask.push_back(true);
+    }
+  }
+
+  RANSACOptions options;
+  options.max_error = 10;
+  options.use_sprt = true;
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto report = ransac.Estimate(src, tgt);
+
+  EXPECT_TRUE(report.success);
+  EXPECT_EQ(report.support.num_inliers, 600);
+  EXPECT_EQ(report.inlier_mask, expected_inlier_mask);
+  EXPECT_LT((expectedTgtFromSrc.ToMatrix() - report.model).norm(), 1e-6);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -29,6 +29,8 @@
 
 #include "colmap/optim/sprt.h"
 
+#include <algorithm>
+
 namespace colmap {
 
 SPRT::SPRT(const Options& options) { Update(options); }
@@ -40,33 +42,80 @@ void SPRT::Update(const Options& options) {
   UpdateDecisionThreshold();
 }
 
+const SPRT::Options& SPRT::GetOptions() const { return options_; }
+
 bool SPRT::Evaluate(const std::vector<double>& residuals,
                     const double max_residual,
                     size_t* num_inliers,
                     size_t* num_eval_samples) {
-  *num_inliers = 0;
-
-  double likelihood_ratio = 1;
+  State state;
+  const bool is_accepted =
+      Evaluate(residuals, max_residual, 0, residuals.size(), &state);
+  *num_inliers = state.num_inliers;
+  *num_eval_samples = state.num_eval_samples;
+  return is_accepted;
+}
 
-  for (size_t i = 0; i < residuals.size(); ++i) {
+bool SPRT::Evaluate(const std::vector<double>& residuals,
+                    const double max_residual,
+                    const size_t begin,
+                    const size_t end,
+                    State* state) const {
+  for (size_t i = begin; i < end; ++i) {
     if (std::abs(residuals[i]) <= max_residual) {
-      *num_inliers += 1;
-      likelihood_ratio *= delta_epsilon_;
+      state->num_inliers += 1;
+      state->likelihood_ratio *= delta_epsilon_;
     } else {
-      likelihood_ratio *= delta_1_epsilon_1_;
+      state->likelihood_ratio *= delta_1_epsilon_1_;
     }
 
-    if (likelihood_ratio > decision_threshold_) {
-      *num_eval_samples = i + 1;
+    if (state->likelihood_ratio > decision_threshold_) {
+      state->num_eval_samples = i + 1;
       return false;
     }
   }
 
-  *num_eval_samples = residuals.size();
+  state->num_eval_samples = end;
 
   return true;
 }
 
+void SPRT::UpdateInlierRatio(const double epsilon) {
+  // The test is only meaningful, if good models are more consistent with the
+  // data than bad models.
+  if (epsilon <= options_.epsilon || epsilon >= 1 ||
+      epsilon <= options_.delta) {
+    return;
+  }
+  Options options = options_;
+  options.epsilon = epsilon;
+  Update(options);
+}
+
+void SPRT::AddRejectedModel(const State& state) {
+  rejected_num_inliers_ += state.num_inliers;
+  rejected_num_eval_samples_ += state.num_eval_samples;
+  if (rejected_num_eval_samples_ == 0) {
+    return;
+  }
+
+  const double kMinDelta = 1e-4;
+  const double delta =
+      std::max(kMinDelta,
+               static_cast<double>(rejected_num_inliers_) /
+                   rejected_num_eval_samples_);
+
+  // Only re-design the test, if the estimate changed significantly.
+  const double kMaxRelativeChange = 0.1;
+  if (delta >= options_.epsilon ||
+      std::abs(delta - options_.delta) <= kMaxRelativeChange * options_.delta) {
+    return;
+  }
+  Options options = options_;
+  options.delta = delta;
+  Update(options);
+}
+
 void SPRT::UpdateDecisionThreshold() {
   // Equation 2
   const double C = (1 - options_.delta) *
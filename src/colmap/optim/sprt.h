@@ -59,15 +59,41 @@ class SPRT {
     int num_models_per_sample = 1;
   };
 
+  // State of the sequential evaluation of a single model, which allows to
+  // evaluate the residuals of the model in multiple chunks.
+  struct State {
+    double likelihood_ratio = 1;
+    size_t num_inliers = 0;
+    size_t num_eval_samples = 0;
+  };
+
   explicit SPRT(const Options& options);
 
   void Update(const Options& options);
 
+  const Options& GetOptions() const;
+
   bool Evaluate(const std::vector<double>& residuals,
                 double max_residual,
                 size_t* num_inliers,
                 size_t* num_eval_samples);
 
+  // Continue the evaluation of a model with the residuals in [begin, end).
+  // Returns false as soon as the model is rejected.
+  bool Evaluate(const std::vector<double>& residuals,
+                double max_residual,
+                size_t begin,
+                size_t end,
+                State* state) const;
+
+  // Adapt the test to the inlier ratio of the best model found so far, as
+  // proposed in section 3 of the paper.
+  void UpdateInlierRatio(double epsilon);
+
+  // Adapt the probability of a sample being consistent with a bad model to
+  // the fraction of consistent samples in the rejected models.
+  void AddRejectedModel(const State& state);
+
  private:
   void UpdateDecisionThreshold();
 
@@ -75,6 +101,8 @@ class SPRT {
   double delta_epsilon_;
   double delta_1_epsilon_1_;
   double decision_threshold_;
+  size_t rejected_num_inliers_ = 0;
+  size_t rejected_num_eval_samples_ = 0;
 };
 
 }  // namespace colmap
@@ -0,0 +1,132 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/optim/sprt.h"
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(SPRT, Evaluate) {
+  SPRT::Options options;
+  options.delta = 0.01;
+  options.epsilon = 0.5;
+  SPRT sprt(options);
+
+  const std::vector<double> inlier_residuals(100, 0.0);
+  size_t num_inliers = 0;
+  size_t num_eval_samples = 0;
+  EXPECT_TRUE(
+      sprt.Evaluate(inlier_residuals, 1.0, &num_inliers, &num_eval_samples));
+  EXPECT_EQ(num_inliers, 100);
+  EXPECT_EQ(num_eval_samples, 100);
+
+  const std::vector<double> outlier_residuals(100, 2.0);
+  EXPECT_FALSE(
+      sprt.Evaluate(outlier_residuals, 1.0, &num_inliers, &num_eval_samples));
+  EXPECT_EQ(num_inliers, 0);
+  EXPECT_GT(num_eval_samples, 0);
+  EXPECT_LT(num_eval_samples, 100);
+}
+
+TEST(SPRT, EvaluateIncrementally) {
+  SPRT::Options options;
+  options.delta = 0.01;
+  options.epsilon = 0.5;
+  SPRT sprt(options);
+
+  std::vector<double> residuals(100, 0.0);
+  for (size_t i = 0; i < residuals.size(); i += 3) {
+    residuals[i] = 2.0;
+  }
+
+  size_t num_inliers = 0;
+  size_t num_eval_samples = 0;
+  const bool is_accepted =
+      sprt.Evaluate(residuals, 1.0, &num_inliers, &num_eval_samples);
+
+  SPRT::State state;
+  bool is_accepted_incrementally = true;
+  for (size_t begin = 0; begin < residuals.size(); begin += 16) {
+    const size_t end = std::min(begin + 16, residuals.size());
+    if (!sprt.Evaluate(residuals, 1.0, begin, end, &state)) {
+      is_accepted_incrementally = false;
+      break;
+    }
+  }
+
+  EXPECT_EQ(is_accepted, is_accepted_incrementally);
+  EXPECT_EQ(num_inliers, state.num_inliers);
+  EXPECT_EQ(num_eval_samples, state.num_eval_samples);
+}
+
+TEST(SPRT, UpdateInlierRatio) {
+  SPRT::Options options;
+  options.delta = 0.01;
+  options.epsilon = 0.1;
+  SPRT sprt(options);
+
+  sprt.UpdateInlierRatio(0.05);
+  EXPECT_EQ(sprt.GetOptions().epsilon, 0.1);
+  sprt.UpdateInlierRatio(0.5);
+  EXPECT_EQ(sprt.GetOptions().epsilon, 0.5);
+  sprt.UpdateInlierRatio(1.0);
+  EXPECT_EQ(sprt.GetOptions().epsilon, 0.5);
+}
+
+TEST(SPRT, AddRejectedModel) {
+  SPRT::Options options;
+  options.delta = 0.01;
+  options.epsilon = 0.5;
+  SPRT sprt(options);
+
+  SPRT::State state;
+  state.num_inliers = 5;
+  state.num_eval_samples = 100;
+  sprt.AddRejectedModel(state);
+  EXPECT_EQ(sprt.GetOptions().delta, 0.05);
+
+  // Small changes of the estimate do not re-design the test.
+  state.num_inliers = 5;
+  state.num_eval_samples = 98;
+  sprt.AddRejectedModel(state);
+  EXPECT_EQ(sprt.GetOptions().delta, 0.05);
+
+  // The probability of bad models must remain below the inlier ratio.
+  state.num_inliers = 1000;
+  state.num_eval_samples = 1000;
+  sprt.AddRejectedModel(state);
+  EXPECT_EQ(sprt.GetOptions().delta, 0.05);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -61,6 +61,13 @@ bool InlierSupportMeasurer::Compare(const Support& support1,
   }
 }
 
+bool InlierSupportMeasurer::IsPossiblyBetter(const size_t max_num_inliers,
+                                             const size_t num_samples,
+                                             const double max_residual,
+                                             const Support& support) const {
+  return max_num_inliers >= support.num_inliers;
+}
+
 UniqueInlierSupportMeasurer::Support UniqueInlierSupportMeasurer::Evaluate(
     const std::vector<double>& residuals, const double max_residual) {
   THROW_CHECK_EQ(residuals.size(), unique_sample_ids_.size());
@@ -97,6 +104,15 @@ bool UniqueInlierSupportMeasurer::Compare(const Support& support1,
   }
 }
 
+bool UniqueInlierSupportMeasurer::IsPossiblyBetter(
+    const size_t max_num_inliers,
+    const size_t num_samples,
+    const double max_residual,
+    const Support& support) const {
+  // The number of unique inliers is bounded by the number of inliers.
+  return max_num_inliers >= support.num_unique_inliers;
+}
+
 MEstimatorSupportMeasurer::Support MEstimatorSupportMeasurer::Evaluate(
     const std::vector<double>& residuals, const double max_residual) {
   Support support;
@@ -120,4 +136,13 @@ bool MEstimatorSupportMeasurer::Compare(const Support& support1,
   return support1.score < support2.score;
 }
 
+bool MEstimatorSupportMeasurer::IsPossiblyBetter(const size_t max_num_inliers,
+                                                 const size_t num_samples,
+                                                 const double max_residual,
+                                                 const Support& support) const {
+  // Every outlier contributes the truncated residual to the score and the
+  // (squared) residuals of the inliers are non-negative.
+  return (num_samples - max_num_inliers) * max_residual < support.score;
+}
+
 }  // namespace colmap
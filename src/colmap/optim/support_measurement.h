@@ -52,6 +52,14 @@ struct InlierSupportMeasurer {
 
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
+
+  // Check whether a model with at most `max_num_inliers` inliers out of
+  // `num_samples` could still have a better support than the given support.
+  // Used to reject models before all their residuals are evaluated.
+  bool IsPossiblyBetter(size_t max_num_inliers,
+                        size_t num_samples,
+                        double max_residual,
+                        const Support& support) const;
 };
 
 // Measure the support of a model by counting the number of unique inliers
@@ -82,6 +90,14 @@ struct UniqueInlierSupportMeasurer {
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
 
+  // Check whether a model with at most `max_num_inliers` inliers out of
+  // `num_samples` could still have a better support than the given support.
+  // Used to reject models before all their residuals are evaluated.
+  bool IsPossiblyBetter(size_t max_num_inliers,
+                        size_t num_samples,
+                        double max_residual,
+                        const Support& support) const;
+
  private:
   std::vector<size_t> unique_sample_ids_;
 };
@@ -102,6 +118,14 @@ struct MEstimatorSupportMeasurer {
 
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
+
+  // Check whether a model with at most `max_num_inliers` inliers out of
+  // `num_samples` could still have a better support than the given support.
+  // Used to reject models before all their residuals are evaluated.
+  bool IsPossiblyBetter(size_t max_num_inliers,
+                        size_t num_samples,
+                        double max_residual,
+                        const Support& support) const;
 };
 
 }  // namespace colmap
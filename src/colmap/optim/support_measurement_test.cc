@@ -138,5 +138,40 @@ TEST(MEstimatorSupportMeasurer, Nominal) {
   EXPECT_TRUE(measurer.Compare(support2, support1));
 }
 
+TEST(InlierSupportMeasurer, IsPossiblyBetter) {
+  InlierSupportMeasurer measurer;
+  InlierSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(0, 10, 1.0, support));
+  support.num_inliers = 5;
+  support.residual_sum = 1.0;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(6, 10, 1.0, support));
+  EXPECT_TRUE(measurer.IsPossiblyBetter(5, 10, 1.0, support));
+  EXPECT_FALSE(measurer.IsPossiblyBetter(4, 10, 1.0, support));
+}
+
+TEST(UniqueInlierSupportMeasurer, IsPossiblyBetter) {
+  UniqueInlierSupportMeasurer measurer;
+  UniqueInlierSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(0, 10, 1.0, support));
+  support.num_inliers = 5;
+  support.num_unique_inliers = 3;
+  support.residual_sum = 1.0;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(4, 10, 1.0, support));
+  EXPECT_TRUE(measurer.IsPossiblyBetter(3, 10, 1.0, support));
+  EXPECT_FALSE(measurer.IsPossiblyBetter(2, 10, 1.0, support));
+}
+
+TEST(MEstimatorSupportMeasurer, IsPossiblyBetter) {
+  MEstimatorSupportMeasurer measurer;
+  MEstimatorSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(0, 10, 1.0, support));
+  support.num_inliers = 5;
+  support.score = 3.0;
+  EXPECT_TRUE(measurer.IsPossiblyBetter(8, 10, 1.0, support));
+  EXPECT_FALSE(measurer.IsPossiblyBetter(7, 10, 1.0, support));
+  EXPECT_FALSE(measurer.IsPossiblyBetter(6, 10, 1.0, support));
+  EXPECT_TRUE(measurer.IsPossiblyBetter(6, 10, 0.5, support));
+}
+
 }  // namespace
 }  // namespace colmap
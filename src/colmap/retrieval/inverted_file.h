@@ -72,6 +72,13 @@ class InvertedFile {
   // The number of added entries.
   size_t NumEntries() const;
 
+  // The number of entries that were sorted by the last call to SortEntries.
+  // Entries added afterwards follow the sorted entries.
+  size_t NumSortedEntries() const;
+
+  // The number of distinct images in the sorted entries.
+  size_t NumImages() const;
+
   // Return all entries in the file.
   const std::vector<EntryType>& GetEntries() const;
 
@@ -96,6 +103,8 @@ class InvertedFile {
 
   // Sorts the inverted file entries in ascending order of image ids. This is
   // required for efficient scoring and must be called before ScoreFeature.
+  // Entries added after a previous call are sorted and merged into the already
+  // sorted entries.
   void SortEntries();
 
   // Clear all entries in this file.
@@ -149,6 +158,12 @@ class InvertedFile {
   // The entries of the inverted file system.
   std::vector<EntryType> entries_;
 
+  // The number of sorted entries at the front of the entries.
+  size_t num_sorted_entries_;
+
+  // The number of distinct images in the sorted entries.
+  size_t num_images_;
+
   // The thresholds used for Hamming embedding.
   DescType thresholds_;
 
@@ -167,7 +182,10 @@ const HammingDistWeightFunctor<kEmbeddingDim>
 
 template <int kEmbeddingDim>
 InvertedFile<kEmbeddingDim>::InvertedFile()
-    : status_(UNUSABLE), idf_weight_(0.0f) {
+    : status_(UNUSABLE),
+      idf_weight_(0.0f),
+      num_sorted_entries_(0),
+      num_images_(0) {
   static_assert(kEmbeddingDim % 8 == 0,
                 "Dimensionality of projected space needs to"
                 " be a multiple of 8.");
@@ -183,6 +201,16 @@ size_t InvertedFile<kEmbeddingDim>::NumEntries() const {
   return entries_.size();
 }
 
+template <int kEmbeddingDim>
+size_t InvertedFile<kEmbeddingDim>::NumSortedEntries() const {
+  return num_sorted_entries_;
+}
+
+template <int kEmbeddingDim>
+size_t InvertedFile<kEmbeddingDim>::NumImages() const {
+  return num_images_;
+}
+
 template <int kEmbeddingDim>
 const std::vector<typename InvertedFile<kEmbeddingDim>::EntryType>&
 InvertedFile<kEmbeddingDim>::GetEntries() const {
@@ -222,17 +250,34 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::SortEntries() {
-  std::sort(entries_.begin(),
-            entries_.end(),
-            [](const EntryType& entry1, const EntryType& entry2) {
-              return entry1.image_id < entry2.image_id;
-            });
+  auto CompareImageIds = [](const EntryType& entry1, const EntryType& entry2) {
+    return entry1.image_id < entry2.image_id;
+  };
+
+  // Only sort the newly added entries and merge them into the sorted entries.
+  if (num_sorted_entries_ < entries_.size()) {
+    const auto sorted_end = entries_.begin() + num_sorted_entries_;
+    std::sort(sorted_end, entries_.end(), CompareImageIds);
+    std::inplace_merge(
+        entries_.begin(), sorted_end, entries_.end(), CompareImageIds);
+  }
+
+  num_sorted_entries_ = entries_.size();
+  num_images_ = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (i == 0 || entries_[i - 1].image_id != entries_[i].image_id) {
+      num_images_ += 1;
+    }
+  }
+
   status_ |= ENTRIES_SORTED;
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ClearEntries() {
   entries_.clear();
+  num_sorted_entries_ = 0;
+  num_images_ = 0;
   status_ &= ~ENTRIES_SORTED;
 }
 
@@ -241,6 +286,8 @@ void InvertedFile<kEmbeddingDim>::Reset() {
   status_ = UNUSABLE;
   idf_weight_ = 0.0f;
   entries_.clear();
+  num_sorted_entries_ = 0;
+  num_images_ = 0;
   thresholds_.setZero();
 }
 
@@ -260,11 +307,15 @@ void InvertedFile<kEmbeddingDim>::ComputeIDFWeight(const int num_total_images) {
     return;
   }
 
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
+  size_t num_images = num_images_;
+  if (!EntriesSorted()) {
+    std::unordered_set<int> image_ids;
+    GetImageIds(&image_ids);
+    num_images = image_ids.size();
+  }
 
   idf_weight_ = std::log(static_cast<double>(num_total_images) /
-                         static_cast<double>(image_ids.size()));
+                         static_cast<double>(num_images));
 }
 
 template <int kEmbeddingDim>
@@ -390,6 +441,12 @@ void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
   for (uint32_t i = 0; i < num_entries; ++i) {
     entries_[i].Read(ifs);
   }
+
+  num_sorted_entries_ = 0;
+  num_images_ = 0;
+  if (EntriesSorted()) {
+    SortEntries();
+  }
 }
 
 template <int kEmbeddingDim>
@@ -70,7 +70,9 @@ class InvertedIndex {
   void Initialize(int num_words);
 
   // Finalizes the inverted index by sorting each inverted file such that all
-  // entries are in ascending order of image ids.
+  // entries are in ascending order of image ids. If only entries of new images
+  // were added since the last call, only the modified inverted files are
+  // sorted and the normalization constants are updated incrementally.
   void Finalize();
 
   // Generate projection matrix for Hamming embedding.
@@ -118,6 +120,25 @@ class InvertedIndex {
   void Write(std::ofstream* ofs) const;
 
  private:
+  // Per-image statistics from which the normalization constants are derived
+  // for any number of indexed images N. With n_w the number of images
+  // containing word w, the self-similarity of an image with entries E is
+  // sum_{w in E} log(N / n_w)^2 = |E| log(N)^2 - 2 log(N) S_1 + S_2, where
+  // S_1 = sum_{w in E} log(n_w) and S_2 = sum_{w in E} log(n_w)^2.
+  struct ImageStatistics {
+    double num_entries = 0.0;
+    double sum_log_num_images = 0.0;
+    double sum_squared_log_num_images = 0.0;
+  };
+
+  // Accumulates the image statistics of a sorted inverted file. For images in
+  // new_image_ids, the entries are added to the statistics. For all other
+  // images, the change from the previous number of images containing the word
+  // is applied. If new_image_ids is null, all images are considered new.
+  void UpdateImageStatistics(const InvertedFile<kEmbeddingDim>& inverted_file,
+                             double prev_log_num_images,
+                             const std::unordered_set<int>* new_image_ids);
+
   void ComputeWeightsAndNormalizationConstants();
 
   // The individual inverted indices.
@@ -131,6 +152,14 @@ class InvertedIndex {
 
   // The projection matrix used to project SIFT descriptors.
   ProjMatrixType proj_matrix_;
+
+  // The statistics of all indexed images and whether they are consistent with
+  // the sorted entries of the inverted files.
+  std::unordered_map<int, ImageStatistics> image_statistics_;
+  bool image_statistics_valid_;
+
+  // The words with entries added since the last call to Finalize.
+  std::vector<int> modified_word_ids_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -142,7 +171,8 @@ const int InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::kInvalidWordId =
     std::numeric_limits<int>::max();
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex() {
+InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex()
+    : image_statistics_valid_(false) {
   proj_matrix_.resize(kEmbeddingDim, kDescDim);
   proj_matrix_.setIdentity();
 }
@@ -160,16 +190,57 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Initialize(
   for (auto& inverted_file : inverted_files_) {
     inverted_file.Reset();
   }
+  image_statistics_.clear();
+  image_statistics_valid_ = false;
+  modified_word_ids_.clear();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize() {
   THROW_CHECK_GT(NumVisualWords(), 0);
 
-  for (auto& inverted_file : inverted_files_) {
-    inverted_file.SortEntries();
+  // The statistics can only be updated incrementally, if the newly added
+  // entries belong to images that were not indexed before.
+  std::unordered_set<int> new_image_ids;
+  if (image_statistics_valid_) {
+    for (const int word_id : modified_word_ids_) {
+      const auto& inverted_file = inverted_files_[word_id];
+      const auto& entries = inverted_file.GetEntries();
+      for (size_t i = inverted_file.NumSortedEntries(); i < entries.size();
+           ++i) {
+        new_image_ids.insert(entries[i].image_id);
+      }
+    }
+    for (const int image_id : new_image_ids) {
+      if (image_statistics_.count(image_id) > 0) {
+        image_statistics_valid_ = false;
+        break;
+      }
+    }
   }
 
+  if (image_statistics_valid_) {
+    for (const int word_id : modified_word_ids_) {
+      auto& inverted_file = inverted_files_[word_id];
+      const double prev_log_num_images =
+          inverted_file.NumImages() > 0
+              ? std::log(static_cast<double>(inverted_file.NumImages()))
+              : 0.0;
+      inverted_file.SortEntries();
+      UpdateImageStatistics(
+          inverted_file, prev_log_num_images, &new_image_ids);
+    }
+  } else {
+    image_statistics_.clear();
+    for (auto& inverted_file : inverted_files_) {
+      inverted_file.SortEntries();
+      UpdateImageStatistics(inverted_file, 0.0, nullptr);
+    }
+    image_statistics_valid_ = true;
+  }
+
+  modified_word_ids_.clear();
+
   ComputeWeightsAndNormalizationConstants();
 }
 
@@ -229,8 +300,11 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntry(
   THROW_CHECK_EQ(descriptor.size(), kDescDim);
   const ProjDescType proj_desc =
       proj_matrix_ * descriptor.transpose().template cast<float>();
-  inverted_files_.at(word_id).AddEntry(
-      image_id, feature_idx, proj_desc, geometry);
+  auto& inverted_file = inverted_files_.at(word_id);
+  if (inverted_file.NumSortedEntries() == inverted_file.NumEntries()) {
+    modified_word_ids_.push_back(word_id);
+  }
+  inverted_file.AddEntry(image_id, feature_idx, proj_desc, geometry);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -238,6 +312,9 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ClearEntries() {
   for (auto& inverted_file : inverted_files_) {
     inverted_file.ClearEntries();
   }
+  image_statistics_.clear();
+  image_statistics_valid_ = false;
+  modified_word_ids_.clear();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -387,6 +464,10 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
     ifs->read(reinterpret_cast<char*>(&value), sizeof(float));
     normalization_constants_[image_id] = value;
   }
+
+  image_statistics_.clear();
+  image_statistics_valid_ = false;
+  modified_word_ids_.clear();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -421,29 +502,78 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::UpdateImageStatistics(
+    const InvertedFile<kEmbeddingDim>& inverted_file,
+    const double prev_log_num_images,
+    const std::unordered_set<int>* new_image_ids) {
+  if (inverted_file.NumImages() == 0) {
+    return;
+  }
+
+  const double log_num_images =
+      std::log(static_cast<double>(inverted_file.NumImages()));
+  const double squared_log_num_images = log_num_images * log_num_images;
+  const double delta_log_num_images = log_num_images - prev_log_num_images;
+  const double delta_squared_log_num_images =
+      squared_log_num_images - prev_log_num_images * prev_log_num_images;
+
+  const auto& entries = inverted_file.GetEntries();
+  size_t begin = 0;
+  while (begin < entries.size()) {
+    const int image_id = entries[begin].image_id;
+    size_t end = begin + 1;
+    while (end < entries.size() && entries[end].image_id == image_id) {
+      ++end;
+    }
+
+    const double num_entries = static_cast<double>(end - begin);
+    ImageStatistics& statistics = image_statistics_[image_id];
+    if (new_image_ids == nullptr || new_image_ids->count(image_id) > 0) {
+      statistics.num_entries += num_entries;
+      statistics.sum_log_num_images += num_entries * log_num_images;
+      statistics.sum_squared_log_num_images +=
+          num_entries * squared_log_num_images;
+    } else {
+      statistics.sum_log_num_images += num_entries * delta_log_num_images;
+      statistics.sum_squared_log_num_images +=
+          num_entries * delta_squared_log_num_images;
+    }
+
+    begin = end;
+  }
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
     ComputeWeightsAndNormalizationConstants() {
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
+  const size_t num_images = image_statistics_.size();
 
   for (auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeIDFWeight(image_ids.size());
+    inverted_file.ComputeIDFWeight(num_images);
   }
 
-  std::unordered_map<int, double> self_similarities(image_ids.size());
-  for (const auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeImageSelfSimilarities(&self_similarities);
-  }
+  const double log_num_images = std::log(static_cast<double>(num_images));
+  const double squared_log_num_images = log_num_images * log_num_images;
 
   normalization_constants_.clear();
-  normalization_constants_.reserve(image_ids.size());
-  for (const auto& self_similarity : self_similarities) {
-    if (self_similarity.second > 0.0) {
-      normalization_constants_[self_similarity.first] =
-          static_cast<float>(1.0 / std::sqrt(self_similarity.second));
+  normalization_constants_.reserve(num_images);
+  for (const auto& image_statistics : image_statistics_) {
+    const ImageStatistics& statistics = image_statistics.second;
+    const double self_similarity =
+        statistics.num_entries * squared_log_num_images -
+        2.0 * log_num_images * statistics.sum_log_num_images +
+        statistics.sum_squared_log_num_images;
+    // Values at the level of the cancellation error are treated as zero,
+    // e.g., if all words of the image occur in all images.
+    const double kEpsilon =
+        1e-12 * (statistics.num_entries * squared_log_num_images +
+                 statistics.sum_squared_log_num_images);
+    if (self_similarity > kEpsilon) {
+      normalization_constants_[image_statistics.first] =
+          static_cast<float>(1.0 / std::sqrt(self_similarity));
     } else {
-      normalization_constants_[self_similarity.first] = 0.0f;
+      normalization_constants_[image_statistics.first] = 0.0f;
     }
   }
 }
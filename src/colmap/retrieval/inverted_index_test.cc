@@ -0,0 +1,193 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/inverted_index.h"
+
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef InvertedIndex<float, 8, 8> InvertedIndexType;
+
+const int kNumWords = 10;
+
+struct TestEntry {
+  int image_id;
+  int word_id;
+  InvertedIndexType::DescType descriptor;
+};
+
+std::vector<TestEntry> CreateTestEntries(const int num_images) {
+  std::vector<TestEntry> entries;
+  for (int image_id = 0; image_id < num_images; ++image_id) {
+    // Every image sees only a subset of the words to obtain non-zero weights.
+    const int num_entries = 10 + 3 * image_id;
+    for (int i = 0; i < num_entries; ++i) {
+      TestEntry entry;
+      entry.image_id = image_id;
+      entry.word_id = (image_id + i * i) % kNumWords;
+      entry.descriptor = InvertedIndexType::DescType::Random(1, 8);
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+void InitializeIndex(InvertedIndexType* index) {
+  index->Initialize(kNumWords);
+  const InvertedIndexType::DescType descriptors =
+      InvertedIndexType::DescType::Random(10 * kNumWords, 8);
+  Eigen::VectorXi word_ids(descriptors.rows());
+  for (int i = 0; i < word_ids.rows(); ++i) {
+    word_ids(i) = i % kNumWords;
+  }
+  index->ComputeHammingEmbedding(descriptors, word_ids);
+}
+
+void AddEntries(const std::vector<TestEntry>& entries,
+                const int begin_image_id,
+                const int end_image_id,
+                InvertedIndexType* index) {
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const TestEntry& entry = entries[i];
+    if (entry.image_id >= begin_image_id && entry.image_id < end_image_id) {
+      index->AddEntry(entry.image_id,
+                      entry.word_id,
+                      i,
+                      entry.descriptor,
+                      InvertedIndexType::GeomType());
+    }
+  }
+}
+
+void ExpectEqualQueries(const std::vector<TestEntry>& entries,
+                        const InvertedIndexType& index1,
+                        const InvertedIndexType& index2) {
+  for (int word_id = 0; word_id < kNumWords; ++word_id) {
+    EXPECT_NEAR(
+        index1.GetIDFWeight(word_id), index2.GetIDFWeight(word_id), 1e-6);
+  }
+
+  InvertedIndexType::DescType descriptors(entries.size(), 8);
+  Eigen::MatrixXi word_ids(entries.size(), 1);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    descriptors.row(i) = entries[i].descriptor;
+    word_ids(i) = entries[i].word_id;
+  }
+
+  std::vector<ImageScore> image_scores1;
+  index1.Query(descriptors, word_ids, &image_scores1);
+  std::vector<ImageScore> image_scores2;
+  index2.Query(descriptors, word_ids, &image_scores2);
+  ASSERT_EQ(image_scores1.size(), image_scores2.size());
+  EXPECT_FALSE(image_scores1.empty());
+  for (size_t i = 0; i < image_scores1.size(); ++i) {
+    EXPECT_EQ(image_scores1[i].image_id, image_scores2[i].image_id);
+    EXPECT_NEAR(image_scores1[i].score, image_scores2[i].score, 1e-5);
+  }
+}
+
+TEST(InvertedIndex, IncrementalFinalize) {
+  const std::vector<TestEntry> entries = CreateTestEntries(12);
+
+  InvertedIndexType full_index;
+  InitializeIndex(&full_index);
+  InvertedIndexType incremental_index = full_index;
+
+  AddEntries(entries, 0, 12, &full_index);
+  full_index.Finalize();
+
+  AddEntries(entries, 0, 5, &incremental_index);
+  incremental_index.Finalize();
+  AddEntries(entries, 5, 6, &incremental_index);
+  incremental_index.Finalize();
+  AddEntries(entries, 6, 12, &incremental_index);
+  incremental_index.Finalize();
+
+  ExpectEqualQueries(entries, full_index, incremental_index);
+}
+
+TEST(InvertedIndex, FinalizeReaddedImage) {
+  const std::vector<TestEntry> entries = CreateTestEntries(6);
+
+  InvertedIndexType full_index;
+  InitializeIndex(&full_index);
+  InvertedIndexType incremental_index = full_index;
+
+  AddEntries(entries, 0, 6, &full_index);
+  AddEntries(entries, 2, 3, &full_index);
+  full_index.Finalize();
+
+  AddEntries(entries, 0, 6, &incremental_index);
+  incremental_index.Finalize();
+  // Entries of an already indexed image require a full update.
+  AddEntries(entries, 2, 3, &incremental_index);
+  incremental_index.Finalize();
+
+  ExpectEqualQueries(entries, full_index, incremental_index);
+}
+
+TEST(InvertedIndex, FinalizeAfterReadWrite) {
+  const std::vector<TestEntry> entries = CreateTestEntries(8);
+
+  InvertedIndexType full_index;
+  InitializeIndex(&full_index);
+  InvertedIndexType incremental_index = full_index;
+
+  AddEntries(entries, 0, 8, &full_index);
+  full_index.Finalize();
+
+  AddEntries(entries, 0, 4, &incremental_index);
+  incremental_index.Finalize();
+
+  const std::string test_dir = CreateTestDir();
+  const std::string index_path = test_dir + "/index.bin";
+  {
+    std::ofstream file(index_path, std::ios::binary);
+    incremental_index.Write(&file);
+  }
+
+  InvertedIndexType read_index;
+  {
+    std::ifstream file(index_path, std::ios::binary);
+    read_index.Read(&file);
+  }
+  AddEntries(entries, 4, 8, &read_index);
+  read_index.Finalize();
+
+  ExpectEqualQueries(entries, full_index, read_index);
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
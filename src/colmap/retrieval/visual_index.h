@@ -37,8 +37,14 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
 
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sstream>
+
 #include <Eigen/Core>
 #include <boost/heap/fibonacci_heap.hpp>
 #include <flann/flann.hpp>
@@ -117,7 +123,6 @@ class VisualIndex {
   };
 
   VisualIndex();
-  ~VisualIndex();
 
   size_t NumVisualWords() const;
 
@@ -141,7 +146,8 @@ class VisualIndex {
              const DescType& descriptors,
              std::vector<ImageScore>* image_scores) const;
 
-  // Prepare the index after adding images and before querying.
+  // Prepare the index after adding images and before querying. Images can be
+  // added to a prepared index, after which only the changes are prepared.
   void Prepare();
 
   // Build a visual index from a set of training descriptors by quantizing the
@@ -149,8 +155,12 @@ class VisualIndex {
   void Build(const BuildOptions& options, const DescType& descriptors);
 
   // Read and write the visual index. This can be done for an index with and
-  // without indexed images.
-  void Read(const std::string& path);
+  // without indexed images. If memory_map is true, the visual words are
+  // mapped from the file instead of copied into memory, such that processes
+  // reading the same index share them. The index is written to a temporary
+  // file that then replaces the given path, so that mapped indices remain
+  // valid when overwritten.
+  void Read(const std::string& path, bool memory_map = false);
   void Write(const std::string& path);
 
  private:
@@ -173,8 +183,11 @@ class VisualIndex {
   // The search structure on the quantized descriptor space.
   flann::AutotunedIndex<flann::L2<kDescType>> visual_word_index_;
 
-  // The centroids of the visual words.
+  // The centroids of the visual words. They are either owned by the index or
+  // mapped from the file it was read from.
   flann::Matrix<kDescType> visual_words_;
+  std::vector<kDescType> visual_words_data_;
+  std::unique_ptr<MappedFile> visual_words_file_;
 
   // The inverted index of the database.
   InvertedIndexType inverted_index_;
@@ -194,13 +207,6 @@ template <typename kDescType, int kDescDim, int kEmbeddingDim>
 VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualIndex()
     : prepared_(false) {}
 
-template <typename kDescType, int kDescDim, int kEmbeddingDim>
-VisualIndex<kDescType, kDescDim, kEmbeddingDim>::~VisualIndex() {
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
-}
-
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 size_t VisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumVisualWords() const {
   return visual_words_.rows;
@@ -556,25 +562,43 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
-    const std::string& path) {
+    const std::string& path, const bool memory_map) {
   long int file_offset = 0;
 
   // Read the visual words.
 
   {
-    if (visual_words_.ptr() != nullptr) {
-      delete[] visual_words_.ptr();
-    }
+    visual_words_ = flann::Matrix<kDescType>();
+    visual_words_data_ = std::vector<kDescType>();
+    visual_words_file_.reset();
 
     std::ifstream file(path, std::ios::binary);
     THROW_CHECK_FILE_OPEN(file, path);
     const uint64_t rows = ReadBinaryLittleEndian<uint64_t>(&file);
     const uint64_t cols = ReadBinaryLittleEndian<uint64_t>(&file);
-    kDescType* visual_words_data = new kDescType[rows * cols];
-    for (size_t i = 0; i < rows * cols; ++i) {
-      visual_words_data[i] = ReadBinaryLittleEndian<kDescType>(&file);
+    const size_t num_values = rows * cols;
+    // The visual words are stored in little endian byte order and can only
+    // be mapped directly on little endian machines.
+    if (memory_map && IsLittleEndian()) {
+      const size_t header_num_bytes = 2 * sizeof(uint64_t);
+      const size_t num_bytes =
+          header_num_bytes + num_values * sizeof(kDescType);
+      THROW_CHECK_GE(GetFileSize(path), num_bytes);
+      visual_words_file_ = std::make_unique<MappedFile>(path, num_bytes);
+      // FLANN only reads the visual words but requires a mutable pointer.
+      kDescType* visual_words_data = const_cast<kDescType*>(
+          reinterpret_cast<const kDescType*>(visual_words_file_->Data() +
+                                             header_num_bytes));
+      visual_words_ = flann::Matrix<kDescType>(visual_words_data, rows, cols);
+      file.seekg(num_bytes, std::ios::beg);
+    } else {
+      visual_words_data_.resize(num_values);
+      for (size_t i = 0; i < num_values; ++i) {
+        visual_words_data_[i] = ReadBinaryLittleEndian<kDescType>(&file);
+      }
+      visual_words_ =
+          flann::Matrix<kDescType>(visual_words_data_.data(), rows, cols);
     }
-    visual_words_ = flann::Matrix<kDescType>(visual_words_data, rows, cols);
     file_offset = file.tellg();
   }
 
@@ -613,12 +637,20 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
     const std::string& path) {
+  // Write to a temporary file first, which is then renamed to the given path.
+  // The random suffix keeps the temporary files of concurrent writers apart.
+  std::random_device random_device;
+  std::ostringstream tmp_path_stream;
+  tmp_path_stream << path << ".tmp" << std::hex << random_device()
+                  << random_device();
+  const std::string tmp_path = tmp_path_stream.str();
+
   // Write the visual words.
 
   {
     THROW_CHECK_NOTNULL(visual_words_.ptr());
-    std::ofstream file(path, std::ios::binary);
-    THROW_CHECK_FILE_OPEN(file, path);
+    std::ofstream file(tmp_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
     WriteBinaryLittleEndian<uint64_t>(&file, visual_words_.rows);
     WriteBinaryLittleEndian<uint64_t>(&file, visual_words_.cols);
     for (size_t i = 0; i < visual_words_.rows * visual_words_.cols; ++i) {
@@ -631,9 +663,9 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   {
     FILE* fout = nullptr;
 #ifdef _MSC_VER
-    THROW_CHECK_EQ(fopen_s(&fout, path.c_str(), "ab"), 0);
+    THROW_CHECK_EQ(fopen_s(&fout, tmp_path.c_str(), "ab"), 0);
 #else
-    fout = fopen(path.c_str(), "ab");
+    fout = fopen(tmp_path.c_str(), "ab");
 #endif
     THROW_CHECK_NOTNULL(fout);
     visual_word_index_.saveIndex(fout);
@@ -643,10 +675,17 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   // Write the inverted index.
 
   {
-    std::ofstream file(path, std::ios::binary | std::ios::app);
-    THROW_CHECK_FILE_OPEN(file, path);
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::app);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
     inverted_index_.Write(&file);
   }
+
+#ifdef _WIN32
+  // Windows does not replace existing files on rename.
+  std::remove(path.c_str());
+#endif
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0)
+      << "Failed to replace " << path;
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -678,7 +717,7 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
   THROW_CHECK_LE(num_centers, options.num_visual_words);
 
   const size_t visual_word_data_size = num_centers * descriptors.cols();
-  kDescType* visual_words_data = new kDescType[visual_word_data_size];
+  std::vector<kDescType> visual_words_data(visual_word_data_size);
   for (size_t i = 0; i < visual_word_data_size; ++i) {
     if (std::is_integral<kDescType>::value) {
       visual_words_data[i] = std::round(centers_data[i]);
@@ -687,12 +726,10 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     }
   }
 
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
-
+  visual_words_data_ = std::move(visual_words_data);
+  visual_words_file_.reset();
   visual_words_ = flann::Matrix<kDescType>(
-      visual_words_data, num_centers, descriptors.cols());
+      visual_words_data_.data(), num_centers, descriptors.cols());
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
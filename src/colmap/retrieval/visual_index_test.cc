@@ -29,6 +29,8 @@
 
 #include "colmap/retrieval/visual_index.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -99,6 +101,30 @@ void TestVocabTreeType() {
     EXPECT_EQ(image_scores[0].image_id, 1);
     EXPECT_EQ(image_scores[1].image_id, 2);
     EXPECT_GT(image_scores[0].score, image_scores[1].score);
+  
+    // The memory-mapped index must answer queries like the fully read one.
+    const std::string index_path = CreateTestDir() + "/index.bin";
+    visual_index.Write(index_path);
+    VisualIndexType read_index;
+    read_index.Read(index_path, /*memory_map=*/false);
+    VisualIndexType mapped_index;
+    mapped_index.Read(index_path, /*memory_map=*/true);
+    EXPECT_EQ(read_index.NumVisualWords(), 100);
+    EXPECT_EQ(mapped_index.NumVisualWords(), 100);
+    for (const auto& query_descriptors : {descriptors1, descriptors2}) {
+      std::vector<ImageScore> read_image_scores;
+      read_index.Query(query_options, query_descriptors, &read_image_scores);
+      std::vector<ImageScore> mapped_image_scores;
+      mapped_index.Query(
+          query_options, query_descriptors, &mapped_image_scores);
+      ASSERT_EQ(read_image_scores.size(), 2);
+      ASSERT_EQ(mapped_image_scores.size(), read_image_scores.size());
+      for (size_t i = 0; i < read_image_scores.size(); ++i) {
+        EXPECT_EQ(mapped_image_scores[i].image_id,
+                  read_image_scores[i].image_id);
+        EXPECT_EQ(mapped_image_scores[i].score, read_image_scores[i].score);
+      }
+    }
   }
 }
 
@@ -30,12 +30,108 @@
 #include "colmap/scene/correspondence_graph.h"
 
 #include "colmap/geometry/pose.h"
+#include "colmap/util/endian.h"
 #include "colmap/util/string.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/trace.h"
 
+#include <cstring>
 #include <map>
 #include <set>
+#include <unordered_set>
 
 namespace colmap {
+namespace {
+
+// Evaluates func(i) for all i in [0, num_items) in contiguous chunks.
+template <typename Func>
+void ParallelForChunks(const size_t num_items,
+                       const int num_threads,
+                       const Func& func) {
+  const int num_eff_threads = std::min(GetEffectiveNumThreads(num_threads),
+                                       static_cast<int>(num_items));
+  if (num_eff_threads <= 1) {
+    for (size_t i = 0; i < num_items; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  // Use a few chunks per thread, so that imbalanced chunks can be stolen.
+  ThreadPool thread_pool(num_eff_threads);
+  const size_t num_chunks = 4 * static_cast<size_t>(num_eff_threads);
+  const size_t grain_size = (num_items + num_chunks - 1) / num_chunks;
+  thread_pool.ParallelFor(
+      0, num_items, grain_size, [&func](size_t begin, const size_t end) {
+        for (; begin < end; ++begin) {
+          func(begin);
+        }
+      });
+}
+
+// The flattened correspondences are stored as arrays of 32-bit words at 8-byte
+// aligned stream positions, such that they can be referenced in place in a
+// memory-mapped file.
+const size_t kArrayAlignment = 8;
+
+template <typename T>
+void WriteAlignedArray(std::ostream* stream,
+                       const T* values,
+                       const size_t num_values) {
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0,
+                "Values must consist of 32-bit words");
+  const size_t pos = static_cast<size_t>(stream->tellp());
+  const char kPadding[kArrayAlignment] = {0};
+  stream->write(kPadding,
+                (kArrayAlignment - pos % kArrayAlignment) % kArrayAlignment);
+  if (IsLittleEndian()) {
+    stream->write(reinterpret_cast<const char*>(values),
+                  num_values * sizeof(T));
+  } else {
+    const char* words = reinterpret_cast<const char*>(values);
+    for (size_t i = 0; i < num_values * sizeof(T); i += sizeof(uint32_t)) {
+      uint32_t word;
+      std::memcpy(&word, words + i, sizeof(uint32_t));
+      WriteBinaryLittleEndian<uint32_t>(stream, word);
+    }
+  }
+}
+
+template <typename T>
+std::shared_ptr<const T> ReadAlignedArray(
+    std::istream* stream,
+    const size_t num_values,
+    const std::shared_ptr<const MappedFile>& mapped_file) {
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0,
+                "Values must consist of 32-bit words");
+  const size_t pos = static_cast<size_t>(stream->tellg());
+  const size_t begin = (pos + kArrayAlignment - 1) / kArrayAlignment *
+                       kArrayAlignment;
+  const size_t num_bytes = num_values * sizeof(T);
+  stream->seekg(begin, std::ios::beg);
+
+  if (mapped_file != nullptr && IsLittleEndian()) {
+    THROW_CHECK_LE(begin + num_bytes, mapped_file->NumBytes());
+    stream->seekg(begin + num_bytes, std::ios::beg);
+    return std::shared_ptr<const T>(
+        mapped_file, reinterpret_cast<const T*>(mapped_file->Data() + begin));
+  }
+
+  auto values = std::make_shared<std::vector<T>>(num_values);
+  char* words = reinterpret_cast<char*>(values->data());
+  stream->read(words, num_bytes);
+  if (!IsLittleEndian()) {
+    for (size_t i = 0; i < num_bytes; i += sizeof(uint32_t)) {
+      uint32_t word;
+      std::memcpy(&word, words + i, sizeof(uint32_t));
+      word = LittleEndianToNative(word);
+      std::memcpy(words + i, &word, sizeof(uint32_t));
+    }
+  }
+  return std::shared_ptr<const T>(values, values->data());
+}
+
+}  // namespace
 
 std::unordered_map<image_pair_t, point2D_t>
 CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
@@ -48,49 +144,73 @@ CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
   return num_corrs_between_images;
 }
 
-void CorrespondenceGraph::Finalize() {
+void CorrespondenceGraph::Finalize(const int num_threads) {
+  COLMAP_TRACE_SCOPE("correspondence_graph/finalize");
   THROW_CHECK(!finalized_);
   finalized_ = true;
 
-  // Flatten all correspondences, remove images without observations.
+  // Flatten all correspondences in parallel.
+  std::vector<Image*> images;
+  images.reserve(images_.size());
+  for (auto& image : images_) {
+    images.push_back(&image.second);
+  }
+
+  ParallelForChunks(images.size(), num_threads, [&images](const size_t i) {
+    FinalizeImage(images[i]);
+  });
+
+  // Erase images without observations.
   for (auto it = images_.begin(); it != images_.end();) {
-    // Count number of correspondences and observations.
-    it->second.num_observations = 0;
-    size_t num_total_corrs = 0;
-    for (auto& corr : it->second.corrs) {
-      num_total_corrs += corr.size();
-      if (!corr.empty()) {
-        it->second.num_observations += 1;
-      }
+    if (it->second.flat_corrs == nullptr) {
+      it = images_.erase(it);
+    } else {
+      ++it;
     }
+  }
+}
 
-    // Erase image without observations.
-    if (num_total_corrs == 0) {
-      images_.erase(it++);
-      continue;
+void CorrespondenceGraph::FinalizeImage(Image* image) {
+  // Count number of correspondences and observations.
+  image->num_observations = 0;
+  size_t num_total_corrs = 0;
+  for (const auto& corrs : image->corrs) {
+    num_total_corrs += corrs.size();
+    if (!corrs.empty()) {
+      image->num_observations += 1;
     }
+  }
 
-    // Reshuffle correspondences into flattened vector.
-    const point2D_t num_points2D = it->second.corrs.size();
-    it->second.flat_corrs.reserve(num_total_corrs);
-    it->second.flat_corr_begs.resize(num_points2D + 1);
-    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
-      it->second.flat_corr_begs[point2D_idx] = it->second.flat_corrs.size();
-      std::vector<Correspondence>& corrs = it->second.corrs[point2D_idx];
-      it->second.flat_corrs.insert(
-          it->second.flat_corrs.end(), corrs.begin(), corrs.end());
-    }
-    it->second.flat_corr_begs[num_points2D] = it->second.flat_corrs.size();
+  // Images without observations are erased by the caller.
+  if (num_total_corrs == 0) {
+    return;
+  }
 
-    // Ensure we reserved enough space before insertion.
-    THROW_CHECK_EQ(it->second.flat_corrs.size(), num_total_corrs);
+  // Reshuffle correspondences into flattened vector.
+  const point2D_t num_points2D = image->corrs.size();
+  auto flat_corrs = std::make_shared<std::vector<Correspondence>>();
+  flat_corrs->reserve(num_total_corrs);
+  auto flat_corr_begs =
+      std::make_shared<std::vector<point2D_t>>(num_points2D + 1);
+  for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
+    (*flat_corr_begs)[point2D_idx] = flat_corrs->size();
+    const std::vector<Correspondence>& corrs = image->corrs[point2D_idx];
+    flat_corrs->insert(flat_corrs->end(), corrs.begin(), corrs.end());
+  }
+  (*flat_corr_begs)[num_points2D] = flat_corrs->size();
 
-    // Deallocate original data.
-    it->second.corrs.clear();
-    it->second.corrs.shrink_to_fit();
+  // Ensure we reserved enough space before insertion.
+  THROW_CHECK_EQ(flat_corrs->size(), num_total_corrs);
 
-    ++it;
-  }
+  image->num_points2D = num_points2D;
+  image->flat_corrs =
+      std::shared_ptr<const Correspondence>(flat_corrs, flat_corrs->data());
+  image->flat_corr_begs =
+      std::shared_ptr<const point2D_t>(flat_corr_begs, flat_corr_begs->data());
+
+  // Deallocate original data.
+  image->corrs.clear();
+  image->corrs.shrink_to_fit();
 }
 
 void CorrespondenceGraph::AddImage(const image_t image_id,
@@ -185,16 +305,176 @@ void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
   }
 }
 
+void CorrespondenceGraph::AddCorrespondences(
+    const std::vector<std::pair<image_pair_t, FeatureMatches>>& image_pairs,
+    const int num_threads) {
+  COLMAP_TRACE_SCOPE("correspondence_graph/add_correspondences");
+
+  struct PairImages {
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    struct Image* image1 = nullptr;
+    struct Image* image2 = nullptr;
+  };
+
+  // Look up the images and pairs serially, since this may modify the maps.
+  std::vector<PairImages> pair_images(image_pairs.size());
+  std::unordered_set<image_pair_t> pair_ids;
+  pair_ids.reserve(image_pairs.size());
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    const image_pair_t pair_id = image_pairs[i].first;
+    THROW_CHECK(pair_ids.insert(pair_id).second)
+        << "Duplicate image pair " << pair_id;
+    PairImages& images = pair_images[i];
+    std::tie(images.image_id1, images.image_id2) =
+        Database::PairIdToImagePair(pair_id);
+    // Avoid self-matches - should only happen, if user provides custom
+    // matches.
+    if (images.image_id1 == images.image_id2) {
+      LOG(WARNING) << "Cannot use self-matches for image_id="
+                   << images.image_id1;
+      continue;
+    }
+    images.image1 = &images_.at(images.image_id1);
+    images.image2 = &images_.at(images.image_id2);
+    image_pairs_[pair_id];
+  }
+
+  // Remove invalid and duplicate correspondences in parallel. This only reads
+  // the correspondences from previous calls and yields the same matches as
+  // adding the correspondences sequentially, since the pairs are unique.
+  std::vector<FeatureMatches> valid_matches(image_pairs.size());
+  ParallelForChunks(
+      image_pairs.size(),
+      num_threads,
+      [&image_pairs, &pair_images, &valid_matches](const size_t i) {
+        const PairImages& images = pair_images[i];
+        if (images.image1 == nullptr) {
+          return;
+        }
+
+        const FeatureMatches& matches = image_pairs[i].second;
+        std::unordered_set<point2D_t> added_point2D_idxs1;
+        std::unordered_set<point2D_t> added_point2D_idxs2;
+        valid_matches[i].reserve(matches.size());
+        for (const auto& match : matches) {
+          const bool valid_idx1 =
+              match.point2D_idx1 < images.image1->corrs.size();
+          const bool valid_idx2 =
+              match.point2D_idx2 < images.image2->corrs.size();
+
+          if (valid_idx1 && valid_idx2) {
+            const auto& corrs1 = images.image1->corrs[match.point2D_idx1];
+            const auto& corrs2 = images.image2->corrs[match.point2D_idx2];
+            const image_t image_id1 = images.image_id1;
+            const image_t image_id2 = images.image_id2;
+
+            const bool duplicate1 =
+                added_point2D_idxs1.count(match.point2D_idx1) > 0 ||
+                std::find_if(corrs1.begin(),
+                             corrs1.end(),
+                             [image_id2](const Correspondence& corr) {
+                               return corr.image_id == image_id2;
+                             }) != corrs1.end();
+            const bool duplicate2 =
+                added_point2D_idxs2.count(match.point2D_idx2) > 0 ||
+                std::find_if(corrs2.begin(),
+                             corrs2.end(),
+                             [image_id1](const Correspondence& corr) {
+                               return corr.image_id == image_id1;
+                             }) != corrs2.end();
+
+            if (duplicate1 || duplicate2) {
+              LOG(WARNING) << StringPrintf(
+                  "Duplicate correspondence between "
+                  "point2D_idx=%d in image_id=%d and point2D_idx=%d in "
+                  "image_id=%d",
+                  match.point2D_idx1,
+                  image_id1,
+                  match.point2D_idx2,
+                  image_id2);
+            } else {
+              added_point2D_idxs1.insert(match.point2D_idx1);
+              added_point2D_idxs2.insert(match.point2D_idx2);
+              valid_matches[i].push_back(match);
+            }
+          } else {
+            if (!valid_idx1) {
+              LOG(WARNING) << StringPrintf(
+                  "point2D_idx=%d in image_id=%d does not exist",
+                  match.point2D_idx1,
+                  images.image_id1);
+            }
+            if (!valid_idx2) {
+              LOG(WARNING) << StringPrintf(
+                  "point2D_idx=%d in image_id=%d does not exist",
+                  match.point2D_idx2,
+                  images.image_id2);
+            }
+          }
+        }
+      });
+
+  // Store the number of correspondences and group the pairs by image, such
+  // that the correspondences of each image are appended by a single thread in
+  // the order of the given pairs.
+  std::vector<struct Image*> images;
+  std::vector<std::vector<size_t>> image_pair_idxs;
+  std::unordered_map<struct Image*, size_t> image_idxs;
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    const PairImages& pair = pair_images[i];
+    if (pair.image1 == nullptr) {
+      continue;
+    }
+
+    const point2D_t num_corrs = valid_matches[i].size();
+    pair.image1->num_correspondences += num_corrs;
+    pair.image2->num_correspondences += num_corrs;
+    image_pairs_[image_pairs[i].first].num_correspondences += num_corrs;
+
+    for (struct Image* image : {pair.image1, pair.image2}) {
+      const auto it = image_idxs.emplace(image, images.size());
+      if (it.second) {
+        images.push_back(image);
+        image_pair_idxs.emplace_back();
+      }
+      image_pair_idxs[it.first->second].push_back(i);
+    }
+  }
+
+  ParallelForChunks(
+      images.size(),
+      num_threads,
+      [&images, &image_pair_idxs, &pair_images, &valid_matches](
+          const size_t i) {
+        struct Image* image = images[i];
+        for (const size_t pair_idx : image_pair_idxs[i]) {
+          const PairImages& pair = pair_images[pair_idx];
+          if (pair.image1 == image) {
+            for (const auto& match : valid_matches[pair_idx]) {
+              image->corrs[match.point2D_idx1].emplace_back(
+                  pair.image_id2, match.point2D_idx2);
+            }
+          } else {
+            for (const auto& match : valid_matches[pair_idx]) {
+              image->corrs[match.point2D_idx2].emplace_back(
+                  pair.image_id1, match.point2D_idx1);
+            }
+          }
+        }
+      });
+}
+
 CorrespondenceGraph::CorrespondenceRange
 CorrespondenceGraph::FindCorrespondences(const image_t image_id,
                                          const point2D_t point2D_idx) const {
   THROW_CHECK(finalized_);
-  const point2D_t next_point2D_idx = point2D_idx + 1;
   const Image& image = images_.at(image_id);
+  THROW_CHECK_LT(point2D_idx, image.num_points2D);
   const Correspondence* beg =
-      image.flat_corrs.data() + image.flat_corr_begs.at(point2D_idx);
+      image.flat_corrs.get() + image.flat_corr_begs.get()[point2D_idx];
   const Correspondence* end =
-      image.flat_corrs.data() + image.flat_corr_begs.at(next_point2D_idx);
+      image.flat_corrs.get() + image.flat_corr_begs.get()[point2D_idx + 1];
   return CorrespondenceRange{beg, end};
 }
 
@@ -281,8 +561,7 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
   FeatureMatches corrs;
   corrs.reserve(num_correspondences);
 
-  const point2D_t num_points2D1 =
-      images_.at(image_id1).flat_corr_begs.size() - 1;
+  const point2D_t num_points2D1 = images_.at(image_id1).num_points2D;
   for (point2D_t point2D_idx1 = 0; point2D_idx1 < num_points2D1;
        ++point2D_idx1) {
     const CorrespondenceRange range =
@@ -308,4 +587,66 @@ bool CorrespondenceGraph::IsTwoViewObservation(
   return (other_range.end - other_range.beg) == 1;
 }
 
+void CorrespondenceGraph::Read(std::istream* stream,
+                               std::shared_ptr<const MappedFile> mapped_file) {
+  THROW_CHECK(stream->good());
+
+  images_.clear();
+  image_pairs_.clear();
+
+  const uint64_t num_images = ReadBinaryLittleEndian<uint64_t>(stream);
+  images_.reserve(num_images);
+  for (uint64_t i = 0; i < num_images; ++i) {
+    const image_t image_id = ReadBinaryLittleEndian<image_t>(stream);
+    Image& image = images_[image_id];
+    image.num_observations = ReadBinaryLittleEndian<point2D_t>(stream);
+    image.num_correspondences = ReadBinaryLittleEndian<point2D_t>(stream);
+    image.num_points2D = ReadBinaryLittleEndian<point2D_t>(stream);
+    image.flat_corr_begs = ReadAlignedArray<point2D_t>(
+        stream, image.num_points2D + 1, mapped_file);
+    image.flat_corrs = ReadAlignedArray<Correspondence>(
+        stream, image.flat_corr_begs.get()[image.num_points2D], mapped_file);
+  }
+
+  const uint64_t num_image_pairs = ReadBinaryLittleEndian<uint64_t>(stream);
+  image_pairs_.reserve(num_image_pairs);
+  for (uint64_t i = 0; i < num_image_pairs; ++i) {
+    const image_pair_t pair_id = ReadBinaryLittleEndian<image_pair_t>(stream);
+    image_pairs_[pair_id].num_correspondences =
+        ReadBinaryLittleEndian<point2D_t>(stream);
+  }
+
+  THROW_CHECK(stream->good());
+
+  finalized_ = true;
+}
+
+void CorrespondenceGraph::Write(std::ostream* stream) const {
+  THROW_CHECK(finalized_);
+  THROW_CHECK(stream->good());
+
+  WriteBinaryLittleEndian<uint64_t>(stream, images_.size());
+  for (const auto& image : images_) {
+    WriteBinaryLittleEndian<image_t>(stream, image.first);
+    WriteBinaryLittleEndian<point2D_t>(stream, image.second.num_observations);
+    WriteBinaryLittleEndian<point2D_t>(stream,
+                                       image.second.num_correspondences);
+    WriteBinaryLittleEndian<point2D_t>(stream, image.second.num_points2D);
+    const point2D_t* flat_corr_begs = image.second.flat_corr_begs.get();
+    WriteAlignedArray(stream, flat_corr_begs, image.second.num_points2D + 1);
+    WriteAlignedArray(stream,
+                      image.second.flat_corrs.get(),
+                      flat_corr_begs[image.second.num_points2D]);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(stream, image_pairs_.size());
+  for (const auto& image_pair : image_pairs_) {
+    WriteBinaryLittleEndian<image_pair_t>(stream, image_pair.first);
+    WriteBinaryLittleEndian<point2D_t>(stream,
+                                       image_pair.second.num_correspondences);
+  }
+
+  THROW_CHECK(stream->good());
+}
+
 }  // namespace colmap
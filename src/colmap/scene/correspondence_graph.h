@@ -30,9 +30,13 @@
 #pragma once
 
 #include "colmap/scene/database.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/types.h"
 
+#include <iostream>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace colmap {
@@ -92,7 +96,9 @@ class CorrespondenceGraph {
   //   of image points that have at least one correspondence.
   // - Deletes images without observations, as they are useless for SfM.
   // - Shrinks the correspondence vectors to their size to save memory.
-  void Finalize();
+  //
+  // The images are finalized in parallel using the given number of threads.
+  void Finalize(int num_threads = 1);
 
   // Add new image to the correspondence graph.
   void AddImage(image_t image_id, size_t num_points2D);
@@ -105,6 +111,13 @@ class CorrespondenceGraph {
                           image_t image_id2,
                           const FeatureMatches& matches);
 
+  // Add correspondences between multiple pairs of images in parallel. The
+  // result is the same as calling AddCorrespondences for each image pair in the
+  // given order. Each image pair must occur at most once in the given list.
+  void AddCorrespondences(
+      const std::vector<std::pair<image_pair_t, FeatureMatches>>& image_pairs,
+      int num_threads);
+
   // Find range of correspondences of an image observation to all other images.
   CorrespondenceRange FindCorrespondences(image_t image_id,
                                           point2D_t point2D_idx) const;
@@ -140,6 +153,14 @@ class CorrespondenceGraph {
   // observation as its only correspondence.
   bool IsTwoViewObservation(image_t image_id, point2D_t point2D_idx) const;
 
+  // Read/write a finalized correspondence graph from/to a binary stream. The
+  // flattened correspondences are written at 8-byte aligned stream positions.
+  // If the stream was opened on a file that is also given as memory-mapped,
+  // the correspondences reference the mapped file instead of being copied.
+  void Read(std::istream* stream,
+            std::shared_ptr<const MappedFile> mapped_file = nullptr);
+  void Write(std::ostream* stream) const;
+
  private:
   struct Image {
     // Number of 2D points with at least one correspondence to another image.
@@ -152,15 +173,23 @@ class CorrespondenceGraph {
     // Correspondences to other images per image point.
     // Added correspondences before Finalize().
     std::vector<std::vector<Correspondence>> corrs;
-    // Flattened correspondences after Finalize().
-    std::vector<Correspondence> flat_corrs;
+
+    // Number of image points after Finalize().
+    point2D_t num_points2D = 0;
+    // Flattened correspondences after Finalize(). They are immutable, so they
+    // are shared between copies of the graph and may reference a memory-mapped
+    // file.
+    std::shared_ptr<const Correspondence> flat_corrs;
     // For each point, determines the beginning of the correspondences in the
-    // flat_corrs vector. The end of point i is determined by the beginning of
-    // the next point. The length of this vector is num_points2D + 1, where the
-    // last element is equivalent to the size of flat_corrs.
-    std::vector<point2D_t> flat_corr_begs;
+    // flat_corrs array. The end of point i is determined by the beginning of
+    // the next point. The length of this array is num_points2D + 1, where the
+    // last element is equivalent to the length of flat_corrs.
+    std::shared_ptr<const point2D_t> flat_corr_begs;
   };
 
+  // Finalize the correspondences of a single image.
+  static void FinalizeImage(Image* image);
+
   struct ImagePair {
     // The number of correspondences between pairs of images.
     point2D_t num_correspondences = 0;
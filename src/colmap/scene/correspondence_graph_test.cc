@@ -29,6 +29,11 @@
 
 #include "colmap/scene/correspondence_graph.h"
 
+#include "colmap/util/testing.h"
+
+#include <fstream>
+#include <sstream>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -44,6 +49,57 @@ int CountNumTransitiveCorrespondences(const CorrespondenceGraph& graph,
   return corrs.size();
 }
 
+std::vector<std::pair<image_pair_t, FeatureMatches>> CreateRandomImagePairs(
+    const int num_images, const point2D_t num_points2D) {
+  std::vector<std::pair<image_pair_t, FeatureMatches>> image_pairs;
+  for (image_t image_id1 = 0; image_id1 < num_images; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 < num_images;
+         ++image_id2) {
+      FeatureMatches matches;
+      // Includes out-of-bounds and duplicate matches.
+      for (point2D_t i = 0; i < num_points2D; i += 3) {
+        matches.emplace_back((i * image_id2) % (num_points2D + 1),
+                             (i * image_id1 + 1) % num_points2D);
+      }
+      image_pairs.emplace_back(
+          Database::ImagePairToPairId(image_id1, image_id2), matches);
+    }
+  }
+  return image_pairs;
+}
+
+void ExpectEqualCorrespondenceGraphs(const CorrespondenceGraph& graph1,
+                                     const CorrespondenceGraph& graph2,
+                                     const int num_images,
+                                     const point2D_t num_points2D) {
+  EXPECT_EQ(graph1.NumImages(), graph2.NumImages());
+  EXPECT_EQ(graph1.NumImagePairs(), graph2.NumImagePairs());
+  EXPECT_EQ(graph1.NumCorrespondencesBetweenImages(),
+            graph2.NumCorrespondencesBetweenImages());
+  std::vector<CorrespondenceGraph::Correspondence> corrs1;
+  std::vector<CorrespondenceGraph::Correspondence> corrs2;
+  for (image_t image_id = 0; image_id < num_images; ++image_id) {
+    ASSERT_EQ(graph1.ExistsImage(image_id), graph2.ExistsImage(image_id));
+    if (!graph1.ExistsImage(image_id)) {
+      continue;
+    }
+    EXPECT_EQ(graph1.NumObservationsForImage(image_id),
+              graph2.NumObservationsForImage(image_id));
+    EXPECT_EQ(graph1.NumCorrespondencesForImage(image_id),
+              graph2.NumCorrespondencesForImage(image_id));
+    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+         ++point2D_idx) {
+      graph1.ExtractCorrespondences(image_id, point2D_idx, &corrs1);
+      graph2.ExtractCorrespondences(image_id, point2D_idx, &corrs2);
+      ASSERT_EQ(corrs1.size(), corrs2.size());
+      for (size_t i = 0; i < corrs1.size(); ++i) {
+        EXPECT_EQ(corrs1[i].image_id, corrs2[i].image_id);
+        EXPECT_EQ(corrs1[i].point2D_idx, corrs2[i].point2D_idx);
+      }
+    }
+  }
+}
+
 TEST(CorrespondenceGraph, Empty) {
   CorrespondenceGraph correspondence_graph;
   EXPECT_EQ(correspondence_graph.NumImages(), 0);
@@ -278,5 +334,79 @@ TEST(CorrespondenceGraph, Duplicate) {
             3);
 }
 
+TEST(CorrespondenceGraph, AddCorrespondencesParallel) {
+  const int kNumImages = 6;
+  const point2D_t kNumPoints2D = 40;
+  const auto image_pairs = CreateRandomImagePairs(kNumImages, kNumPoints2D);
+
+  CorrespondenceGraph sequential_graph;
+  CorrespondenceGraph parallel_graph;
+  for (image_t image_id = 0; image_id < kNumImages + 1; ++image_id) {
+    sequential_graph.AddImage(image_id, kNumPoints2D);
+    parallel_graph.AddImage(image_id, kNumPoints2D);
+  }
+
+  for (const auto& image_pair : image_pairs) {
+    const auto image_ids = Database::PairIdToImagePair(image_pair.first);
+    sequential_graph.AddCorrespondences(
+        image_ids.first, image_ids.second, image_pair.second);
+  }
+  sequential_graph.Finalize();
+
+  // Add the pairs in two batches to also check the duplicate detection
+  // against previously added correspondences.
+  const size_t num_pairs1 = image_pairs.size() / 2;
+  parallel_graph.AddCorrespondences(
+      {image_pairs.begin(), image_pairs.begin() + num_pairs1},
+      /*num_threads=*/3);
+  parallel_graph.AddCorrespondences(
+      {image_pairs.begin() + num_pairs1, image_pairs.end()},
+      /*num_threads=*/3);
+  parallel_graph.Finalize(/*num_threads=*/3);
+
+  // The image without correspondences is removed.
+  EXPECT_FALSE(parallel_graph.ExistsImage(kNumImages));
+  ExpectEqualCorrespondenceGraphs(
+      sequential_graph, parallel_graph, kNumImages, kNumPoints2D);
+}
+
+TEST(CorrespondenceGraph, ReadWrite) {
+  const int kNumImages = 5;
+  const point2D_t kNumPoints2D = 30;
+  CorrespondenceGraph correspondence_graph;
+  for (image_t image_id = 0; image_id < kNumImages; ++image_id) {
+    correspondence_graph.AddImage(image_id, kNumPoints2D);
+  }
+  correspondence_graph.AddCorrespondences(
+      CreateRandomImagePairs(kNumImages, kNumPoints2D), /*num_threads=*/1);
+  correspondence_graph.Finalize();
+
+  std::stringstream stream;
+  correspondence_graph.Write(&stream);
+  CorrespondenceGraph read_correspondence_graph;
+  read_correspondence_graph.Read(&stream);
+  ExpectEqualCorrespondenceGraphs(correspondence_graph,
+                                  read_correspondence_graph,
+                                  kNumImages,
+                                  kNumPoints2D);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string graph_path = test_dir + "/correspondence_graph.bin";
+  {
+    std::ofstream file(graph_path, std::ios::binary);
+    correspondence_graph.Write(&file);
+  }
+  CorrespondenceGraph mapped_correspondence_graph;
+  {
+    std::ifstream file(graph_path, std::ios::binary);
+    mapped_correspondence_graph.Read(
+        &file, std::make_shared<const MappedFile>(graph_path));
+  }
+  ExpectEqualCorrespondenceGraphs(correspondence_graph,
+                                  mapped_correspondence_graph,
+                                  kNumImages,
+                                  kNumPoints2D);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -43,6 +43,8 @@ void SwapFeatureMatchesBlob(FeatureMatchesBlob* matches) {
   matches->col(0).swap(matches->col(1));
 }
 
+}  // namespace
+
 FeatureKeypointsBlob FeatureKeypointsToBlob(const FeatureKeypoints& keypoints) {
   const FeatureKeypointsBlob::Index kNumCols = 6;
   FeatureKeypointsBlob blob(keypoints.size(), kNumCols);
@@ -103,6 +105,8 @@ FeatureMatches FeatureMatchesFromBlob(const FeatureMatchesBlob& blob) {
   return matches;
 }
 
+namespace {
+
 template <typename MatrixType>
 MatrixType ReadStaticMatrixBlob(sqlite3_stmt* sql_stmt,
                                 const int rc,
@@ -380,6 +384,22 @@ size_t Database::NumVerifiedImagePairs() const {
   return CountRows("two_view_geometries");
 }
 
+uint64_t Database::ChangeStamp() const {
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, "SELECT stamp FROM changes;", -1, &sql_stmt, 0));
+
+  uint64_t stamp = 0;
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  if (rc == SQLITE_ROW) {
+    stamp = static_cast<uint64_t>(sqlite3_column_int64(sql_stmt, 0));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return stamp;
+}
+
 Camera Database::ReadCamera(const camera_t camera_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_camera_, 1, camera_id));
 
@@ -569,12 +589,22 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 void Database::ReadTwoViewGeometries(
     std::vector<image_pair_t>* image_pair_ids,
     std::vector<TwoViewGeometry>* two_view_geometries) const {
+  ReadTwoViewGeometries([image_pair_ids, two_view_geometries](
+                            const image_pair_t pair_id,
+                            TwoViewGeometry&& two_view_geometry) {
+    image_pair_ids->push_back(pair_id);
+    two_view_geometries->push_back(std::move(two_view_geometry));
+  });
+}
+
+void Database::ReadTwoViewGeometries(
+    const std::function<void(image_pair_t, TwoViewGeometry&&)>& callback)
+    const {
   int rc;
   while ((rc = SQLITE3_CALL(sqlite3_step(
               sql_stmt_read_two_view_geometries_))) == SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 0));
-    image_pair_ids->push_back(pair_id);
 
     TwoViewGeometry two_view_geometry;
 
@@ -603,7 +633,7 @@ void Database::ReadTwoViewGeometries(
     two_view_geometry.E.transposeInPlace();
     two_view_geometry.H.transposeInPlace();
 
-    two_view_geometries->push_back(two_view_geometry);
+    callback(pair_id, std::move(two_view_geometry));
   }
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometries_));
@@ -631,6 +661,22 @@ void Database::ReadTwoViewGeometryNumInliers(
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometry_num_inliers_));
 }
 
+void Database::ReadTwoViewGeometryNumInliers(
+    const std::function<void(image_pair_t, int, int)>& callback) const {
+  while (SQLITE3_CALL(sqlite3_step(
+             sql_stmt_read_two_view_geometry_num_inliers_)) == SQLITE_ROW) {
+    const image_pair_t pair_id = static_cast<image_pair_t>(
+        sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 0));
+    const int rows = static_cast<int>(
+        sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 1));
+    const int config = static_cast<int>(
+        sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 2));
+    callback(pair_id, rows, config);
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometry_num_inliers_));
+}
+
 camera_t Database::WriteCamera(const Camera& camera,
                                const bool use_camera_id) const {
   if (use_camera_id) {
@@ -1197,7 +1243,7 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_two_view_geometries_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometries_);
 
-  sql = "SELECT pair_id, rows FROM two_view_geometries WHERE rows > 0;";
+  sql = "SELECT pair_id, rows, config FROM two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_,
                                   sql.c_str(),
                                   -1,
@@ -1291,6 +1337,7 @@ void Database::CreateTables() const {
   CreateDescriptorsTable();
   CreateMatchesTable();
   CreateTwoViewGeometriesTable();
+  CreateChangesTable();
 }
 
 void Database::CreateCameraTable() const {
@@ -1384,6 +1431,28 @@ void Database::CreateTwoViewGeometriesTable() const {
   }
 }
 
+void Database::CreateChangesTable() const {
+  std::string sql =
+      "CREATE TABLE IF NOT EXISTS changes"
+      "   (id     INTEGER  PRIMARY KEY  NOT NULL  CHECK(id = 0),"
+      "    stamp  INTEGER               NOT NULL);"
+      "INSERT OR IGNORE INTO changes(id, stamp) VALUES(0, 0);";
+  for (const std::string table :
+       {"cameras", "images", "keypoints", "two_view_geometries"}) {
+    for (const std::string event : {"insert", "update", "delete"}) {
+      sql += StringPrintf(
+          "CREATE TRIGGER IF NOT EXISTS %s_%s_changes AFTER %s ON %s "
+          "BEGIN UPDATE changes SET stamp = stamp + 1; END;",
+          table.c_str(),
+          event.c_str(),
+          event.c_str(),
+          table.c_str());
+    }
+  }
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+}
+
 void Database::UpdateSchema() const {
   if (!ExistsColumn("two_view_geometries", "F")) {
     SQLITE3_EXEC(database_,
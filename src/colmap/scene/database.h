@@ -36,6 +36,7 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
+#include <functional>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -52,6 +53,12 @@ typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
 typedef Eigen::Matrix<point2D_t, Eigen::Dynamic, 2, Eigen::RowMajor>
     FeatureMatchesBlob;
 
+// Convert features and matches to and from their row-major blob layout.
+FeatureKeypointsBlob FeatureKeypointsToBlob(const FeatureKeypoints& keypoints);
+FeatureKeypoints FeatureKeypointsFromBlob(const FeatureKeypointsBlob& blob);
+FeatureMatchesBlob FeatureMatchesToBlob(const FeatureMatches& matches);
+FeatureMatches FeatureMatchesFromBlob(const FeatureMatchesBlob& blob);
+
 // Database class to read and write images, features, cameras, matches, etc.
 // from a SQLite database. The class is not thread-safe and must not be accessed
 // concurrently. The class is optimized for single-thread speed and for optimal
@@ -127,6 +134,12 @@ class Database {
   // Number of rows in `two_view_geometries` table.
   size_t NumVerifiedImagePairs() const;
 
+  // Counter in the `changes` table, which is incremented by triggers on every
+  // insert, update, and delete in the `cameras`, `images`, `keypoints`, and
+  // `two_view_geometries` tables, also by other connections and processes.
+  // Changes to descriptors and raw matches are not counted.
+  uint64_t ChangeStamp() const;
+
   // Each image pair is assigned an unique ID in the `matches` and
   // `two_view_geometries` table. We intentionally avoid to store the pairs in a
   // separate table by using e.g. AUTOINCREMENT, since the overhead of querying
@@ -167,12 +180,23 @@ class Database {
       std::vector<image_pair_t>* image_pair_ids,
       std::vector<TwoViewGeometry>* two_view_geometries) const;
 
+  // Stream all two-view geometries to the callback one at a time, without
+  // holding all of them in memory.
+  void ReadTwoViewGeometries(
+      const std::function<void(image_pair_t, TwoViewGeometry&&)>& callback)
+      const;
+
   // Read all image pairs that have an entry in the `NumVerifiedImagePairs`
   // table with at least one inlier match and their number of inlier matches.
   void ReadTwoViewGeometryNumInliers(
       std::vector<std::pair<image_t, image_t>>* image_pairs,
       std::vector<int>* num_inliers) const;
 
+  // Stream the pair identifier, number of inlier matches, and configuration of
+  // the same image pairs to the callback, without reading the matches.
+  void ReadTwoViewGeometryNumInliers(
+      const std::function<void(image_pair_t, int, int)>& callback) const;
+
   // Add new camera and return its database identifier. If `use_camera_id`
   // is false a new identifier is automatically generated.
   camera_t WriteCamera(const Camera& camera, bool use_camera_id = false) const;
@@ -263,6 +287,7 @@ class Database {
   void CreateDescriptorsTable() const;
   void CreateMatchesTable() const;
   void CreateTwoViewGeometriesTable() const;
+  void CreateChangesTable() const;
 
   void UpdateSchema() const;
 
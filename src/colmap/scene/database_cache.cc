@@ -30,18 +30,168 @@
 #include "colmap/scene/database_cache.h"
 
 #include "colmap/feature/utils.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/string.h"
 #include "colmap/util/timer.h"
-
+#include "colmap/util/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
 #include <unordered_set>
 
 namespace colmap {
 
+namespace {
+
+// The identifier and version of the snapshot file format.
+const char kSnapshotMagic[] = "COLMAP_DATABASE_CACHE";
+const uint32_t kSnapshotVersion = 1;
+
+// The number of matches read from the database before they are added to the
+// correspondence graph in parallel.
+const size_t kNumMatchesPerBatch = 1 << 22;
+
+void WriteString(std::ostream* stream, const std::string& str) {
+  WriteBinaryLittleEndian<uint64_t>(stream, str.size());
+  stream->write(str.data(), str.size());
+}
+
+std::string ReadString(std::istream* stream) {
+  const uint64_t size = ReadBinaryLittleEndian<uint64_t>(stream);
+  std::string str(size, '\0');
+  stream->read(&str[0], size);
+  return str;
+}
+
+// 64-bit FNV-1a hash to fingerprint the contents of the database.
+class ContentHash {
+ public:
+  void Add(const void* data, const size_t num_bytes) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < num_bytes; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+    }
+  }
+
+  template <typename T>
+  void Add(const T value) {
+    static_assert(std::is_arithmetic<T>::value, "Value must be arithmetic");
+    Add(&value, sizeof(T));
+  }
+
+  void Add(const std::string& str) {
+    Add<uint64_t>(str.size());
+    Add(str.data(), str.size());
+  }
+
+  uint64_t Value() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 14695981039346656037ull;
+};
+
+// Fingerprint of the cameras, images, and the number of inlier matches and
+// configuration of the two-view geometries in the database. Only metadata is
+// hashed, such that neither keypoints nor matches have to be read.
+uint64_t ComputeDatabaseHash(const Database& database) {
+  ContentHash hash;
+
+  std::vector<struct Camera> cameras = database.ReadAllCameras();
+  std::sort(cameras.begin(),
+            cameras.end(),
+            [](const struct Camera& camera1, const struct Camera& camera2) {
+              return camera1.camera_id < camera2.camera_id;
+            });
+  for (const auto& camera : cameras) {
+    hash.Add(camera.camera_id);
+    hash.Add(static_cast<int>(camera.model_id));
+    hash.Add<uint64_t>(camera.width);
+    hash.Add<uint64_t>(camera.height);
+    hash.Add(camera.has_prior_focal_length);
+    for (const double param : camera.params) {
+      hash.Add(param);
+    }
+  }
+
+  std::vector<class Image> images = database.ReadAllImages();
+  std::sort(images.begin(),
+            images.end(),
+            [](const class Image& image1, const class Image& image2) {
+              return image1.ImageId() < image2.ImageId();
+            });
+  for (const auto& image : images) {
+    hash.Add(image.ImageId());
+    hash.Add(image.CameraId());
+    hash.Add(image.Name());
+    const Rigid3d& cam_from_world_prior = image.CamFromWorldPrior();
+    for (int i = 0; i < 4; ++i) {
+      hash.Add(cam_from_world_prior.rotation.coeffs()(i));
+    }
+    for (int i = 0; i < 3; ++i) {
+      hash.Add(cam_from_world_prior.translation(i));
+    }
+  }
+
+  // The two-view geometries are streamed in unspecified order, so they are
+  // hashed in the order of the pairs.
+  std::vector<std::tuple<image_pair_t, int, int>> pairs;
+  database.ReadTwoViewGeometryNumInliers(
+      [&pairs](
+          const image_pair_t pair_id, const int num_inliers, const int config) {
+        pairs.emplace_back(pair_id, num_inliers, config);
+      });
+  std::sort(pairs.begin(), pairs.end());
+  for (const auto& [pair_id, num_inliers, config] : pairs) {
+    hash.Add(pair_id);
+    hash.Add(num_inliers);
+    hash.Add(config);
+  }
+
+  return hash.Value();
+}
+
+// Key that identifies the database contents and options of a snapshot.
+std::string GetSnapshotKey(const Database& database,
+                           const size_t min_num_matches,
+                           const bool ignore_watermarks,
+                           const std::unordered_set<std::string>& image_names,
+                           const FeatureStore* feature_store) {
+  std::ostringstream key;
+  key << database.NumCameras() << " " << database.NumImages() << " "
+      << database.NumKeypoints() << " " << database.NumVerifiedImagePairs()
+      << " " << database.NumInlierMatches() << " " << database.ChangeStamp()
+      << " " << ComputeDatabaseHash(database) << " "
+      << min_num_matches << " " << ignore_watermarks;
+  std::vector<std::string> sorted_image_names(image_names.begin(),
+                                              image_names.end());
+  std::sort(sorted_image_names.begin(), sorted_image_names.end());
+  for (const auto& image_name : sorted_image_names) {
+    key << " " << image_name.size() << ":" << image_name;
+  }
+  if (feature_store != nullptr) {
+    key << " " << feature_store->Path() << " "
+        << feature_store->NumKeypointsRecords();
+  }
+  return key.str();
+}
+
+}  // namespace
+
 std::shared_ptr<DatabaseCache> DatabaseCache::Create(
     const Database& database,
     const size_t min_num_matches,
     const bool ignore_watermarks,
-    const std::unordered_set<std::string>& image_names) {
+    const std::unordered_set<std::string>& image_names,
+    const int num_threads,
+    const FeatureStore* feature_store) {
+  COLMAP_TRACE_SCOPE("database_cache/create");
   auto cache = std::make_shared<DatabaseCache>();
 
   //////////////////////////////////////////////////////////////////////////////
@@ -65,123 +215,220 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
       " %d in %.3fs", cache->cameras_.size(), timer.ElapsedSeconds());
 
   //////////////////////////////////////////////////////////////////////////////
-  // Load matches
+  // Load images
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  LOG(INFO) << "Loading matches...";
+  LOG(INFO) << "Loading images...";
 
-  std::vector<image_pair_t> image_pair_ids;
-  std::vector<TwoViewGeometry> two_view_geometries;
-  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  std::vector<class Image> images = database.ReadAllImages();
 
-  LOG(INFO) << StringPrintf(
-      " %d in %.3fs", image_pair_ids.size(), timer.ElapsedSeconds());
+  // Determines for which images data should be loaded.
+  std::unordered_set<image_t> image_ids;
+  for (const auto& image : images) {
+    if (image_names.empty() || image_names.count(image.Name()) > 0) {
+      image_ids.insert(image.ImageId());
+    }
+  }
 
-  auto UseInlierMatchesCheck = [min_num_matches, ignore_watermarks](
-                                   const TwoViewGeometry& two_view_geometry) {
-    return static_cast<size_t>(two_view_geometry.inlier_matches.size()) >=
-               min_num_matches &&
-           (!ignore_watermarks ||
-            two_view_geometry.config != TwoViewGeometry::WATERMARK);
-  };
+  LOG(INFO) << StringPrintf(
+      " %d in %.3fs", images.size(), timer.ElapsedSeconds());
 
   //////////////////////////////////////////////////////////////////////////////
-  // Load images
+  // Build correspondence graph
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  LOG(INFO) << "Loading images...";
+  LOG(INFO) << "Building correspondence graph...";
 
-  std::unordered_set<image_t> image_ids;
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
 
-  {
-    std::vector<class Image> images = database.ReadAllImages();
-    const size_t num_images = images.size();
+  // Images without correspondences are removed from the graph in Finalize.
+  for (const image_t image_id : image_ids) {
+    cache->correspondence_graph_->AddImage(
+        image_id,
+        feature_store != nullptr
+            ? feature_store->NumKeypointsForImage(image_id)
+            : database.NumKeypointsForImage(image_id));
+  }
 
-    // Determines for which images data should be loaded.
-    if (image_names.empty()) {
-      for (const auto& image : images) {
-        image_ids.insert(image.ImageId());
-      }
-    } else {
-      for (const auto& image : images) {
-        if (image_names.count(image.Name()) > 0) {
-          image_ids.insert(image.ImageId());
-        }
-      }
+  // Stream the matches from the database and add them in parallel batches,
+  // such that only a single batch of matches is held in memory.
+  std::unordered_set<image_t> connected_image_ids;
+  std::vector<std::pair<image_pair_t, FeatureMatches>> batch;
+  size_t num_batch_matches = 0;
+  size_t num_image_pairs = 0;
+  size_t num_ignored_image_pairs = 0;
+  database.ReadTwoViewGeometries([&](const image_pair_t pair_id,
+                                     TwoViewGeometry&& two_view_geometry) {
+    num_image_pairs += 1;
+
+    image_t image_id1;
+    image_t image_id2;
+    std::tie(image_id1, image_id2) = Database::PairIdToImagePair(pair_id);
+    if (static_cast<size_t>(two_view_geometry.inlier_matches.size()) <
+            min_num_matches ||
+        (ignore_watermarks &&
+         two_view_geometry.config == TwoViewGeometry::WATERMARK) ||
+        image_ids.count(image_id1) == 0 || image_ids.count(image_id2) == 0) {
+      num_ignored_image_pairs += 1;
+      return;
     }
 
-    // Collect all images that are connected in the correspondence graph.
-    std::unordered_set<image_t> connected_image_ids;
-    connected_image_ids.reserve(image_ids.size());
-    for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-      if (UseInlierMatchesCheck(two_view_geometries[i])) {
-        image_t image_id1;
-        image_t image_id2;
-        std::tie(image_id1, image_id2) =
-            Database::PairIdToImagePair(image_pair_ids[i]);
-        if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-          connected_image_ids.insert(image_id1);
-          connected_image_ids.insert(image_id2);
-        }
-      }
-    }
+    connected_image_ids.insert(image_id1);
+    connected_image_ids.insert(image_id2);
 
-    // Load images with correspondences and discard images without
-    // correspondences, as those images are useless for SfM.
-    cache->images_.reserve(connected_image_ids.size());
-    for (auto& image : images) {
-      const image_t image_id = image.ImageId();
-      if (image_ids.count(image_id) > 0 &&
-          connected_image_ids.count(image_id) > 0) {
-        image.SetPoints2D(
-            FeatureKeypointsToPointsVector(database.ReadKeypoints(image_id)));
-        cache->images_.emplace(image_id, std::move(image));
-      }
+    num_batch_matches += two_view_geometry.inlier_matches.size();
+    batch.emplace_back(pair_id, std::move(two_view_geometry.inlier_matches));
+    if (num_batch_matches >= kNumMatchesPerBatch) {
+      cache->correspondence_graph_->AddCorrespondences(batch, num_threads);
+      batch.clear();
+      num_batch_matches = 0;
     }
+  });
+  cache->correspondence_graph_->AddCorrespondences(batch, num_threads);
+  batch.clear();
 
-    LOG(INFO) << StringPrintf(" %d in %.3fs (connected %d)",
-                              num_images,
-                              timer.ElapsedSeconds(),
-                              connected_image_ids.size());
-  }
+  cache->correspondence_graph_->Finalize(num_threads);
+
+  LOG(INFO) << StringPrintf(" %d in %.3fs (ignored %d)",
+                            num_image_pairs,
+                            timer.ElapsedSeconds(),
+                            num_ignored_image_pairs);
 
   //////////////////////////////////////////////////////////////////////////////
-  // Build correspondence graph
+  // Load keypoints
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  LOG(INFO) << "Building correspondence graph...";
+  LOG(INFO) << "Loading keypoints...";
+
+  // Load images with correspondences and discard images without
+  // correspondences, as those images are useless for SfM.
+  cache->images_.reserve(connected_image_ids.size());
+  for (auto& image : images) {
+    const image_t image_id = image.ImageId();
+    if (connected_image_ids.count(image_id) > 0) {
+      image.SetPoints2D(FeatureKeypointsToPointsVector(
+          feature_store != nullptr ? feature_store->ReadKeypoints(image_id)
+                                   : database.ReadKeypoints(image_id)));
+      cache->images_.emplace(image_id, std::move(image));
+    }
+  }
 
-  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  // Set number of observations and correspondences per image.
+  for (auto& image : cache->images_) {
+    image.second.SetNumObservations(
+        cache->correspondence_graph_->NumObservationsForImage(image.first));
+    image.second.SetNumCorrespondences(
+        cache->correspondence_graph_->NumCorrespondencesForImage(image.first));
+  }
+
+  LOG(INFO) << StringPrintf(" %d in %.3fs (connected %d)",
+                            cache->images_.size(),
+                            timer.ElapsedSeconds(),
+                            connected_image_ids.size());
 
-  for (const auto& image : cache->images_) {
-    cache->correspondence_graph_->AddImage(image.first,
-                                           image.second.NumPoints2D());
+  return cache;
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateWithSnapshot(
+    const std::string& snapshot_path,
+    const Database& database,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names,
+    const int num_threads,
+    const FeatureStore* feature_store) {
+  const std::string key = GetSnapshotKey(
+      database, min_num_matches, ignore_watermarks, image_names, feature_store);
+
+  if (ExistsFile(snapshot_path)) {
+    Timer timer;
+    timer.Start();
+    LOG(INFO) << "Reading database cache snapshot...";
+    auto cache = ReadSnapshot(snapshot_path, key);
+    if (cache != nullptr) {
+      LOG(INFO) << StringPrintf(" %d images in %.3fs",
+                                cache->NumImages(),
+                                timer.ElapsedSeconds());
+      return cache;
+    }
+    LOG(INFO) << " outdated";
   }
 
-  size_t num_ignored_image_pairs = 0;
-  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-    if (UseInlierMatchesCheck(two_view_geometries[i])) {
-      image_t image_id1;
-      image_t image_id2;
-      std::tie(image_id1, image_id2) =
-          Database::PairIdToImagePair(image_pair_ids[i]);
-      if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-        cache->correspondence_graph_->AddCorrespondences(
-            image_id1, image_id2, two_view_geometries[i].inlier_matches);
-      } else {
-        num_ignored_image_pairs += 1;
-      }
-    } else {
-      num_ignored_image_pairs += 1;
+  auto cache = Create(database,
+                      min_num_matches,
+                      ignore_watermarks,
+                      image_names,
+                      num_threads,
+                      feature_store);
+  cache->WriteSnapshot(snapshot_path, key);
+  return cache;
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::ReadSnapshot(
+    const std::string& path, const std::string& key) {
+  COLMAP_TRACE_SCOPE("database_cache/read_snapshot");
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  if (ReadString(&file) != kSnapshotMagic ||
+      ReadBinaryLittleEndian<uint32_t>(&file) != kSnapshotVersion ||
+      ReadString(&file) != key) {
+    return nullptr;
+  }
+
+  auto cache = std::make_shared<DatabaseCache>();
+
+  const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&file);
+  cache->cameras_.reserve(num_cameras);
+  for (size_t i = 0; i < num_cameras; ++i) {
+    struct Camera camera;
+    camera.camera_id = ReadBinaryLittleEndian<camera_t>(&file);
+    camera.model_id =
+        static_cast<CameraModelId>(ReadBinaryLittleEndian<int>(&file));
+    camera.width = ReadBinaryLittleEndian<uint64_t>(&file);
+    camera.height = ReadBinaryLittleEndian<uint64_t>(&file);
+    camera.has_prior_focal_length = ReadBinaryLittleEndian<uint8_t>(&file);
+    camera.params.resize(ReadBinaryLittleEndian<uint64_t>(&file));
+    ReadBinaryLittleEndian<double>(&file, &camera.params);
+    cache->cameras_.emplace(camera.camera_id, std::move(camera));
+  }
+
+  const size_t num_images = ReadBinaryLittleEndian<uint64_t>(&file);
+  cache->images_.reserve(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    class Image image;
+    image.SetImageId(ReadBinaryLittleEndian<image_t>(&file));
+    image.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
+    image.SetName(ReadString(&file));
+    Rigid3d& cam_from_world_prior = image.CamFromWorldPrior();
+    cam_from_world_prior.rotation.w() = ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.rotation.x() = ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.rotation.y() = ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.rotation.z() = ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.translation.x() =
+        ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.translation.y() =
+        ReadBinaryLittleEndian<double>(&file);
+    cam_from_world_prior.translation.z() =
+        ReadBinaryLittleEndian<double>(&file);
+    std::vector<Eigen::Vector2d> points2D(
+        ReadBinaryLittleEndian<uint64_t>(&file));
+    for (auto& point2D : points2D) {
+      point2D.x() = ReadBinaryLittleEndian<double>(&file);
+      point2D.y() = ReadBinaryLittleEndian<double>(&file);
     }
+    image.SetPoints2D(points2D);
+    cache->images_.emplace(image.ImageId(), std::move(image));
   }
 
-  cache->correspondence_graph_->Finalize();
+  // The correspondences are referenced in the mapped file without copying.
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  cache->correspondence_graph_->Read(&file,
+                                     std::make_shared<const MappedFile>(path));
 
-  // Set number of observations and correspondences per image.
   for (auto& image : cache->images_) {
     image.second.SetNumObservations(
         cache->correspondence_graph_->NumObservationsForImage(image.first));
@@ -189,13 +436,76 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
         cache->correspondence_graph_->NumCorrespondencesForImage(image.first));
   }
 
-  LOG(INFO) << StringPrintf(" in %.3fs (ignored %d)",
-                            timer.ElapsedSeconds(),
-                            num_ignored_image_pairs);
-
   return cache;
 }
 
+void DatabaseCache::WriteSnapshot(const std::string& path,
+                                  const std::string& key) const {
+  COLMAP_TRACE_SCOPE("database_cache/write_snapshot");
+  // Write to a temporary file first, such that a snapshot mapped by another
+  // process is not modified. The random suffix keeps the temporary files of
+  // concurrent writers apart.
+  std::random_device random_device;
+  std::ostringstream tmp_path_stream;
+  tmp_path_stream << path << ".tmp" << std::hex << random_device()
+                  << random_device();
+  const std::string tmp_path = tmp_path_stream.str();
+
+  {
+    std::ofstream file(tmp_path, std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+
+    WriteString(&file, kSnapshotMagic);
+    WriteBinaryLittleEndian<uint32_t>(&file, kSnapshotVersion);
+    WriteString(&file, key);
+
+    WriteBinaryLittleEndian<uint64_t>(&file, cameras_.size());
+    for (const auto& camera : cameras_) {
+      WriteBinaryLittleEndian<camera_t>(&file, camera.first);
+      WriteBinaryLittleEndian<int>(&file,
+                                   static_cast<int>(camera.second.model_id));
+      WriteBinaryLittleEndian<uint64_t>(&file, camera.second.width);
+      WriteBinaryLittleEndian<uint64_t>(&file, camera.second.height);
+      WriteBinaryLittleEndian<uint8_t>(&file,
+                                       camera.second.has_prior_focal_length);
+      WriteBinaryLittleEndian<uint64_t>(&file, camera.second.params.size());
+      WriteBinaryLittleEndian<double>(&file, camera.second.params);
+    }
+
+    WriteBinaryLittleEndian<uint64_t>(&file, images_.size());
+    for (const auto& image : images_) {
+      WriteBinaryLittleEndian<image_t>(&file, image.first);
+      WriteBinaryLittleEndian<camera_t>(&file, image.second.CameraId());
+      WriteString(&file, image.second.Name());
+      const Rigid3d& cam_from_world_prior = image.second.CamFromWorldPrior();
+      WriteBinaryLittleEndian<double>(&file, cam_from_world_prior.rotation.w());
+      WriteBinaryLittleEndian<double>(&file, cam_from_world_prior.rotation.x());
+      WriteBinaryLittleEndian<double>(&file, cam_from_world_prior.rotation.y());
+      WriteBinaryLittleEndian<double>(&file, cam_from_world_prior.rotation.z());
+      WriteBinaryLittleEndian<double>(&file,
+                                      cam_from_world_prior.translation.x());
+      WriteBinaryLittleEndian<double>(&file,
+                                      cam_from_world_prior.translation.y());
+      WriteBinaryLittleEndian<double>(&file,
+                                      cam_from_world_prior.translation.z());
+      WriteBinaryLittleEndian<uint64_t>(&file, image.second.NumPoints2D());
+      for (const auto& point2D : image.second.Points2D()) {
+        WriteBinaryLittleEndian<double>(&file, point2D.xy.x());
+        WriteBinaryLittleEndian<double>(&file, point2D.xy.y());
+      }
+    }
+
+    correspondence_graph_->Write(&file);
+  }
+
+#ifdef _WIN32
+  // Windows does not replace existing files on rename.
+  std::remove(path.c_str());
+#endif
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0)
+      << "Failed to replace " << path;
+}
+
 const class Image* DatabaseCache::FindImageWithName(
     const std::string& name) const {
   for (const auto& image : images_) {
@@ -32,6 +32,7 @@
 #include "colmap/scene/camera.h"
 #include "colmap/scene/correspondence_graph.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/scene/image.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/eigen_alignment.h"
@@ -59,11 +60,38 @@ class DatabaseCache {
   // @param ignore_watermarks     Whether to ignore watermark image pairs.
   // @param image_names           Whether to use only load the data for a subset
   //                              of the images. All images are used if empty.
+  // @param num_threads           The number of threads used to build the
+  //                              correspondence graph.
+  // @param feature_store         Optional feature store from which the
+  //                              keypoints are read instead of the database.
   static std::shared_ptr<DatabaseCache> Create(
       const Database& database,
       size_t min_num_matches,
       bool ignore_watermarks,
-      const std::unordered_set<std::string>& image_names);
+      const std::unordered_set<std::string>& image_names,
+      int num_threads = -1,
+      const FeatureStore* feature_store = nullptr);
+
+  // Same as Create, but reuses a binary snapshot of the cache at the given
+  // path. If the snapshot was written for the same options and database, the
+  // cache is read from it and its correspondences are memory-mapped.
+  // Otherwise, the cache is created from the database and the snapshot is
+  // (re-)written. To keep the lookup cheap, neither keypoints nor matches are
+  // read. Instead, the database is identified by its change stamp, its number
+  // of cameras, images, keypoints, verified image pairs, and inlier matches,
+  // and a hash of its cameras, images, and the number of inlier matches and
+  // configuration of every two-view geometry. If a feature store is given, it
+  // is identified by its path and number of keypoints records. Any write to
+  // the database tables or the keypoints in the store is therefore detected,
+  // but not a database or store that is replaced by one with equal metadata.
+  static std::shared_ptr<DatabaseCache> CreateWithSnapshot(
+      const std::string& snapshot_path,
+      const Database& database,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names,
+      int num_threads = -1,
+      const FeatureStore* feature_store = nullptr);
 
   // Get number of objects.
   inline size_t NumCameras() const;
@@ -91,6 +119,12 @@ class DatabaseCache {
   const class Image* FindImageWithName(const std::string& name) const;
 
  private:
+  // Read/write the cache from/to a snapshot file, which is identified by the
+  // given key. Returns null if the file's key does not match.
+  static std::shared_ptr<DatabaseCache> ReadSnapshot(const std::string& path,
+                                                     const std::string& key);
+  void WriteSnapshot(const std::string& path, const std::string& key) const;
+
   std::shared_ptr<class CorrespondenceGraph> correspondence_graph_;
 
   std::unordered_map<camera_t, struct Camera> cameras_;
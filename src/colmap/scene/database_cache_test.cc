@@ -29,6 +29,9 @@
 
 #include "colmap/scene/database_cache.h"
 
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -90,5 +93,176 @@ TEST(DatabaseCache, Nominal) {
             1);
 }
 
+TEST(DatabaseCache, FeatureStore) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  Image image1;
+  image1.SetName("image1");
+  image1.SetCameraId(camera_id);
+  Image image2;
+  image2.SetName("image2");
+  image2.SetCameraId(camera_id);
+  const image_t image_id1 = database.WriteImage(image1);
+  const image_t image_id2 = database.WriteImage(image2);
+  FeatureStore feature_store(CreateTestDir());
+  FeatureKeypoints keypoints1(10);
+  keypoints1[3].x = 3;
+  feature_store.WriteKeypoints(image_id1, keypoints1);
+  feature_store.WriteKeypoints(image_id2, FeatureKeypoints(5));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{3, 1}};
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{},
+                                     /*num_threads=*/-1,
+                                     &feature_store);
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->Image(image_id1).NumPoints2D(), 10);
+  EXPECT_EQ(cache->Image(image_id1).Point2D(3).xy.x(), 3);
+  EXPECT_EQ(cache->Image(image_id2).NumPoints2D(), 5);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesForImage(image_id1),
+            1);
+}
+
+TEST(DatabaseCache, Snapshot) {
+  const std::string test_dir = CreateTestDir();
+  const std::string database_path = test_dir + "/database.db";
+  const std::string snapshot_path = test_dir + "/database_cache.bin";
+  Database database(database_path);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    FeatureKeypoints keypoints(10);
+    keypoints[i].x = i;
+    database.WriteKeypoints(image_ids.back(), keypoints);
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+
+  auto ExpectEqualCaches = [&image_ids, camera_id](
+                               const DatabaseCache& cache1,
+                               const DatabaseCache& cache2) {
+    EXPECT_EQ(cache1.NumCameras(), cache2.NumCameras());
+    EXPECT_EQ(cache1.NumImages(), cache2.NumImages());
+    for (const image_t image_id : image_ids) {
+      ASSERT_EQ(cache1.ExistsImage(image_id), cache2.ExistsImage(image_id));
+      if (!cache1.ExistsImage(image_id)) {
+        continue;
+      }
+      const Image& image1 = cache1.Image(image_id);
+      const Image& image2 = cache2.Image(image_id);
+      EXPECT_EQ(image1.Name(), image2.Name());
+      EXPECT_EQ(image1.CameraId(), image2.CameraId());
+      EXPECT_EQ(image1.NumObservations(), image2.NumObservations());
+      EXPECT_EQ(image1.NumCorrespondences(), image2.NumCorrespondences());
+      ASSERT_EQ(image1.NumPoints2D(), image2.NumPoints2D());
+      for (point2D_t i = 0; i < image1.NumPoints2D(); ++i) {
+        EXPECT_EQ(image1.Point2D(i).xy, image2.Point2D(i).xy);
+      }
+    }
+    EXPECT_EQ(cache1.CorrespondenceGraph()->NumCorrespondencesBetweenImages(),
+              cache2.CorrespondenceGraph()->NumCorrespondencesBetweenImages());
+    EXPECT_EQ(cache1.Camera(camera_id).params,
+              cache2.Camera(camera_id).params);
+  };
+
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{});
+  EXPECT_FALSE(ExistsFile(snapshot_path));
+  auto written_cache =
+      DatabaseCache::CreateWithSnapshot(snapshot_path,
+                                        database,
+                                        /*min_num_matches=*/0,
+                                        /*ignore_watermarks=*/false,
+                                        /*image_names=*/{});
+  EXPECT_TRUE(ExistsFile(snapshot_path));
+  ExpectEqualCaches(*cache, *written_cache);
+  auto read_cache =
+      DatabaseCache::CreateWithSnapshot(snapshot_path,
+                                        database,
+                                        /*min_num_matches=*/0,
+                                        /*ignore_watermarks=*/false,
+                                        /*image_names=*/{});
+  ExpectEqualCaches(*cache, *read_cache);
+  EXPECT_EQ(read_cache->NumImages(), 2);
+
+  // The snapshot is rewritten after the database changed.
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  auto updated_cache =
+      DatabaseCache::CreateWithSnapshot(snapshot_path,
+                                        database,
+                                        /*min_num_matches=*/0,
+                                        /*ignore_watermarks=*/false,
+                                        /*image_names=*/{});
+  EXPECT_EQ(updated_cache->NumImages(), 3);
+  ExpectEqualCaches(*updated_cache,
+                    *DatabaseCache::CreateWithSnapshot(
+                        snapshot_path,
+                        database,
+                        /*min_num_matches=*/0,
+                        /*ignore_watermarks=*/false,
+                        /*image_names=*/{}));
+
+  // The snapshot is rewritten after the camera parameters changed, also if
+  // the number of entries in the database remains the same.
+  Camera updated_camera = database.ReadCamera(camera_id);
+  updated_camera.params[0] += 1;
+  database.UpdateCamera(updated_camera);
+  auto updated_camera_cache =
+      DatabaseCache::CreateWithSnapshot(snapshot_path,
+                                        database,
+                                        /*min_num_matches=*/0,
+                                        /*ignore_watermarks=*/false,
+                                        /*image_names=*/{});
+  EXPECT_EQ(updated_camera_cache->Camera(camera_id).params,
+            updated_camera.params);
+  ExpectEqualCaches(*updated_camera_cache,
+                    *DatabaseCache::CreateWithSnapshot(
+                        snapshot_path,
+                        database,
+                        /*min_num_matches=*/0,
+                        /*ignore_watermarks=*/false,
+                        /*image_names=*/{}));
+
+  // The snapshot is rewritten after a pair was verified with other inlier
+  // matches of the same number.
+  database.DeleteInlierMatches(image_ids[1], image_ids[2]);
+  TwoViewGeometry updated_two_view_geometry;
+  updated_two_view_geometry.inlier_matches = {{0, 1}, {2, 4}};
+  database.WriteTwoViewGeometry(
+      image_ids[1], image_ids[2], updated_two_view_geometry);
+  auto updated_matches_cache =
+      DatabaseCache::CreateWithSnapshot(snapshot_path,
+                                        database,
+                                        /*min_num_matches=*/0,
+                                        /*ignore_watermarks=*/false,
+                                        /*image_names=*/{});
+  ExpectEqualCaches(*updated_matches_cache,
+                    *DatabaseCache::Create(database,
+                                           /*min_num_matches=*/0,
+                                           /*ignore_watermarks=*/false,
+                                           /*image_names=*/{}));
+  const auto& correspondence_graph =
+      *updated_matches_cache->CorrespondenceGraph();
+  EXPECT_TRUE(correspondence_graph.HasCorrespondences(image_ids[2], 4));
+  EXPECT_FALSE(correspondence_graph.HasCorrespondences(image_ids[2], 3));
+
+  // The old snapshot remains valid while it is in use.
+  ExpectEqualCaches(*cache, *read_cache);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -31,6 +31,7 @@
 
 #include "colmap/geometry/pose.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/testing.h"
 
 #include <thread>
 
@@ -370,6 +371,15 @@ TEST(Database, TwoViewGeometry) {
   EXPECT_EQ(image_pairs[0].first, image_id1);
   EXPECT_EQ(image_pairs[0].second, image_id2);
   EXPECT_EQ(num_inliers[0], two_view_geometry.inlier_matches.size());
+  int num_pairs = 0;
+  database.ReadTwoViewGeometryNumInliers(
+      [&](const image_pair_t pair_id, const int num_inliers, const int config) {
+        EXPECT_EQ(pair_id, Database::ImagePairToPairId(image_id1, image_id2));
+        EXPECT_EQ(num_inliers, two_view_geometry.inlier_matches.size());
+        EXPECT_EQ(config, two_view_geometry.config);
+        num_pairs += 1;
+      });
+  EXPECT_EQ(num_pairs, 1);
   EXPECT_EQ(database.NumInlierMatches(), 1000);
   database.DeleteInlierMatches(image_id1, image_id2);
   EXPECT_EQ(database.NumInlierMatches(), 0);
@@ -379,6 +389,48 @@ TEST(Database, TwoViewGeometry) {
   EXPECT_EQ(database.NumInlierMatches(), 0);
 }
 
+TEST(Database, ChangeStamp) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+  uint64_t stamp = 0;
+  image_t image_id1 = kInvalidImageId;
+  image_t image_id2 = kInvalidImageId;
+  {
+    Database database(database_path);
+    EXPECT_EQ(database.ChangeStamp(), 0);
+    Camera camera = Camera::CreateFromModelName(
+        kInvalidCameraId, "SIMPLE_PINHOLE", 1, 1, 1);
+    camera.camera_id = database.WriteCamera(camera);
+    Image image;
+    image.SetName("test1");
+    image.SetCameraId(camera.camera_id);
+    image_id1 = database.WriteImage(image);
+    image.SetName("test2");
+    image_id2 = database.WriteImage(image);
+    EXPECT_GT(database.ChangeStamp(), 0);
+    stamp = database.ChangeStamp();
+    database.WriteKeypoints(image_id1, FeatureKeypoints(10));
+    EXPECT_GT(database.ChangeStamp(), stamp);
+    stamp = database.ChangeStamp();
+    // Descriptors are not counted.
+    database.WriteDescriptors(image_id1, FeatureDescriptors(10, 128));
+    EXPECT_EQ(database.ChangeStamp(), stamp);
+  }
+
+  // The stamp persists and is not changed by reopening the database.
+  Database database(database_path);
+  EXPECT_EQ(database.ChangeStamp(), stamp);
+
+  // Rewriting the same number of keypoints changes the stamp.
+  database.ClearKeypoints();
+  database.WriteKeypoints(image_id1, FeatureKeypoints(10));
+  EXPECT_GT(database.ChangeStamp(), stamp);
+  stamp = database.ChangeStamp();
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches.resize(10);
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  EXPECT_GT(database.ChangeStamp(), stamp);
+}
+
 TEST(Database, Merge) {
   Database database1(Database::kInMemoryDatabasePath);
   Database database2(Database::kInMemoryDatabasePath);
@@ -0,0 +1,509 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace colmap {
+namespace {
+
+// Start every entry on a cache line boundary, so that views into the mapped
+// data are suitably aligned for vectorized access.
+constexpr uint64_t kDataAlignment = 64;
+
+// Offset of records that mark deleted entries.
+constexpr uint64_t kDeletedOffset = std::numeric_limits<uint64_t>::max();
+
+// Minimum address space reserved when remapping a data file.
+constexpr uint64_t kMinMappingCapacity = 1 << 20;
+
+}  // namespace
+
+FeatureStore::FeatureStore() {}
+
+FeatureStore::FeatureStore(const std::string& path) : FeatureStore() {
+  Open(path);
+}
+
+FeatureStore::~FeatureStore() { Close(); }
+
+void FeatureStore::Open(const std::string& path) {
+  Close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  CreateDirIfNotExists(path, /*recursive=*/true);
+  path_ = path;
+  OpenTable("keypoints", sizeof(float), &keypoints_);
+  OpenTable("descriptors", sizeof(uint8_t), &descriptors_);
+  OpenTable("matches", sizeof(point2D_t), &matches_);
+}
+
+void FeatureStore::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CloseTable(&keypoints_);
+  CloseTable(&descriptors_);
+  CloseTable(&matches_);
+  path_.clear();
+}
+
+const std::string& FeatureStore::Path() const { return path_; }
+
+bool FeatureStore::ExistsKeypoints(const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return FindRecord(keypoints_, image_id) != nullptr;
+}
+
+bool FeatureStore::ExistsDescriptors(const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return FindRecord(descriptors_, image_id) != nullptr;
+}
+
+bool FeatureStore::ExistsMatches(const image_t image_id1,
+                                 const image_t image_id2) const {
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return FindRecord(matches_, pair_id) != nullptr;
+}
+
+size_t FeatureStore::NumKeypointsForImage(const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record* record = FindRecord(keypoints_, image_id);
+  return record == nullptr ? 0 : record->rows;
+}
+
+size_t FeatureStore::NumDescriptorsForImage(const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record* record = FindRecord(descriptors_, image_id);
+  return record == nullptr ? 0 : record->rows;
+}
+
+size_t FeatureStore::NumMatchesForImagePair(const image_t image_id1,
+                                            const image_t image_id2) const {
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record* record = FindRecord(matches_, pair_id);
+  return record == nullptr ? 0 : record->rows;
+}
+
+size_t FeatureStore::MaxNumKeypoints() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t max_num_keypoints = 0;
+  for (const auto& record : keypoints_.records) {
+    if (record.second.offset != kDeletedOffset) {
+      max_num_keypoints =
+          std::max(max_num_keypoints, static_cast<size_t>(record.second.rows));
+    }
+  }
+  return max_num_keypoints;
+}
+
+uint64_t FeatureStore::NumKeypointsRecords() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keypoints_.num_index_records;
+}
+
+std::vector<image_t> FeatureStore::KeypointsImageIds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<image_t> image_ids;
+  image_ids.reserve(keypoints_.records.size());
+  for (const auto& record : keypoints_.records) {
+    if (record.second.offset != kDeletedOffset) {
+      image_ids.push_back(static_cast<image_t>(record.first));
+    }
+  }
+  return image_ids;
+}
+
+std::vector<image_t> FeatureStore::DescriptorsImageIds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<image_t> image_ids;
+  image_ids.reserve(descriptors_.records.size());
+  for (const auto& record : descriptors_.records) {
+    if (record.second.offset != kDeletedOffset) {
+      image_ids.push_back(static_cast<image_t>(record.first));
+    }
+  }
+  return image_ids;
+}
+
+std::vector<image_pair_t> FeatureStore::MatchesImagePairIds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<image_pair_t> pair_ids;
+  pair_ids.reserve(matches_.records.size());
+  for (const auto& record : matches_.records) {
+    if (record.second.offset != kDeletedOffset) {
+      pair_ids.push_back(static_cast<image_pair_t>(record.first));
+    }
+  }
+  return pair_ids;
+}
+
+FeatureStore::KeypointsView FeatureStore::ReadKeypointsView(
+    const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record& record = GetRecord(keypoints_, image_id);
+  const auto* data = static_cast<const float*>(RecordData(&keypoints_, record));
+  return KeypointsView(data, record.rows, record.cols);
+}
+
+FeatureStore::DescriptorsView FeatureStore::ReadDescriptorsView(
+    const image_t image_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record& record = GetRecord(descriptors_, image_id);
+  const auto* data =
+      static_cast<const uint8_t*>(RecordData(&descriptors_, record));
+  return DescriptorsView(data, record.rows, record.cols);
+}
+
+FeatureStore::MatchesView FeatureStore::ReadMatchesView(
+    const image_pair_t pair_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Record& record = GetRecord(matches_, pair_id);
+  THROW_CHECK_EQ(record.cols, 2);
+  const auto* data =
+      static_cast<const point2D_t*>(RecordData(&matches_, record));
+  return MatchesView(data, record.rows, record.cols);
+}
+
+FeatureKeypointsBlob FeatureStore::ReadKeypointsBlob(
+    const image_t image_id) const {
+  return ReadKeypointsView(image_id);
+}
+
+FeatureKeypoints FeatureStore::ReadKeypoints(const image_t image_id) const {
+  return FeatureKeypointsFromBlob(ReadKeypointsBlob(image_id));
+}
+
+FeatureDescriptors FeatureStore::ReadDescriptors(
+    const image_t image_id) const {
+  return ReadDescriptorsView(image_id);
+}
+
+FeatureMatchesBlob FeatureStore::ReadMatchesBlob(
+    const image_t image_id1, const image_t image_id2) const {
+  FeatureMatchesBlob blob =
+      ReadMatchesView(Database::ImagePairToPairId(image_id1, image_id2));
+  if (Database::SwapImagePair(image_id1, image_id2)) {
+    blob.col(0).swap(blob.col(1));
+  }
+  return blob;
+}
+
+FeatureMatches FeatureStore::ReadMatches(const image_t image_id1,
+                                         const image_t image_id2) const {
+  return FeatureMatchesFromBlob(ReadMatchesBlob(image_id1, image_id2));
+}
+
+void FeatureStore::WriteKeypoints(const image_t image_id,
+                                  const FeatureKeypoints& keypoints) {
+  WriteKeypoints(image_id, FeatureKeypointsToBlob(keypoints));
+}
+
+void FeatureStore::WriteKeypoints(const image_t image_id,
+                                  const FeatureKeypointsBlob& blob) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AppendData(&keypoints_, image_id, blob.data(), blob.rows(), blob.cols());
+}
+
+void FeatureStore::WriteDescriptors(const image_t image_id,
+                                    const FeatureDescriptors& descriptors) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AppendData(&descriptors_,
+             image_id,
+             descriptors.data(),
+             descriptors.rows(),
+             descriptors.cols());
+}
+
+void FeatureStore::WriteMatches(const image_t image_id1,
+                                const image_t image_id2,
+                                const FeatureMatches& matches) {
+  WriteMatches(image_id1, image_id2, FeatureMatchesToBlob(matches));
+}
+
+void FeatureStore::WriteMatches(const image_t image_id1,
+                                const image_t image_id2,
+                                const FeatureMatchesBlob& blob) {
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (Database::SwapImagePair(image_id1, image_id2)) {
+    FeatureMatchesBlob swapped_blob = blob;
+    swapped_blob.col(0).swap(swapped_blob.col(1));
+    AppendData(&matches_,
+               pair_id,
+               swapped_blob.data(),
+               swapped_blob.rows(),
+               swapped_blob.cols());
+  } else {
+    AppendData(&matches_, pair_id, blob.data(), blob.rows(), blob.cols());
+  }
+}
+
+void FeatureStore::DeleteMatches(const image_t image_id1,
+                                 const image_t image_id2) {
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (FindRecord(matches_, pair_id) != nullptr) {
+    Record record;
+    record.offset = kDeletedOffset;
+    AppendIndexRecord(&matches_, pair_id, record);
+  }
+}
+
+void FeatureStore::OpenTable(const std::string& name,
+                             const size_t element_num_bytes,
+                             Table* table) {
+  table->element_num_bytes = element_num_bytes;
+  table->data_path = JoinPaths(path_, name + ".data");
+  table->index_path = JoinPaths(path_, name + ".index");
+
+  // Create the files if they do not exist yet.
+  for (const std::string& path : {table->data_path, table->index_path}) {
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::app);
+    THROW_CHECK_FILE_OPEN(file, path);
+  }
+
+  const uint64_t data_file_size = GetFileSize(table->data_path);
+
+  // Replay the index. Later records supersede earlier ones. Data and index
+  // records are appended in this order, so an interrupted write leaves at most
+  // one incomplete record at the end of each file. Replay stops at the first
+  // index record that is incomplete or refers to incomplete data.
+  uint64_t index_size = 0;
+  table->data_size = 0;
+  table->num_index_records = 0;
+  {
+    std::ifstream index_file(table->index_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(index_file, table->index_path);
+    while (true) {
+      const uint64_t key = ReadBinaryLittleEndian<uint64_t>(&index_file);
+      Record record;
+      record.offset = ReadBinaryLittleEndian<uint64_t>(&index_file);
+      record.rows = ReadBinaryLittleEndian<uint32_t>(&index_file);
+      record.cols = ReadBinaryLittleEndian<uint32_t>(&index_file);
+      if (!index_file) {
+        break;
+      }
+      if (record.offset != kDeletedOffset) {
+        const uint64_t record_end =
+            record.offset + static_cast<uint64_t>(record.rows) * record.cols *
+                                element_num_bytes;
+        if (record_end > data_file_size) {
+          break;
+        }
+        table->data_size = std::max(table->data_size, record_end);
+      }
+      table->records[key] = record;
+      table->num_index_records += 1;
+      index_size = index_file.tellg();
+    }
+  }
+
+  // Discard the incomplete trailing records, such that new records are
+  // appended directly after the last complete ones.
+  if (index_size < GetFileSize(table->index_path)) {
+    LOG(WARNING) << "Discarding incomplete records in " << table->index_path;
+    boost::filesystem::resize_file(table->index_path, index_size);
+  }
+  if (table->data_size < data_file_size) {
+    boost::filesystem::resize_file(table->data_path, table->data_size);
+  }
+
+  table->data_file.open(table->data_path,
+                        std::ios::binary | std::ios::out | std::ios::app);
+  THROW_CHECK_FILE_OPEN(table->data_file, table->data_path);
+  table->index_file.open(table->index_path,
+                         std::ios::binary | std::ios::out | std::ios::app);
+  THROW_CHECK_FILE_OPEN(table->index_file, table->index_path);
+
+  table->mapping =
+      std::make_shared<MappedFile>(table->data_path, table->data_size);
+}
+
+void FeatureStore::CloseTable(Table* table) {
+  if (table->data_file.is_open()) {
+    table->data_file.close();
+  }
+  if (table->index_file.is_open()) {
+    table->index_file.close();
+  }
+  table->element_num_bytes = 0;
+  table->data_size = 0;
+  table->num_index_records = 0;
+  table->records.clear();
+  table->mapping.reset();
+  table->retired_mappings.clear();
+}
+
+const FeatureStore::Record* FeatureStore::FindRecord(const Table& table,
+                                                     const uint64_t key) const {
+  const auto it = table.records.find(key);
+  if (it == table.records.end() || it->second.offset == kDeletedOffset) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+const FeatureStore::Record& FeatureStore::GetRecord(const Table& table,
+                                                    const uint64_t key) const {
+  const Record* record = FindRecord(table, key);
+  THROW_CHECK_NOTNULL(record);
+  return *record;
+}
+
+void FeatureStore::AppendData(Table* table,
+                              const uint64_t key,
+                              const void* data,
+                              const uint32_t rows,
+                              const uint32_t cols) {
+  THROW_CHECK(table->data_file.is_open()) << "Feature store is not open";
+
+  const uint64_t padding =
+      (kDataAlignment - table->data_size % kDataAlignment) % kDataAlignment;
+  const uint64_t num_bytes =
+      static_cast<uint64_t>(rows) * cols * table->element_num_bytes;
+  const char kZeros[kDataAlignment] = {};
+  table->data_file.write(kZeros, padding);
+  table->data_file.write(static_cast<const char*>(data), num_bytes);
+  table->data_file.flush();
+  THROW_CHECK(table->data_file) << "Failed to write " << table->data_path;
+
+  Record record;
+  record.offset = table->data_size + padding;
+  record.rows = rows;
+  record.cols = cols;
+  table->data_size += padding + num_bytes;
+
+  // The index record is written after the data, such that the index never
+  // refers to incomplete data.
+  AppendIndexRecord(table, key, record);
+}
+
+void FeatureStore::AppendIndexRecord(Table* table,
+                                     const uint64_t key,
+                                     const Record& record) {
+  THROW_CHECK(table->index_file.is_open()) << "Feature store is not open";
+  WriteBinaryLittleEndian<uint64_t>(&table->index_file, key);
+  WriteBinaryLittleEndian<uint64_t>(&table->index_file, record.offset);
+  WriteBinaryLittleEndian<uint32_t>(&table->index_file, record.rows);
+  WriteBinaryLittleEndian<uint32_t>(&table->index_file, record.cols);
+  table->index_file.flush();
+  THROW_CHECK(table->index_file) << "Failed to write " << table->index_path;
+  table->records[key] = record;
+  table->num_index_records += 1;
+}
+
+const void* FeatureStore::RecordData(Table* table,
+                                     const Record& record) const {
+  const uint64_t num_bytes = static_cast<uint64_t>(record.rows) * record.cols *
+                             table->element_num_bytes;
+  if (num_bytes == 0) {
+    return nullptr;
+  }
+
+  // Remap the data file if the record lies beyond the reserved capacity of
+  // the last mapping. The capacity grows geometrically, such that appending
+  // and reading entries in turn only remaps a logarithmic number of times.
+  // Previous mappings stay alive, since views may still refer to them.
+  if (record.offset + num_bytes > table->mapping->Capacity()) {
+    const uint64_t capacity = std::max<uint64_t>(
+        {table->data_size,
+         2 * static_cast<uint64_t>(table->mapping->Capacity()),
+         kMinMappingCapacity});
+    table->retired_mappings.push_back(std::move(table->mapping));
+    table->mapping = std::make_shared<MappedFile>(
+        table->data_path, table->data_size, capacity);
+  }
+
+  THROW_CHECK_LE(record.offset + num_bytes, table->mapping->Capacity());
+  return table->mapping->Data() + record.offset;
+}
+
+void ExportFeaturesToFeatureStore(const Database& database,
+                                  FeatureStore* feature_store) {
+  THROW_CHECK_NOTNULL(feature_store);
+  for (const Image& image : database.ReadAllImages()) {
+    if (database.ExistsKeypoints(image.ImageId())) {
+      feature_store->WriteKeypoints(
+          image.ImageId(), database.ReadKeypointsBlob(image.ImageId()));
+    }
+    if (database.ExistsDescriptors(image.ImageId())) {
+      feature_store->WriteDescriptors(
+          image.ImageId(), database.ReadDescriptors(image.ImageId()));
+    }
+  }
+
+  for (const auto& matches : database.ReadAllMatches()) {
+    const auto image_pair = Database::PairIdToImagePair(matches.first);
+    feature_store->WriteMatches(
+        image_pair.first, image_pair.second, matches.second);
+  }
+}
+
+void ImportFeaturesFromFeatureStore(const FeatureStore& feature_store,
+                                    Database* database) {
+  THROW_CHECK_NOTNULL(database);
+  DatabaseTransaction database_transaction(database);
+
+  for (const image_t image_id : feature_store.KeypointsImageIds()) {
+    if (!database->ExistsKeypoints(image_id)) {
+      database->WriteKeypoints(image_id,
+                               feature_store.ReadKeypointsBlob(image_id));
+    }
+  }
+
+  for (const image_t image_id : feature_store.DescriptorsImageIds()) {
+    if (!database->ExistsDescriptors(image_id)) {
+      database->WriteDescriptors(image_id,
+                                 feature_store.ReadDescriptors(image_id));
+    }
+  }
+
+  for (const image_pair_t pair_id : feature_store.MatchesImagePairIds()) {
+    const auto image_pair = Database::PairIdToImagePair(pair_id);
+    if (!database->ExistsMatches(image_pair.first, image_pair.second)) {
+      database->WriteMatches(
+          image_pair.first,
+          image_pair.second,
+          feature_store.ReadMatchesBlob(image_pair.first, image_pair.second));
+    }
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,193 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/feature/types.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/types.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+class MappedFile;
+
+// Append-only feature store as an alternative to the keypoints, descriptors,
+// and matches tables of the SQLite database. Each table is stored as one data
+// file with the row-major matrices of all entries and one index file with the
+// offset and dimensions of every entry. Entries are never modified in place:
+// writing an existing entry appends a new version, which supersedes the old
+// one, and deleting an entry appends a tombstone record.
+//
+// The data files are memory-mapped for reading, such that descriptors and
+// keypoints can be accessed as zero-copy views. Views remain valid until the
+// store is closed, also if new entries are written in the meantime. Data is
+// stored in the native byte order of the host. All methods are thread-safe.
+//
+// Cameras, images, and two-view geometries remain in the database. Feature
+// extraction, matching, and `DatabaseCache` can read from and write to the
+// store directly. Use `ExportFeaturesToFeatureStore` and
+// `ImportFeaturesFromFeatureStore` to convert between the two storage formats
+// for all other consumers of the database.
+class FeatureStore {
+ public:
+  typedef Eigen::Map<const FeatureKeypointsBlob> KeypointsView;
+  typedef Eigen::Map<const FeatureDescriptors> DescriptorsView;
+  typedef Eigen::Map<const FeatureMatchesBlob> MatchesView;
+
+  FeatureStore();
+  explicit FeatureStore(const std::string& path);
+  ~FeatureStore();
+
+  // Open the store in the given directory, which is created if it does not
+  // exist. Entries from previous sessions are loaded from the index files.
+  void Open(const std::string& path);
+  void Close();
+
+  const std::string& Path() const;
+
+  bool ExistsKeypoints(image_t image_id) const;
+  bool ExistsDescriptors(image_t image_id) const;
+  bool ExistsMatches(image_t image_id1, image_t image_id2) const;
+
+  size_t NumKeypointsForImage(image_t image_id) const;
+  size_t NumDescriptorsForImage(image_t image_id) const;
+  size_t NumMatchesForImagePair(image_t image_id1, image_t image_id2) const;
+
+  // Maximum number of keypoints of any image in the store.
+  size_t MaxNumKeypoints() const;
+
+  // Number of keypoints records written to the store, i.e. of all writes and
+  // deletes of keypoints. It identifies the version of the keypoints, since
+  // entries are never modified in place.
+  uint64_t NumKeypointsRecords() const;
+
+  // Identifiers of all existing entries in unspecified order.
+  std::vector<image_t> KeypointsImageIds() const;
+  std::vector<image_t> DescriptorsImageIds() const;
+  std::vector<image_pair_t> MatchesImagePairIds() const;
+
+  // Zero-copy views into the memory-mapped data. The user is responsible for
+  // making sure that the entry exists. Matches are viewed in the order of the
+  // image pair identifier, i.e. the first column refers to the image with the
+  // smaller identifier as defined by `Database::SwapImagePair`.
+  KeypointsView ReadKeypointsView(image_t image_id) const;
+  DescriptorsView ReadDescriptorsView(image_t image_id) const;
+  MatchesView ReadMatchesView(image_pair_t pair_id) const;
+
+  // Read an existing entry into owning containers. For image pairs, the order
+  // of `image_id1` and `image_id2` does not matter.
+  FeatureKeypointsBlob ReadKeypointsBlob(image_t image_id) const;
+  FeatureKeypoints ReadKeypoints(image_t image_id) const;
+  FeatureDescriptors ReadDescriptors(image_t image_id) const;
+  FeatureMatchesBlob ReadMatchesBlob(image_t image_id1,
+                                     image_t image_id2) const;
+  FeatureMatches ReadMatches(image_t image_id1, image_t image_id2) const;
+
+  // Append a new entry, which replaces any existing entry with the same
+  // identifier. For image pairs, the order of `image_id1` and `image_id2` does
+  // not matter.
+  void WriteKeypoints(image_t image_id, const FeatureKeypoints& keypoints);
+  void WriteKeypoints(image_t image_id, const FeatureKeypointsBlob& blob);
+  void WriteDescriptors(image_t image_id,
+                        const FeatureDescriptors& descriptors);
+  void WriteMatches(image_t image_id1,
+                    image_t image_id2,
+                    const FeatureMatches& matches);
+  void WriteMatches(image_t image_id1,
+                    image_t image_id2,
+                    const FeatureMatchesBlob& blob);
+
+  // Delete matches of an image pair.
+  void DeleteMatches(image_t image_id1, image_t image_id2);
+
+ private:
+  struct Record {
+    uint64_t offset = 0;
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+  };
+
+  struct Table {
+    std::string data_path;
+    std::string index_path;
+    size_t element_num_bytes = 0;
+    std::ofstream data_file;
+    std::ofstream index_file;
+    uint64_t data_size = 0;
+    uint64_t num_index_records = 0;
+    std::unordered_map<uint64_t, Record> records;
+    // The current mapping of the data file and all previous mappings, which
+    // are kept alive until the store is closed to keep views valid.
+    std::shared_ptr<MappedFile> mapping;
+    std::vector<std::shared_ptr<MappedFile>> retired_mappings;
+  };
+
+  void OpenTable(const std::string& name,
+                 size_t element_num_bytes,
+                 Table* table);
+  void CloseTable(Table* table);
+
+  const Record* FindRecord(const Table& table, uint64_t key) const;
+  const Record& GetRecord(const Table& table, uint64_t key) const;
+  void AppendData(Table* table,
+                  uint64_t key,
+                  const void* data,
+                  uint32_t rows,
+                  uint32_t cols);
+  void AppendIndexRecord(Table* table, uint64_t key, const Record& record);
+  const void* RecordData(Table* table, const Record& record) const;
+
+  std::string path_;
+  mutable std::mutex mutex_;
+  mutable Table keypoints_;
+  mutable Table descriptors_;
+  mutable Table matches_;
+};
+
+// Copy all keypoints, descriptors, and raw matches from the database into the
+// feature store. Existing entries in the store are replaced.
+void ExportFeaturesToFeatureStore(const Database& database,
+                                  FeatureStore* feature_store);
+
+// Copy all keypoints, descriptors, and raw matches from the feature store into
+// the database. Entries that already exist in the database are skipped.
+void ImportFeaturesFromFeatureStore(const FeatureStore& feature_store,
+                                    Database* database);
+
+}  // namespace colmap
@@ -0,0 +1,239 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(FeatureStore, Empty) {
+  FeatureStore feature_store(CreateTestDir());
+  EXPECT_FALSE(feature_store.ExistsKeypoints(1));
+  EXPECT_FALSE(feature_store.ExistsDescriptors(1));
+  EXPECT_FALSE(feature_store.ExistsMatches(1, 2));
+  EXPECT_EQ(feature_store.MaxNumKeypoints(), 0);
+  EXPECT_EQ(feature_store.NumKeypointsRecords(), 0);
+  EXPECT_TRUE(feature_store.KeypointsImageIds().empty());
+  EXPECT_TRUE(feature_store.DescriptorsImageIds().empty());
+  EXPECT_TRUE(feature_store.MatchesImagePairIds().empty());
+}
+
+TEST(FeatureStore, KeypointsAndDescriptors) {
+  FeatureStore feature_store(CreateTestDir());
+
+  FeatureKeypoints keypoints(10);
+  keypoints[0].x = 1;
+  keypoints[9].y = 2;
+  feature_store.WriteKeypoints(1, keypoints);
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  feature_store.WriteDescriptors(1, descriptors);
+
+  EXPECT_TRUE(feature_store.ExistsKeypoints(1));
+  EXPECT_TRUE(feature_store.ExistsDescriptors(1));
+  EXPECT_FALSE(feature_store.ExistsKeypoints(2));
+  EXPECT_EQ(feature_store.NumKeypointsForImage(1), 10);
+  EXPECT_EQ(feature_store.NumDescriptorsForImage(1), 10);
+  EXPECT_EQ(feature_store.MaxNumKeypoints(), 10);
+
+  const FeatureStore::KeypointsView keypoints_view =
+      feature_store.ReadKeypointsView(1);
+  EXPECT_EQ(keypoints_view.rows(), 10);
+  EXPECT_EQ(keypoints_view.cols(), 6);
+  EXPECT_EQ(keypoints_view(0, 0), 1);
+  EXPECT_EQ(keypoints_view(9, 1), 2);
+  EXPECT_EQ(feature_store.ReadKeypoints(1)[9].y, 2);
+
+  const FeatureStore::DescriptorsView descriptors_view =
+      feature_store.ReadDescriptorsView(1);
+  EXPECT_EQ(descriptors_view, descriptors);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(descriptors_view.data()) % 64, 0);
+
+  // Overwriting appends a new version and keeps previous views valid.
+  const FeatureDescriptors descriptors2 = FeatureDescriptors::Random(20, 128);
+  feature_store.WriteDescriptors(1, descriptors2);
+  feature_store.WriteKeypoints(2, FeatureKeypoints(20));
+  EXPECT_EQ(feature_store.ReadDescriptors(1), descriptors2);
+  EXPECT_EQ(descriptors_view, descriptors);
+  EXPECT_EQ(feature_store.MaxNumKeypoints(), 20);
+}
+
+TEST(FeatureStore, Matches) {
+  FeatureStore feature_store(CreateTestDir());
+
+  FeatureMatches matches(100);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    matches[i].point2D_idx1 = i;
+    matches[i].point2D_idx2 = 2 * i;
+  }
+  feature_store.WriteMatches(2, 1, matches);
+  EXPECT_TRUE(feature_store.ExistsMatches(1, 2));
+  EXPECT_TRUE(feature_store.ExistsMatches(2, 1));
+  EXPECT_EQ(feature_store.NumMatchesForImagePair(1, 2), 100);
+
+  const FeatureMatches matches21 = feature_store.ReadMatches(2, 1);
+  const FeatureMatches matches12 = feature_store.ReadMatches(1, 2);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    EXPECT_EQ(matches21[i].point2D_idx1, matches[i].point2D_idx1);
+    EXPECT_EQ(matches21[i].point2D_idx2, matches[i].point2D_idx2);
+    EXPECT_EQ(matches12[i].point2D_idx1, matches[i].point2D_idx2);
+    EXPECT_EQ(matches12[i].point2D_idx2, matches[i].point2D_idx1);
+  }
+
+  const FeatureStore::MatchesView matches_view =
+      feature_store.ReadMatchesView(Database::ImagePairToPairId(1, 2));
+  EXPECT_EQ(matches_view(1, 0), matches[1].point2D_idx2);
+  EXPECT_EQ(matches_view(1, 1), matches[1].point2D_idx1);
+
+  feature_store.WriteMatches(1, 3, FeatureMatches());
+  EXPECT_TRUE(feature_store.ExistsMatches(1, 3));
+  EXPECT_TRUE(feature_store.ReadMatches(1, 3).empty());
+
+  feature_store.DeleteMatches(1, 2);
+  EXPECT_FALSE(feature_store.ExistsMatches(1, 2));
+  EXPECT_EQ(feature_store.MatchesImagePairIds().size(), 1);
+}
+
+TEST(FeatureStore, Reopen) {
+  const std::string test_dir = CreateTestDir();
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  {
+    FeatureStore feature_store(test_dir);
+    feature_store.WriteKeypoints(1, FeatureKeypoints(5));
+    feature_store.WriteKeypoints(1, FeatureKeypoints(10));
+    feature_store.WriteDescriptors(1, descriptors);
+    feature_store.WriteMatches(1, 2, FeatureMatches(3));
+    feature_store.WriteMatches(1, 3, FeatureMatches(4));
+    feature_store.DeleteMatches(1, 3);
+  }
+
+  FeatureStore feature_store(test_dir);
+  EXPECT_EQ(feature_store.NumKeypointsRecords(), 2);
+  EXPECT_EQ(feature_store.NumKeypointsForImage(1), 10);
+  EXPECT_EQ(feature_store.ReadDescriptorsView(1), descriptors);
+  EXPECT_EQ(feature_store.NumMatchesForImagePair(1, 2), 3);
+  EXPECT_FALSE(feature_store.ExistsMatches(1, 3));
+}
+
+TEST(FeatureStore, ReopenWithIncompleteRecords) {
+  const std::string test_dir = CreateTestDir();
+  const FeatureDescriptors descriptors1 = FeatureDescriptors::Random(10, 128);
+  const FeatureDescriptors descriptors2 = FeatureDescriptors::Random(20, 128);
+  const FeatureDescriptors descriptors3 = FeatureDescriptors::Random(30, 128);
+  {
+    FeatureStore feature_store(test_dir);
+    feature_store.WriteDescriptors(1, descriptors1);
+    feature_store.WriteDescriptors(2, descriptors2);
+  }
+
+  // Simulate an interrupted write of the data and index of another entry.
+  const std::string data_path = JoinPaths(test_dir, "descriptors.data");
+  const std::string index_path = JoinPaths(test_dir, "descriptors.index");
+  const size_t data_size = GetFileSize(data_path);
+  const size_t index_size = GetFileSize(index_path);
+  {
+    std::ofstream data_file(data_path, std::ios::binary | std::ios::app);
+    data_file << std::string(1000, 'x');
+    std::ofstream index_file(index_path, std::ios::binary | std::ios::app);
+    index_file << std::string(10, 'x');
+  }
+
+  {
+    FeatureStore feature_store(test_dir);
+    EXPECT_EQ(GetFileSize(data_path), data_size);
+    EXPECT_EQ(GetFileSize(index_path), index_size);
+    EXPECT_EQ(feature_store.ReadDescriptors(1), descriptors1);
+    EXPECT_EQ(feature_store.ReadDescriptors(2), descriptors2);
+    feature_store.WriteDescriptors(3, descriptors3);
+  }
+
+  FeatureStore feature_store(test_dir);
+  EXPECT_EQ(feature_store.DescriptorsImageIds().size(), 3);
+  EXPECT_EQ(feature_store.ReadDescriptors(1), descriptors1);
+  EXPECT_EQ(feature_store.ReadDescriptors(2), descriptors2);
+  EXPECT_EQ(feature_store.ReadDescriptors(3), descriptors3);
+}
+
+TEST(FeatureStore, InterleavedWritesAndReads) {
+  FeatureStore feature_store(CreateTestDir());
+  std::vector<FeatureDescriptors> descriptors;
+  std::vector<FeatureStore::DescriptorsView> descriptors_views;
+  for (int i = 0; i < 100; ++i) {
+    descriptors.push_back(FeatureDescriptors::Random(100, 128));
+    feature_store.WriteDescriptors(i, descriptors.back());
+    descriptors_views.push_back(feature_store.ReadDescriptorsView(i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(descriptors_views[i], descriptors[i]);
+  }
+}
+
+TEST(FeatureStore, ExportImport) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1, 1, 1);
+  camera.camera_id = database.WriteCamera(camera);
+  Image image;
+  image.SetCameraId(camera.camera_id);
+  image.SetName("test1");
+  const image_t image_id1 = database.WriteImage(image);
+  image.SetName("test2");
+  const image_t image_id2 = database.WriteImage(image);
+
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  database.WriteKeypoints(image_id1, FeatureKeypoints(10));
+  database.WriteDescriptors(image_id1, descriptors);
+  database.WriteMatches(image_id1, image_id2, FeatureMatches(5));
+
+  FeatureStore feature_store(CreateTestDir());
+  ExportFeaturesToFeatureStore(database, &feature_store);
+  EXPECT_EQ(feature_store.NumKeypointsForImage(image_id1), 10);
+  EXPECT_FALSE(feature_store.ExistsKeypoints(image_id2));
+  EXPECT_EQ(feature_store.ReadDescriptors(image_id1), descriptors);
+  EXPECT_EQ(feature_store.NumMatchesForImagePair(image_id1, image_id2), 5);
+
+  feature_store.WriteKeypoints(image_id2, FeatureKeypoints(20));
+  feature_store.WriteDescriptors(image_id2,
+                                 FeatureDescriptors::Random(20, 128));
+  ImportFeaturesFromFeatureStore(feature_store, &database);
+  EXPECT_EQ(database.NumKeypointsForImage(image_id1), 10);
+  EXPECT_EQ(database.NumKeypointsForImage(image_id2), 20);
+  EXPECT_EQ(database.ReadDescriptors(image_id2),
+            feature_store.ReadDescriptors(image_id2));
+  EXPECT_EQ(database.NumMatches(), 5);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,161 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/point3d_map.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+
+namespace colmap {
+
+const size_t Point3DMap::kChunkSize;
+const size_t Point3DMap::kMaxDenseIdFactor;
+const size_t Point3DMap::kMinDenseIds;
+const uint32_t Point3DMap::kInvalidSlot;
+
+Point3DMap::Point3DMap(const Point3DMap& other) {
+  reserve(other.size());
+  for (const auto& point3D : other) {
+    emplace(point3D.first, point3D.second);
+  }
+}
+
+Point3DMap::Point3DMap(Point3DMap&& other) noexcept { swap(other); }
+
+Point3DMap& Point3DMap::operator=(Point3DMap other) noexcept {
+  swap(other);
+  return *this;
+}
+
+Point3DMap::~Point3DMap() { clear(); }
+
+void Point3DMap::clear() {
+  for (size_t slot = 0; slot < occupied_.size(); ++slot) {
+    if (occupied_[slot]) {
+      SlotValue(slot).~value_type();
+    }
+  }
+  chunks_.clear();
+  occupied_.clear();
+  free_slots_.clear();
+  dense_slots_.clear();
+  sparse_slots_.clear();
+  size_ = 0;
+}
+
+void Point3DMap::reserve(const size_t num_points3D) {
+  THROW_CHECK_LT(num_points3D, kInvalidSlot);
+  const size_t num_chunks = (num_points3D + kChunkSize - 1) / kChunkSize;
+  while (chunks_.size() < num_chunks) {
+    chunks_.emplace_back(new SlotStorage[kChunkSize]);
+  }
+  occupied_.reserve(num_points3D);
+}
+
+size_t Point3DMap::erase(const point3D_t point3D_id) {
+  const uint32_t slot = FindSlot(point3D_id);
+  if (slot == kInvalidSlot) {
+    return 0;
+  }
+
+  if (point3D_id < dense_slots_.size()) {
+    dense_slots_[point3D_id] = kInvalidSlot;
+  } else {
+    sparse_slots_.erase(point3D_id);
+  }
+
+  SlotValue(slot).~value_type();
+  occupied_[slot] = 0;
+  free_slots_.push_back(slot);
+  size_ -= 1;
+
+  return 1;
+}
+
+Point3DMap::iterator Point3DMap::erase(const const_iterator pos) {
+  const size_t next_slot = NextOccupiedSlot(pos.slot_ + 1);
+  erase(pos->first);
+  return iterator(this, next_slot);
+}
+
+void Point3DMap::swap(Point3DMap& other) noexcept {
+  chunks_.swap(other.chunks_);
+  occupied_.swap(other.occupied_);
+  free_slots_.swap(other.free_slots_);
+  dense_slots_.swap(other.dense_slots_);
+  sparse_slots_.swap(other.sparse_slots_);
+  std::swap(size_, other.size_);
+}
+
+uint32_t Point3DMap::AllocateSlot() {
+  if (!free_slots_.empty()) {
+    const uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+
+  const size_t slot = occupied_.size();
+  THROW_CHECK_LT(slot, kInvalidSlot);
+  if (slot / kChunkSize >= chunks_.size()) {
+    chunks_.emplace_back(new SlotStorage[kChunkSize]);
+  }
+  occupied_.push_back(0);
+
+  return static_cast<uint32_t>(slot);
+}
+
+void Point3DMap::IndexSlot(const point3D_t point3D_id, const uint32_t slot) {
+  if (point3D_id < dense_slots_.size()) {
+    dense_slots_[point3D_id] = slot;
+    return;
+  }
+
+  const size_t max_num_dense_ids =
+      std::max(kMinDenseIds, kMaxDenseIdFactor * (size_ + 1));
+  if (point3D_id >= max_num_dense_ids) {
+    sparse_slots_.emplace(point3D_id, slot);
+    return;
+  }
+
+  dense_slots_.resize(point3D_id + 1, kInvalidSlot);
+  dense_slots_[point3D_id] = slot;
+
+  // Move sparse identifiers now covered by the dense table.
+  for (auto it = sparse_slots_.begin(); it != sparse_slots_.end();) {
+    if (it->first < dense_slots_.size()) {
+      dense_slots_[it->first] = it->second;
+      it = sparse_slots_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,315 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/scene/point3d.h"
+#include "colmap/util/types.h"
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+
+// Container mapping 3D point identifiers to 3D points with the interface of
+// an std::unordered_map<point3D_t, Point3D>. Points are stored in large
+// contiguous chunks of slots instead of individually allocated hash nodes, and
+// slots of deleted points are recycled through a free list. Identifiers are
+// resolved through a dense id-to-slot table, since reconstructions generate
+// consecutive identifiers, with a hash map fallback for very sparse ids.
+//
+// Like std::unordered_map, references to stored points remain valid when
+// other points are inserted or erased. Iteration is in slot order, which
+// matches insertion order as long as no points were erased.
+class Point3DMap {
+ public:
+  template <bool kConst>
+  class IteratorBase;
+
+  typedef point3D_t key_type;
+  typedef struct Point3D mapped_type;
+  typedef std::pair<const point3D_t, struct Point3D> value_type;
+  typedef size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+  typedef IteratorBase<false> iterator;
+  typedef IteratorBase<true> const_iterator;
+
+  Point3DMap() = default;
+  Point3DMap(const Point3DMap& other);
+  Point3DMap(Point3DMap&& other) noexcept;
+  Point3DMap& operator=(Point3DMap other) noexcept;
+  ~Point3DMap();
+
+  inline size_t size() const;
+  inline bool empty() const;
+
+  // Remove all points and release the underlying storage.
+  void clear();
+
+  // Preallocate storage for the given number of points.
+  void reserve(size_t num_points3D);
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+  inline const_iterator cbegin() const;
+  inline const_iterator cend() const;
+
+  inline iterator find(point3D_t point3D_id);
+  inline const_iterator find(point3D_t point3D_id) const;
+  inline size_t count(point3D_t point3D_id) const;
+
+  // Throws std::out_of_range if the point does not exist.
+  inline struct Point3D& at(point3D_t point3D_id);
+  inline const struct Point3D& at(point3D_t point3D_id) const;
+
+  // Default constructs the point if it does not exist.
+  inline struct Point3D& operator[](point3D_t point3D_id);
+
+  // Construct a new point in place. Returns the existing point and false, if
+  // a point with the same identifier already exists.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(point3D_t point3D_id, Args&&... args);
+
+  size_t erase(point3D_t point3D_id);
+  iterator erase(const_iterator pos);
+
+  void swap(Point3DMap& other) noexcept;
+
+  template <bool kConst>
+  class IteratorBase {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Point3DMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<kConst,
+                                      const Point3DMap::value_type*,
+                                      Point3DMap::value_type*>::type pointer;
+    typedef typename std::conditional<kConst,
+                                      const Point3DMap::value_type&,
+                                      Point3DMap::value_type&>::type reference;
+
+    IteratorBase() = default;
+
+    // Allow implicit conversion from mutable to const iterators.
+    template <bool kOtherConst,
+              typename = typename std::enable_if<kConst && !kOtherConst>::type>
+    IteratorBase(const IteratorBase<kOtherConst>& other)
+        : map_(other.map_), slot_(other.slot_) {}
+
+    reference operator*() const { return map_->SlotValue(slot_); }
+    pointer operator->() const { return &map_->SlotValue(slot_); }
+
+    IteratorBase& operator++() {
+      slot_ = map_->NextOccupiedSlot(slot_ + 1);
+      return *this;
+    }
+
+    IteratorBase operator++(int) {
+      IteratorBase prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+    friend bool operator==(const IteratorBase& lhs, const IteratorBase& rhs) {
+      return lhs.slot_ == rhs.slot_;
+    }
+
+    friend bool operator!=(const IteratorBase& lhs, const IteratorBase& rhs) {
+      return lhs.slot_ != rhs.slot_;
+    }
+
+   private:
+    friend class Point3DMap;
+    friend class IteratorBase<!kConst>;
+
+    typedef typename std::
+        conditional<kConst, const Point3DMap*, Point3DMap*>::type MapPointer;
+
+    IteratorBase(MapPointer map, size_t slot) : map_(map), slot_(slot) {}
+
+    MapPointer map_ = nullptr;
+    size_t slot_ = 0;
+  };
+
+ private:
+  // Number of slots per contiguously allocated chunk.
+  static const size_t kChunkSize = 4096;
+  // Identifiers are indexed densely as long as the largest identifier is
+  // at most this factor larger than the number of stored points.
+  static const size_t kMaxDenseIdFactor = 8;
+  static const size_t kMinDenseIds = kChunkSize;
+  static const uint32_t kInvalidSlot = std::numeric_limits<uint32_t>::max();
+
+  typedef typename std::aligned_storage<sizeof(value_type),
+                                        alignof(value_type)>::type SlotStorage;
+
+  inline value_type& SlotValue(size_t slot);
+  inline const value_type& SlotValue(size_t slot) const;
+  inline size_t NextOccupiedSlot(size_t slot) const;
+  inline uint32_t FindSlot(point3D_t point3D_id) const;
+
+  uint32_t AllocateSlot();
+  void IndexSlot(point3D_t point3D_id, uint32_t slot);
+
+  // Chunks of raw storage for the slots, never moved after allocation.
+  std::vector<std::unique_ptr<SlotStorage[]>> chunks_;
+  // Whether the slot at the given index holds a live point.
+  std::vector<uint8_t> occupied_;
+  // Indices of unoccupied slots below occupied_.size().
+  std::vector<uint32_t> free_slots_;
+  // Slot of each point indexed by its identifier.
+  std::vector<uint32_t> dense_slots_;
+  // Slot of points with identifiers beyond dense_slots_.size().
+  std::unordered_map<point3D_t, uint32_t> sparse_slots_;
+  size_t size_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+size_t Point3DMap::size() const { return size_; }
+
+bool Point3DMap::empty() const { return size_ == 0; }
+
+Point3DMap::iterator Point3DMap::begin() {
+  return iterator(this, NextOccupiedSlot(0));
+}
+
+Point3DMap::iterator Point3DMap::end() {
+  return iterator(this, occupied_.size());
+}
+
+Point3DMap::const_iterator Point3DMap::begin() const {
+  return const_iterator(this, NextOccupiedSlot(0));
+}
+
+Point3DMap::const_iterator Point3DMap::end() const {
+  return const_iterator(this, occupied_.size());
+}
+
+Point3DMap::const_iterator Point3DMap::cbegin() const { return begin(); }
+
+Point3DMap::const_iterator Point3DMap::cend() const { return end(); }
+
+Point3DMap::iterator Point3DMap::find(const point3D_t point3D_id) {
+  const uint32_t slot = FindSlot(point3D_id);
+  return slot == kInvalidSlot ? end() : iterator(this, slot);
+}
+
+Point3DMap::const_iterator Point3DMap::find(const point3D_t point3D_id) const {
+  const uint32_t slot = FindSlot(point3D_id);
+  return slot == kInvalidSlot ? end() : const_iterator(this, slot);
+}
+
+size_t Point3DMap::count(const point3D_t point3D_id) const {
+  return FindSlot(point3D_id) == kInvalidSlot ? 0 : 1;
+}
+
+struct Point3D& Point3DMap::at(const point3D_t point3D_id) {
+  const uint32_t slot = FindSlot(point3D_id);
+  if (slot == kInvalidSlot) {
+    throw std::out_of_range("Point3DMap::at");
+  }
+  return SlotValue(slot).second;
+}
+
+const struct Point3D& Point3DMap::at(const point3D_t point3D_id) const {
+  const uint32_t slot = FindSlot(point3D_id);
+  if (slot == kInvalidSlot) {
+    throw std::out_of_range("Point3DMap::at");
+  }
+  return SlotValue(slot).second;
+}
+
+struct Point3D& Point3DMap::operator[](const point3D_t point3D_id) {
+  return emplace(point3D_id).first->second;
+}
+
+template <typename... Args>
+std::pair<Point3DMap::iterator, bool> Point3DMap::emplace(
+    const point3D_t point3D_id, Args&&... args) {
+  const uint32_t existing_slot = FindSlot(point3D_id);
+  if (existing_slot != kInvalidSlot) {
+    return std::make_pair(iterator(this, existing_slot), false);
+  }
+
+  const uint32_t slot = AllocateSlot();
+  new (&chunks_[slot / kChunkSize][slot % kChunkSize])
+      value_type(std::piecewise_construct,
+                 std::forward_as_tuple(point3D_id),
+                 std::forward_as_tuple(std::forward<Args>(args)...));
+  occupied_[slot] = 1;
+  IndexSlot(point3D_id, slot);
+  size_ += 1;
+
+  return std::make_pair(iterator(this, slot), true);
+}
+
+Point3DMap::value_type& Point3DMap::SlotValue(const size_t slot) {
+  return *reinterpret_cast<value_type*>(
+      &chunks_[slot / kChunkSize][slot % kChunkSize]);
+}
+
+const Point3DMap::value_type& Point3DMap::SlotValue(const size_t slot) const {
+  return *reinterpret_cast<const value_type*>(
+      &chunks_[slot / kChunkSize][slot % kChunkSize]);
+}
+
+size_t Point3DMap::NextOccupiedSlot(size_t slot) const {
+  while (slot < occupied_.size() && !occupied_[slot]) {
+    ++slot;
+  }
+  return slot;
+}
+
+uint32_t Point3DMap::FindSlot(const point3D_t point3D_id) const {
+  if (point3D_id < dense_slots_.size()) {
+    return dense_slots_[point3D_id];
+  }
+  if (sparse_slots_.empty()) {
+    return kInvalidSlot;
+  }
+  const auto it = sparse_slots_.find(point3D_id);
+  return it == sparse_slots_.end() ? kInvalidSlot : it->second;
+}
+
+}  // namespace colmap
@@ -0,0 +1,160 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/point3d_map.h"
+
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+Point3D CreatePoint3D(const double x) {
+  Point3D point3D;
+  point3D.xyz = Eigen::Vector3d(x, 0, 0);
+  point3D.track.AddElement(1, 2);
+  return point3D;
+}
+
+TEST(Point3DMap, Empty) {
+  Point3DMap points3D;
+  EXPECT_TRUE(points3D.empty());
+  EXPECT_EQ(points3D.size(), 0);
+  EXPECT_EQ(points3D.begin(), points3D.end());
+  EXPECT_EQ(points3D.count(1), 0);
+  EXPECT_EQ(points3D.find(1), points3D.end());
+  EXPECT_THROW(points3D.at(1), std::out_of_range);
+  EXPECT_EQ(points3D.erase(1), 0);
+}
+
+TEST(Point3DMap, EmplaceFindErase) {
+  Point3DMap points3D;
+  EXPECT_TRUE(points3D.emplace(1, CreatePoint3D(1)).second);
+  EXPECT_TRUE(points3D.emplace(2, CreatePoint3D(2)).second);
+  const auto existing = points3D.emplace(1, CreatePoint3D(3));
+  EXPECT_FALSE(existing.second);
+  EXPECT_EQ(existing.first->first, 1);
+  EXPECT_EQ(existing.first->second.xyz(0), 1);
+  EXPECT_EQ(points3D.size(), 2);
+  EXPECT_EQ(points3D.count(1), 1);
+  EXPECT_EQ(points3D.count(3), 0);
+  EXPECT_EQ(points3D.at(2).xyz(0), 2);
+  EXPECT_EQ(points3D.at(2).track.Length(), 1);
+  EXPECT_EQ(points3D[3].track.Length(), 0);
+  EXPECT_EQ(points3D.size(), 3);
+  EXPECT_EQ(points3D.erase(2), 1);
+  EXPECT_EQ(points3D.erase(2), 0);
+  EXPECT_EQ(points3D.size(), 2);
+  EXPECT_EQ(points3D.find(2), points3D.end());
+  const auto next = points3D.erase(points3D.find(1));
+  ASSERT_NE(next, points3D.end());
+  EXPECT_EQ(next->first, 3);
+  EXPECT_EQ(points3D.size(), 1);
+  points3D.clear();
+  EXPECT_TRUE(points3D.empty());
+  EXPECT_EQ(points3D.begin(), points3D.end());
+}
+
+TEST(Point3DMap, IterationAndReferenceStability) {
+  Point3DMap points3D;
+  const size_t kNumPoints3D = 10000;
+  for (size_t i = 1; i <= kNumPoints3D; ++i) {
+    points3D.emplace(i, CreatePoint3D(i));
+  }
+  const Point3D* point3D_ptr = &points3D.at(kNumPoints3D / 2);
+
+  for (size_t i = 1; i <= kNumPoints3D; i += 2) {
+    EXPECT_EQ(points3D.erase(i), 1);
+  }
+  for (size_t i = 1; i <= kNumPoints3D; i += 2) {
+    points3D.emplace(kNumPoints3D + i, CreatePoint3D(kNumPoints3D + i));
+  }
+  EXPECT_EQ(points3D.size(), kNumPoints3D);
+  EXPECT_EQ(&points3D.at(kNumPoints3D / 2), point3D_ptr);
+
+  size_t num_points3D = 0;
+  for (const auto& point3D : points3D) {
+    EXPECT_EQ(point3D.second.xyz(0), point3D.first);
+    EXPECT_EQ(points3D.count(point3D.first), 1);
+    num_points3D += 1;
+  }
+  EXPECT_EQ(num_points3D, kNumPoints3D);
+
+  for (auto& point3D : points3D) {
+    point3D.second.error = 1;
+  }
+  for (const auto& point3D : points3D) {
+    EXPECT_TRUE(point3D.second.HasError());
+  }
+}
+
+TEST(Point3DMap, SparseIds) {
+  Point3DMap points3D;
+  const point3D_t kLargeId = std::numeric_limits<point3D_t>::max() - 1;
+  points3D.emplace(kLargeId, CreatePoint3D(1));
+  points3D.emplace(100000, CreatePoint3D(2));
+  EXPECT_EQ(points3D.size(), 2);
+  EXPECT_EQ(points3D.at(kLargeId).xyz(0), 1);
+  EXPECT_EQ(points3D.at(100000).xyz(0), 2);
+  for (size_t i = 1; i <= 20000; ++i) {
+    points3D.emplace(i, CreatePoint3D(i));
+  }
+  EXPECT_EQ(points3D.size(), 20002);
+  EXPECT_EQ(points3D.at(100000).xyz(0), 2);
+  points3D.emplace(150000, CreatePoint3D(3));
+  EXPECT_EQ(points3D.at(100000).xyz(0), 2);
+  EXPECT_EQ(points3D.at(150000).xyz(0), 3);
+  EXPECT_EQ(points3D.at(kLargeId).xyz(0), 1);
+  EXPECT_EQ(points3D.erase(kLargeId), 1);
+  EXPECT_EQ(points3D.count(kLargeId), 0);
+}
+
+TEST(Point3DMap, CopyAndMove) {
+  Point3DMap points3D;
+  points3D.emplace(1, CreatePoint3D(1));
+  points3D.emplace(2, CreatePoint3D(2));
+  points3D.erase(1);
+
+  Point3DMap copied_points3D = points3D;
+  EXPECT_EQ(copied_points3D.size(), 1);
+  EXPECT_EQ(copied_points3D.at(2).xyz(0), 2);
+  copied_points3D.at(2).xyz(0) = 3;
+  EXPECT_EQ(points3D.at(2).xyz(0), 2);
+
+  Point3DMap moved_points3D = std::move(copied_points3D);
+  EXPECT_EQ(moved_points3D.size(), 1);
+  EXPECT_EQ(moved_points3D.at(2).xyz(0), 3);
+
+  moved_points3D = points3D;
+  EXPECT_EQ(moved_points3D.at(2).xyz(0), 2);
+}
+
+}  // namespace
+}  // namespace colmap
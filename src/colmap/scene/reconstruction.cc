@@ -307,6 +307,7 @@ void Reconstruction::RegisterImage(const image_t image_id) {
   if (!image.IsRegistered()) {
     image.SetRegistered(true);
     reg_image_ids_.push_back(image_id);
+    changed_image_ids_.insert(image_id);
   }
 }
 
@@ -325,6 +326,14 @@ void Reconstruction::DeRegisterImage(const image_t image_id) {
   reg_image_ids_.erase(
       std::remove(reg_image_ids_.begin(), reg_image_ids_.end(), image_id),
       reg_image_ids_.end());
+
+  changed_image_ids_.insert(image_id);
+}
+
+std::unordered_set<image_t> Reconstruction::PopChangedImageIds() {
+  std::unordered_set<image_t> changed_image_ids;
+  changed_image_ids.swap(changed_image_ids_);
+  return changed_image_ids;
 }
 
 void Reconstruction::Normalize(const double extent,
@@ -535,11 +544,13 @@ size_t Reconstruction::FilterPoints3D(
     const double max_reproj_error,
     const double min_tri_angle,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  const std::vector<point3D_t> point3D_ids_vec(point3D_ids.begin(),
+                                               point3D_ids.end());
   size_t num_filtered = 0;
+  num_filtered += FilterPoints3DWithLargeReprojectionError(max_reproj_error,
+                                                           point3D_ids_vec);
   num_filtered +=
-      FilterPoints3DWithLargeReprojectionError(max_reproj_error, point3D_ids);
-  num_filtered +=
-      FilterPoints3DWithSmallTriangulationAngle(min_tri_angle, point3D_ids);
+      FilterPoints3DWithSmallTriangulationAngle(min_tri_angle, point3D_ids_vec);
   return num_filtered;
 }
 
@@ -564,7 +575,13 @@ size_t Reconstruction::FilterAllPoints3D(const double max_reproj_error,
   // Important: First filter observations and points with large reprojection
   // error, so that observations with large reprojection error do not make
   // a point stable through a large triangulation angle.
-  const std::unordered_set<point3D_t>& point3D_ids = Point3DIds();
+  // Visit the points in storage order, which is considerably faster than
+  // going through a hash set of all point identifiers.
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(points3D_.size());
+  for (const auto& point3D : points3D_) {
+    point3D_ids.push_back(point3D.first);
+  }
   size_t num_filtered = 0;
   num_filtered +=
       FilterPoints3DWithLargeReprojectionError(max_reproj_error, point3D_ids);
@@ -870,7 +887,7 @@ void Reconstruction::CreateImageDirs(const std::string& path) const {
 
 size_t Reconstruction::FilterPoints3DWithSmallTriangulationAngle(
     const double min_tri_angle,
-    const std::unordered_set<point3D_t>& point3D_ids) {
+    const std::vector<point3D_t>& point3D_ids) {
   // Number of filtered points.
   size_t num_filtered = 0;
 
@@ -932,12 +949,15 @@ size_t Reconstruction::FilterPoints3DWithSmallTriangulationAngle(
 
 size_t Reconstruction::FilterPoints3DWithLargeReprojectionError(
     const double max_reproj_error,
-    const std::unordered_set<point3D_t>& point3D_ids) {
+    const std::vector<point3D_t>& point3D_ids) {
   const double max_squared_reproj_error = max_reproj_error * max_reproj_error;
 
   // Number of filtered points.
   size_t num_filtered = 0;
 
+  // Reused across points to avoid reallocations.
+  std::vector<TrackElement> track_els_to_delete;
+
   for (const auto point3D_id : point3D_ids) {
     if (!ExistsPoint3D(point3D_id)) {
       continue;
@@ -953,7 +973,7 @@ size_t Reconstruction::FilterPoints3DWithLargeReprojectionError(
 
     double reproj_error_sum = 0.0;
 
-    std::vector<TrackElement> track_els_to_delete;
+    track_els_to_delete.clear();
 
     for (const auto& track_el : point3D.track.Elements()) {
       const class Image& image = Image(track_el.image_id);
@@ -1003,6 +1023,9 @@ void Reconstruction::SetObservationAsTriangulated(
     class Image& corr_image = Image(corr->image_id);
     const Point2D& corr_point2D = corr_image.Point2D(corr->point2D_idx);
     corr_image.IncrementCorrespondenceHasPoint3D(corr->point2D_idx);
+    if (!corr_image.IsRegistered()) {
+      changed_image_ids_.insert(corr->image_id);
+    }
     // Update number of shared 3D points between image pairs and make sure to
     // only count the correspondences once (not twice forward and backward).
     if (point2D.point3D_id == corr_point2D.point3D_id &&
@@ -1036,6 +1059,9 @@ void Reconstruction::ResetTriObservations(const image_t image_id,
     class Image& corr_image = Image(corr->image_id);
     const Point2D& corr_point2D = corr_image.Point2D(corr->point2D_idx);
     corr_image.DecrementCorrespondenceHasPoint3D(corr->point2D_idx);
+    if (!corr_image.IsRegistered()) {
+      changed_image_ids_.insert(corr->image_id);
+    }
     // Update number of shared 3D points between image pairs and make sure to
     // only count the correspondences once (not twice forward and backward).
     if (point2D.point3D_id == corr_point2D.point3D_id &&
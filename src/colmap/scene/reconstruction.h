@@ -35,6 +35,7 @@
 #include "colmap/scene/image.h"
 #include "colmap/scene/point2d.h"
 #include "colmap/scene/point3d.h"
+#include "colmap/scene/point3d_map.h"
 #include "colmap/scene/track.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
@@ -94,7 +95,7 @@ class Reconstruction {
   inline const std::unordered_map<camera_t, struct Camera>& Cameras() const;
   inline const std::unordered_map<image_t, class Image>& Images() const;
   inline const std::vector<image_t>& RegImageIds() const;
-  inline const std::unordered_map<point3D_t, struct Point3D>& Points3D() const;
+  inline const Point3DMap& Points3D() const;
   inline const std::unordered_map<image_pair_t, ImagePairStat>& ImagePairs()
       const;
 
@@ -166,6 +167,12 @@ class Reconstruction {
   // Check if image is registered.
   inline bool IsImageRegistered(image_t image_id) const;
 
+  // Return and reset the images whose registration status or number of
+  // visible 3D points changed since the last call. Only visibility changes of
+  // unregistered images are tracked. This allows to incrementally update
+  // state derived from these quantities, e.g., the next image candidates.
+  std::unordered_set<image_t> PopChangedImageIds();
+
   // Normalize scene by scaling and translation to avoid degenerate
   // visualization after bundle adjustment and to improve numerical
   // stability of algorithms.
@@ -290,10 +297,9 @@ class Reconstruction {
 
  private:
   size_t FilterPoints3DWithSmallTriangulationAngle(
-      double min_tri_angle, const std::unordered_set<point3D_t>& point3D_ids);
+      double min_tri_angle, const std::vector<point3D_t>& point3D_ids);
   size_t FilterPoints3DWithLargeReprojectionError(
-      double max_reproj_error,
-      const std::unordered_set<point3D_t>& point3D_ids);
+      double max_reproj_error, const std::vector<point3D_t>& point3D_ids);
 
   std::tuple<Eigen::Vector3d, Eigen::Vector3d, Eigen::Vector3d>
   ComputeBoundsAndCentroid(double p0, double p1, bool use_images) const;
@@ -309,13 +315,16 @@ class Reconstruction {
 
   std::unordered_map<camera_t, struct Camera> cameras_;
   std::unordered_map<image_t, class Image> images_;
-  std::unordered_map<point3D_t, struct Point3D> points3D_;
+  Point3DMap points3D_;
 
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
 
   // { image_id, ... } where `images_.at(image_id).registered == true`.
   std::vector<image_t> reg_image_ids_;
 
+  // Images with changed registration or visibility, see `PopChangedImageIds`.
+  std::unordered_set<image_t> changed_image_ids_;
+
   // Total number of added 3D points, used to generate unique identifiers.
   point3D_t max_point3D_id_;
 };
@@ -395,7 +404,7 @@ const std::vector<image_t>& Reconstruction::RegImageIds() const {
   return reg_image_ids_;
 }
 
-const std::unordered_map<point3D_t, Point3D>& Reconstruction::Points3D() const {
+const Point3DMap& Reconstruction::Points3D() const {
   return points3D_;
 }
 
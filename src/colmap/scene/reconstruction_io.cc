@@ -360,13 +360,15 @@ void ReadPoints3DBinary(Reconstruction& reconstruction,
     point3D.color(2) = ReadBinaryLittleEndian<uint8_t>(&file);
     point3D.error = ReadBinaryLittleEndian<double>(&file);
 
+    // Allocate the exact track length up front instead of growing and
+    // compressing the track afterwards.
     const size_t track_length = ReadBinaryLittleEndian<uint64_t>(&file);
+    point3D.track.Reserve(track_length);
     for (size_t j = 0; j < track_length; ++j) {
       const image_t image_id = ReadBinaryLittleEndian<image_t>(&file);
       const point2D_t point2D_idx = ReadBinaryLittleEndian<point2D_t>(&file);
       point3D.track.AddElement(image_id, point2D_idx);
     }
-    point3D.track.Compress();
 
     reconstruction.AddPoint3D(point3D_id, std::move(point3D));
   }
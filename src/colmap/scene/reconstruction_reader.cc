@@ -0,0 +1,264 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/reconstruction_reader.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#include <cstring>
+#include <future>
+
+namespace colmap {
+namespace {
+
+// Size of the fixed-size part of a record in points3D.bin, i.e., identifier,
+// position, color, error, and track length.
+constexpr size_t kPoint3DHeaderNumBytes =
+    sizeof(point3D_t) + 3 * sizeof(double) + 3 * sizeof(uint8_t) +
+    sizeof(double) + sizeof(uint64_t);
+constexpr size_t kTrackElementNumBytes = sizeof(image_t) + sizeof(point2D_t);
+constexpr size_t kPoint2DNumBytes = 2 * sizeof(double) + sizeof(point3D_t);
+
+template <typename T>
+T DecodeLittleEndian(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return LittleEndianToNative(value);
+}
+
+// Bounds-checked sequential decoding of a mapped binary file.
+class BinaryCursor {
+ public:
+  explicit BinaryCursor(const MappedFile& file)
+      : pos_(file.Data()), end_(file.Data() + file.NumBytes()) {}
+  BinaryCursor(const MappedFile& file, const char* pos)
+      : pos_(pos), end_(file.Data() + file.NumBytes()) {}
+
+  template <typename T>
+  T Read() {
+    return DecodeLittleEndian<T>(Skip(sizeof(T)));
+  }
+
+  // Advance the cursor and return the position before advancing.
+  const char* Skip(const size_t num_bytes) {
+    THROW_CHECK_LE(num_bytes, static_cast<size_t>(end_ - pos_))
+        << "Unexpected end of file";
+    const char* pos = pos_;
+    pos_ += num_bytes;
+    return pos;
+  }
+
+  const char* Position() const { return pos_; }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+size_t ReadNumRecords(const MappedFile& file) {
+  BinaryCursor cursor(file);
+  return cursor.Read<uint64_t>();
+}
+
+void ParsePoint3D(BinaryCursor* cursor, Point3DBinaryView* point3D) {
+  point3D->point3D_id = cursor->Read<point3D_t>();
+  point3D->xyz(0) = cursor->Read<double>();
+  point3D->xyz(1) = cursor->Read<double>();
+  point3D->xyz(2) = cursor->Read<double>();
+  point3D->color(0) = cursor->Read<uint8_t>();
+  point3D->color(1) = cursor->Read<uint8_t>();
+  point3D->color(2) = cursor->Read<uint8_t>();
+  point3D->error = cursor->Read<double>();
+  point3D->track_length = cursor->Read<uint64_t>();
+  point3D->track_data =
+      cursor->Skip(point3D->track_length * kTrackElementNumBytes);
+}
+
+}  // namespace
+
+Eigen::Vector2d ImageBinaryView::Point2D(const size_t idx) const {
+  THROW_CHECK_LT(idx, num_points2D);
+  const char* data = points2D_data + idx * kPoint2DNumBytes;
+  return Eigen::Vector2d(DecodeLittleEndian<double>(data),
+                         DecodeLittleEndian<double>(data + sizeof(double)));
+}
+
+point3D_t ImageBinaryView::Point3DId(const size_t idx) const {
+  THROW_CHECK_LT(idx, num_points2D);
+  return DecodeLittleEndian<point3D_t>(points2D_data + idx * kPoint2DNumBytes +
+                                       2 * sizeof(double));
+}
+
+TrackElement Point3DBinaryView::Element(const size_t idx) const {
+  THROW_CHECK_LT(idx, track_length);
+  const char* data = track_data + idx * kTrackElementNumBytes;
+  return TrackElement(DecodeLittleEndian<image_t>(data),
+                      DecodeLittleEndian<point2D_t>(data + sizeof(image_t)));
+}
+
+BinaryReconstructionReader::BinaryReconstructionReader(const std::string& path)
+    : cameras_file_(new MappedFile(JoinPaths(path, "cameras.bin"))),
+      images_file_(new MappedFile(JoinPaths(path, "images.bin"))),
+      points3D_file_(new MappedFile(JoinPaths(path, "points3D.bin"))) {}
+
+BinaryReconstructionReader::~BinaryReconstructionReader() = default;
+
+size_t BinaryReconstructionReader::NumCameras() const {
+  return ReadNumRecords(*cameras_file_);
+}
+
+size_t BinaryReconstructionReader::NumImages() const {
+  return ReadNumRecords(*images_file_);
+}
+
+size_t BinaryReconstructionReader::NumPoints3D() const {
+  return ReadNumRecords(*points3D_file_);
+}
+
+void BinaryReconstructionReader::VisitCameras(
+    const std::function<void(const struct Camera&)>& visitor) const {
+  BinaryCursor cursor(*cameras_file_);
+  const size_t num_cameras = cursor.Read<uint64_t>();
+  struct Camera camera;
+  for (size_t i = 0; i < num_cameras; ++i) {
+    camera.camera_id = cursor.Read<camera_t>();
+    camera.model_id = static_cast<CameraModelId>(cursor.Read<int>());
+    camera.width = cursor.Read<uint64_t>();
+    camera.height = cursor.Read<uint64_t>();
+    camera.params.resize(CameraModelNumParams(camera.model_id));
+    for (double& param : camera.params) {
+      param = cursor.Read<double>();
+    }
+    THROW_CHECK(camera.VerifyParams());
+    visitor(camera);
+  }
+}
+
+void BinaryReconstructionReader::VisitImages(
+    const std::function<void(const ImageBinaryView&)>& visitor) const {
+  BinaryCursor cursor(*images_file_);
+  const size_t num_images = cursor.Read<uint64_t>();
+  ImageBinaryView image;
+  for (size_t i = 0; i < num_images; ++i) {
+    image.image_id = cursor.Read<image_t>();
+    Rigid3d& cam_from_world = image.cam_from_world;
+    cam_from_world.rotation.w() = cursor.Read<double>();
+    cam_from_world.rotation.x() = cursor.Read<double>();
+    cam_from_world.rotation.y() = cursor.Read<double>();
+    cam_from_world.rotation.z() = cursor.Read<double>();
+    cam_from_world.rotation.normalize();
+    cam_from_world.translation.x() = cursor.Read<double>();
+    cam_from_world.translation.y() = cursor.Read<double>();
+    cam_from_world.translation.z() = cursor.Read<double>();
+    image.camera_id = cursor.Read<camera_t>();
+
+    const char* name_begin = cursor.Position();
+    while (*cursor.Skip(1) != '\0') {
+    }
+    image.name.assign(name_begin, cursor.Position() - name_begin - 1);
+
+    image.num_points2D = cursor.Read<uint64_t>();
+    image.points2D_data = cursor.Skip(image.num_points2D * kPoint2DNumBytes);
+
+    visitor(image);
+  }
+}
+
+void BinaryReconstructionReader::VisitPoints3D(
+    const std::function<void(const Point3DBinaryView&)>& visitor) const {
+  BinaryCursor cursor(*points3D_file_);
+  const size_t num_points3D = cursor.Read<uint64_t>();
+  Point3DBinaryView point3D;
+  for (size_t i = 0; i < num_points3D; ++i) {
+    ParsePoint3D(&cursor, &point3D);
+    visitor(point3D);
+  }
+}
+
+void BinaryReconstructionReader::VisitPoints3DParallel(
+    const std::function<void(int, const Point3DBinaryView&)>& visitor,
+    const int num_threads) const {
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  if (num_eff_threads == 1) {
+    VisitPoints3D(
+        [&visitor](const Point3DBinaryView& point3D) { visitor(0, point3D); });
+    return;
+  }
+
+  // Locate the beginning of each chunk by skipping over the records.
+  BinaryCursor cursor(*points3D_file_);
+  const size_t num_points3D = cursor.Read<uint64_t>();
+  if (num_points3D == 0) {
+    return;
+  }
+
+  const size_t kNumChunksPerThread = 4;
+  const size_t num_chunks =
+      std::min(num_points3D, kNumChunksPerThread * num_eff_threads);
+  const size_t chunk_size = (num_points3D + num_chunks - 1) / num_chunks;
+
+  std::vector<const char*> chunk_begins;
+  chunk_begins.reserve(num_chunks);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    if (i % chunk_size == 0) {
+      chunk_begins.push_back(cursor.Position());
+    }
+    cursor.Skip(kPoint3DHeaderNumBytes - sizeof(uint64_t));
+    const size_t track_length = cursor.Read<uint64_t>();
+    cursor.Skip(track_length * kTrackElementNumBytes);
+  }
+
+  ThreadPool thread_pool(num_eff_threads);
+  std::vector<std::future<void>> futures;
+  futures.reserve(chunk_begins.size());
+  for (size_t chunk_idx = 0; chunk_idx < chunk_begins.size(); ++chunk_idx) {
+    futures.push_back(thread_pool.AddTask([&, chunk_idx]() {
+      const int thread_idx = thread_pool.GetThreadIndex();
+      BinaryCursor chunk_cursor(*points3D_file_, chunk_begins[chunk_idx]);
+      const size_t begin = chunk_idx * chunk_size;
+      const size_t end = std::min(num_points3D, begin + chunk_size);
+      Point3DBinaryView point3D;
+      for (size_t i = begin; i < end; ++i) {
+        ParsePoint3D(&chunk_cursor, &point3D);
+        visitor(thread_idx, point3D);
+      }
+    }));
+  }
+
+  // Propagate any parsing errors from the workers.
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+}  // namespace colmap
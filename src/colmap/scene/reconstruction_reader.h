@@ -0,0 +1,127 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/geometry/rigid3.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/track.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/types.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+class MappedFile;
+
+// View of an image record in images.bin. The 2D points are decoded on access
+// from the mapped file and the view is only valid during the visit.
+struct ImageBinaryView {
+  image_t image_id = kInvalidImageId;
+  Rigid3d cam_from_world;
+  camera_t camera_id = kInvalidCameraId;
+  std::string name;
+  size_t num_points2D = 0;
+
+  Eigen::Vector2d Point2D(size_t idx) const;
+  point3D_t Point3DId(size_t idx) const;
+
+  // Pointer to the encoded 2D points in the mapped file.
+  const char* points2D_data = nullptr;
+};
+
+// View of a point record in points3D.bin. The track elements are decoded on
+// access from the mapped file and the view is only valid during the visit.
+struct Point3DBinaryView {
+  point3D_t point3D_id = kInvalidPoint3DId;
+  Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+  Eigen::Vector3ub color = Eigen::Vector3ub::Zero();
+  double error = -1.;
+  size_t track_length = 0;
+
+  inline bool HasError() const { return error != -1.; }
+
+  TrackElement Element(size_t idx) const;
+
+  // Pointer to the encoded track elements in the mapped file.
+  const char* track_data = nullptr;
+};
+
+// Streaming reader for models in the binary format written by
+// `Reconstruction::WriteBinary`. The files are memory-mapped and parsed on the
+// fly during a visit, so that tools which only need a single pass over the
+// cameras, images, or points do not have to materialize a `Reconstruction`.
+//
+// Example usage:
+//
+//    BinaryReconstructionReader reader("sparse/0");
+//    size_t num_observations = 0;
+//    reader.VisitPoints3D([&](const Point3DBinaryView& point3D) {
+//      num_observations += point3D.track_length;
+//    });
+//
+class BinaryReconstructionReader {
+ public:
+  // Map the cameras.bin, images.bin, and points3D.bin files in the given
+  // directory.
+  explicit BinaryReconstructionReader(const std::string& path);
+  ~BinaryReconstructionReader();
+
+  size_t NumCameras() const;
+  size_t NumImages() const;
+  size_t NumPoints3D() const;
+
+  void VisitCameras(
+      const std::function<void(const struct Camera&)>& visitor) const;
+  void VisitImages(
+      const std::function<void(const ImageBinaryView&)>& visitor) const;
+  void VisitPoints3D(
+      const std::function<void(const Point3DBinaryView&)>& visitor) const;
+
+  // Parse points3D.bin in chunks on multiple threads. The visitor is called
+  // concurrently with the index of the calling thread in [0, num_threads) and
+  // the points are visited in no particular order. Since the records have
+  // variable size, the chunk boundaries are located by a quick scan over the
+  // track lengths before the actual parsing.
+  void VisitPoints3DParallel(
+      const std::function<void(int, const Point3DBinaryView&)>& visitor,
+      int num_threads = -1) const;
+
+ private:
+  std::unique_ptr<MappedFile> cameras_file_;
+  std::unique_ptr<MappedFile> images_file_;
+  std::unique_ptr<MappedFile> points3D_file_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,142 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/reconstruction_reader.h"
+
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <mutex>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+std::string WriteSyntheticReconstruction(Reconstruction* reconstruction) {
+  SyntheticDatasetOptions options;
+  options.num_points3D = 1000;
+  SynthesizeDataset(options, reconstruction);
+  const std::string path = CreateTestDir();
+  reconstruction->WriteBinary(path);
+  return path;
+}
+
+TEST(BinaryReconstructionReader, Cameras) {
+  Reconstruction reconstruction;
+  const std::string path = WriteSyntheticReconstruction(&reconstruction);
+  BinaryReconstructionReader reader(path);
+  EXPECT_EQ(reader.NumCameras(), reconstruction.NumCameras());
+  size_t num_cameras = 0;
+  reader.VisitCameras([&](const Camera& camera) {
+    const Camera& ref_camera = reconstruction.Camera(camera.camera_id);
+    EXPECT_EQ(camera.model_id, ref_camera.model_id);
+    EXPECT_EQ(camera.width, ref_camera.width);
+    EXPECT_EQ(camera.height, ref_camera.height);
+    EXPECT_EQ(camera.params, ref_camera.params);
+    num_cameras += 1;
+  });
+  EXPECT_EQ(num_cameras, reconstruction.NumCameras());
+}
+
+TEST(BinaryReconstructionReader, Images) {
+  Reconstruction reconstruction;
+  const std::string path = WriteSyntheticReconstruction(&reconstruction);
+  BinaryReconstructionReader reader(path);
+  EXPECT_EQ(reader.NumImages(), reconstruction.NumRegImages());
+  size_t num_images = 0;
+  reader.VisitImages([&](const ImageBinaryView& image) {
+    const Image& ref_image = reconstruction.Image(image.image_id);
+    EXPECT_EQ(image.name, ref_image.Name());
+    EXPECT_EQ(image.camera_id, ref_image.CameraId());
+    EXPECT_TRUE(image.cam_from_world.rotation.isApprox(
+        ref_image.CamFromWorld().rotation));
+    EXPECT_EQ(image.cam_from_world.translation,
+              ref_image.CamFromWorld().translation);
+    EXPECT_EQ(image.num_points2D, ref_image.NumPoints2D());
+    for (point2D_t idx = 0; idx < image.num_points2D; ++idx) {
+      EXPECT_EQ(image.Point2D(idx), ref_image.Point2D(idx).xy);
+      EXPECT_EQ(image.Point3DId(idx), ref_image.Point2D(idx).point3D_id);
+    }
+    num_images += 1;
+  });
+  EXPECT_EQ(num_images, reconstruction.NumRegImages());
+}
+
+TEST(BinaryReconstructionReader, Points3D) {
+  Reconstruction reconstruction;
+  const std::string path = WriteSyntheticReconstruction(&reconstruction);
+  BinaryReconstructionReader reader(path);
+  EXPECT_EQ(reader.NumPoints3D(), reconstruction.NumPoints3D());
+  size_t num_points3D = 0;
+  reader.VisitPoints3D([&](const Point3DBinaryView& point3D) {
+    const Point3D& ref_point3D = reconstruction.Point3D(point3D.point3D_id);
+    EXPECT_EQ(point3D.xyz, ref_point3D.xyz);
+    EXPECT_EQ(point3D.color, ref_point3D.color);
+    EXPECT_EQ(point3D.error, ref_point3D.error);
+    ASSERT_EQ(point3D.track_length, ref_point3D.track.Length());
+    for (size_t i = 0; i < point3D.track_length; ++i) {
+      EXPECT_EQ(point3D.Element(i).image_id,
+                ref_point3D.track.Element(i).image_id);
+      EXPECT_EQ(point3D.Element(i).point2D_idx,
+                ref_point3D.track.Element(i).point2D_idx);
+    }
+    num_points3D += 1;
+  });
+  EXPECT_EQ(num_points3D, reconstruction.NumPoints3D());
+}
+
+TEST(BinaryReconstructionReader, Points3DParallel) {
+  Reconstruction reconstruction;
+  const std::string path = WriteSyntheticReconstruction(&reconstruction);
+  BinaryReconstructionReader reader(path);
+  for (const int num_threads : {1, 3, 8}) {
+    std::mutex mutex;
+    std::unordered_set<point3D_t> point3D_ids;
+    size_t num_observations = 0;
+    reader.VisitPoints3DParallel(
+        [&](const int thread_idx, const Point3DBinaryView& point3D) {
+          EXPECT_GE(thread_idx, 0);
+          EXPECT_LT(thread_idx, num_threads);
+          EXPECT_EQ(point3D.xyz,
+                    reconstruction.Point3D(point3D.point3D_id).xyz);
+          std::lock_guard<std::mutex> lock(mutex);
+          EXPECT_TRUE(point3D_ids.insert(point3D.point3D_id).second);
+          num_observations += point3D.track_length;
+        },
+        num_threads);
+    EXPECT_EQ(point3D_ids.size(), reconstruction.NumPoints3D());
+    EXPECT_EQ(num_observations, reconstruction.ComputeNumObservations());
+  }
+}
+
+}  // namespace
+}  // namespace colmap
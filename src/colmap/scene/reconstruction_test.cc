@@ -212,6 +212,45 @@ TEST(Reconstruction, RegisterImage) {
   EXPECT_FALSE(reconstruction.IsImageRegistered(1));
 }
 
+TEST(Reconstruction, PopChangedImageIds) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, &reconstruction);
+  reconstruction.DeRegisterImage(3);
+  EXPECT_EQ(reconstruction.PopChangedImageIds(),
+            std::unordered_set<image_t>({3}));
+  EXPECT_TRUE(reconstruction.PopChangedImageIds().empty());
+
+  auto correspondence_graph = std::make_shared<CorrespondenceGraph>();
+  for (image_t image_id = 1; image_id <= 3; ++image_id) {
+    correspondence_graph->AddImage(image_id, 10);
+    reconstruction.Image(image_id).SetNumObservations(1);
+  }
+  correspondence_graph->AddCorrespondences(1, 2, FeatureMatches({{0, 0}}));
+  correspondence_graph->AddCorrespondences(1, 3, FeatureMatches({{0, 0}}));
+  correspondence_graph->Finalize();
+  reconstruction.SetUp(correspondence_graph);
+
+  // Only visibility changes of unregistered images are tracked.
+  const point3D_t point3D_id =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Random(), Track());
+  reconstruction.AddObservation(point3D_id, TrackElement(1, 0));
+  EXPECT_EQ(reconstruction.Image(2).NumVisiblePoints3D(), 1);
+  EXPECT_EQ(reconstruction.Image(3).NumVisiblePoints3D(), 1);
+  EXPECT_EQ(reconstruction.PopChangedImageIds(),
+            std::unordered_set<image_t>({3}));
+  reconstruction.AddObservation(point3D_id, TrackElement(2, 0));
+  EXPECT_TRUE(reconstruction.PopChangedImageIds().empty());
+  reconstruction.DeletePoint3D(point3D_id);
+  EXPECT_EQ(reconstruction.Image(3).NumVisiblePoints3D(), 0);
+  EXPECT_EQ(reconstruction.PopChangedImageIds(),
+            std::unordered_set<image_t>({3}));
+
+  reconstruction.RegisterImage(3);
+  reconstruction.DeRegisterImage(2);
+  EXPECT_EQ(reconstruction.PopChangedImageIds(),
+            std::unordered_set<image_t>({2, 3}));
+}
+
 TEST(Reconstruction, Normalize) {
   Reconstruction reconstruction;
   GenerateReconstruction(3, &reconstruction);
@@ -284,6 +284,12 @@ const uint8_t* Bitmap::GetScanline(const int y) const {
   return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
 }
 
+uint8_t* Bitmap::GetScanline(const int y) {
+  THROW_CHECK_GE(y, 0);
+  THROW_CHECK_LT(y, height_);
+  return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
+}
+
 void Bitmap::Fill(const BitmapColor<uint8_t>& color) {
   for (int y = 0; y < height_; ++y) {
     uint8_t* line = FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
@@ -594,6 +600,33 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
   return true;
 }
 
+bool Bitmap::ReadHeader(const std::string& path) {
+  if (!ExistsFile(path)) {
+    return false;
+  }
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path.c_str(), 0);
+
+  if (format == FIF_UNKNOWN) {
+    return false;
+  }
+
+  // Fall back to decoding the full image for formats without header-only
+  // loading support.
+  const int flags =
+      FreeImage_FIFSupportsNoPixels(format) ? FIF_LOAD_NOPIXELS : 0;
+  handle_ = FreeImageHandle(FreeImage_Load(format, path.c_str(), flags));
+  if (handle_.ptr == nullptr) {
+    return false;
+  }
+
+  width_ = FreeImage_GetWidth(handle_.ptr);
+  height_ = FreeImage_GetHeight(handle_.ptr);
+  channels_ = IsPtrRGB(handle_.ptr) ? 3 : 1;
+
+  return true;
+}
+
 bool Bitmap::Write(const std::string& path, const int flags) const {
   FREE_IMAGE_FORMAT save_format = FreeImage_GetFIFFromFilename(path.c_str());
   if (save_format == FIF_UNKNOWN) {
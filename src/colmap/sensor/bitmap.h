@@ -129,6 +129,7 @@ class Bitmap {
 
   // Get pointer to y-th scanline, where the 0-th scanline is at the top.
   const uint8_t* GetScanline(int y) const;
+  uint8_t* GetScanline(int y);
 
   // Fill entire bitmap with uniform color. For grayscale images, the first
   // element of the vector is used.
@@ -151,6 +152,11 @@ class Bitmap {
   // Read bitmap at given path and convert to grey- or colorscale.
   bool Read(const std::string& path, bool as_rgb = true);
 
+  // Read only the dimensions and metadata (e.g., EXIF) of the bitmap at given
+  // path without decoding the pixels, if supported by the file format. The
+  // pixels of the resulting bitmap must not be accessed.
+  bool ReadHeader(const std::string& path);
+
   // Write image to file. Flags can be used to set e.g. the JPEG quality.
   // Consult the FreeImage documentation for all available flags.
   bool Write(const std::string& path, int flags = 0) const;
@@ -551,5 +551,23 @@ TEST(Bitmap, ReadWriteAsGrey) {
             bitmap.ConvertToRowMajorArray());
 }
 
+TEST(Bitmap, ReadHeader) {
+  Bitmap bitmap;
+  bitmap.Allocate(4, 3, true);
+  bitmap.Fill(BitmapColor<uint8_t>(1, 2, 3));
+
+  const std::string test_dir = CreateTestDir();
+  const std::string filename = test_dir + "/bitmap.png";
+
+  EXPECT_TRUE(bitmap.Write(filename));
+
+  Bitmap read_bitmap;
+  EXPECT_TRUE(read_bitmap.ReadHeader(filename));
+  EXPECT_EQ(read_bitmap.Width(), bitmap.Width());
+  EXPECT_EQ(read_bitmap.Height(), bitmap.Height());
+
+  EXPECT_FALSE(read_bitmap.ReadHeader(test_dir + "/missing.png"));
+}
+
 }  // namespace
 }  // namespace colmap
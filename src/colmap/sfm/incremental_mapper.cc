@@ -35,30 +35,17 @@
 #include "colmap/scene/projection.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/trace.h"
 
 #include <array>
 #include <fstream>
+#include <mutex>
+#include <numeric>
+#include <set>
 
 namespace colmap {
 namespace {
 
-void SortAndAppendNextImages(std::vector<std::pair<image_t, float>> image_ranks,
-                             std::vector<image_t>* sorted_images_ids) {
-  std::sort(image_ranks.begin(),
-            image_ranks.end(),
-            [](const std::pair<image_t, float>& image1,
-               const std::pair<image_t, float>& image2) {
-              return image1.second > image2.second;
-            });
-
-  sorted_images_ids->reserve(sorted_images_ids->size() + image_ranks.size());
-  for (const auto& image : image_ranks) {
-    sorted_images_ids->push_back(image.first);
-  }
-
-  image_ranks.clear();
-}
-
 float RankNextImageMaxVisiblePointsNum(const Image& image) {
   return static_cast<float>(image.NumVisiblePoints3D());
 }
@@ -72,6 +59,22 @@ float RankNextImageMinUncertainty(const Image& image) {
   return static_cast<float>(image.Point3DVisibilityScore());
 }
 
+float RankNextImage(
+    const IncrementalMapper::Options::ImageSelectionMethod method,
+    const Image& image) {
+  switch (method) {
+    case IncrementalMapper::Options::ImageSelectionMethod::
+        MAX_VISIBLE_POINTS_NUM:
+      return RankNextImageMaxVisiblePointsNum(image);
+    case IncrementalMapper::Options::ImageSelectionMethod::
+        MAX_VISIBLE_POINTS_RATIO:
+      return RankNextImageMaxVisiblePointsRatio(image);
+    case IncrementalMapper::Options::ImageSelectionMethod::MIN_UNCERTAINTY:
+      return RankNextImageMinUncertainty(image);
+  }
+  return 0;
+}
+
 }  // namespace
 
 bool IncrementalMapper::Options::Check() const {
@@ -81,6 +84,7 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_LE(init_max_forward_motion, 1.0);
   CHECK_OPTION_GE(init_min_tri_angle, 0.0);
   CHECK_OPTION_GE(init_max_reg_trials, 1);
+  CHECK_OPTION_GE(init_num_scored_pairs, 1);
   CHECK_OPTION_GT(abs_pose_max_error, 0.0);
   CHECK_OPTION_GT(abs_pose_min_num_inliers, 0);
   CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0.0);
@@ -93,6 +97,7 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GE(filter_max_reproj_error, 0.0);
   CHECK_OPTION_GE(filter_min_tri_angle, 0.0);
   CHECK_OPTION_GE(max_reg_trials, 1);
+  CHECK_OPTION_GE(num_speculative_reg_images, 1);
   return true;
 }
 
@@ -125,6 +130,10 @@ void IncrementalMapper::BeginReconstruction(
 
   filtered_images_.clear();
   num_reg_trials_.clear();
+
+  next_image_candidates_valid_ = false;
+  next_image_candidates_.Clear();
+  changed_next_image_ids_.clear();
 }
 
 void IncrementalMapper::EndReconstruction(const bool discard) {
@@ -138,13 +147,18 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
 
   reconstruction_->TearDown();
   reconstruction_ = nullptr;
+  next_image_candidates_valid_ = false;
+  next_image_candidates_.Clear();
+  changed_next_image_ids_.clear();
   triangulator_.reset();
+  local_bundle_adjuster_.reset();
 }
 
 bool IncrementalMapper::FindInitialImagePair(const Options& options,
                                              TwoViewGeometry& two_view_geometry,
                                              image_t& image_id1,
                                              image_t& image_id2) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/find_initial_image_pair");
   THROW_CHECK(options.Check());
 
   std::vector<image_t> image_ids1;
@@ -165,33 +179,136 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
     image_ids1 = FindFirstInitialImage(options);
   }
 
-  // Try to find good initial pair.
-  for (size_t i1 = 0; i1 < image_ids1.size(); ++i1) {
-    image_id1 = image_ids1[i1];
-
-    const std::vector<image_t> image_ids2 =
-        FindSecondInitialImage(options, image_id1);
+  // Try to find good initial pair. The candidate pairs are evaluated in
+  // parallel in batches of ranked pairs. The selection is independent of the
+  // evaluation order: The first `init_num_scored_pairs` suitable pairs in
+  // ranked order are scored and pairs ranked after them are skipped.
+  const int num_threads = GetEffectiveNumThreads(options.num_threads);
+  const size_t batch_size = 4 * num_threads;
+  const size_t num_scored_pairs = options.init_num_scored_pairs;
+  std::unique_ptr<ThreadPool> thread_pool;
+
+  struct InitialImagePair {
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    bool success = false;
+    bool evaluated = false;
+    TwoViewGeometry two_view_geometry;
+  };
 
-    for (size_t i2 = 0; i2 < image_ids2.size(); ++i2) {
-      image_id2 = image_ids2[i2];
+  std::vector<InitialImagePair> candidates;
+  std::unordered_set<image_pair_t> candidate_pair_ids;
+  // Ranks of the suitable pairs found so far, shared among the evaluation
+  // tasks to cancel the evaluation of lower ranked pairs.
+  std::mutex success_ranks_mutex;
+  std::set<size_t> success_ranks;
+
+  auto EvaluateCandidate = [this,
+                            &options,
+                            &candidates,
+                            num_scored_pairs,
+                            &success_ranks_mutex,
+                            &success_ranks](const size_t rank) {
+    {
+      std::lock_guard<std::mutex> lock(success_ranks_mutex);
+      if (std::distance(success_ranks.begin(),
+                        success_ranks.lower_bound(rank)) >=
+          static_cast<std::ptrdiff_t>(num_scored_pairs)) {
+        return;
+      }
+    }
+    InitialImagePair& candidate = candidates[rank];
+    candidate.evaluated = true;
+    candidate.success =
+        EstimateInitialTwoViewGeometry(options,
+                                       candidate.two_view_geometry,
+                                       candidate.image_id1,
+                                       candidate.image_id2);
+    if (candidate.success) {
+      std::lock_guard<std::mutex> lock(success_ranks_mutex);
+      success_ranks.insert(rank);
+    }
+  };
 
+  size_t num_evaluated_candidates = 0;
+  for (size_t i1 = 0;
+       i1 < image_ids1.size() && success_ranks.size() < num_scored_pairs;
+       ++i1) {
+    const std::vector<image_t> image_ids2 =
+        FindSecondInitialImage(options, image_ids1[i1]);
+    for (const image_t image_id2 : image_ids2) {
       const image_pair_t pair_id =
-          Database::ImagePairToPairId(image_id1, image_id2);
-
+          Database::ImagePairToPairId(image_ids1[i1], image_id2);
       // Try every pair only once.
-      if (init_image_pairs_.count(pair_id) > 0) {
-        continue;
+      if (init_image_pairs_.count(pair_id) == 0 &&
+          candidate_pair_ids.insert(pair_id).second) {
+        InitialImagePair candidate;
+        candidate.image_id1 = image_ids1[i1];
+        candidate.image_id2 = image_id2;
+        candidates.push_back(std::move(candidate));
       }
+    }
 
-      init_image_pairs_.insert(pair_id);
+    const bool last_image1 = i1 + 1 == image_ids1.size();
+    if (candidates.size() - num_evaluated_candidates < batch_size &&
+        !last_image1) {
+      continue;
+    }
 
-      if (EstimateInitialTwoViewGeometry(
-              options, two_view_geometry, image_id1, image_id2)) {
-        return true;
+    if (num_threads == 1) {
+      for (size_t rank = num_evaluated_candidates; rank < candidates.size();
+           ++rank) {
+        EvaluateCandidate(rank);
+      }
+    } else {
+      if (!thread_pool) {
+        thread_pool = std::make_unique<ThreadPool>(num_threads);
+      }
+      std::vector<std::future<void>> futures;
+      futures.reserve(candidates.size() - num_evaluated_candidates);
+      for (size_t rank = num_evaluated_candidates; rank < candidates.size();
+           ++rank) {
+        futures.push_back(thread_pool->AddTask(EvaluateCandidate, rank));
       }
+      for (auto& future : futures) {
+        future.get();
+      }
+    }
+    num_evaluated_candidates = candidates.size();
+  }
+
+  // Among the suitable pairs, choose the one with the most inliers and prefer
+  // higher ranked pairs in case of ties.
+  const InitialImagePair* best_candidate = nullptr;
+  size_t num_scored_candidates = 0;
+  for (const size_t rank : success_ranks) {
+    if (num_scored_candidates++ == num_scored_pairs) {
+      break;
+    }
+    const InitialImagePair& candidate = candidates[rank];
+    if (best_candidate == nullptr ||
+        candidate.two_view_geometry.inlier_matches.size() >
+            best_candidate->two_view_geometry.inlier_matches.size()) {
+      best_candidate = &candidate;
     }
   }
 
+  // Suitable pairs that were not chosen can be tried again in later calls.
+  for (const auto& candidate : candidates) {
+    if (candidate.evaluated &&
+        (!candidate.success || &candidate == best_candidate)) {
+      init_image_pairs_.insert(Database::ImagePairToPairId(
+          candidate.image_id1, candidate.image_id2));
+    }
+  }
+
+  if (best_candidate != nullptr) {
+    image_id1 = best_candidate->image_id1;
+    image_id2 = best_candidate->image_id2;
+    two_view_geometry = best_candidate->two_view_geometry;
+    return true;
+  }
+
   // No suitable pair found in entire dataset.
   image_id1 = kInvalidImageId;
   image_id2 = kInvalidImageId;
@@ -199,60 +316,45 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
   return false;
 }
 
-std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
+std::vector<image_t> IncrementalMapper::FindNextImages(
+    const Options& options,
+    const size_t max_num_images,
+    const std::unordered_set<image_t>& skip_image_ids) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/find_next_images");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK(options.Check());
 
-  std::function<float(const Image&)> rank_image_func;
-  switch (options.image_selection_method) {
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_NUM:
-      rank_image_func = RankNextImageMaxVisiblePointsNum;
-      break;
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_RATIO:
-      rank_image_func = RankNextImageMaxVisiblePointsRatio;
-      break;
-    case Options::ImageSelectionMethod::MIN_UNCERTAINTY:
-      rank_image_func = RankNextImageMinUncertainty;
-      break;
-  }
-
-  std::vector<std::pair<image_t, float>> image_ranks;
-  std::vector<std::pair<image_t, float>> other_image_ranks;
-
-  // Append images that have not failed to register before.
-  for (const auto& image : reconstruction_->Images()) {
-    // Skip images that are already registered.
-    if (image.second.IsRegistered()) {
-      continue;
-    }
-
-    // Only consider images with a sufficient number of visible points.
-    if (image.second.NumVisiblePoints3D() <
-        static_cast<size_t>(options.abs_pose_min_num_inliers)) {
-      continue;
+  if (!next_image_candidates_valid_ ||
+      options.image_selection_method !=
+          next_image_options_.image_selection_method ||
+      options.abs_pose_min_num_inliers !=
+          next_image_options_.abs_pose_min_num_inliers ||
+      options.max_reg_trials != next_image_options_.max_reg_trials) {
+    // Rank all images from scratch.
+    next_image_options_ = options;
+    next_image_candidates_valid_ = true;
+    next_image_candidates_.Clear();
+    changed_next_image_ids_.clear();
+    reconstruction_->PopChangedImageIds();
+    for (const auto& image : reconstruction_->Images()) {
+      UpdateNextImageCandidate(image.first);
     }
-
-    // Only try registration for a certain maximum number of times.
-    const size_t num_reg_trials = num_reg_trials_[image.first];
-    if (num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
-      continue;
+  } else {
+    // Only re-rank images whose registration status, number of visible
+    // points, number of registration trials, or filter status changed.
+    for (const image_t image_id : reconstruction_->PopChangedImageIds()) {
+      UpdateNextImageCandidate(image_id);
     }
-
-    // If image has been filtered or failed to register, place it in the
-    // second bucket and prefer images that have not been tried before.
-    const float rank = rank_image_func(image.second);
-    if (filtered_images_.count(image.first) == 0 && num_reg_trials == 0) {
-      image_ranks.emplace_back(image.first, rank);
-    } else {
-      other_image_ranks.emplace_back(image.first, rank);
+    for (const image_t image_id : changed_next_image_ids_) {
+      UpdateNextImageCandidate(image_id);
     }
+    changed_next_image_ids_.clear();
   }
 
-  std::vector<image_t> ranked_images_ids;
-  SortAndAppendNextImages(image_ranks, &ranked_images_ids);
-  SortAndAppendNextImages(other_image_ranks, &ranked_images_ids);
-
-  return ranked_images_ids;
+  return next_image_candidates_.TopKeys(
+      max_num_images, [&skip_image_ids](const image_t image_id) {
+        return skip_image_ids.count(image_id) > 0;
+      });
 }
 
 void IncrementalMapper::RegisterInitialImagePair(
@@ -260,6 +362,7 @@ void IncrementalMapper::RegisterInitialImagePair(
     const TwoViewGeometry& two_view_geometry,
     const image_t image_id1,
     const image_t image_id2) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/register_initial_image_pair");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_EQ(reconstruction_->NumRegImages(), 0);
 
@@ -269,6 +372,8 @@ void IncrementalMapper::RegisterInitialImagePair(
   init_num_reg_trials_[image_id2] += 1;
   num_reg_trials_[image_id1] += 1;
   num_reg_trials_[image_id2] += 1;
+  changed_next_image_ids_.insert(image_id1);
+  changed_next_image_ids_.insert(image_id2);
 
   const image_pair_t pair_id =
       Database::ImagePairToPairId(image_id1, image_id2);
@@ -333,20 +438,101 @@ void IncrementalMapper::RegisterInitialImagePair(
   }
 }
 
-bool IncrementalMapper::RegisterNextImage(const Options& options,
-                                          const image_t image_id) {
+std::vector<IncrementalMapper::NextImagePose>
+IncrementalMapper::EstimateNextImagePoses(
+    const Options& options, const std::vector<image_t>& image_ids) const {
+  COLMAP_TRACE_SCOPE("incremental_mapper/estimate_next_image_poses");
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
+  THROW_CHECK(options.Check());
+
+  std::vector<NextImagePose> next_image_poses(image_ids.size());
+  if (image_ids.empty()) {
+    return next_image_poses;
+  }
+
+  // Each candidate is estimated by a single thread, since the candidates
+  // themselves are processed in parallel.
+  auto EstimateNextImagePose = [this, &options, &image_ids, &next_image_poses](
+                                   const size_t idx) {
+    const Image& image = reconstruction_->Image(image_ids[idx]);
+    THROW_CHECK(!image.IsRegistered())
+        << "Image cannot be registered multiple times";
+    if (image.NumVisiblePoints3D() <
+        static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+      return;
+    }
+
+    std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+    std::vector<Eigen::Vector2d> tri_points2D;
+    std::vector<Eigen::Vector3d> tri_points3D;
+    FindNextImageCorrespondences(
+        options, image_ids[idx], &tri_corrs, &tri_points2D, &tri_points3D);
+    if (tri_points2D.size() <
+        static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+      return;
+    }
+
+    NextImagePose& next_image_pose = next_image_poses[idx];
+    next_image_pose.camera = reconstruction_->Camera(image.CameraId());
+    AbsolutePoseEstimationOptions abs_pose_options;
+    AbsolutePoseRefinementOptions abs_pose_refinement_options;
+    SetUpNextImageCamera(options,
+                         image,
+                         &next_image_pose.camera,
+                         &abs_pose_options,
+                         &abs_pose_refinement_options);
+    abs_pose_options.num_threads = 1;
+
+    size_t num_inliers;
+    std::vector<char> inlier_mask;
+    next_image_pose.success =
+        EstimateAbsolutePose(abs_pose_options,
+                             tri_points2D,
+                             tri_points3D,
+                             &next_image_pose.cam_from_world,
+                             &next_image_pose.camera,
+                             &num_inliers,
+                             &inlier_mask) &&
+        num_inliers >= static_cast<size_t>(options.abs_pose_min_num_inliers);
+  };
+
+  ThreadPool thread_pool(std::min(GetEffectiveNumThreads(options.num_threads),
+                                  static_cast<int>(image_ids.size())));
+  std::vector<std::future<void>> futures;
+  futures.reserve(image_ids.size());
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    futures.push_back(thread_pool.AddTask(EstimateNextImagePose, i));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  return next_image_poses;
+}
+
+bool IncrementalMapper::RegisterNextImage(
+    const Options& options,
+    const image_t image_id,
+    const NextImagePose* next_image_pose) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/register_next_image");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
 
   THROW_CHECK(options.Check());
 
   Image& image = reconstruction_->Image(image_id);
-  Camera& camera = reconstruction_->Camera(image.CameraId());
 
   THROW_CHECK(!image.IsRegistered())
       << "Image cannot be registered multiple times";
 
   num_reg_trials_[image_id] += 1;
+  changed_next_image_ids_.insert(image_id);
+
+  // The speculative estimation already failed for this image.
+  if (next_image_pose != nullptr && !next_image_pose->success) {
+    return false;
+  }
 
   // Check if enough 2D-3D correspondences.
   if (image.NumVisiblePoints3D() <
@@ -361,53 +547,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
   std::vector<Eigen::Vector2d> tri_points2D;
   std::vector<Eigen::Vector3d> tri_points3D;
-
-  const std::shared_ptr<const CorrespondenceGraph> correspondence_graph =
-      database_cache_->CorrespondenceGraph();
-
-  std::unordered_set<point3D_t> corr_point3D_ids;
-  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-       ++point2D_idx) {
-    const Point2D& point2D = image.Point2D(point2D_idx);
-
-    corr_point3D_ids.clear();
-    const auto corr_range =
-        correspondence_graph->FindCorrespondences(image_id, point2D_idx);
-    for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
-      const Image& corr_image = reconstruction_->Image(corr->image_id);
-      if (!corr_image.IsRegistered()) {
-        continue;
-      }
-
-      const Point2D& corr_point2D = corr_image.Point2D(corr->point2D_idx);
-      if (!corr_point2D.HasPoint3D()) {
-        continue;
-      }
-
-      // Avoid duplicate correspondences.
-      if (corr_point3D_ids.count(corr_point2D.point3D_id) > 0) {
-        continue;
-      }
-
-      const Camera& corr_camera =
-          reconstruction_->Camera(corr_image.CameraId());
-
-      // Avoid correspondences to images with bogus camera parameters.
-      if (corr_camera.HasBogusParams(options.min_focal_length_ratio,
-                                     options.max_focal_length_ratio,
-                                     options.max_extra_param)) {
-        continue;
-      }
-
-      const Point3D& point3D =
-          reconstruction_->Point3D(corr_point2D.point3D_id);
-
-      tri_corrs.emplace_back(point2D_idx, corr_point2D.point3D_id);
-      corr_point3D_ids.insert(corr_point2D.point3D_id);
-      tri_points2D.push_back(point2D.xy);
-      tri_points3D.push_back(point3D.xyz);
-    }
-  }
+  FindNextImageCorrespondences(
+      options, image_id, &tri_corrs, &tri_points2D, &tri_points3D);
 
   // The size of `next_image.num_tri_obs` and `tri_corrs_point2D_idxs.size()`
   // can only differ, when there are images with bogus camera parameters, and
@@ -421,72 +562,47 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // 2D-3D estimation
   //////////////////////////////////////////////////////////////////////////////
 
-  // Only refine / estimate focal length, if no focal length was specified
-  // (manually or through EXIF) and if it was not already estimated previously
-  // from another image (when multiple images share the same camera
-  // parameters)
-
+  // The camera and pose are estimated on copies, such that the reconstruction
+  // is only modified if the image can be registered.
+  Camera camera = reconstruction_->Camera(image.CameraId());
+  Rigid3d cam_from_world;
   AbsolutePoseEstimationOptions abs_pose_options;
-  abs_pose_options.num_threads = options.num_threads;
-  abs_pose_options.num_focal_length_samples = 30;
-  abs_pose_options.min_focal_length_ratio = options.min_focal_length_ratio;
-  abs_pose_options.max_focal_length_ratio = options.max_focal_length_ratio;
-  abs_pose_options.ransac_options.max_error = options.abs_pose_max_error;
-  abs_pose_options.ransac_options.min_inlier_ratio =
-      options.abs_pose_min_inlier_ratio;
-  // Use high confidence to avoid preemptive termination of P3P RANSAC
-  // - too early termination may lead to bad registration.
-  abs_pose_options.ransac_options.min_num_trials = 100;
-  abs_pose_options.ransac_options.max_num_trials = 10000;
-  abs_pose_options.ransac_options.confidence = 0.99999;
-
   AbsolutePoseRefinementOptions abs_pose_refinement_options;
-  if (num_reg_images_per_camera_[image.CameraId()] > 0) {
-    // Camera already refined from another image with the same camera.
-    if (camera.HasBogusParams(options.min_focal_length_ratio,
-                              options.max_focal_length_ratio,
-                              options.max_extra_param)) {
-      // Previously refined camera has bogus parameters,
-      // so reset parameters and try to re-estimage.
-      camera.params = database_cache_->Camera(image.CameraId()).params;
-      abs_pose_options.estimate_focal_length = !camera.has_prior_focal_length;
-      abs_pose_refinement_options.refine_focal_length = true;
-      abs_pose_refinement_options.refine_extra_params = true;
-    } else {
-      abs_pose_options.estimate_focal_length = false;
-      abs_pose_refinement_options.refine_focal_length = false;
-      abs_pose_refinement_options.refine_extra_params = false;
-    }
-  } else {
-    // Camera not refined before. Note that the camera parameters might have
-    // been changed before but the image was filtered, so we explicitly reset
-    // the camera parameters and try to re-estimate them.
-    camera.params = database_cache_->Camera(image.CameraId()).params;
-    abs_pose_options.estimate_focal_length = !camera.has_prior_focal_length;
-    abs_pose_refinement_options.refine_focal_length = true;
-    abs_pose_refinement_options.refine_extra_params = true;
-  }
+  const bool reset_camera_params = SetUpNextImageCamera(
+      options, image, &camera, &abs_pose_options, &abs_pose_refinement_options);
 
-  if (!options.abs_pose_refine_focal_length) {
-    abs_pose_options.estimate_focal_length = false;
-    abs_pose_refinement_options.refine_focal_length = false;
-  }
-
-  if (!options.abs_pose_refine_extra_params) {
-    abs_pose_refinement_options.refine_extra_params = false;
-  }
-
-  size_t num_inliers;
+  size_t num_inliers = 0;
   std::vector<char> inlier_mask;
 
-  if (!EstimateAbsolutePose(abs_pose_options,
-                            tri_points2D,
-                            tri_points3D,
-                            &image.CamFromWorld(),
-                            &camera,
-                            &num_inliers,
-                            &inlier_mask)) {
-    return false;
+  if (next_image_pose == nullptr) {
+    if (!EstimateAbsolutePose(abs_pose_options,
+                              tri_points2D,
+                              tri_points3D,
+                              &cam_from_world,
+                              &camera,
+                              &num_inliers,
+                              &inlier_mask)) {
+      return false;
+    }
+  } else {
+    // Re-validate the speculatively estimated pose by recomputing its inliers
+    // against the current reconstruction. The estimation itself succeeded, so
+    // the pose is accepted with the same minimum number of inliers as in the
+    // sequential path.
+    if (reset_camera_params) {
+      camera.params = next_image_pose->camera.params;
+    }
+    cam_from_world = next_image_pose->cam_from_world;
+    const double max_squared_error =
+        options.abs_pose_max_error * options.abs_pose_max_error;
+    inlier_mask.resize(tri_points2D.size());
+    for (size_t i = 0; i < tri_points2D.size(); ++i) {
+      inlier_mask[i] =
+          CalculateSquaredReprojectionError(
+              tri_points2D[i], tri_points3D[i], cam_from_world, camera) <=
+          max_squared_error;
+      num_inliers += inlier_mask[i];
+    }
   }
 
   if (num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
@@ -501,7 +617,7 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
                           inlier_mask,
                           tri_points2D,
                           tri_points3D,
-                          &image.CamFromWorld(),
+                          &cam_from_world,
                           &camera)) {
     return false;
   }
@@ -510,6 +626,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // Continue tracks
   //////////////////////////////////////////////////////////////////////////////
 
+  image.CamFromWorld() = cam_from_world;
+  reconstruction_->Camera(image.CameraId()) = camera;
   reconstruction_->RegisterImage(image_id);
   RegisterImageEvent(image_id);
 
@@ -526,23 +644,28 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     }
   }
 
+  TraceValue("incremental_mapper/num_reg_image_inliers", num_inliers);
+
   return true;
 }
 
 size_t IncrementalMapper::TriangulateImage(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/triangulate_image");
   THROW_CHECK_NOTNULL(reconstruction_);
   VLOG(1) << "=> Continued observations: "
           << reconstruction_->Image(image_id).NumPoints3D();
   const size_t num_tris =
       triangulator_->TriangulateImage(tri_options, image_id);
   VLOG(1) << "=> Added observations: " << num_tris;
+  TraceValue("incremental_mapper/num_triangulated_observations", num_tris);
   return num_tris;
 }
 
 size_t IncrementalMapper::Retriangulate(
     const IncrementalTriangulator::Options& tri_options) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/retriangulate");
   THROW_CHECK_NOTNULL(reconstruction_);
   return triangulator_->Retriangulate(tri_options);
 }
@@ -561,6 +684,7 @@ size_t IncrementalMapper::MergeTracks(
 
 size_t IncrementalMapper::CompleteAndMergeTracks(
     const IncrementalTriangulator::Options& tri_options) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/complete_and_merge_tracks");
   const size_t num_completed_observations = CompleteTracks(tri_options);
   VLOG(1) << "=> Completed observations: " << num_completed_observations;
   const size_t num_merged_observations = MergeTracks(tri_options);
@@ -575,6 +699,7 @@ IncrementalMapper::AdjustLocalBundle(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/adjust_local_bundle");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK(options.Check());
 
@@ -646,11 +771,20 @@ IncrementalMapper::AdjustLocalBundle(
     }
 
     // Adjust the local bundle.
-    BundleAdjuster bundle_adjuster(ba_options, ba_config);
-    bundle_adjuster.Solve(reconstruction_.get());
-
-    report.num_adjusted_observations =
-        bundle_adjuster.Summary().num_residuals / 2;
+    if (options.local_ba_persistent) {
+      if (!local_bundle_adjuster_) {
+        local_bundle_adjuster_ = std::make_unique<PersistentBundleAdjuster>();
+      }
+      local_bundle_adjuster_->Solve(
+          ba_options, ba_config, reconstruction_.get());
+      report.num_adjusted_observations =
+          local_bundle_adjuster_->Summary().num_residuals / 2;
+    } else {
+      BundleAdjuster bundle_adjuster(ba_options, ba_config);
+      bundle_adjuster.Solve(reconstruction_.get());
+      report.num_adjusted_observations =
+          bundle_adjuster.Summary().num_residuals / 2;
+    }
 
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
@@ -686,6 +820,7 @@ IncrementalMapper::AdjustLocalBundle(
 
 bool IncrementalMapper::AdjustGlobalBundle(
     const Options& options, const BundleAdjustmentOptions& ba_options) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/adjust_global_bundle");
   THROW_CHECK_NOTNULL(reconstruction_);
 
   const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
@@ -818,6 +953,7 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
   for (const image_t image_id : image_ids) {
     DeRegisterImageEvent(image_id);
     filtered_images_.insert(image_id);
+    changed_next_image_ids_.insert(image_id);
   }
 
   const size_t num_filtered_images = image_ids.size();
@@ -826,6 +962,7 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
 }
 
 size_t IncrementalMapper::FilterPoints(const Options& options) {
+  COLMAP_TRACE_SCOPE("incremental_mapper/filter_points");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK(options.Check());
   const size_t num_filtered_observations = reconstruction_->FilterAllPoints3D(
@@ -1168,6 +1305,203 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   return local_bundle_image_ids;
 }
 
+void IncrementalMapper::FindNextImageCorrespondences(
+    const Options& options,
+    const image_t image_id,
+    std::vector<std::pair<point2D_t, point3D_t>>* tri_corrs,
+    std::vector<Eigen::Vector2d>* tri_points2D,
+    std::vector<Eigen::Vector3d>* tri_points3D) const {
+  const Image& image = reconstruction_->Image(image_id);
+
+  const std::shared_ptr<const CorrespondenceGraph> correspondence_graph =
+      database_cache_->CorrespondenceGraph();
+
+  std::unordered_set<point3D_t> corr_point3D_ids;
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    const Point2D& point2D = image.Point2D(point2D_idx);
+
+    corr_point3D_ids.clear();
+    const auto corr_range =
+        correspondence_graph->FindCorrespondences(image_id, point2D_idx);
+    for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
+      const Image& corr_image = reconstruction_->Image(corr->image_id);
+      if (!corr_image.IsRegistered()) {
+        continue;
+      }
+
+      const Point2D& corr_point2D = corr_image.Point2D(corr->point2D_idx);
+      if (!corr_point2D.HasPoint3D()) {
+        continue;
+      }
+
+      // Avoid duplicate correspondences.
+      if (corr_point3D_ids.count(corr_point2D.point3D_id) > 0) {
+        continue;
+      }
+
+      const Camera& corr_camera =
+          reconstruction_->Camera(corr_image.CameraId());
+
+      // Avoid correspondences to images with bogus camera parameters.
+      if (corr_camera.HasBogusParams(options.min_focal_length_ratio,
+                                     options.max_focal_length_ratio,
+                                     options.max_extra_param)) {
+        continue;
+      }
+
+      const Point3D& point3D =
+          reconstruction_->Point3D(corr_point2D.point3D_id);
+
+      tri_corrs->emplace_back(point2D_idx, corr_point2D.point3D_id);
+      corr_point3D_ids.insert(corr_point2D.point3D_id);
+      tri_points2D->push_back(point2D.xy);
+      tri_points3D->push_back(point3D.xyz);
+    }
+  }
+
+  // PROSAC assumes the correspondences to be ordered by decreasing quality.
+  // 3D points with longer tracks are typically more accurate.
+  if (options.abs_pose_use_prosac) {
+    std::vector<size_t> track_lengths(tri_corrs->size());
+    for (size_t i = 0; i < tri_corrs->size(); ++i) {
+      track_lengths[i] =
+          reconstruction_->Point3D((*tri_corrs)[i].second).track.Length();
+    }
+    std::vector<size_t> order(tri_corrs->size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [&track_lengths](size_t i, size_t j) {
+          return track_lengths[i] > track_lengths[j];
+        });
+    std::vector<std::pair<point2D_t, point3D_t>> ordered_tri_corrs;
+    std::vector<Eigen::Vector2d> ordered_tri_points2D;
+    std::vector<Eigen::Vector3d> ordered_tri_points3D;
+    ordered_tri_corrs.reserve(order.size());
+    ordered_tri_points2D.reserve(order.size());
+    ordered_tri_points3D.reserve(order.size());
+    for (const size_t i : order) {
+      ordered_tri_corrs.push_back((*tri_corrs)[i]);
+      ordered_tri_points2D.push_back((*tri_points2D)[i]);
+      ordered_tri_points3D.push_back((*tri_points3D)[i]);
+    }
+    *tri_corrs = std::move(ordered_tri_corrs);
+    *tri_points2D = std::move(ordered_tri_points2D);
+    *tri_points3D = std::move(ordered_tri_points3D);
+  }
+}
+
+bool IncrementalMapper::SetUpNextImageCamera(
+    const Options& options,
+    const Image& image,
+    Camera* camera,
+    AbsolutePoseEstimationOptions* abs_pose_options,
+    AbsolutePoseRefinementOptions* abs_pose_refinement_options) const {
+  // Only refine / estimate focal length, if no focal length was specified
+  // (manually or through EXIF) and if it was not already estimated previously
+  // from another image (when multiple images share the same camera
+  // parameters)
+
+  abs_pose_options->num_threads = options.num_threads;
+  abs_pose_options->num_focal_length_samples = 30;
+  abs_pose_options->min_focal_length_ratio = options.min_focal_length_ratio;
+  abs_pose_options->max_focal_length_ratio = options.max_focal_length_ratio;
+  abs_pose_options->ransac_options.max_error = options.abs_pose_max_error;
+  abs_pose_options->ransac_options.min_inlier_ratio =
+      options.abs_pose_min_inlier_ratio;
+  // Use high confidence to avoid preemptive termination of P3P RANSAC
+  // - too early termination may lead to bad registration.
+  abs_pose_options->ransac_options.min_num_trials = 100;
+  abs_pose_options->ransac_options.max_num_trials = 10000;
+  abs_pose_options->ransac_options.confidence = 0.99999;
+  abs_pose_options->use_prosac = options.abs_pose_use_prosac;
+
+  bool reset_camera_params = false;
+  const auto num_reg_images_it =
+      num_reg_images_per_camera_.find(image.CameraId());
+  if (num_reg_images_it != num_reg_images_per_camera_.end() &&
+      num_reg_images_it->second > 0) {
+    // Camera already refined from another image with the same camera.
+    if (camera->HasBogusParams(options.min_focal_length_ratio,
+                               options.max_focal_length_ratio,
+                               options.max_extra_param)) {
+      // Previously refined camera has bogus parameters,
+      // so reset parameters and try to re-estimage.
+      reset_camera_params = true;
+    } else {
+      abs_pose_options->estimate_focal_length = false;
+      abs_pose_refinement_options->refine_focal_length = false;
+      abs_pose_refinement_options->refine_extra_params = false;
+    }
+  } else {
+    // Camera not refined before. Note that the camera parameters might have
+    // been changed before but the image was filtered, so we explicitly reset
+    // the camera parameters and try to re-estimate them.
+    reset_camera_params = true;
+  }
+
+  if (reset_camera_params) {
+    camera->params = database_cache_->Camera(image.CameraId()).params;
+    abs_pose_options->estimate_focal_length = !camera->has_prior_focal_length;
+    abs_pose_refinement_options->refine_focal_length = true;
+    abs_pose_refinement_options->refine_extra_params = true;
+  }
+
+  if (!options.abs_pose_refine_focal_length) {
+    abs_pose_options->estimate_focal_length = false;
+    abs_pose_refinement_options->refine_focal_length = false;
+  }
+
+  if (!options.abs_pose_refine_extra_params) {
+    abs_pose_refinement_options->refine_extra_params = false;
+  }
+
+  return reset_camera_params;
+}
+
+void IncrementalMapper::UpdateNextImageCandidate(const image_t image_id) {
+  if (!reconstruction_->ExistsImage(image_id)) {
+    next_image_candidates_.Erase(image_id);
+    return;
+  }
+
+  const Image& image = reconstruction_->Image(image_id);
+
+  // Skip images that are already registered.
+  if (image.IsRegistered()) {
+    next_image_candidates_.Erase(image_id);
+    return;
+  }
+
+  // Only consider images with a sufficient number of visible points.
+  if (image.NumVisiblePoints3D() <
+      static_cast<size_t>(next_image_options_.abs_pose_min_num_inliers)) {
+    next_image_candidates_.Erase(image_id);
+    return;
+  }
+
+  // Only try registration for a certain maximum number of times.
+  const auto num_reg_trials_it = num_reg_trials_.find(image_id);
+  const size_t num_reg_trials = num_reg_trials_it == num_reg_trials_.end()
+                                    ? 0
+                                    : num_reg_trials_it->second;
+  if (num_reg_trials >=
+      static_cast<size_t>(next_image_options_.max_reg_trials)) {
+    next_image_candidates_.Erase(image_id);
+    return;
+  }
+
+  // If image has been filtered or failed to register, rank it behind all
+  // images that have not been tried before.
+  const bool is_untried =
+      filtered_images_.count(image_id) == 0 && num_reg_trials == 0;
+  next_image_candidates_.Set(
+      image_id,
+      std::make_pair(
+          is_untried,
+          RankNextImage(next_image_options_.image_selection_method, image)));
+}
+
 void IncrementalMapper::RegisterImageEvent(const image_t image_id) {
   const Image& image = reconstruction_->Image(image_id);
   size_t& num_reg_images_for_camera =
@@ -1203,7 +1537,7 @@ bool IncrementalMapper::EstimateInitialTwoViewGeometry(
     const Options& options,
     TwoViewGeometry& two_view_geometry,
     const image_t image_id1,
-    const image_t image_id2) {
+    const image_t image_id2) const {
   const Image& image1 = database_cache_->Image(image_id1);
   const Camera& camera1 = database_cache_->Camera(image1.CameraId());
 
@@ -30,10 +30,14 @@
 #pragma once
 
 #include "colmap/estimators/bundle_adjustment.h"
+#include "colmap/estimators/pose.h"
 #include "colmap/scene/database.h"
 #include "colmap/scene/database_cache.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sfm/incremental_triangulator.h"
+#include "colmap/util/indexed_max_heap.h"
+
+#include <limits>
 
 namespace colmap {
 
@@ -78,6 +82,11 @@ class IncrementalMapper {
     // Maximum number of trials to use an image for initialization.
     int init_max_reg_trials = 2;
 
+    // Number of suitable initial image pairs, in ranked order, among which the
+    // pair with the most inlier matches is chosen. If 1, the first suitable
+    // pair in ranked order is chosen.
+    int init_num_scored_pairs = 1;
+
     // Maximum reprojection error in absolute pose estimation.
     double abs_pose_max_error = 12.0;
 
@@ -87,6 +96,10 @@ class IncrementalMapper {
     // Minimum inlier ratio in absolute pose estimation.
     double abs_pose_min_inlier_ratio = 0.25;
 
+    // Whether to sample the 2D-3D correspondences with PROSAC in absolute
+    // pose estimation, prioritizing 3D points with longer tracks.
+    bool abs_pose_use_prosac = false;
+
     // Whether to estimate the focal length in absolute pose estimation.
     bool abs_pose_refine_focal_length = true;
 
@@ -99,6 +112,11 @@ class IncrementalMapper {
     // Minimum triangulation for images to be chosen in local bundle adjustment.
     double local_ba_min_tri_angle = 6;
 
+    // Whether to keep the local bundle adjustment problem across image
+    // registrations and only update the residuals that changed. Disabled by
+    // default.
+    bool local_ba_persistent = false;
+
     // Thresholds for bogus camera parameters. Images with bogus camera
     // parameters are filtered and ignored in triangulation.
     double min_focal_length_ratio = 0.1;  // Opening angle of ~130deg
@@ -114,6 +132,11 @@ class IncrementalMapper {
     // Maximum number of trials to register an image.
     int max_reg_trials = 3;
 
+    // Number of next image candidates whose poses are speculatively estimated
+    // in parallel before registering them in rank order. If 1, the candidates
+    // are estimated one at a time.
+    int num_speculative_reg_images = 1;
+
     // If reconstruction is provided as input, fix the existing image poses.
     bool fix_existing_images = false;
 
@@ -132,6 +155,13 @@ class IncrementalMapper {
     bool Check() const;
   };
 
+  // Pose of a next image candidate estimated by `EstimateNextImagePoses`.
+  struct NextImagePose {
+    bool success = false;
+    Rigid3d cam_from_world;
+    Camera camera;
+  };
+
   struct LocalBundleAdjustmentReport {
     size_t num_merged_observations = 0;
     size_t num_completed_observations = 0;
@@ -165,8 +195,14 @@ class IncrementalMapper {
 
   // Find best next image to register in the incremental reconstruction. The
   // images should be passed to `RegisterNextImage`. This function automatically
-  // ignores images that failed to registered for `max_reg_trials`.
-  std::vector<image_t> FindNextImages(const Options& options);
+  // ignores images that failed to registered for `max_reg_trials`. At most
+  // `max_num_images` are returned and images in `skip_image_ids` are ignored.
+  // The candidates are ranked incrementally, i.e., only images whose state
+  // changed since the last call are re-ranked.
+  std::vector<image_t> FindNextImages(
+      const Options& options,
+      size_t max_num_images = std::numeric_limits<size_t>::max(),
+      const std::unordered_set<image_t>& skip_image_ids = {});
 
   // Attempt to seed the reconstruction from an image pair.
   void RegisterInitialImagePair(const Options& options,
@@ -174,9 +210,20 @@ class IncrementalMapper {
                                 image_t image_id1,
                                 image_t image_id2);
 
+  // Speculatively estimate the poses of the given next image candidates in
+  // parallel without modifying the reconstruction. The results can be passed
+  // to `RegisterNextImage` as long as the reconstruction is not modified in
+  // the meantime, e.g., by a successful registration.
+  std::vector<NextImagePose> EstimateNextImagePoses(
+      const Options& options, const std::vector<image_t>& image_ids) const;
+
   // Attempt to register image to the existing model. This requires that
-  // a previous call to `RegisterInitialImagePair` was successful.
-  bool RegisterNextImage(const Options& options, image_t image_id);
+  // a previous call to `RegisterInitialImagePair` was successful. If a
+  // speculatively estimated pose is given, the RANSAC estimation is skipped
+  // and the pose is only re-validated against the current reconstruction.
+  bool RegisterNextImage(const Options& options,
+                         image_t image_id,
+                         const NextImagePose* next_image_pose = nullptr);
 
   // Triangulate observations of image.
   size_t TriangulateImage(const IncrementalTriangulator::Options& tri_options,
@@ -261,7 +308,7 @@ class IncrementalMapper {
   bool EstimateInitialTwoViewGeometry(const Options& options,
                                       TwoViewGeometry& two_view_geometry,
                                       image_t image_id1,
-                                      image_t image_id2);
+                                      image_t image_id2) const;
 
  private:
   // Find seed images for incremental reconstruction. Suitable seed images have
@@ -282,6 +329,27 @@ class IncrementalMapper {
   std::vector<image_t> FindLocalBundle(const Options& options,
                                        image_t image_id) const;
 
+  // Find the 2D-3D correspondences of the next image to the 3D points
+  // observed by registered images.
+  void FindNextImageCorrespondences(
+      const Options& options,
+      image_t image_id,
+      std::vector<std::pair<point2D_t, point3D_t>>* tri_corrs,
+      std::vector<Eigen::Vector2d>* tri_points2D,
+      std::vector<Eigen::Vector3d>* tri_points3D) const;
+
+  // Set up the camera of the next image and the pose estimation options.
+  // Returns whether the camera parameters were reset for re-estimation.
+  bool SetUpNextImageCamera(
+      const Options& options,
+      const Image& image,
+      Camera* camera,
+      AbsolutePoseEstimationOptions* abs_pose_options,
+      AbsolutePoseRefinementOptions* abs_pose_refinement_options) const;
+
+  // Update the rank of the image in the next image candidates.
+  void UpdateNextImageCandidate(image_t image_id);
+
   // Register / De-register image in current reconstruction and update
   // the number of shared images between all reconstructions.
   void RegisterImageEvent(image_t image_id);
@@ -296,6 +364,9 @@ class IncrementalMapper {
   // Class that is responsible for incremental triangulation.
   std::unique_ptr<IncrementalTriangulator> triangulator_;
 
+  // Bundle adjuster that is reused for consecutive local bundle adjustments.
+  std::unique_ptr<PersistentBundleAdjuster> local_bundle_adjuster_;
+
   // Number of images that are registered in at least on reconstruction.
   size_t num_total_reg_images_;
 
@@ -324,6 +395,17 @@ class IncrementalMapper {
   // an upper bound to the number of trials to register an image.
   std::unordered_map<image_t, size_t> num_reg_trials_;
 
+  // Candidates for the next image registration with their priority, where
+  // images that were not yet tried or filtered take precedence over the rank.
+  // The options used to rank the candidates are stored to detect changes.
+  IndexedMaxHeap<image_t, std::pair<bool, float>> next_image_candidates_;
+  bool next_image_candidates_valid_ = false;
+  Options next_image_options_;
+
+  // Images whose number of registration trials or filter status changed since
+  // the last update of the next image candidates.
+  std::unordered_set<image_t> changed_next_image_ids_;
+
   // Images that were registered before beginning the reconstruction.
   // This image list will be non-empty, if the reconstruction is continued from
   // an existing reconstruction.
@@ -0,0 +1,135 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/sfm/incremental_mapper.h"
+
+#include "colmap/scene/synthetic.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+std::shared_ptr<DatabaseCache> CreateSyntheticDatabaseCache() {
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 12;
+  synthetic_dataset_options.num_points3D = 200;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction, &database);
+  return DatabaseCache::Create(database,
+                               /*min_num_matches=*/0,
+                               /*ignore_watermarks=*/false,
+                               /*image_names=*/{});
+}
+
+struct InitialImagePair {
+  bool success = false;
+  image_t image_id1 = kInvalidImageId;
+  image_t image_id2 = kInvalidImageId;
+  size_t num_inliers = 0;
+};
+
+InitialImagePair FindInitialImagePair(
+    const std::shared_ptr<DatabaseCache>& database_cache,
+    const IncrementalMapper::Options& options) {
+  IncrementalMapper mapper(database_cache);
+  mapper.BeginReconstruction(std::make_shared<Reconstruction>());
+  InitialImagePair pair;
+  TwoViewGeometry two_view_geometry;
+  pair.success = mapper.FindInitialImagePair(
+      options, two_view_geometry, pair.image_id1, pair.image_id2);
+  pair.num_inliers = two_view_geometry.inlier_matches.size();
+  mapper.EndReconstruction(/*discard=*/true);
+  return pair;
+}
+
+void ExpectValidInitialImagePair(const DatabaseCache& database_cache,
+                                 const IncrementalMapper::Options& options,
+                                 const InitialImagePair& pair) {
+  ASSERT_TRUE(pair.success);
+  EXPECT_NE(pair.image_id1, pair.image_id2);
+  EXPECT_TRUE(database_cache.ExistsImage(pair.image_id1));
+  EXPECT_TRUE(database_cache.ExistsImage(pair.image_id2));
+  EXPECT_GE(pair.num_inliers,
+            static_cast<size_t>(options.init_min_num_inliers));
+}
+
+TEST(IncrementalMapper, FindInitialImagePairNumThreads) {
+  const auto database_cache = CreateSyntheticDatabaseCache();
+
+  IncrementalMapper::Options options;
+  options.num_threads = 1;
+  const InitialImagePair pair = FindInitialImagePair(database_cache, options);
+  ExpectValidInitialImagePair(*database_cache, options, pair);
+
+  for (const int num_threads : {2, 4, 8}) {
+    options.num_threads = num_threads;
+    const InitialImagePair parallel_pair =
+        FindInitialImagePair(database_cache, options);
+    EXPECT_TRUE(parallel_pair.success);
+    EXPECT_EQ(parallel_pair.image_id1, pair.image_id1);
+    EXPECT_EQ(parallel_pair.image_id2, pair.image_id2);
+    EXPECT_EQ(parallel_pair.num_inliers, pair.num_inliers);
+  }
+}
+
+TEST(IncrementalMapper, FindInitialImagePairNumScoredPairs) {
+  const auto database_cache = CreateSyntheticDatabaseCache();
+
+  IncrementalMapper::Options options;
+  options.init_num_scored_pairs = 5;
+  options.num_threads = 1;
+  const InitialImagePair pair = FindInitialImagePair(database_cache, options);
+  ExpectValidInitialImagePair(*database_cache, options, pair);
+
+  // The pair with the most inliers among the scored pairs is chosen, which
+  // is at least as good as the first suitable pair.
+  options.init_num_scored_pairs = 1;
+  const InitialImagePair first_pair =
+      FindInitialImagePair(database_cache, options);
+  ExpectValidInitialImagePair(*database_cache, options, first_pair);
+  EXPECT_GE(pair.num_inliers, first_pair.num_inliers);
+
+  options.init_num_scored_pairs = 5;
+  for (const int num_threads : {1, 4}) {
+    options.num_threads = num_threads;
+    const InitialImagePair repeated_pair =
+        FindInitialImagePair(database_cache, options);
+    EXPECT_TRUE(repeated_pair.success);
+    EXPECT_EQ(repeated_pair.image_id1, pair.image_id1);
+    EXPECT_EQ(repeated_pair.image_id2, pair.image_id2);
+    EXPECT_EQ(repeated_pair.num_inliers, pair.num_inliers);
+  }
+}
+
+}  // namespace
+}  // namespace colmap
@@ -54,7 +54,9 @@ class StereoOptionsTab : public OptionsWidget {
 
     AddOptionInt(
         &options->patch_match_stereo->max_image_size, "max_image_size", -1);
+    AddOptionBool(&options->patch_match_stereo->use_gpu, "use_gpu");
     AddOptionText(&options->patch_match_stereo->gpu_index, "gpu_index");
+    AddOptionInt(&options->patch_match_stereo->num_threads, "num_threads", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_min, "depth_min", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_max, "depth_max", -1);
     AddOptionInt(&options->patch_match_stereo->window_radius, "window_radius");
@@ -379,7 +381,6 @@ void DenseReconstructionWidget::Stereo() {
     return;
   }
 
-#if defined(COLMAP_CUDA_ENABLED)
   auto processor =
       std::make_unique<ControllerThread<mvs::PatchMatchController>>(
           std::make_shared<mvs::PatchMatchController>(
@@ -387,12 +388,6 @@ void DenseReconstructionWidget::Stereo() {
   processor->AddCallback(Thread::FINISHED_CALLBACK,
                          [this]() { refresh_workspace_action_->trigger(); });
   thread_control_widget_->StartThread("Stereo...", true, std::move(processor));
-#else
-  QMessageBox::critical(this,
-                        "",
-                        tr("Dense stereo reconstruction requires CUDA, which "
-                           "is not available on your system."));
-#endif
 }
 
 void DenseReconstructionWidget::Fusion() {
@@ -94,6 +94,12 @@ SIFTExtractionWidget::SIFTExtractionWidget(QWidget* parent,
                 "estimate_affine_shape");
   AddOptionInt(&options->sift_extraction->max_num_orientations,
                "max_num_orientations");
+  AddOptionBool(&options->sift_extraction->two_pass_extraction,
+                "two_pass_extraction");
+  AddOptionInt(&options->sift_extraction->num_image_threads,
+               "num_image_threads",
+               -1);
+  AddOptionInt(&options->sift_extraction->tile_size, "tile_size", 0);
   AddOptionBool(&options->sift_extraction->upright, "upright");
   AddOptionBool(&options->sift_extraction->domain_size_pooling,
                 "domain_size_pooling");
@@ -119,7 +119,7 @@ class ModelViewerWidget : public QOpenGLWidget,
   std::shared_ptr<Reconstruction> reconstruction;
   std::unordered_map<camera_t, Camera> cameras;
   std::unordered_map<image_t, Image> images;
-  std::unordered_map<point3D_t, Point3D> points3D;
+  Point3DMap points3D;
   std::vector<image_t> reg_image_ids;
 
   QLabel* statusbar_status_label;
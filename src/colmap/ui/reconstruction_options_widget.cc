@@ -47,6 +47,9 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionDirPath(&options->mapper->snapshot_path, "snapshot_path");
   AddOptionInt(
       &options->mapper->snapshot_images_freq, "snapshot_images_freq", 0);
+  AddOptionFilePath(&options->mapper->database_cache_path,
+                    "database_cache_path");
+  AddOptionDirPath(&options->mapper->feature_store_path, "feature_store_path");
 }
 
 MapperTriangulationOptionsWidget::MapperTriangulationOptionsWidget(
@@ -84,6 +87,9 @@ MapperRegistrationOptionsWidget::MapperRegistrationOptionsWidget(
   AddOptionDouble(&options->mapper->mapper.abs_pose_min_inlier_ratio,
                   "abs_pose_min_inlier_ratio");
   AddOptionInt(&options->mapper->mapper.max_reg_trials, "max_reg_trials", 1);
+  AddOptionInt(&options->mapper->mapper.num_speculative_reg_images,
+               "num_speculative_reg_images",
+               1);
 }
 
 MapperInitializationOptionsWidget::MapperInitializationOptionsWidget(
@@ -101,6 +107,9 @@ MapperInitializationOptionsWidget::MapperInitializationOptionsWidget(
                   "init_min_tri_angle [deg]");
   AddOptionInt(
       &options->mapper->mapper.init_max_reg_trials, "init_max_reg_trials", 1);
+  AddOptionInt(&options->mapper->mapper.init_num_scored_pairs,
+               "init_num_scored_pairs",
+               1);
 }
 
 MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
@@ -59,12 +59,20 @@ class LRUCache {
   const value_t& Get(const key_t& key);
   value_t& GetMutable(const key_t& key);
 
+  // The number of calls to Get and GetMutable that found the element in the
+  // cache and that had to compute the new value, respectively.
+  size_t NumHits() const;
+  size_t NumMisses() const;
+
   // Manually set the value of an element.
   virtual void Set(const key_t& key, value_t value);
 
   // Pop least recently used element from cache.
   virtual void Pop();
 
+  // Remove the element with the given key, if it exists.
+  virtual void Erase(const key_t& key);
+
   // Clear all elements from cache.
   virtual void Clear();
 
@@ -83,6 +91,9 @@ class LRUCache {
 
   // Function to compute new values if not in the cache.
   const std::function<value_t(const key_t&)> getter_func_;
+
+  size_t num_hits_;
+  size_t num_misses_;
 };
 
 // Least Recently Used cache implementation that is constrained by a maximum
@@ -102,6 +113,7 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
 
   void Set(const key_t& key, value_t value) override;
   void Pop() override;
+  void Erase(const key_t& key) override;
   void Clear() override;
 
  private:
@@ -125,7 +137,10 @@ template <typename key_t, typename value_t>
 LRUCache<key_t, value_t>::LRUCache(
     const size_t max_num_elems,
     const std::function<value_t(const key_t&)>& getter_func)
-    : max_num_elems_(max_num_elems), getter_func_(getter_func) {
+    : max_num_elems_(max_num_elems),
+      getter_func_(getter_func),
+      num_hits_(0),
+      num_misses_(0) {
   THROW_CHECK(getter_func);
   THROW_CHECK_GT(max_num_elems, 0);
 }
@@ -140,6 +155,16 @@ size_t LRUCache<key_t, value_t>::MaxNumElems() const {
   return max_num_elems_;
 }
 
+template <typename key_t, typename value_t>
+size_t LRUCache<key_t, value_t>::NumHits() const {
+  return num_hits_;
+}
+
+template <typename key_t, typename value_t>
+size_t LRUCache<key_t, value_t>::NumMisses() const {
+  return num_misses_;
+}
+
 template <typename key_t, typename value_t>
 bool LRUCache<key_t, value_t>::Exists(const key_t& key) const {
   return elems_map_.find(key) != elems_map_.end();
@@ -154,9 +179,11 @@ template <typename key_t, typename value_t>
 value_t& LRUCache<key_t, value_t>::GetMutable(const key_t& key) {
   const auto it = elems_map_.find(key);
   if (it == elems_map_.end()) {
+    num_misses_ += 1;
     Set(key, std::move(getter_func_(key)));
     return elems_map_[key]->second;
   } else {
+    num_hits_ += 1;
     elems_list_.splice(elems_list_.begin(), elems_list_, it->second);
     return it->second->second;
   }
@@ -186,6 +213,15 @@ void LRUCache<key_t, value_t>::Pop() {
   }
 }
 
+template <typename key_t, typename value_t>
+void LRUCache<key_t, value_t>::Erase(const key_t& key) {
+  const auto it = elems_map_.find(key);
+  if (it != elems_map_.end()) {
+    elems_list_.erase(it->second);
+    elems_map_.erase(it);
+  }
+}
+
 template <typename key_t, typename value_t>
 void LRUCache<key_t, value_t>::Clear() {
   elems_list_.clear();
@@ -245,6 +281,16 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Pop() {
   }
 }
 
+template <typename key_t, typename value_t>
+void MemoryConstrainedLRUCache<key_t, value_t>::Erase(const key_t& key) {
+  const auto it = elems_num_bytes_.find(key);
+  if (it != elems_num_bytes_.end()) {
+    num_bytes_ -= it->second;
+    elems_num_bytes_.erase(it);
+    LRUCache<key_t, value_t>::Erase(key);
+  }
+}
+
 template <typename key_t, typename value_t>
 void MemoryConstrainedLRUCache<key_t, value_t>::UpdateNumBytes(
     const key_t& key) {
@@ -66,6 +66,27 @@ TEST(LRUCache, Get) {
   EXPECT_TRUE(cache.Exists(6));
 }
 
+TEST(LRUCache, NumHitsMisses) {
+  LRUCache<int, int> cache(2, [](const int key) { return key; });
+  EXPECT_EQ(cache.NumHits(), 0);
+  EXPECT_EQ(cache.NumMisses(), 0);
+  cache.Get(0);
+  cache.Get(1);
+  EXPECT_EQ(cache.NumHits(), 0);
+  EXPECT_EQ(cache.NumMisses(), 2);
+  cache.Get(0);
+  cache.GetMutable(1);
+  EXPECT_EQ(cache.NumHits(), 2);
+  EXPECT_EQ(cache.NumMisses(), 2);
+  cache.Get(2);
+  cache.Get(0);
+  EXPECT_EQ(cache.NumHits(), 2);
+  EXPECT_EQ(cache.NumMisses(), 4);
+  cache.Set(3, 3);
+  EXPECT_EQ(cache.NumHits(), 2);
+  EXPECT_EQ(cache.NumMisses(), 4);
+}
+
 TEST(LRUCache, GetMutable) {
   LRUCache<int, int> cache(5, [](const int key) { return key; });
   EXPECT_EQ(cache.NumElems(), 0);
@@ -148,6 +169,25 @@ TEST(LRUCache, Pop) {
   EXPECT_EQ(cache.NumElems(), 0);
 }
 
+TEST(LRUCache, Erase) {
+  LRUCache<int, int> cache(5, [](const int key) { return key; });
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(cache.Get(i), i);
+  }
+
+  cache.Erase(1);
+  EXPECT_EQ(cache.NumElems(), 2);
+  EXPECT_TRUE(cache.Exists(0));
+  EXPECT_FALSE(cache.Exists(1));
+  EXPECT_TRUE(cache.Exists(2));
+  cache.Erase(1);
+  EXPECT_EQ(cache.NumElems(), 2);
+
+  cache.Pop();
+  EXPECT_FALSE(cache.Exists(0));
+  EXPECT_TRUE(cache.Exists(2));
+}
+
 TEST(LRUCache, Clear) {
   LRUCache<int, int> cache(5, [](const int key) { return key; });
   EXPECT_EQ(cache.NumElems(), 0);
@@ -237,6 +277,25 @@ TEST(MemoryConstrainedLRUCache, Clear) {
   EXPECT_TRUE(cache.Exists(1));
 }
 
+TEST(MemoryConstrainedLRUCache, Erase) {
+  MemoryConstrainedLRUCache<int, SizedElem> cache(
+      10, [](const int key) { return SizedElem(key); });
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(cache.Get(i).NumBytes(), i);
+  }
+  EXPECT_EQ(cache.NumBytes(), 6);
+
+  cache.Erase(2);
+  EXPECT_EQ(cache.NumElems(), 3);
+  EXPECT_EQ(cache.NumBytes(), 4);
+  EXPECT_FALSE(cache.Exists(2));
+  cache.Erase(2);
+  EXPECT_EQ(cache.NumBytes(), 4);
+
+  EXPECT_EQ(cache.Get(2).NumBytes(), 2);
+  EXPECT_EQ(cache.NumBytes(), 6);
+}
+
 TEST(MemoryConstrainedLRUCache, UpdateNumBytes) {
   MemoryConstrainedLRUCache<int, SizedElem> cache(
       50, [](const int key) { return SizedElem(key); });
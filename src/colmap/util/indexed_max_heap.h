@@ -0,0 +1,246 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/util/logging.h"
+
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+
+// Binary max-heap with an index from keys to heap positions, such that the
+// priority of existing keys can be updated and keys can be removed in
+// logarithmic time. Each key is contained at most once.
+template <typename key_t, typename priority_t>
+class IndexedMaxHeap {
+ public:
+  size_t Size() const;
+  bool Empty() const;
+
+  // Check whether the key is contained in the heap.
+  bool Contains(const key_t& key) const;
+
+  // Get the priority of a contained key.
+  const priority_t& Priority(const key_t& key) const;
+
+  // Insert a new key or update the priority of an existing key.
+  void Set(const key_t& key, const priority_t& priority);
+
+  // Remove the key from the heap, if it is contained.
+  void Erase(const key_t& key);
+
+  // Access and remove the key with the highest priority.
+  const key_t& Top() const;
+  void Pop();
+
+  // Remove all keys from the heap.
+  void Clear();
+
+  // Get up to the given number of keys ordered by decreasing priority without
+  // modifying the heap. Keys for which the optional skip function returns true
+  // are ignored. The cost depends only on the number of visited keys and not
+  // on the size of the heap.
+  std::vector<key_t> TopKeys(
+      size_t max_num_keys,
+      const std::function<bool(const key_t&)>& skip_func = nullptr) const;
+
+ private:
+  void Swap(size_t idx1, size_t idx2);
+  void SiftUp(size_t idx);
+  void SiftDown(size_t idx);
+
+  std::vector<std::pair<key_t, priority_t>> nodes_;
+  std::unordered_map<key_t, size_t> node_idxs_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename key_t, typename priority_t>
+size_t IndexedMaxHeap<key_t, priority_t>::Size() const {
+  return nodes_.size();
+}
+
+template <typename key_t, typename priority_t>
+bool IndexedMaxHeap<key_t, priority_t>::Empty() const {
+  return nodes_.empty();
+}
+
+template <typename key_t, typename priority_t>
+bool IndexedMaxHeap<key_t, priority_t>::Contains(const key_t& key) const {
+  return node_idxs_.count(key) > 0;
+}
+
+template <typename key_t, typename priority_t>
+const priority_t& IndexedMaxHeap<key_t, priority_t>::Priority(
+    const key_t& key) const {
+  return nodes_.at(node_idxs_.at(key)).second;
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::Set(const key_t& key,
+                                            const priority_t& priority) {
+  const auto it = node_idxs_.find(key);
+  if (it == node_idxs_.end()) {
+    node_idxs_.emplace(key, nodes_.size());
+    nodes_.emplace_back(key, priority);
+    SiftUp(nodes_.size() - 1);
+  } else {
+    const size_t idx = it->second;
+    const bool increased = nodes_[idx].second < priority;
+    nodes_[idx].second = priority;
+    if (increased) {
+      SiftUp(idx);
+    } else {
+      SiftDown(idx);
+    }
+  }
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::Erase(const key_t& key) {
+  const auto it = node_idxs_.find(key);
+  if (it == node_idxs_.end()) {
+    return;
+  }
+
+  const size_t idx = it->second;
+  const size_t last_idx = nodes_.size() - 1;
+  if (idx != last_idx) {
+    Swap(idx, last_idx);
+  }
+  node_idxs_.erase(it);
+  nodes_.pop_back();
+
+  if (idx < nodes_.size()) {
+    SiftUp(idx);
+    SiftDown(idx);
+  }
+}
+
+template <typename key_t, typename priority_t>
+const key_t& IndexedMaxHeap<key_t, priority_t>::Top() const {
+  THROW_CHECK(!nodes_.empty());
+  return nodes_.front().first;
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::Pop() {
+  THROW_CHECK(!nodes_.empty());
+  Erase(nodes_.front().first);
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::Clear() {
+  nodes_.clear();
+  node_idxs_.clear();
+}
+
+template <typename key_t, typename priority_t>
+std::vector<key_t> IndexedMaxHeap<key_t, priority_t>::TopKeys(
+    const size_t max_num_keys,
+    const std::function<bool(const key_t&)>& skip_func) const {
+  std::vector<key_t> keys;
+  if (nodes_.empty() || max_num_keys == 0) {
+    return keys;
+  }
+
+  // Best-first traversal of the heap, where the frontier contains the
+  // children of all visited nodes.
+  const auto compare_nodes = [this](const size_t idx1, const size_t idx2) {
+    return nodes_[idx1].second < nodes_[idx2].second;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(compare_nodes)>
+      frontier(compare_nodes);
+  frontier.push(0);
+  while (!frontier.empty() && keys.size() < max_num_keys) {
+    const size_t idx = frontier.top();
+    frontier.pop();
+    if (!skip_func || !skip_func(nodes_[idx].first)) {
+      keys.push_back(nodes_[idx].first);
+    }
+    for (size_t child_idx = 2 * idx + 1;
+         child_idx <= 2 * idx + 2 && child_idx < nodes_.size();
+         ++child_idx) {
+      frontier.push(child_idx);
+    }
+  }
+
+  return keys;
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::Swap(const size_t idx1,
+                                             const size_t idx2) {
+  std::swap(nodes_[idx1], nodes_[idx2]);
+  node_idxs_[nodes_[idx1].first] = idx1;
+  node_idxs_[nodes_[idx2].first] = idx2;
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::SiftUp(size_t idx) {
+  while (idx > 0) {
+    const size_t parent_idx = (idx - 1) / 2;
+    if (!(nodes_[parent_idx].second < nodes_[idx].second)) {
+      break;
+    }
+    Swap(idx, parent_idx);
+    idx = parent_idx;
+  }
+}
+
+template <typename key_t, typename priority_t>
+void IndexedMaxHeap<key_t, priority_t>::SiftDown(size_t idx) {
+  while (true) {
+    const size_t left_idx = 2 * idx + 1;
+    const size_t right_idx = left_idx + 1;
+    size_t max_idx = idx;
+    if (left_idx < nodes_.size() &&
+        nodes_[max_idx].second < nodes_[left_idx].second) {
+      max_idx = left_idx;
+    }
+    if (right_idx < nodes_.size() &&
+        nodes_[max_idx].second < nodes_[right_idx].second) {
+      max_idx = right_idx;
+    }
+    if (max_idx == idx) {
+      break;
+    }
+    Swap(idx, max_idx);
+    idx = max_idx;
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,135 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/indexed_max_heap.h"
+
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(IndexedMaxHeap, Empty) {
+  IndexedMaxHeap<int, float> heap;
+  EXPECT_TRUE(heap.Empty());
+  EXPECT_EQ(heap.Size(), 0);
+  EXPECT_FALSE(heap.Contains(0));
+  EXPECT_TRUE(heap.TopKeys(10).empty());
+  EXPECT_ANY_THROW(heap.Top());
+  EXPECT_ANY_THROW(heap.Pop());
+}
+
+TEST(IndexedMaxHeap, SetAndPop) {
+  IndexedMaxHeap<int, float> heap;
+  heap.Set(1, 1.f);
+  heap.Set(2, 3.f);
+  heap.Set(3, 2.f);
+  EXPECT_EQ(heap.Size(), 3);
+  EXPECT_TRUE(heap.Contains(2));
+  EXPECT_EQ(heap.Priority(2), 3.f);
+  EXPECT_EQ(heap.Top(), 2);
+  heap.Pop();
+  EXPECT_FALSE(heap.Contains(2));
+  EXPECT_EQ(heap.Top(), 3);
+  heap.Pop();
+  EXPECT_EQ(heap.Top(), 1);
+  heap.Pop();
+  EXPECT_TRUE(heap.Empty());
+}
+
+TEST(IndexedMaxHeap, Update) {
+  IndexedMaxHeap<int, float> heap;
+  for (int i = 0; i < 10; ++i) {
+    heap.Set(i, static_cast<float>(i));
+  }
+  EXPECT_EQ(heap.Top(), 9);
+  heap.Set(0, 100.f);
+  EXPECT_EQ(heap.Size(), 10);
+  EXPECT_EQ(heap.Top(), 0);
+  heap.Set(0, -1.f);
+  EXPECT_EQ(heap.Top(), 9);
+  heap.Erase(9);
+  heap.Erase(9);
+  EXPECT_EQ(heap.Size(), 9);
+  EXPECT_EQ(heap.Top(), 8);
+  EXPECT_EQ(heap.TopKeys(3), std::vector<int>({8, 7, 6}));
+  heap.Clear();
+  EXPECT_TRUE(heap.Empty());
+  EXPECT_FALSE(heap.Contains(0));
+}
+
+TEST(IndexedMaxHeap, TopKeys) {
+  IndexedMaxHeap<int, float> heap;
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0, 1);
+  std::vector<std::pair<float, int>> expected;
+  for (int i = 0; i < 1000; ++i) {
+    heap.Set(i, distribution(prng));
+  }
+  for (int i = 0; i < 1000; i += 3) {
+    heap.Set(i, distribution(prng));
+  }
+  for (int i = 0; i < 1000; i += 7) {
+    heap.Erase(i);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (heap.Contains(i)) {
+      expected.emplace_back(heap.Priority(i), i);
+    }
+  }
+  std::sort(expected.rbegin(), expected.rend());
+  EXPECT_EQ(heap.Size(), expected.size());
+
+  const std::vector<int> top_keys = heap.TopKeys(expected.size() + 10);
+  ASSERT_EQ(top_keys.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(top_keys[i], expected[i].second);
+  }
+
+  const std::vector<int> top_odd_keys =
+      heap.TopKeys(5, [](const int key) { return key % 2 == 0; });
+  std::vector<int> expected_odd_keys;
+  for (const auto& priority_and_key : expected) {
+    if (priority_and_key.second % 2 == 1 && expected_odd_keys.size() < 5) {
+      expected_odd_keys.push_back(priority_and_key.second);
+    }
+  }
+  EXPECT_EQ(top_odd_keys, expected_odd_keys);
+
+  for (const auto& priority_and_key : expected) {
+    EXPECT_EQ(heap.Top(), priority_and_key.second);
+    heap.Pop();
+  }
+  EXPECT_TRUE(heap.Empty());
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,87 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/mapped_file.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace colmap {
+
+MappedFile::MappedFile(const std::string& path)
+    : MappedFile(path, GetFileSize(path)) {}
+
+MappedFile::MappedFile(const std::string& path, const size_t num_bytes)
+    : MappedFile(path, num_bytes, num_bytes) {}
+
+MappedFile::MappedFile(const std::string& path,
+                       const size_t num_bytes,
+                       const size_t capacity)
+    : num_bytes_(num_bytes), capacity_(capacity) {
+  THROW_CHECK_LE(num_bytes_, capacity_);
+#ifdef _WIN32
+  capacity_ = num_bytes_;
+#endif
+  if (capacity_ == 0) {
+    return;
+  }
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  buffer_.resize(num_bytes_);
+  file.read(buffer_.data(), num_bytes_);
+  THROW_CHECK(file) << "Failed to read " << path;
+  data_ = buffer_.data();
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  THROW_CHECK_GE(fd, 0) << "Failed to open " << path;
+  void* data = mmap(nullptr, capacity_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  THROW_CHECK(data != MAP_FAILED) << "Failed to map " << path;
+  data_ = static_cast<const char*>(data);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), capacity_);
+  }
+#endif
+}
+
+}  // namespace colmap
@@ -0,0 +1,69 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Read-only mapping of a file into memory. On platforms without POSIX memory
+// mapping, the file contents are read into memory.
+class MappedFile {
+ public:
+  // Map the entire file.
+  explicit MappedFile(const std::string& path);
+  // Map only the first bytes of the file.
+  MappedFile(const std::string& path, size_t num_bytes);
+  // Map the first bytes of the file and reserve address space for up to
+  // `capacity` bytes, such that data appended to the file later on can be
+  // accessed through the same mapping once it has been written. Bytes beyond
+  // the current end of the file must not be accessed. On platforms without
+  // POSIX memory mapping, the capacity is equal to the number of bytes.
+  MappedFile(const std::string& path, size_t num_bytes, size_t capacity);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Data() const { return data_; }
+  size_t NumBytes() const { return num_bytes_; }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  size_t num_bytes_ = 0;
+  size_t capacity_ = 0;
+  const char* data_ = nullptr;
+#ifdef _WIN32
+  std::vector<char> buffer_;
+#endif
+};
+
+}  // namespace colmap
@@ -31,6 +31,9 @@
 
 #include "colmap/util/logging.h"
 
+#include <algorithm>
+#include <exception>
+
 namespace colmap {
 
 Thread::Thread()
@@ -181,9 +184,28 @@ void Thread::RunFunc() {
   Callback(FINISHED_CALLBACK);
 }
 
+namespace {
+
+// The thread pool and index of the calling worker thread.
+struct WorkerInfo {
+  const ThreadPool* thread_pool = nullptr;
+  int index = -1;
+};
+
+thread_local WorkerInfo tls_worker_info;
+
+}  // namespace
+
 ThreadPool::ThreadPool(const int num_threads)
-    : stopped_(false), num_active_workers_(0) {
+    : num_queued_tasks_(0),
+      num_unfinished_tasks_(0),
+      stopped_(false),
+      num_sleeping_workers_(0) {
   const int num_effective_threads = GetEffectiveNumThreads(num_threads);
+  queues_.reserve(num_effective_threads);
+  for (int index = 0; index < num_effective_threads; ++index) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
   for (int index = 0; index < num_effective_threads; ++index) {
     std::function<void(void)> worker =
         std::bind(&ThreadPool::WorkerFunc, this, index);
@@ -194,74 +216,273 @@ ThreadPool::ThreadPool(const int num_threads)
 ThreadPool::~ThreadPool() { Stop(); }
 
 void ThreadPool::Stop() {
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
+  if (stopped_.exchange(true)) {
+    return;
+  }
 
-    if (stopped_) {
-      return;
+  // The discarded tasks are destroyed outside the queue locks, since their
+  // destruction may notify waiting threads, e.g., in ParallelFor.
+  std::vector<std::function<void()>> discarded_tasks;
+  auto DiscardTasks = [&discarded_tasks](WorkerQueue* queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (auto& task : queue->tasks) {
+      discarded_tasks.push_back(std::move(task));
     }
-
-    stopped_ = true;
-
-    std::queue<std::function<void()>> empty_tasks;
-    std::swap(tasks_, empty_tasks);
+    queue->tasks.clear();
+  };
+  DiscardTasks(&injection_queue_);
+  for (auto& queue : queues_) {
+    DiscardTasks(queue.get());
+  }
+  const size_t num_discarded_tasks = discarded_tasks.size();
+  num_queued_tasks_ -= num_discarded_tasks;
+  if (num_discarded_tasks > 0) {
+    num_unfinished_tasks_ -= num_discarded_tasks;
   }
+  discarded_tasks.clear();
 
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
   task_condition_.notify_all();
 
   for (auto& worker : workers_) {
     worker.join();
   }
 
+  {
+    std::lock_guard<std::mutex> lock(finished_mutex_);
+  }
   finished_condition_.notify_all();
 }
 
 void ThreadPool::Wait() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  if (!tasks_.empty() || num_active_workers_ > 0) {
-    finished_condition_.wait(
-        lock, [this]() { return tasks_.empty() && num_active_workers_ == 0; });
-  }
+  std::unique_lock<std::mutex> lock(finished_mutex_);
+  finished_condition_.wait(lock,
+                           [this]() { return num_unfinished_tasks_ == 0; });
 }
 
-void ThreadPool::WorkerFunc(const int index) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    thread_id_to_index_.emplace(GetThreadId(), index);
+void ThreadPool::ParallelFor(const size_t begin,
+                             const size_t end,
+                             const size_t grain_size,
+                             const std::function<void(size_t, size_t)>& func) {
+  THROW_CHECK_GT(grain_size, 0);
+  if (begin >= end) {
+    return;
   }
 
-  while (true) {
-    std::function<void()> task;
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      task_condition_.wait(lock,
-                           [this] { return stopped_ || !tasks_.empty(); });
-      if (stopped_ && tasks_.empty()) {
+  // The state is shared with the scheduled tasks, which may only start after
+  // all chunks were processed and this function returned.
+  struct State {
+    size_t begin;
+    size_t end;
+    size_t grain_size;
+    size_t num_chunks;
+    const std::function<void(size_t, size_t)>* func;
+    std::atomic<size_t> next_chunk_idx{0};
+    std::mutex mutex;
+    std::condition_variable finished_condition;
+    size_t num_finished_chunks = 0;
+    std::exception_ptr exception;
+
+    void FinishChunks(const size_t num_chunks,
+                      const std::exception_ptr& chunk_exception) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (chunk_exception && !exception) {
+        exception = chunk_exception;
+      }
+      num_finished_chunks += num_chunks;
+      if (num_finished_chunks == this->num_chunks) {
+        finished_condition.notify_all();
+      }
+    }
+  };
+
+  // Fails all unclaimed chunks when a scheduled task is destroyed. This is a
+  // no-op if the task ran, since it only returns once all chunks are claimed,
+  // but it keeps the caller from waiting forever if Stop() discards the task.
+  struct TaskGuard {
+    std::shared_ptr<State> state;
+    ~TaskGuard() {
+      size_t num_canceled_chunks = 0;
+      while (state->next_chunk_idx++ < state->num_chunks) {
+        num_canceled_chunks += 1;
+      }
+      if (num_canceled_chunks > 0) {
+        state->FinishChunks(num_canceled_chunks,
+                            std::make_exception_ptr(std::runtime_error(
+                                "Thread pool was stopped.")));
+      }
+    }
+  };
+
+  auto state = std::make_shared<State>();
+  state->begin = begin;
+  state->end = end;
+  state->grain_size = grain_size;
+  state->num_chunks = (end - begin + grain_size - 1) / grain_size;
+  state->func = &func;
+
+  auto ProcessChunks = [](State* state) {
+    while (true) {
+      const size_t chunk_idx = state->next_chunk_idx++;
+      if (chunk_idx >= state->num_chunks) {
         return;
       }
-      task = std::move(tasks_.front());
-      tasks_.pop();
-      num_active_workers_ += 1;
+      const size_t chunk_begin = state->begin + chunk_idx * state->grain_size;
+      const size_t chunk_end =
+          std::min(chunk_begin + state->grain_size, state->end);
+      std::exception_ptr exception;
+      try {
+        (*state->func)(chunk_begin, chunk_end);
+      } catch (...) {
+        exception = std::current_exception();
+      }
+      state->FinishChunks(1, exception);
     }
+  };
+
+  const bool is_worker = GetWorkerIndex() >= 0;
+  const size_t num_tasks =
+      std::min(state->num_chunks - (is_worker ? 1 : 0), NumThreads());
+  for (size_t i = 0; i < num_tasks; ++i) {
+    auto guard = std::make_shared<TaskGuard>();
+    guard->state = state;
+    try {
+      ScheduleTask(
+          [guard, ProcessChunks]() { ProcessChunks(guard->state.get()); });
+    } catch (const std::runtime_error&) {
+      // The pool was stopped and the destroyed guard failed the remaining
+      // chunks, but the already scheduled tasks may still be running.
+      break;
+    }
+  }
+
+  if (is_worker) {
+    ProcessChunks(state.get());
+  }
 
-    task();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished_condition.wait(lock, [&state]() {
+    return state->num_finished_chunks == state->num_chunks;
+  });
+  if (state->exception) {
+    std::rethrow_exception(state->exception);
+  }
+}
+
+void ThreadPool::ScheduleTask(std::function<void()> task) {
+  // Tasks of workers go to their own deque and external tasks to the shared
+  // injection queue, which is served in FIFO order.
+  const int worker_index = GetWorkerIndex();
+  WorkerQueue& queue =
+      worker_index >= 0 ? *queues_[worker_index] : injection_queue_;
+  {
+    // Stop() sets the stopped flag before it discards the tasks of each queue
+    // under its lock, so the task is either rejected here or discarded there.
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (stopped_) {
+      throw std::runtime_error("Cannot add task to stopped thread pool.");
+    }
+    num_unfinished_tasks_ += 1;
+    num_queued_tasks_ += 1;
+    queue.tasks.push_back(std::move(task));
+  }
 
+  // Only wake up a sleeping worker if there is one. The sleeping workers
+  // re-check the number of queued tasks after announcing themselves, so
+  // that either the task is seen or the sleeping worker is notified.
+  if (num_sleeping_workers_ > 0) {
     {
-      std::unique_lock<std::mutex> lock(mutex_);
-      num_active_workers_ -= 1;
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    task_condition_.notify_one();
+  }
+}
+
+bool ThreadPool::PopTask(const int index, std::function<void()>* task) {
+  // Take the most recent own task for better locality.
+  {
+    WorkerQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Take the oldest external task.
+  {
+    std::lock_guard<std::mutex> lock(injection_queue_.mutex);
+    if (!injection_queue_.tasks.empty()) {
+      *task = std::move(injection_queue_.tasks.front());
+      injection_queue_.tasks.pop_front();
+      return true;
     }
+  }
+
+  // Steal the oldest task of another worker.
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    WorkerQueue& queue = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
 
+  return false;
+}
+
+void ThreadPool::FinishTask() {
+  if (--num_unfinished_tasks_ == 0) {
+    {
+      std::lock_guard<std::mutex> lock(finished_mutex_);
+    }
     finished_condition_.notify_all();
   }
 }
 
+void ThreadPool::WorkerFunc(const int index) {
+  tls_worker_info.thread_pool = this;
+  tls_worker_info.index = index;
+
+  while (true) {
+    std::function<void()> task;
+    if (PopTask(index, &task)) {
+      num_queued_tasks_ -= 1;
+      task();
+      FinishTask();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_workers_ += 1;
+    task_condition_.wait(
+        lock, [this] { return stopped_ || num_queued_tasks_ > 0; });
+    num_sleeping_workers_ -= 1;
+    if (stopped_ && num_queued_tasks_ == 0) {
+      return;
+    }
+  }
+}
+
+int ThreadPool::GetWorkerIndex() const {
+  return tls_worker_info.thread_pool == this ? tls_worker_info.index : -1;
+}
+
 std::thread::id ThreadPool::GetThreadId() const {
   return std::this_thread::get_id();
 }
 
 int ThreadPool::GetThreadIndex() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  return thread_id_to_index_.at(GetThreadId());
+  const int index = GetWorkerIndex();
+  if (index < 0) {
+    throw std::out_of_range("Thread is not a worker of the thread pool.");
+  }
+  return index;
 }
 
 int GetEffectiveNumThreads(const int num_threads) {
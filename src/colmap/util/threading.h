@@ -33,9 +33,13 @@
 
 #include <atomic>
 #include <climits>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <type_traits>
@@ -189,7 +193,15 @@ class Thread {
 //      thread_pool.AddTask([](const int i) { /* Do some work */ });
 //    }
 //    thread_pool.Wait();
+//    thread_pool.ParallelFor(0, 1000, /*grain_size=*/10,
+//                            [](size_t begin, size_t end) { /* Work */ });
 //
+// Every worker owns a deque of tasks, such that workers do not contend on a
+// single shared queue. Tasks added by a worker, e.g., in nested parallel
+// loops, are pushed to its own deque, and other tasks are pushed to a shared
+// injection queue. Workers process their own tasks in LIFO order, then the
+// external tasks in FIFO order, and finally steal the oldest tasks of other
+// workers.
 class ThreadPool {
  public:
   static const int kMaxNumThreads = -1;
@@ -206,12 +218,26 @@ class ThreadPool {
 
   inline size_t NumThreads() const;
 
-  // Add new task to the thread pool.
+  // Add new task to the thread pool. Tasks added by other threads than the
+  // workers are started in the order in which they were added.
   template <class func_t, class... args_t>
   auto AddTask(func_t&& f, args_t&&... args)
       -> std::future<result_of_t<func_t, args_t...>>;
 
-  // Stop the execution of all workers.
+  // Call func(chunk_begin, chunk_end) in parallel for consecutive chunks of at
+  // most grain_size indices that partition [begin, end), and return once all
+  // chunks are processed. The chunks are claimed dynamically in increasing
+  // order. If called from a worker of this pool, the calling worker processes
+  // chunks itself, such that nested parallel loops cannot deadlock. Otherwise,
+  // the chunks are only processed by the workers, such that GetThreadIndex can
+  // be used in func. The first exception thrown by func is rethrown.
+  void ParallelFor(size_t begin,
+                   size_t end,
+                   size_t grain_size,
+                   const std::function<void(size_t, size_t)>& func);
+
+  // Stop the execution of all workers. Queued tasks are discarded, such that
+  // their futures report a broken promise and pending ParallelFor calls throw.
   void Stop();
 
   // Wait until tasks are finished.
@@ -226,19 +252,36 @@ class ThreadPool {
   int GetThreadIndex();
 
  private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
   void WorkerFunc(int index);
 
+  // Index of the calling thread in this pool or -1 for other threads.
+  int GetWorkerIndex() const;
+
+  void ScheduleTask(std::function<void()> task);
+  bool PopTask(int index, std::function<void()>* task);
+  void FinishTask();
+
   std::vector<std::thread> workers_;
-  std::queue<std::function<void()>> tasks_;
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  WorkerQueue injection_queue_;
 
-  std::mutex mutex_;
-  std::condition_variable task_condition_;
-  std::condition_variable finished_condition_;
+  // Number of tasks in the queues and number of queued or running tasks.
+  std::atomic<size_t> num_queued_tasks_;
+  std::atomic<size_t> num_unfinished_tasks_;
 
-  bool stopped_;
-  int num_active_workers_;
+  std::atomic<bool> stopped_;
+  std::atomic<int> num_sleeping_workers_;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable task_condition_;
 
-  std::unordered_map<std::thread::id, int> thread_id_to_index_;
+  std::mutex finished_mutex_;
+  std::condition_variable finished_condition_;
 };
 
 // A job queue class for the producer-consumer paradigm.
@@ -334,15 +377,7 @@ auto ThreadPool::AddTask(func_t&& f, args_t&&... args)
 
   std::future<return_t> result = task->get_future();
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (stopped_) {
-      throw std::runtime_error("Cannot add task to stopped thread pool.");
-    }
-    tasks_.emplace([task]() { (*task)(); });
-  }
-
-  task_condition_.notify_one();
+  ScheduleTask([task]() { (*task)(); });
 
   return result;
 }
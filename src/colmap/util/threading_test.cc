@@ -640,6 +640,151 @@ TEST(ThreadPool, GetThreadIndex) {
   }
 }
 
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  for (const size_t grain_size : {1, 3, 7, 100, 1000}) {
+    std::vector<int> results(100, 0);
+    pool.ParallelFor(
+        0, results.size(), grain_size, [&](const size_t begin, size_t end) {
+          EXPECT_LE(end - begin, grain_size);
+          for (size_t i = begin; i < end; ++i) {
+            results[i] += 1;
+          }
+        });
+    for (const auto result : results) {
+      EXPECT_EQ(result, 1);
+    }
+  }
+
+  int num_calls = 0;
+  pool.ParallelFor(5, 5, 1, [&](size_t, size_t) { ++num_calls; });
+  EXPECT_EQ(num_calls, 0);
+  EXPECT_THROW(pool.ParallelFor(0, 1, 0, [](size_t, size_t) {}),
+               std::invalid_argument);
+}
+
+TEST(ThreadPool, ParallelForWorkerIndex) {
+  ThreadPool pool(4);
+  std::vector<int> results(100, -1);
+  pool.ParallelFor(0, results.size(), 1, [&](const size_t i, size_t) {
+    results[i] = pool.GetThreadIndex();
+  });
+  for (const auto result : results) {
+    EXPECT_GE(result, 0);
+    EXPECT_LE(result, 3);
+  }
+}
+
+TEST(ThreadPool, ParallelForNested) {
+  ThreadPool pool(2);
+  std::vector<std::atomic<int>> results(100);
+  for (auto& result : results) {
+    result = 0;
+  }
+
+  // Nested calls from tasks and chunks must not deadlock, even if all workers
+  // are blocked in an outer loop.
+  for (int i = 0; i < 4; ++i) {
+    pool.AddTask([&]() {
+      pool.ParallelFor(0, 10, 1, [&](const size_t outer, size_t) {
+        pool.ParallelFor(0, 10, 3, [&](size_t begin, const size_t end) {
+          for (; begin < end; ++begin) {
+            results[outer * 10 + begin] += 1;
+          }
+        });
+      });
+    });
+  }
+  pool.Wait();
+
+  for (const auto& result : results) {
+    EXPECT_EQ(result, 4);
+  }
+}
+
+TEST(ThreadPool, ParallelForException) {
+  ThreadPool pool(4);
+  std::atomic<int> num_processed(0);
+  EXPECT_THROW(pool.ParallelFor(0,
+                                100,
+                                1,
+                                [&](const size_t i, size_t) {
+                                  num_processed += 1;
+                                  if (i == 42) {
+                                    throw std::runtime_error("Error");
+                                  }
+                                }),
+               std::runtime_error);
+  // All chunks are still processed before the exception is propagated.
+  EXPECT_EQ(num_processed, 100);
+}
+
+TEST(ThreadPool, ExternalTasksInOrder) {
+  ThreadPool pool(1);
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  pool.AddTask([unblocked]() { unblocked.wait(); });
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    pool.AddTask([&order, i]() { order.push_back(i); });
+  }
+  unblock.set_value();
+  pool.Wait();
+  ASSERT_EQ(order.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(ThreadPool, ParallelForStop) {
+  ThreadPool pool(1);
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  pool.AddTask([unblocked]() { unblocked.wait(); });
+  std::atomic<int> num_processed(0);
+  std::atomic<bool> stopped_error(false);
+  // The loop either fails to schedule its tasks or they are discarded by
+  // Stop() while the only worker is blocked, but it must not hang.
+  std::thread thread([&]() {
+    try {
+      pool.ParallelFor(
+          0, 10, 1, [&](size_t, size_t) { num_processed += 1; });
+    } catch (const std::runtime_error&) {
+      stopped_error = true;
+    }
+    unblock.set_value();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  pool.Stop();
+  thread.join();
+  EXPECT_TRUE(stopped_error);
+  EXPECT_EQ(num_processed, 0);
+}
+
+TEST(ThreadPool, AddTaskRacingStop) {
+  for (int i = 0; i < 20; ++i) {
+    ThreadPool pool(2);
+    std::vector<std::future<void>> futures;
+    // Every task added concurrently to Stop() is either rejected, run, or
+    // discarded, such that neither its future nor Wait() hangs.
+    std::thread thread([&]() {
+      try {
+        while (true) {
+          futures.push_back(pool.AddTask([]() {}));
+        }
+      } catch (const std::runtime_error&) {
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    pool.Stop();
+    thread.join();
+    for (auto& future : futures) {
+      future.wait();
+    }
+    pool.Wait();
+  }
+}
+
 TEST(JobQueue, SingleProducerSingleConsumer) {
   JobQueue<int> job_queue;
 
@@ -0,0 +1,411 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/trace.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/string.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+namespace colmap {
+namespace {
+
+std::string EscapeJSON(const char* str) {
+  std::string escaped;
+  for (const char* c = str; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+      escaped += *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      escaped += StringPrintf("\\u%04x", static_cast<int>(*c));
+    } else {
+      escaped += *c;
+    }
+  }
+  return escaped;
+}
+
+const char* TraceStatsTypeToString(const TraceStats::Type type) {
+  switch (type) {
+    case TraceStats::Type::SPAN:
+      return "span";
+    case TraceStats::Type::COUNTER:
+      return "counter";
+    case TraceStats::Type::VALUE:
+      return "value";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+void TraceStats::Add(const double value) {
+  count += 1;
+  sum += value;
+  min = std::min(min, value);
+  max = std::max(max, value);
+  int bin = 0;
+  if (value >= 1) {
+    bin = std::min(kNumBins - 1, 1 + std::ilogb(value));
+  }
+  histogram[bin] += 1;
+}
+
+void TraceStats::Merge(const TraceStats& other) {
+  count += other.count;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  for (int bin = 0; bin < kNumBins; ++bin) {
+    histogram[bin] += other.histogram[bin];
+  }
+}
+
+double TraceStats::Mean() const { return count == 0 ? 0 : sum / count; }
+
+double TraceStats::Quantile(const double q) const {
+  THROW_CHECK_GE(q, 0);
+  THROW_CHECK_LE(q, 1);
+  if (count == 0) {
+    return 0;
+  }
+  const double rank = q * count;
+  size_t cumulative_count = 0;
+  for (int bin = 0; bin < kNumBins; ++bin) {
+    cumulative_count += histogram[bin];
+    if (cumulative_count > 0 && cumulative_count >= rank) {
+      return std::max(min, std::min(max, std::ldexp(1.0, bin)));
+    }
+  }
+  return max;
+}
+
+bool Tracer::Options::Check() const {
+  CHECK_OPTION_GT(max_num_events_per_thread, 0);
+  return true;
+}
+
+struct Tracer::Event {
+  const char* name = nullptr;
+  TraceStats::Type type = TraceStats::Type::SPAN;
+  int64_t timestamp_us = 0;
+  // Duration in microseconds for spans, increment for counters, and sample
+  // for values.
+  double value = 0;
+  // Total of the counter in the recording thread after the increment.
+  double total = 0;
+};
+
+struct Tracer::ThreadBuffer {
+  explicit ThreadBuffer(const int thread_index) : thread_index(thread_index) {}
+
+  void Clear(const size_t max_num_events) {
+    this->max_num_events = max_num_events;
+    events.clear();
+    events.shrink_to_fit();
+    num_events = 0;
+    stats.clear();
+  }
+
+  const int thread_index;
+  std::mutex mutex;
+  // Ring of the most recent events, where the oldest event is at index
+  // `num_events % max_num_events` once the ring is full.
+  size_t max_num_events = 0;
+  std::vector<Event> events;
+  size_t num_events = 0;
+  std::unordered_map<const char*, TraceStats> stats;
+};
+
+// Returns the buffer of an exited thread to the tracer for reuse, so that
+// short-lived threads, e.g., of per-stage thread pools, do not accumulate.
+struct Tracer::ThreadBufferHandle {
+  ~ThreadBufferHandle() {
+    if (thread_buffer != nullptr) {
+      Tracer::Instance().ReleaseThreadBuffer(thread_buffer);
+    }
+  }
+
+  ThreadBuffer* thread_buffer = nullptr;
+};
+
+Tracer::Tracer()
+    : enabled_(false), start_time_(std::chrono::steady_clock::now()) {}
+
+Tracer& Tracer::Instance() {
+  // Intentionally leaked, so that it outlives the buffers of all threads.
+  static Tracer* tracer = new Tracer();
+  return *tracer;
+}
+
+void Tracer::Enable(const Options& options) {
+  THROW_CHECK(options.Check());
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+  for (auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> thread_lock(thread_buffer->mutex);
+    thread_buffer->Clear(options_.max_num_events_per_thread);
+  }
+  enabled_ = true;
+}
+
+void Tracer::Disable() { enabled_ = false; }
+
+void Tracer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> thread_lock(thread_buffer->mutex);
+    thread_buffer->Clear(options_.max_num_events_per_thread);
+  }
+}
+
+int64_t Tracer::NowMicroSeconds() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start_time_)
+      .count();
+}
+
+void Tracer::RecordSpan(const char* name,
+                        const int64_t begin_us,
+                        const int64_t end_us) {
+  Event event;
+  event.name = name;
+  event.type = TraceStats::Type::SPAN;
+  event.timestamp_us = begin_us;
+  event.value = static_cast<double>(end_us - begin_us);
+  Record(event);
+}
+
+void Tracer::RecordCounter(const char* name, const double increment) {
+  Event event;
+  event.name = name;
+  event.type = TraceStats::Type::COUNTER;
+  event.timestamp_us = NowMicroSeconds();
+  event.value = increment;
+  Record(event);
+}
+
+void Tracer::RecordValue(const char* name, const double value) {
+  Event event;
+  event.name = name;
+  event.type = TraceStats::Type::VALUE;
+  event.timestamp_us = NowMicroSeconds();
+  event.value = value;
+  Record(event);
+}
+
+Tracer::ThreadBuffer* Tracer::GetThreadBuffer() {
+  thread_local ThreadBufferHandle handle;
+  if (handle.thread_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_thread_buffers_.empty()) {
+      thread_buffers_.push_back(
+          std::make_unique<ThreadBuffer>(thread_buffers_.size() + 1));
+      handle.thread_buffer = thread_buffers_.back().get();
+      handle.thread_buffer->max_num_events =
+          options_.max_num_events_per_thread;
+    } else {
+      handle.thread_buffer = free_thread_buffers_.back();
+      free_thread_buffers_.pop_back();
+    }
+  }
+  return handle.thread_buffer;
+}
+
+void Tracer::ReleaseThreadBuffer(ThreadBuffer* thread_buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_thread_buffers_.push_back(thread_buffer);
+}
+
+void Tracer::Record(Event event) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  ThreadBuffer* thread_buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(thread_buffer->mutex);
+
+  TraceStats& stats = thread_buffer->stats[event.name];
+  if (stats.count == 0) {
+    stats.name = event.name;
+    stats.type = event.type;
+  }
+  stats.Add(event.value);
+  event.total = stats.sum;
+
+  if (thread_buffer->events.size() < thread_buffer->max_num_events) {
+    thread_buffer->events.push_back(event);
+  } else {
+    thread_buffer->events[thread_buffer->num_events %
+                          thread_buffer->max_num_events] = event;
+  }
+  thread_buffer->num_events += 1;
+}
+
+std::vector<TraceStats> Tracer::Stats() const {
+  // Merge by name, since the same name may be defined in different
+  // translation units with different addresses.
+  std::map<std::string, TraceStats> merged_stats;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> thread_lock(thread_buffer->mutex);
+    for (const auto& stats : thread_buffer->stats) {
+      const auto it = merged_stats.find(stats.second.name);
+      if (it == merged_stats.end()) {
+        merged_stats.emplace(stats.second.name, stats.second);
+      } else {
+        it->second.Merge(stats.second);
+      }
+    }
+  }
+
+  std::vector<TraceStats> all_stats;
+  all_stats.reserve(merged_stats.size());
+  for (auto& stats : merged_stats) {
+    all_stats.push_back(std::move(stats.second));
+  }
+  return all_stats;
+}
+
+size_t Tracer::NumDroppedEvents() const {
+  size_t num_dropped_events = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> thread_lock(thread_buffer->mutex);
+    num_dropped_events +=
+        thread_buffer->num_events - thread_buffer->events.size();
+  }
+  return num_dropped_events;
+}
+
+void Tracer::WriteChromeTrace(const std::string& path) const {
+  const size_t num_dropped_events = NumDroppedEvents();
+
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+  file.precision(15);
+
+  file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"num_dropped_events\":"
+       << num_dropped_events << "},\"traceEvents\":[";
+
+  bool is_first_event = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> thread_lock(thread_buffer->mutex);
+    const size_t num_events = thread_buffer->events.size();
+    const size_t begin_idx =
+        thread_buffer->num_events > num_events
+            ? thread_buffer->num_events % thread_buffer->max_num_events
+            : 0;
+    for (size_t i = 0; i < num_events; ++i) {
+      const Event& event = thread_buffer->events[(begin_idx + i) % num_events];
+      file << (is_first_event ? "\n" : ",\n") << "{\"name\":\""
+           << EscapeJSON(event.name) << "\",\"cat\":\"colmap\",\"pid\":0,"
+           << "\"tid\":" << thread_buffer->thread_index
+           << ",\"ts\":" << event.timestamp_us;
+      switch (event.type) {
+        case TraceStats::Type::SPAN:
+          file << ",\"ph\":\"X\",\"dur\":"
+               << static_cast<int64_t>(event.value);
+          break;
+        case TraceStats::Type::COUNTER:
+          // Counter tracks stack the series of all threads to the total.
+          file << ",\"ph\":\"C\",\"args\":{\"thread "
+               << thread_buffer->thread_index << "\":" << event.total << "}";
+          break;
+        case TraceStats::Type::VALUE:
+          file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}";
+          break;
+      }
+      file << "}";
+      is_first_event = false;
+    }
+  }
+
+  file << "\n]}\n";
+}
+
+std::string Tracer::Summary() const {
+  std::ostringstream summary;
+  summary << StringPrintf("%-40s %-7s %10s %14s %12s %12s %12s %12s %12s\n",
+                          "Name",
+                          "Type",
+                          "Count",
+                          "Total",
+                          "Mean",
+                          "P50",
+                          "P90",
+                          "P99",
+                          "Max");
+  for (const TraceStats& stats : Stats()) {
+    const double scale = stats.type == TraceStats::Type::SPAN ? 1e-3 : 1;
+    summary << StringPrintf(
+        "%-40s %-7s %10zu %14.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+        stats.name.c_str(),
+        TraceStatsTypeToString(stats.type),
+        stats.count,
+        scale * stats.sum,
+        scale * stats.Mean(),
+        scale * stats.Quantile(0.5),
+        scale * stats.Quantile(0.9),
+        scale * stats.Quantile(0.99),
+        scale * stats.max);
+  }
+  return summary.str();
+}
+
+void Tracer::Finish() {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  Disable();
+
+  std::string output_path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_path = options_.output_path;
+  }
+
+  if (!output_path.empty()) {
+    WriteChromeTrace(output_path);
+    LOG(INFO) << "Wrote trace to " << output_path;
+  }
+
+  LOG(INFO) << "Trace summary (durations in milliseconds):\n" << Summary();
+}
+
+}  // namespace colmap
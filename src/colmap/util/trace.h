@@ -0,0 +1,221 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Aggregated statistics of all recorded spans, counters, or values of one name.
+struct TraceStats {
+  enum class Type {
+    // Durations of scoped spans in microseconds.
+    SPAN = 0,
+    // Increments of counters.
+    COUNTER = 1,
+    // Samples of a value distribution.
+    VALUE = 2,
+  };
+
+  // Histogram with logarithmically increasing bin widths, where the first bin
+  // covers values below 1 and bin i > 0 covers values in [2^(i-1), 2^i).
+  static const int kNumBins = 64;
+
+  std::string name;
+  Type type = Type::SPAN;
+  size_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+  std::array<size_t, kNumBins> histogram{};
+
+  void Add(double value);
+  void Merge(const TraceStats& other);
+
+  double Mean() const;
+
+  // Approximate quantile in [0, 1] as the upper bound of the histogram bin
+  // containing the quantile, clamped to the range of the values.
+  double Quantile(double q) const;
+};
+
+// Process-wide collector of scoped spans, counters, and value distributions,
+// e.g., to find out where the time goes in long-running reconstructions:
+//
+//    void Stage() {
+//      COLMAP_TRACE_SCOPE("stage");
+//      TraceValue("stage/num_items", items.size());
+//    }
+//
+// Every thread records into its own buffer, which keeps the most recent
+// events for the Chrome trace export (chrome://tracing or Perfetto) in a ring
+// and the exact aggregated statistics of all events for the summary. Tracing
+// is disabled by default, in which case recording only costs a relaxed atomic
+// load. Names are identified by pointer and must outlive the tracer, so
+// string literals should be used.
+class Tracer {
+ public:
+  struct Options {
+    // Maximum number of most recent events per thread kept for the trace.
+    int max_num_events_per_thread = 1 << 16;
+
+    // If not empty, the Chrome trace is written to this path on `Finish`.
+    std::string output_path = "";
+
+    bool Check() const;
+  };
+
+  static Tracer& Instance();
+
+  // Enable recording and discard all previously recorded events.
+  void Enable(const Options& options);
+  void Disable();
+  inline bool IsEnabled() const;
+
+  // Discard all recorded events and statistics.
+  void Clear();
+
+  // Microseconds since the creation of the tracer.
+  int64_t NowMicroSeconds() const;
+
+  // Record events for the calling thread. Ignored if tracing is disabled.
+  void RecordSpan(const char* name, int64_t begin_us, int64_t end_us);
+  void RecordCounter(const char* name, double increment);
+  void RecordValue(const char* name, double value);
+
+  // Statistics of all recorded events merged across threads, sorted by name.
+  std::vector<TraceStats> Stats() const;
+
+  // Number of events that were overwritten in the ring buffers and are thus
+  // missing from the trace but not from the statistics.
+  size_t NumDroppedEvents() const;
+
+  // Write the recorded events in the Chrome trace event JSON format.
+  void WriteChromeTrace(const std::string& path) const;
+
+  // Human-readable table of the statistics, with durations in milliseconds.
+  std::string Summary() const;
+
+  // Write the trace to the output path, log the summary, and disable tracing.
+  // Does nothing if tracing is disabled.
+  void Finish();
+
+ private:
+  struct Event;
+  struct ThreadBuffer;
+  struct ThreadBufferHandle;
+
+  Tracer();
+
+  ThreadBuffer* GetThreadBuffer();
+  void ReleaseThreadBuffer(ThreadBuffer* thread_buffer);
+  void Record(Event event);
+
+  std::atomic<bool> enabled_;
+  const std::chrono::steady_clock::time_point start_time_;
+
+  mutable std::mutex mutex_;
+  Options options_;
+  std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers_;
+  std::vector<ThreadBuffer*> free_thread_buffers_;
+};
+
+// Records the lifetime of the object as a span, if tracing is enabled at
+// construction. Use the COLMAP_TRACE_SCOPE macro for anonymous spans.
+class ScopedTraceSpan {
+ public:
+  explicit ScopedTraceSpan(const char* name);
+  ~ScopedTraceSpan();
+
+  ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+  ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+ private:
+  const char* name_ = nullptr;
+  int64_t begin_us_ = 0;
+};
+
+// Add the increment to the counter of the given name.
+inline void TraceCounter(const char* name, double increment = 1);
+
+// Add a sample to the value distribution of the given name.
+inline void TraceValue(const char* name, double value);
+
+#define COLMAP_TRACE_CONCAT_IMPL(a, b) a##b
+#define COLMAP_TRACE_CONCAT(a, b) COLMAP_TRACE_CONCAT_IMPL(a, b)
+#define COLMAP_TRACE_SCOPE(name) \
+  ::colmap::ScopedTraceSpan COLMAP_TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool Tracer::IsEnabled() const {
+  return enabled_.load(std::memory_order_relaxed);
+}
+
+inline ScopedTraceSpan::ScopedTraceSpan(const char* name) {
+  Tracer& tracer = Tracer::Instance();
+  if (tracer.IsEnabled()) {
+    name_ = name;
+    begin_us_ = tracer.NowMicroSeconds();
+  }
+}
+
+inline ScopedTraceSpan::~ScopedTraceSpan() {
+  if (name_ != nullptr) {
+    Tracer& tracer = Tracer::Instance();
+    tracer.RecordSpan(name_, begin_us_, tracer.NowMicroSeconds());
+  }
+}
+
+void TraceCounter(const char* name, const double increment) {
+  Tracer& tracer = Tracer::Instance();
+  if (tracer.IsEnabled()) {
+    tracer.RecordCounter(name, increment);
+  }
+}
+
+void TraceValue(const char* name, const double value) {
+  Tracer& tracer = Tracer::Instance();
+  if (tracer.IsEnabled()) {
+    tracer.RecordValue(name, value);
+  }
+}
+
+}  // namespace colmap
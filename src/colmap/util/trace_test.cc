@@ -0,0 +1,187 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/trace.h"
+
+#include "colmap/util/testing.h"
+
+#include <thread>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(TraceStats, Empty) {
+  TraceStats stats;
+  EXPECT_EQ(stats.count, 0);
+  EXPECT_EQ(stats.Mean(), 0);
+  EXPECT_EQ(stats.Quantile(0.5), 0);
+}
+
+TEST(TraceStats, AddMerge) {
+  TraceStats stats1;
+  for (int i = 1; i <= 100; ++i) {
+    stats1.Add(i);
+  }
+  EXPECT_EQ(stats1.count, 100);
+  EXPECT_EQ(stats1.sum, 5050);
+  EXPECT_EQ(stats1.min, 1);
+  EXPECT_EQ(stats1.max, 100);
+  EXPECT_EQ(stats1.Mean(), 50.5);
+  // The quantiles are the upper bounds of the bins [1, 2), [32, 64), and
+  // [64, 128) clamped to the maximum value.
+  EXPECT_EQ(stats1.Quantile(0), 2);
+  EXPECT_EQ(stats1.Quantile(0.5), 64);
+  EXPECT_EQ(stats1.Quantile(0.99), 100);
+  EXPECT_EQ(stats1.Quantile(1), 100);
+
+  TraceStats stats2;
+  stats2.Add(0.5);
+  stats2.Add(1000);
+  stats1.Merge(stats2);
+  EXPECT_EQ(stats1.count, 102);
+  EXPECT_EQ(stats1.sum, 6050.5);
+  EXPECT_EQ(stats1.min, 0.5);
+  EXPECT_EQ(stats1.max, 1000);
+  EXPECT_EQ(stats1.Quantile(0), 1);
+  EXPECT_EQ(stats1.Quantile(1), 1000);
+}
+
+TEST(Tracer, Disabled) {
+  Tracer& tracer = Tracer::Instance();
+  tracer.Enable(Tracer::Options());
+  tracer.Disable();
+  EXPECT_FALSE(tracer.IsEnabled());
+  {
+    COLMAP_TRACE_SCOPE("span");
+    TraceCounter("counter");
+    TraceValue("value", 1);
+  }
+  EXPECT_TRUE(tracer.Stats().empty());
+}
+
+TEST(Tracer, MultipleThreads) {
+  Tracer& tracer = Tracer::Instance();
+  tracer.Enable(Tracer::Options());
+  EXPECT_TRUE(tracer.IsEnabled());
+
+  const int kNumThreads = 4;
+  const int kNumIterations = 100;
+  // Run twice to reuse the buffers of the exited threads.
+  for (int run = 0; run < 2; ++run) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+      threads.emplace_back([]() {
+        for (int j = 0; j < kNumIterations; ++j) {
+          COLMAP_TRACE_SCOPE("span");
+          TraceCounter("counter", 2);
+          TraceValue("value", j);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  const std::vector<TraceStats> stats = tracer.Stats();
+  ASSERT_EQ(stats.size(), 3);
+  EXPECT_EQ(stats[0].name, "counter");
+  EXPECT_EQ(stats[0].type, TraceStats::Type::COUNTER);
+  EXPECT_EQ(stats[0].count, 2 * kNumThreads * kNumIterations);
+  EXPECT_EQ(stats[0].sum, 4 * kNumThreads * kNumIterations);
+  EXPECT_EQ(stats[1].name, "span");
+  EXPECT_EQ(stats[1].type, TraceStats::Type::SPAN);
+  EXPECT_EQ(stats[1].count, 2 * kNumThreads * kNumIterations);
+  EXPECT_GE(stats[1].min, 0);
+  EXPECT_EQ(stats[2].name, "value");
+  EXPECT_EQ(stats[2].type, TraceStats::Type::VALUE);
+  EXPECT_EQ(stats[2].count, 2 * kNumThreads * kNumIterations);
+  EXPECT_EQ(stats[2].min, 0);
+  EXPECT_EQ(stats[2].max, kNumIterations - 1);
+  EXPECT_EQ(tracer.NumDroppedEvents(), 0);
+  EXPECT_NE(tracer.Summary().find("counter"), std::string::npos);
+
+  tracer.Clear();
+  EXPECT_TRUE(tracer.Stats().empty());
+  tracer.Disable();
+}
+
+TEST(Tracer, WriteChromeTrace) {
+  Tracer& tracer = Tracer::Instance();
+  Tracer::Options options;
+  options.max_num_events_per_thread = 4;
+  tracer.Enable(options);
+
+  for (int i = 0; i < 10; ++i) {
+    COLMAP_TRACE_SCOPE("span \"quoted\"");
+    TraceCounter("counter");
+  }
+
+  // All events enter the statistics but only the most recent the trace.
+  const std::vector<TraceStats> stats = tracer.Stats();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].count, 10);
+  EXPECT_EQ(stats[1].count, 10);
+  EXPECT_EQ(tracer.NumDroppedEvents(), 16);
+
+  const std::string path = CreateTestDir() + "/trace.json";
+  tracer.WriteChromeTrace(path);
+  tracer.Disable();
+
+  boost::property_tree::ptree trace;
+  boost::property_tree::read_json(path, trace);
+  EXPECT_EQ(trace.get<int>("otherData.num_dropped_events"), 16);
+  const auto& events = trace.get_child("traceEvents");
+  ASSERT_EQ(events.size(), 4);
+  int64_t prev_timestamp = 0;
+  double prev_total = 0;
+  for (const auto& event : events) {
+    const int64_t timestamp = event.second.get<int64_t>("ts");
+    EXPECT_GE(timestamp, prev_timestamp);
+    prev_timestamp = timestamp;
+    if (event.second.get<std::string>("ph") == "X") {
+      EXPECT_EQ(event.second.get<std::string>("name"), "span \"quoted\"");
+      EXPECT_GE(event.second.get<int64_t>("dur"), 0);
+    } else {
+      EXPECT_EQ(event.second.get<std::string>("ph"), "C");
+      EXPECT_EQ(event.second.get<std::string>("name"), "counter");
+      const double total = event.second.get_child("args").front().second
+                               .get_value<double>();
+      EXPECT_GT(total, prev_total);
+      prev_total = total;
+    }
+  }
+  EXPECT_EQ(prev_total, 10);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -105,6 +105,7 @@ void BindAbsolutePoseEstimator(py::module& m) {
                      &AbsolutePoseEstimationOptions::min_focal_length_ratio)
       .def_readwrite("max_focal_length_ratio",
                      &AbsolutePoseEstimationOptions::max_focal_length_ratio)
+      .def_readwrite("use_prosac", &AbsolutePoseEstimationOptions::use_prosac)
       .def_readwrite("ransac", &AbsolutePoseEstimationOptions::ransac_options);
   MakeDataclass(PyEstimationOptions);
   auto est_options =
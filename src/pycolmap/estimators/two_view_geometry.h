@@ -62,6 +62,7 @@ void BindTwoViewGeometryEstimator(py::module& m) {
                      &TwoViewGeometryOptions::compute_relative_pose)
       .def_readwrite("multiple_models",
                      &TwoViewGeometryOptions::multiple_models)
+      .def_readwrite("use_prosac", &TwoViewGeometryOptions::use_prosac)
       .def_readwrite("ransac", &TwoViewGeometryOptions::ransac_options);
   MakeDataclass(PyTwoViewGeometryOptions);
   auto tvg_options = PyTwoViewGeometryOptions().cast<TwoViewGeometryOptions>();
@@ -24,6 +24,7 @@ void BindOptim(py::module& m) {
           .def_readwrite("dyn_num_trials_multiplier",
                          &RANSACOptions::dyn_num_trials_multiplier)
           .def_readwrite("min_num_trials", &RANSACOptions::min_num_trials)
-          .def_readwrite("max_num_trials", &RANSACOptions::max_num_trials);
+          .def_readwrite("max_num_trials", &RANSACOptions::max_num_trials)
+          .def_readwrite("use_sprt", &RANSACOptions::use_sprt);
   MakeDataclass(PyRANSACOptions);
 }
@@ -113,6 +113,21 @@ void BindExtractFeatures(py::module& m) {
                          &SEOpts::max_num_orientations,
                          "Maximum number of orientations per keypoint if not "
                          "estimate_affine_shape.")
+          .def_readwrite("two_pass_extraction",
+                         &SEOpts::two_pass_extraction,
+                         "Whether the CPU extractor only computes "
+                         "orientations and descriptors for the keypoints "
+                         "kept under max_num_features.")
+          .def_readwrite("num_image_threads",
+                         &SEOpts::num_image_threads,
+                         "Number of threads used within a single image by "
+                         "the CPU extractor.")
+          .def_readwrite("tile_size",
+                         &SEOpts::tile_size,
+                         "If positive, images larger than this size are split "
+                         "into overlapping tiles, which are extracted in "
+                         "parallel. The output only approximates that of the "
+                         "whole image. Disabled if 0.")
           .def_readwrite("upright",
                          &SEOpts::upright,
                          "Fix the orientation to 0 for upright features")
@@ -185,7 +185,12 @@ void BindImages(py::module& m) {
               &IROpts::camera_mask_path,
               "Optional path to an image file specifying a mask for all "
               "images. No features will be extracted in regions where the "
-              "mask is black (pixel intensity value 0 in grayscale)");
+              "mask is black (pixel intensity value 0 in grayscale)")
+          .def_readwrite(
+              "feature_store_path",
+              &IROpts::feature_store_path,
+              "Optional path to a feature store directory, in which the "
+              "extracted features are stored instead of the database.");
   MakeDataclass(PyImageReaderOptions);
   auto reader_options = PyImageReaderOptions().cast<IROpts>();
 
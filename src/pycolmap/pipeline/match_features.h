@@ -98,7 +98,27 @@ void BindMatchFeatures(py::module& m) {
           .def_readwrite("guided_matching",
                          &SMOpts::guided_matching,
                          "Whether to perform guided matching, if geometric "
-                         "verification succeeds.");
+                         "verification succeeds.")
+          .def_readwrite("cpu_index_cache_size",
+                         &SMOpts::cpu_index_cache_size,
+                         "Maximum memory in megabytes of the per-image search "
+                         "indices for CPU matching, which are shared by all "
+                         "matching threads. Set to 0 to disable the cache.")
+          .def_readwrite("cpu_index_cache_path",
+                         &SMOpts::cpu_index_cache_path,
+                         "Optional directory, e.g., next to the database, in "
+                         "which the search indices for CPU matching are "
+                         "persisted and reused in later matching runs.")
+          .def_readwrite("cpu_batch_size",
+                         &SMOpts::cpu_batch_size,
+                         "Maximum number of image pairs with the same first "
+                         "image that one CPU matching thread matches in a "
+                         "single pass. Set to 1 to match pairs separately.")
+          .def_readwrite("feature_store_path",
+                         &SMOpts::feature_store_path,
+                         "Optional path to a feature store directory, from "
+                         "which features are read and to which raw matches "
+                         "are written instead of the database.");
   MakeDataclass(PySiftMatchingOptions);
   auto sift_matching_options = PySiftMatchingOptions().cast<SMOpts>();
 
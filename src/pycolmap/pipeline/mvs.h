@@ -1,13 +1,10 @@
 #pragma once
 
 #include "colmap/mvs/fusion.h"
+#include "colmap/mvs/patch_match.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/util/misc.h"
 
-#ifdef COLMAP_CUDA_ENABLED
-#include "colmap/mvs/patch_match.h"
-#endif  // COLMAP_CUDA_ENABLED
-
 #include "colmap/util/logging.h"
 
 #include "pycolmap/helpers.h"
@@ -21,7 +18,6 @@ using namespace colmap;
 using namespace pybind11::literals;
 namespace py = pybind11;
 
-#ifdef COLMAP_CUDA_ENABLED
 void PatchMatchStereo(const std::string& workspace_path,
                       std::string workspace_format,
                       const std::string& pmvs_option_name,
@@ -38,7 +34,6 @@ void PatchMatchStereo(const std::string& workspace_path,
       options, workspace_path, workspace_format, pmvs_option_name, config_path);
   controller.Run();
 }
-#endif  // COLMAP_CUDA_ENABLED
 
 Reconstruction StereoFusion(const std::string& output_path,
                             const std::string& workspace_path,
@@ -83,7 +78,6 @@ Reconstruction StereoFusion(const std::string& output_path,
 }
 
 void BindMVS(py::module& m) {
-#ifdef COLMAP_CUDA_ENABLED
   using PMOpts = mvs::PatchMatchOptions;
   auto PyPatchMatchOptions =
       py::class_<PMOpts>(m, "PatchMatchOptions")
@@ -91,12 +85,20 @@ void BindMVS(py::module& m) {
           .def_readwrite("max_image_size",
                          &PMOpts::max_image_size,
                          "Maximum image size in either dimension.")
+          .def_readwrite("use_gpu",
+                         &PMOpts::use_gpu,
+                         "Whether to use the CUDA implementation of patch "
+                         "match, if available.")
           .def_readwrite(
               "gpu_index",
               &PMOpts::gpu_index,
               "Index of the GPU used for patch match. For multi-GPU usage, "
               "you should separate multiple GPU indices by comma, e.g., "
               "\"0,1,2,3\".")
+          .def_readwrite("num_threads",
+                         &PMOpts::num_threads,
+                         "The number of threads used by the CPU "
+                         "implementation.")
           .def_readwrite("depth_min", &PMOpts::depth_min)
           .def_readwrite("depth_max", &PMOpts::depth_max)
           .def_readwrite(
@@ -180,8 +182,7 @@ void BindMVS(py::module& m) {
         "pmvs_option_name"_a = "option-all",
         "options"_a = patch_match_options,
         "config_path"_a = "",
-        "Runs Patch-Match-Stereo (requires CUDA)");
-#endif  // COLMAP_CUDA_ENABLED
+        "Runs Patch-Match-Stereo");
 
   using SFOpts = mvs::StereoFusionOptions;
   auto PyStereoFusionOptions =
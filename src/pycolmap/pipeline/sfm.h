@@ -236,6 +236,15 @@ void BindSfM(py::module& m) {
                      &MapperOpts::snapshot_images_freq,
                      "Frequency of registered images according to which "
                      "reconstruction snapshots will be saved.")
+      .def_readwrite("database_cache_path",
+                     &MapperOpts::database_cache_path,
+                     "Path to a binary snapshot of the loaded database, which "
+                     "is reused if it matches the database and options and "
+                     "is (re-)written otherwise.")
+      .def_readwrite("feature_store_path",
+                     &MapperOpts::feature_store_path,
+                     "Optional path to a feature store directory, from which "
+                     "the keypoints are read instead of the database.")
       .def_readwrite("image_names",
                      &MapperOpts::image_names,
                      "Which images to reconstruct. If no images are specified, "
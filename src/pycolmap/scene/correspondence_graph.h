@@ -56,7 +56,7 @@ void BindCorrespondenceGraph(py::module& m) {
               const image_t image_id2) {
              return self.NumCorrespondencesBetweenImages(image_id1, image_id2);
            })
-      .def("finalize", &CorrespondenceGraph::Finalize)
+      .def("finalize", &CorrespondenceGraph::Finalize, "num_threads"_a = 1)
       .def("add_image", &CorrespondenceGraph::AddImage)
       .def(
           "add_correspondences",
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "colmap/scene/point3d.h"
+#include "colmap/scene/point3d_map.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/types.h"
@@ -18,7 +19,6 @@
 using namespace colmap;
 namespace py = pybind11;
 
-using Point3DMap = std::unordered_map<point3D_t, Point3D>;
 PYBIND11_MAKE_OPAQUE(Point3DMap);
 
 void BindPoint3D(py::module& m) {
@@ -42,6 +42,11 @@ void BindIncrementalMapper(py::module& m) {
           "init_max_reg_trials",
           &Opts::init_max_reg_trials,
           "Maximum number of trials to use an image for initialization.")
+      .def_readwrite("init_num_scored_pairs",
+                     &Opts::init_num_scored_pairs,
+                     "Number of suitable initial image pairs, in ranked order, "
+                     "among which the pair with the most inlier matches is "
+                     "chosen.")
       .def_readwrite("abs_pose_max_error",
                      &Opts::abs_pose_max_error,
                      "Maximum reprojection error in absolute pose estimation.")
@@ -51,6 +56,10 @@ void BindIncrementalMapper(py::module& m) {
       .def_readwrite("abs_pose_min_inlier_ratio",
                      &Opts::abs_pose_min_inlier_ratio,
                      "Minimum inlier ratio in absolute pose estimation.")
+      .def_readwrite("abs_pose_use_prosac",
+                     &Opts::abs_pose_use_prosac,
+                     "Whether to sample the 2D-3D correspondences with PROSAC "
+                     "in absolute pose estimation.")
       .def_readwrite(
           "abs_pose_refine_focal_length",
           &Opts::abs_pose_refine_focal_length,
@@ -66,6 +75,11 @@ void BindIncrementalMapper(py::module& m) {
                      &Opts::local_ba_min_tri_angle,
                      "Minimum triangulation for images to be chosen in local "
                      "bundle adjustment.")
+      .def_readwrite("local_ba_persistent",
+                     &Opts::local_ba_persistent,
+                     "Whether to keep the local bundle adjustment problem "
+                     "across image registrations and only update the "
+                     "residuals that changed.")
       .def_readwrite("min_focal_length_ratio",
                      &Opts::min_focal_length_ratio,
                      "The threshold used to filter and ignore images with "
@@ -88,6 +102,10 @@ void BindIncrementalMapper(py::module& m) {
       .def_readwrite("max_reg_trials",
                      &Opts::max_reg_trials,
                      "Maximum number of trials to register an image.")
+      .def_readwrite("num_speculative_reg_images",
+                     &Opts::num_speculative_reg_images,
+                     "Number of next image candidates whose poses are "
+                     "speculatively estimated in parallel.")
       .def_readwrite("fix_existing_images",
                      &Opts::fix_existing_images,
                      "If reconstruction is provided as input, fix the existing "